@@ -20,6 +20,7 @@
 #ifndef RIPPLE_KEYCACHE_H_INCLUDED
 #define RIPPLE_KEYCACHE_H_INCLUDED
 
+#include <algorithm>
 #include <mutex>
 #include <unordered_map>
 
@@ -38,6 +39,9 @@ namespace ripple {
     The cache has a target size and an expiration time. When cached items become
     older than the maximum age they are eligible for removal during a
     call to @ref sweep.
+
+    The target may also be given in bytes. Every entry costs the same, so
+    this is converted to a number of entries using bytesPerEntry.
 */
 // VFALCO TODO Figure out how to pass through the allocator
 template <
@@ -94,11 +98,16 @@ private:
     clock_type& m_clock;
     std::string const m_name;
     unsigned int m_target_size;
+    std::size_t m_target_bytes;
     clock_type::duration m_target_age;
 
 public:
     typedef typename map_type::size_type size_type;
 
+    /** The approximate memory used by one entry, including the map node. */
+    static std::size_t const bytesPerEntry =
+        sizeof (typename map_type::value_type) + 2 * sizeof (void*);
+
     /** Construct with the specified name.
 
         @param size The initial target size.
@@ -113,6 +122,7 @@ public:
         , m_clock (clock)
         , m_name (name)
         , m_target_size (target_size)
+        , m_target_bytes (0)
         , m_target_age (std::chrono::seconds (expiration_seconds))
     {
         assert (m_target_size >= 0);
@@ -127,6 +137,7 @@ public:
         , m_clock (clock)
         , m_name (name)
         , m_target_size (target_size)
+        , m_target_bytes (0)
         , m_target_age (std::chrono::seconds (expiration_seconds))
     {
         assert (m_target_size >= 0);
@@ -153,6 +164,12 @@ public:
         return m_map.size ();
     }
 
+    /** Returns the approximate memory used by the entries. */
+    std::size_t bytes () const
+    {
+        return size () * bytesPerEntry;
+    }
+
     /** Empty the cache */
     void clear ()
     {
@@ -166,6 +183,13 @@ public:
         m_target_size = s;
     }
 
+    /** Set the desired memory use, or zero for no byte limit. */
+    void setTargetBytes (std::size_t bytes)
+    {
+        lock_guard lock (m_mutex);
+        m_target_bytes = bytes;
+    }
+
     void setTargetAge (size_type s)
     {
         lock_guard lock (m_mutex);
@@ -250,15 +274,17 @@ public:
 
         lock_guard lock (m_mutex);
 
-        if (m_target_size == 0 ||
-            (m_map.size () <= m_target_size))
+        size_type const target_size (targetSize ());
+
+        if (target_size == 0 ||
+            (m_map.size () <= target_size))
         {
             when_expire = now - m_target_age;
         }
         else
         {
             when_expire = now - clock_type::duration (
-                m_target_age.count() * m_target_size / m_map.size ());
+                m_target_age.count() * target_size / m_map.size ());
 
             clock_type::duration const minimumAge (
                 std::chrono::seconds (1));
@@ -287,6 +313,21 @@ public:
     }
 
 private:
+    // The tighter of the entry and byte targets, or zero for no limit
+    size_type targetSize () const
+    {
+        if (m_target_bytes == 0)
+            return m_target_size;
+
+        size_type const byEntries (std::max <size_type> (
+            1, m_target_bytes / bytesPerEntry));
+
+        if (m_target_size == 0)
+            return byEntries;
+
+        return std::min <size_type> (m_target_size, byEntries);
+    }
+
     void collect_metrics ()
     {
         m_stats.size.set (size ());
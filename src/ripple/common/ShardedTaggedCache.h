@@ -0,0 +1,306 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_SHARDEDTAGGEDCACHE_H_INCLUDED
+#define RIPPLE_SHARDEDTAGGEDCACHE_H_INCLUDED
+
+#include "TaggedCache.h"
+
+#include <atomic>
+#include <memory>
+
+namespace ripple {
+
+/** A TaggedCache split into independently locked shards.
+
+    Each key is assigned to one of a fixed number of shards by its hash, and
+    every shard is a complete TaggedCache with its own mutex. Threads working
+    on different keys rarely wait for each other, which matters for the hot
+    caches that every JobQueue thread goes through.
+
+    The interface matches TaggedCache, except that there is no single mutex
+    to expose. The target size and target bytes are divided evenly among
+    the shards, and sweep() locks only one shard at a time. sweepShard()
+    sweeps just the next shard, so the work can also be spread out over
+    several calls.
+*/
+template <
+    class Key,
+    class T,
+    class Hash = beast::hardened_hash <Key>,
+    class KeyEqual = std::equal_to <Key>,
+    class Mutex = std::recursive_mutex
+>
+class ShardedTaggedCache
+{
+public:
+    typedef TaggedCache <Key, T, Hash, KeyEqual, Mutex> shard_type;
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef typename shard_type::weak_mapped_ptr weak_mapped_ptr;
+    typedef typename shard_type::mapped_ptr mapped_ptr;
+    typedef typename shard_type::clock_type clock_type;
+    typedef typename shard_type::cost_function cost_function;
+
+    static std::size_t const defaultShardCount = 16;
+
+public:
+    ShardedTaggedCache (std::string const& name, int size,
+        typename clock_type::rep expiration_seconds, clock_type& clock, beast::Journal journal,
+            beast::insight::Collector::ptr const& collector = beast::insight::NullCollector::New (),
+                cost_function const& cost = cost_function (),
+                    std::size_t shards = defaultShardCount)
+        : m_clock (clock)
+        , m_stats (name,
+            std::bind (&ShardedTaggedCache::collect_metrics, this),
+                collector)
+        , m_target_size (size)
+        , m_target_bytes (0)
+        , m_next_sweep (0)
+    {
+        assert (shards > 0);
+
+        m_shards.reserve (shards);
+        for (std::size_t i = 0; i < shards; ++i)
+            m_shards.emplace_back (new shard_type (name,
+                shardTargetSize (size, shards), expiration_seconds,
+                    clock, journal, beast::insight::NullCollector::New (),
+                        cost));
+    }
+
+public:
+    /** Return the clock associated with the cache. */
+    clock_type& clock ()
+    {
+        return m_clock;
+    }
+
+    std::size_t getShardCount () const
+    {
+        return m_shards.size ();
+    }
+
+    int getTargetSize () const
+    {
+        return m_target_size;
+    }
+
+    void setTargetSize (int s)
+    {
+        m_target_size = s;
+
+        for (auto& shard : m_shards)
+            shard->setTargetSize (shardTargetSize (s, m_shards.size ()));
+    }
+
+    std::size_t getTargetBytes () const
+    {
+        return m_target_bytes;
+    }
+
+    void setTargetBytes (std::size_t bytes)
+    {
+        m_target_bytes = bytes;
+
+        // Round up, as for the target size
+        std::size_t const shards (m_shards.size ());
+        for (auto& shard : m_shards)
+            shard->setTargetBytes ((bytes + shards - 1) / shards);
+    }
+
+    typename clock_type::rep getTargetAge () const
+    {
+        return m_shards.front ()->getTargetAge ();
+    }
+
+    void setTargetAge (typename clock_type::rep s)
+    {
+        for (auto& shard : m_shards)
+            shard->setTargetAge (s);
+    }
+
+    int getCacheSize ()
+    {
+        int size = 0;
+        for (auto& shard : m_shards)
+            size += shard->getCacheSize ();
+        return size;
+    }
+
+    std::size_t getCacheBytes ()
+    {
+        std::size_t bytes = 0;
+        for (auto& shard : m_shards)
+            bytes += shard->getCacheBytes ();
+        return bytes;
+    }
+
+    int getTrackSize ()
+    {
+        int size = 0;
+        for (auto& shard : m_shards)
+            size += shard->getTrackSize ();
+        return size;
+    }
+
+    float getHitRate ()
+    {
+        std::uint64_t hits (0);
+        std::uint64_t misses (0);
+        getHitsAndMisses (hits, misses);
+        return (static_cast<float> (hits) * 100) / (1.0f + hits + misses);
+    }
+
+    void clearStats ()
+    {
+        for (auto& shard : m_shards)
+            shard->clearStats ();
+    }
+
+    void clear ()
+    {
+        for (auto& shard : m_shards)
+            shard->clear ();
+    }
+
+    /** Sweep every shard, holding only one shard's lock at a time. */
+    void sweep ()
+    {
+        for (auto& shard : m_shards)
+            shard->sweep ();
+    }
+
+    /** Sweep the next shard in round robin order.
+        Calling this getShardCount() times does the same work as sweep().
+    */
+    void sweepShard ()
+    {
+        m_shards [m_next_sweep++ % m_shards.size ()]->sweep ();
+    }
+
+    bool del (key_type const& key, bool valid)
+    {
+        return shard (key).del (key, valid);
+    }
+
+    /** Replace aliased objects with originals.
+        @see TaggedCache::canonicalize
+    */
+    bool canonicalize (key_type const& key, boost::shared_ptr<T>& data, bool replace = false)
+    {
+        return shard (key).canonicalize (key, data, replace);
+    }
+
+    boost::shared_ptr<T> fetch (key_type const& key)
+    {
+        return shard (key).fetch (key);
+    }
+
+    bool insert (key_type const& key, T const& value)
+    {
+        return shard (key).insert (key, value);
+    }
+
+    bool retrieve (key_type const& key, T& data)
+    {
+        return shard (key).retrieve (key, data);
+    }
+
+    bool refreshIfPresent (key_type const& key)
+    {
+        return shard (key).refreshIfPresent (key);
+    }
+
+private:
+    static int shardTargetSize (int size, std::size_t shards)
+    {
+        // Round up so that a small non-zero target never becomes zero,
+        // which would mean "no limit".
+        return static_cast<int> ((size + shards - 1) / shards);
+    }
+
+    shard_type& shard (key_type const& key)
+    {
+        return *m_shards [m_hash (key) % m_shards.size ()];
+    }
+
+    void getHitsAndMisses (std::uint64_t& hits, std::uint64_t& misses)
+    {
+        for (auto& shard : m_shards)
+        {
+            std::uint64_t h, m;
+            shard->getHitsAndMisses (h, m);
+            hits += h;
+            misses += m;
+        }
+    }
+
+    void collect_metrics ()
+    {
+        m_stats.size.set (getCacheSize ());
+
+        {
+            std::uint64_t hits (0);
+            std::uint64_t misses (0);
+            getHitsAndMisses (hits, misses);
+
+            beast::insight::Gauge::value_type hit_rate (0);
+            auto const total (hits + misses);
+            if (total != 0)
+                hit_rate = (hits * 100) / total;
+            m_stats.hit_rate.set (hit_rate);
+        }
+    }
+
+private:
+    struct Stats
+    {
+        template <class Handler>
+        Stats (std::string const& prefix, Handler const& handler,
+            beast::insight::Collector::ptr const& collector)
+            : hook (collector->make_hook (handler))
+            , size (collector->make_gauge (prefix, "size"))
+            , hit_rate (collector->make_gauge (prefix, "hit_rate"))
+            { }
+
+        beast::insight::Hook hook;
+        beast::insight::Gauge size;
+        beast::insight::Gauge hit_rate;
+    };
+
+    clock_type& m_clock;
+    Stats m_stats;
+
+    // Chooses the shard for a key
+    Hash m_hash;
+
+    std::vector <std::unique_ptr <shard_type>> m_shards;
+
+    // Desired number of cache entries over all shards (0 = ignore)
+    std::atomic <int> m_target_size;
+
+    // Desired total cost of cached objects over all shards (0 = ignore)
+    std::atomic <std::size_t> m_target_bytes;
+
+    std::atomic <std::size_t> m_next_sweep;
+};
+
+}
+
+#endif
@@ -27,6 +27,7 @@
 
 #include <boost/smart_ptr.hpp>
 
+#include <algorithm>
 #include <functional>
 #include <mutex>
 #include <unordered_map>
@@ -46,6 +47,11 @@ struct TaggedCacheLog;
     If it stays in memory even after it is ejected from the cache,
     the map will track it.
 
+    The cache can be limited by a number of objects, by a number of bytes,
+    or both. Bytes are counted with an optional cost function that returns
+    the approximate memory used by an object. Without one, every object
+    costs nothing and only the object count applies.
+
     @note Callers must not modify data objects that are stored in the cache
           unless they hold their own lock over all cache operations.
 */
@@ -71,21 +77,26 @@ public:
     typedef boost::weak_ptr <mapped_type> weak_mapped_ptr;
     typedef boost::shared_ptr <mapped_type> mapped_ptr;
     typedef beast::abstract_clock <std::chrono::seconds> clock_type;
+    typedef std::function <std::size_t (mapped_type const&)> cost_function;
 
 public:
     // VFALCO TODO Change expiration_seconds to clock_type::duration
     TaggedCache (std::string const& name, int size,
         clock_type::rep expiration_seconds, clock_type& clock, beast::Journal journal,
-            beast::insight::Collector::ptr const& collector = beast::insight::NullCollector::New ())
+            beast::insight::Collector::ptr const& collector = beast::insight::NullCollector::New (),
+                cost_function const& cost = cost_function ())
         : m_journal (journal)
         , m_clock (clock)
         , m_stats (name,
             std::bind (&TaggedCache::collect_metrics, this),
                 collector)
+        , m_cost (cost)
         , m_name (name)
         , m_target_size (size)
+        , m_target_bytes (0)
         , m_target_age (std::chrono::seconds (expiration_seconds))
         , m_cache_count (0)
+        , m_cache_bytes (0)
         , m_hits (0)
         , m_misses (0)
     {
@@ -116,6 +127,24 @@ public:
             m_name << " target size set to " << s;
     }
 
+    std::size_t getTargetBytes () const
+    {
+        lock_guard lock (m_mutex);
+        return m_target_bytes;
+    }
+
+    /** Set the desired number of bytes held by the cache.
+        Zero means there is no byte limit.
+    */
+    void setTargetBytes (std::size_t bytes)
+    {
+        lock_guard lock (m_mutex);
+        m_target_bytes = bytes;
+
+        if (m_journal.debug) m_journal.debug <<
+            m_name << " target bytes set to " << bytes;
+    }
+
     clock_type::rep getTargetAge () const
     {
         lock_guard lock (m_mutex);
@@ -136,6 +165,13 @@ public:
         return m_cache_count;
     }
 
+    /** Returns the total cost of the objects held in the cache. */
+    std::size_t getCacheBytes ()
+    {
+        lock_guard lock (m_mutex);
+        return m_cache_bytes;
+    }
+
     int getTrackSize ()
     {
         lock_guard lock (m_mutex);
@@ -148,6 +184,14 @@ public:
         return (static_cast<float> (m_hits) * 100) / (1.0f + m_hits + m_misses);
     }
 
+    /** Retrieve the raw counters behind getHitRate. */
+    void getHitsAndMisses (std::uint64_t& hits, std::uint64_t& misses) const
+    {
+        lock_guard lock (m_mutex);
+        hits = m_hits;
+        misses = m_misses;
+    }
+
     void clearStats ()
     {
         lock_guard lock (m_mutex);
@@ -160,6 +204,7 @@ public:
         lock_guard lock (m_mutex);
         m_cache.clear ();
         m_cache_count = 0;
+        m_cache_bytes = 0;
     }
 
     void sweep ()
@@ -179,15 +224,30 @@ public:
 
             lock_guard lock (m_mutex);
 
-            if (m_target_size == 0 ||
-                (static_cast<int> (m_cache.size ()) <= m_target_size))
+            bool const overSize = m_target_size != 0 &&
+                (static_cast<int> (m_cache.size ()) > m_target_size);
+            bool const overBytes = m_target_bytes != 0 &&
+                (m_cache_bytes > m_target_bytes);
+
+            if (!overSize && !overBytes)
             {
                 when_expire = now - m_target_age;
             }
             else
             {
-                when_expire = now - clock_type::duration (
-                    m_target_age.count() * m_target_size / m_cache.size ());
+                // Shorten the age in proportion to how far over
+                // target we are, using whichever limit is tighter.
+                clock_type::rep age = m_target_age.count();
+
+                if (overSize)
+                    age = std::min <clock_type::rep> (age,
+                        m_target_age.count() * m_target_size / m_cache.size ());
+
+                if (overBytes)
+                    age = std::min <clock_type::rep> (age,
+                        m_target_age.count() * m_target_bytes / m_cache_bytes);
+
+                when_expire = now - clock_type::duration (age);
 
                 clock_type::duration const minimumAge (
                     std::chrono::seconds (1));
@@ -196,6 +256,7 @@ public:
 
                 if (m_journal.trace) m_journal.trace <<
                     m_name << " is growing fast " << m_cache.size () << " of " << m_target_size <<
+                        ", " << m_cache_bytes << " of " << m_target_bytes << " bytes" <<
                         " aging at " << (now - when_expire) << " of " << m_target_age;
             }
 
@@ -222,6 +283,7 @@ public:
                 {
                     // strong, expired
                     --m_cache_count;
+                    m_cache_bytes -= cit->second.cost;
                     ++cacheRemovals;
                     if (cit->second.ptr.unique ())
                     {
@@ -270,6 +332,7 @@ public:
         if (entry.isCached ())
         {
             --m_cache_count;
+            m_cache_bytes -= entry.cost;
             entry.ptr.reset ();
             ret = true;
         }
@@ -303,8 +366,10 @@ public:
 
         if (cit == m_cache.end ())
         {
-            m_cache.insert (cache_pair (key, Entry (m_clock.now(), data)));
+            std::size_t const cost (costOf (data));
+            m_cache.insert (cache_pair (key, Entry (m_clock.now(), data, cost)));
             ++m_cache_count;
+            m_cache_bytes += cost;
             return false;
         }
 
@@ -315,8 +380,11 @@ public:
         {
             if (replace)
             {
+                m_cache_bytes -= entry.cost;
                 entry.ptr = data;
                 entry.weak_ptr = data;
+                entry.cost = costOf (data);
+                m_cache_bytes += entry.cost;
             }
             else
             {
@@ -334,6 +402,7 @@ public:
             {
                 entry.ptr = data;
                 entry.weak_ptr = data;
+                entry.cost = costOf (data);
             }
             else
             {
@@ -342,12 +411,15 @@ public:
             }
 
             ++m_cache_count;
+            m_cache_bytes += entry.cost;
             return true;
         }
 
         entry.ptr = data;
         entry.weak_ptr = data;
+        entry.cost = costOf (data);
         ++m_cache_count;
+        m_cache_bytes += entry.cost;
 
         return false;
     }
@@ -380,6 +452,7 @@ public:
         {
             // independent of cache size, so not counted as a hit
             ++m_cache_count;
+            m_cache_bytes += entry.cost;
             return entry.ptr;
         }
 
@@ -443,6 +516,7 @@ public:
                 {
                     // We just put the object back in cache
                     ++m_cache_count;
+                    m_cache_bytes += entry.cost;
                     entry.touch (m_clock.now());
                     found = true;
                 }
@@ -474,6 +548,13 @@ public:
     }
 
 private:
+    std::size_t costOf (mapped_ptr const& data) const
+    {
+        if (!m_cost || !data)
+            return 0;
+        return m_cost (*data);
+    }
+
     void collect_metrics ()
     {
         m_stats.size.set (getCacheSize ());
@@ -512,12 +593,14 @@ private:
         mapped_ptr ptr;
         weak_mapped_ptr weak_ptr;
         clock_type::time_point last_access;
+        std::size_t cost;
 
         Entry (clock_type::time_point const& last_access_,
-            mapped_ptr const& ptr_)
+            mapped_ptr const& ptr_, std::size_t cost_)
             : ptr (ptr_)
             , weak_ptr (ptr_)
             , last_access (last_access_)
+            , cost (cost_)
         {
         }
 
@@ -538,17 +621,26 @@ private:
 
     mutex_type mutable m_mutex;
 
+    // Approximate memory used by an object
+    cost_function m_cost;
+
     // Used for logging
     std::string m_name;
 
     // Desired number of cache entries (0 = ignore)
     int m_target_size;
 
+    // Desired total cost of cached objects (0 = ignore)
+    std::size_t m_target_bytes;
+
     // Desired maximum cache age
     clock_type::duration m_target_age;
 
     // Number of items cached
     int m_cache_count;
+
+    // Total cost of the items cached
+    std::size_t m_cache_bytes;
     cache_type m_cache;  // Hold strong reference to recent objects
     std::uint64_t m_hits;
     std::uint64_t m_misses;
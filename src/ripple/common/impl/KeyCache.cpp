@@ -88,6 +88,23 @@ public:
             c.sweep ();
             expect (c.size () < 3);
         }
+
+        // Same again, but limited by bytes instead of entries
+        {
+            Cache c ("test", clock, 0, 3);
+            c.setTargetBytes (2 * Cache::bytesPerEntry);
+
+            expect (c.insert ("one"));
+            ++clock;
+            expect (c.insert ("two"));
+            ++clock;
+            expect (c.insert ("three"));
+            ++clock;
+            expect (c.size () == 3);
+            expect (c.bytes () == 3 * Cache::bytesPerEntry);
+            c.sweep ();
+            expect (c.size () < 3);
+        }
     }
 };
 
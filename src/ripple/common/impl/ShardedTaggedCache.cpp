@@ -0,0 +1,209 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include "../ShardedTaggedCache.h"
+
+#include "../../beast/beast/unit_test/suite.h"
+#include "../../beast/beast/chrono/manual_clock.h"
+
+#include <thread>
+
+namespace ripple {
+
+class ShardedTaggedCache_test : public beast::unit_test::suite
+{
+public:
+    typedef int Key;
+    typedef std::string Value;
+    typedef ShardedTaggedCache <Key, Value> Cache;
+
+    void testBasics ()
+    {
+        testcase ("basics");
+
+        beast::Journal const j;
+        beast::manual_clock <std::chrono::seconds> clock;
+        clock.set (0);
+
+        Cache c ("test", 1, 1, clock, j);
+        expect (c.getShardCount () == Cache::defaultShardCount);
+
+        // Enough keys that several shards are used
+        int const count = 100;
+
+        for (int i = 0; i < count; ++i)
+            expect (! c.insert (i, std::to_string (i)));
+        expect (c.getCacheSize () == count);
+        expect (c.getTrackSize () == count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            std::string s;
+            expect (c.retrieve (i, s) && s == std::to_string (i));
+        }
+
+        // Keep a strong pointer to one object and let everything age
+        Cache::mapped_ptr p1 (c.fetch (7));
+        expect (p1 != nullptr);
+        ++clock;
+        c.sweep ();
+        expect (c.getCacheSize () == 0);
+        expect (c.getTrackSize () == 1);
+
+        // Canonicalizing a copy gives back the original
+        Cache::mapped_ptr p2 (boost::make_shared <Value> ("7"));
+        expect (c.canonicalize (7, p2));
+        expect (p1.get () == p2.get ());
+        expect (c.getCacheSize () == 1);
+
+        p1.reset ();
+        p2.reset ();
+        ++clock;
+        c.sweep ();
+        expect (c.getCacheSize () == 0);
+        expect (c.getTrackSize () == 0);
+    }
+
+    void testSweepShard ()
+    {
+        testcase ("sweepShard");
+
+        beast::Journal const j;
+        beast::manual_clock <std::chrono::seconds> clock;
+        clock.set (0);
+
+        Cache c ("test", 0, 1, clock, j);
+
+        int const count = 200;
+
+        for (int i = 0; i < count; ++i)
+            c.insert (i, std::to_string (i));
+
+        ++clock;
+
+        // Each call sweeps one shard, a full cycle sweeps them all
+        int last = c.getTrackSize ();
+        for (std::size_t i = 0; i < c.getShardCount (); ++i)
+        {
+            c.sweepShard ();
+            int const now = c.getTrackSize ();
+            expect (now <= last);
+            last = now;
+        }
+        expect (c.getCacheSize () == 0);
+        expect (c.getTrackSize () == 0);
+    }
+
+    void run ()
+    {
+        testBasics ();
+        testSweepShard ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(ShardedTaggedCache,common,ripple);
+
+//------------------------------------------------------------------------------
+
+class ShardedTaggedCache_timing_test : public beast::unit_test::suite
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+    typedef beast::manual_clock <std::chrono::seconds> cache_clock;
+
+    // Many threads fetching, and canonicalizing on a miss, from a key
+    // space larger than the cache, like the tree node cache during sync.
+    template <class Cache>
+    clock_type::duration contend (Cache& c, int threads, int ops, int keys)
+    {
+        std::vector <std::thread> workers;
+
+        clock_type::time_point const start = clock_type::now ();
+
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back ([&c, t, ops, keys]
+            {
+                std::uint32_t x = 2463534242UL + t;
+
+                for (int i = 0; i < ops; ++i)
+                {
+                    // xorshift, cheap enough not to dominate the timing
+                    x ^= x << 13;
+                    x ^= x >> 17;
+                    x ^= x << 5;
+                    int const key = static_cast <int> (x % keys);
+
+                    typename Cache::mapped_ptr p (c.fetch (key));
+                    if (! p)
+                    {
+                        p = boost::make_shared <std::uint64_t> (key);
+                        c.canonicalize (key, p);
+                    }
+                }
+            });
+        }
+
+        for (auto& w : workers)
+            w.join ();
+
+        return clock_type::now () - start;
+    }
+
+    void run ()
+    {
+        beast::Journal const j;
+        cache_clock clock;
+        clock.set (0);
+
+        int const threads = std::max (4u, std::thread::hardware_concurrency ());
+        int const ops = 500000;
+        int const keys = 131072;
+
+        clock_type::duration t1 (clock_type::duration::max ());
+        clock_type::duration t2 (clock_type::duration::max ());
+
+        // Alternate between the two and keep the best of each,
+        // with fresh caches every round
+        for (int round = 0; round < 3; ++round)
+        {
+            {
+                TaggedCache <int, std::uint64_t> c ("single", 65536, 60, clock, j);
+                t1 = std::min (t1, contend (c, threads, ops, keys));
+                expect (c.getCacheSize () > 0);
+            }
+            {
+                ShardedTaggedCache <int, std::uint64_t> c ("sharded", 65536, 60, clock, j);
+                t2 = std::min (t2, contend (c, threads, ops, keys));
+                expect (c.getCacheSize () > 0);
+            }
+        }
+
+        log <<
+            threads << " threads x " << ops << " operations: " <<
+            "TaggedCache " << std::chrono::duration_cast <
+                std::chrono::milliseconds> (t1).count () << "ms, " <<
+            "ShardedTaggedCache " << std::chrono::duration_cast <
+                std::chrono::milliseconds> (t2).count () << "ms";
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(ShardedTaggedCache_timing,common,ripple);
+
+}
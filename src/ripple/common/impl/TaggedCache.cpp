@@ -143,6 +143,31 @@ public:
             expect (c.getCacheSize() == 0);
             expect (c.getTrackSize() == 0);
         }
+
+        // Limit the cache by bytes, using the string length as the cost,
+        // and make sure a sweep evicts sooner once it is over budget.
+        {
+            Cache b ("bytes", 0, 10, clock, j,
+                beast::insight::NullCollector::New (),
+                    [](Value const& v) { return v.size (); });
+
+            for (int i = 0; i < 10; ++i)
+                expect (! b.insert (i, std::string (50, 'x')));
+            expect (b.getCacheBytes () == 500);
+
+            ++clock;
+            ++clock;
+            b.sweep ();
+            expect (b.getCacheSize () == 10);
+            expect (b.getCacheBytes () == 500);
+
+            // Five times over budget ages objects five times faster
+            b.setTargetBytes (100);
+            b.sweep ();
+            expect (b.getCacheSize () == 0);
+            expect (b.getCacheBytes () == 0);
+            expect (b.getTrackSize () == 0);
+        }
     }
 };
 
@@ -82,6 +82,16 @@ public:
     virtual void write (void const* buffer, std::size_t bytes) = 0;
     /** @} */
 
+    /** Block until no more than `bytes` of written data remain unsent.
+        A caller producing a large reply uses this to keep pace with the
+        connection, instead of queueing the whole reply in memory. It
+        must not be called from a Handler function, since those run on
+        the threads that send the data.
+        @return `false` if the data can no longer be sent. Further writes
+                are then discarded.
+    */
+    virtual bool waitForWrites (std::size_t bytes) = 0;
+
     /** Output support using ostream. */
     /** @{ */
     ScopedStream operator<< (std::ostream& manip (std::ostream&))
@@ -20,7 +20,11 @@
 #ifndef RIPPLE_HTTP_PEER_H_INCLUDED
 #define RIPPLE_HTTP_PEER_H_INCLUDED
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 
 #include "../../ripple/common/MultiSocket.h"
 
@@ -51,7 +55,10 @@ public:
         dataTimeoutSeconds = 10,
 
         // Max seconds without completing the request
-        requestTimeoutSeconds = 30
+        requestTimeoutSeconds = 30,
+
+        // Max seconds a writer waits without any data being sent
+        writeTimeoutSeconds = 30
 
     };
 
@@ -64,7 +71,16 @@ public:
     std::unique_ptr <MultiSocket> m_socket;
     beast::MemoryBlock m_buffer;
     beast::HTTPRequestParser m_parser;
-    int m_writesPending;
+
+    // Buffers waiting to be sent. Only the front one is being written.
+    std::deque <SharedBuffer> m_writeQueue;
+
+    // Bytes passed to write() and not yet sent, for waitForWrites()
+    std::mutex m_writeMutex;
+    std::condition_variable m_writeCond;
+    std::size_t m_writeBytes;
+    bool m_writeFailed;
+
     bool m_closed;
     bool m_callClose;
     beast::SharedPtr <Peer> m_detach_ref;
@@ -80,7 +96,8 @@ public:
         , m_data_timer (m_impl.get_io_service())
         , m_request_timer (m_impl.get_io_service())
         , m_buffer (bufferSize)
-        , m_writesPending (0)
+        , m_writeBytes (0)
+        , m_writeFailed (false)
         , m_closed (false)
         , m_callClose (false)
         , m_errorCode (0)
@@ -159,6 +176,19 @@ public:
     // Send a copy of the data.
     void write (void const* buffer, std::size_t bytes)
     {
+        if (bytes == 0)
+            return;
+
+        {
+            std::lock_guard <std::mutex> lock (m_writeMutex);
+
+            // Nothing more can be sent
+            if (m_writeFailed)
+                return;
+
+            m_writeBytes += bytes;
+        }
+
         // Make sure this happens on an io_service thread.
         m_impl.get_io_service().dispatch (m_strand.wrap (
             boost::bind (&Peer::handle_write, Ptr (this),
@@ -166,6 +196,31 @@ public:
                     CompletionCounter (this))));
     }
 
+    // Block until the unsent data is no more than the given size
+    bool waitForWrites (std::size_t bytes)
+    {
+        std::unique_lock <std::mutex> lock (m_writeMutex);
+
+        while (m_writeBytes > bytes && ! m_writeFailed)
+        {
+            // Each completed write notifies us, so timing out means the
+            // peer has not taken any data for the whole period.
+            if (m_writeCond.wait_for (lock, std::chrono::seconds (
+                writeTimeoutSeconds)) == std::cv_status::timeout)
+            {
+                m_writeFailed = true;
+                lock.unlock ();
+
+                m_impl.get_io_service().dispatch (m_strand.wrap (
+                    boost::bind (&Peer::handle_write_timeout, Ptr (this),
+                        CompletionCounter (this))));
+                return false;
+            }
+        }
+
+        return ! m_writeFailed;
+    }
+
     // Make the Session asynchronous
     void detach ()
     {
@@ -246,6 +301,13 @@ public:
         async_write (buf);
     }
 
+    // Called when a writer gave up waiting for the peer to take data
+    void handle_write_timeout (CompletionCounter)
+    {
+        failed (boost::system::errc::make_error_code (
+            boost::system::errc::timed_out));
+    }
+
     // Called when the handshake completes
     //
     void handle_handshake (error_code ec, CompletionCounter)
@@ -306,17 +368,36 @@ public:
     void handle_write (error_code ec, std::size_t bytes_transferred,
         SharedBuffer buf, CompletionCounter)
     {
-        if (ec == boost::asio::error::operation_aborted)
-            return;
-
         if (ec != 0)
         {
-            failed (ec);
+            // The rest of the queue will never be sent
+            m_writeQueue.clear ();
+
+            {
+                std::lock_guard <std::mutex> lock (m_writeMutex);
+                m_writeFailed = true;
+                m_writeBytes = 0;
+            }
+            m_writeCond.notify_all ();
+
+            if (ec != boost::asio::error::operation_aborted)
+                failed (ec);
             return;
         }
 
-        bassert (m_writesPending > 0);
-        if (--m_writesPending == 0 && m_closed)
+        {
+            std::lock_guard <std::mutex> lock (m_writeMutex);
+            bassert (m_writeBytes >= buf->size ());
+            m_writeBytes -= buf->size ();
+        }
+        m_writeCond.notify_all ();
+
+        bassert (! m_writeQueue.empty ());
+        m_writeQueue.pop_front ();
+
+        if (! m_writeQueue.empty ())
+            start_write ();
+        else if (m_closed)
             m_socket->shutdown (socket::shutdown_send);
     }
 
@@ -473,12 +554,23 @@ public:
                         CompletionCounter (this))));
     }
 
-    // Send a shared buffer
+    // Send a shared buffer after any that are already queued.
+    // Only one composed write may be in progress on the stream at a
+    // time, so the next buffer is started from the completion handler.
     void async_write (SharedBuffer const& buf)
     {
         bassert (buf.get().size() > 0);
 
-        ++m_writesPending;
+        m_writeQueue.push_back (buf);
+
+        if (m_writeQueue.size () == 1)
+            start_write ();
+    }
+
+    // Start writing the buffer at the front of the queue
+    void start_write ()
+    {
+        SharedBuffer const& buf (m_writeQueue.front ());
 
         // Send the copy. We pass the SharedBuffer in the last parameter
         // so that a reference is maintained as the handler gets copied.
@@ -503,6 +595,11 @@ public:
         {
             typename BufferSequence::value_type const& buffer (*iter);
 
+            {
+                std::lock_guard <std::mutex> lock (m_writeMutex);
+                m_writeBytes += boost::asio::buffer_size (buffer);
+            }
+
             // Put a copy of this section of the buffer sequence into
             // a reference counted, shared container.
             //
@@ -0,0 +1,207 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include "../../../beast/beast/unit_test/suite.h"
+
+#include "../../common/RippleSSLContext.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace ripple {
+namespace HTTP {
+
+class Server_test : public beast::unit_test::suite
+{
+public:
+    enum
+    {
+        testPort = 51299,
+
+        // The reply is much larger than the socket buffers can hold
+        chunkBytes = 16 * 1024,
+        chunkCount = 4096,
+        totalBytes = chunkBytes * chunkCount,
+
+        maxPendingBytes = 4 * chunkBytes
+    };
+
+    // Each chunk is filled with its own byte, so that chunks arriving
+    // out of order or interleaved are seen by the client.
+    static char chunkByte (std::size_t chunk)
+    {
+        return static_cast <char> (chunk % 251);
+    }
+
+    // Writes a large reply from its own thread, as the RPC server does
+    // from the job queue, waiting whenever too much is queued.
+    class TestHandler : public Handler
+    {
+    public:
+        std::thread m_thread;
+        std::atomic <std::size_t> m_written;
+        std::atomic <bool> m_failed;
+
+        TestHandler ()
+            : m_written (0)
+            , m_failed (false)
+        {
+        }
+
+        ~TestHandler ()
+        {
+            if (m_thread.joinable ())
+                m_thread.join ();
+        }
+
+        void onAccept (Session&)
+        {
+        }
+
+        void onHeaders (Session&)
+        {
+        }
+
+        void onRequest (Session& session)
+        {
+            session.detach ();
+            m_thread = std::thread (&TestHandler::writeReply, this,
+                std::ref (session));
+        }
+
+        void onClose (Session&, int)
+        {
+        }
+
+        void onStopped (Server&)
+        {
+        }
+
+        void writeReply (Session& session)
+        {
+            std::string chunk;
+
+            for (std::size_t i = 0; i < chunkCount; ++i)
+            {
+                chunk.assign (chunkBytes, chunkByte (i));
+                session.write (chunk);
+                m_written += chunk.size ();
+
+                if (! session.waitForWrites (maxPendingBytes))
+                {
+                    m_failed = true;
+                    break;
+                }
+            }
+
+            session.close ();
+        }
+    };
+
+    //--------------------------------------------------------------------------
+
+    typedef boost::asio::ip::tcp::socket socket_type;
+
+    bool connect (socket_type& socket)
+    {
+        boost::asio::ip::tcp::endpoint const endpoint (
+            boost::asio::ip::address_v4::loopback (), testPort);
+
+        // The server opens its port on its own thread
+        for (int i = 0; i < 50; ++i)
+        {
+            boost::system::error_code ec;
+            socket.connect (endpoint, ec);
+            if (! ec)
+                return true;
+            socket.close ();
+            std::this_thread::sleep_for (std::chrono::milliseconds (100));
+        }
+        return false;
+    }
+
+    void testSlowReader ()
+    {
+        testcase ("slow reader");
+
+        std::unique_ptr <RippleSSLContext> context (
+            RippleSSLContext::createBare ());
+        TestHandler handler;
+        Server server (handler, beast::Journal ());
+
+        Ports ports;
+        ports.push_back (Port (testPort, beast::IP::Endpoint (
+            beast::IP::AddressV4 (127, 0, 0, 1)), Port::no_ssl, context.get ()));
+        server.setPorts (ports);
+
+        boost::asio::io_service io_service;
+        socket_type socket (io_service);
+        if (! expect (connect (socket), "connect"))
+            return;
+
+        std::string const request ("GET / HTTP/1.0\r\n\r\n");
+        boost::asio::write (socket, boost::asio::buffer (request));
+
+        // Until the client reads, the writer must stall once the socket
+        // buffers and the session's allowance are full.
+        std::size_t written (0);
+        for (int i = 0; i < 50; ++i)
+        {
+            std::this_thread::sleep_for (std::chrono::milliseconds (100));
+            std::size_t const now (handler.m_written);
+            if (now != 0 && now == written)
+                break;
+            written = now;
+        }
+        expect (written < totalBytes, "writer was held back");
+
+        std::vector <char> buffer (64 * 1024);
+        std::size_t received (0);
+        bool ordered (true);
+        for (;;)
+        {
+            boost::system::error_code ec;
+            std::size_t const bytes (socket.read_some (
+                boost::asio::buffer (buffer), ec));
+
+            for (std::size_t i = 0; ordered && i < bytes; ++i)
+                ordered = buffer [i] == chunkByte ((received + i) / chunkBytes);
+            received += bytes;
+
+            if (ec)
+                break;
+        }
+
+        expect (ordered, "chunks arrived in order");
+        expect (received == totalBytes, "whole reply received");
+        expect (! handler.m_failed, "writer was not failed");
+    }
+
+    void run ()
+    {
+        testSlowReader ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Server,http,ripple);
+
+}
+}
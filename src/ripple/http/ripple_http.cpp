@@ -36,3 +36,5 @@
 # include "impl/Door.h"
 #include "impl/ServerImpl.cpp"
 #include "impl/Server.cpp"
+
+#include "impl/Tests.cpp"
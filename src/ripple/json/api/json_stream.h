@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#ifndef RIPPLE_JSON_STREAM_H_INCLUDED
+#define RIPPLE_JSON_STREAM_H_INCLUDED
+
+#include <functional>
+
+namespace Json
+{
+
+/** Writes JSON text a piece at a time, as it is produced.
+
+    A response can be written a member or an array element at a time
+    instead of being built into one Value and rendered into one string.
+    The text goes into a buffer, and the buffer is handed to the output
+    whenever it fills up. So the memory in use stays around the buffer
+    size however large the document is, and the first bytes go out as
+    soon as the first buffer is full.
+
+    Nothing is handed to the output until the buffer fills or flush() is
+    called. A caller can check isStreaming() at the end, and take a small
+    document whole with release() instead.
+
+    The text is compact, as written by FastWriter.
+*/
+class Stream
+{
+public:
+    typedef std::function <void (char const* data, std::size_t size)> Output;
+
+    static std::size_t const defaultBufferSize = 64 * 1024;
+
+    explicit Stream (Output const& output,
+        std::size_t bufferSize = defaultBufferSize);
+
+    /** Open an object or an array.
+        At the top level or inside an array the collection is a new
+        element. Inside an object it is the member with the given name.
+    */
+    /** @{ */
+    void startObject ();
+    void startArray ();
+    void startObject (char const* key);
+    void startArray (char const* key);
+    /** @} */
+
+    /** Close the innermost open object or array. */
+    void finish ();
+
+    /** Returns the number of objects and arrays still open. */
+    std::size_t depth () const;
+
+    /** Write a complete value.
+        At the top level or inside an array the value is a new element.
+    */
+    void append (Value const& value);
+
+    /** Write a member of the innermost open object. */
+    void set (char const* key, Value const& value);
+
+    /** Write each member of the object as a member of the innermost open
+        object. Anything that is not an object is ignored.
+    */
+    void setMembers (Value const& object);
+
+    /** Hand everything buffered so far to the output. */
+    void flush ();
+
+    /** Returns `true` if any text has been handed to the output. */
+    bool isStreaming () const;
+
+    /** Take the buffered text instead of handing it to the output. */
+    std::string release ();
+
+private:
+    struct Level
+    {
+        char closer;
+        bool empty;
+    };
+
+    void open (char opener, char closer);
+    void separate ();
+    void writeKey (char const* key);
+    void writeValue (Value const& value);
+    void write (char const* text);
+    void write (std::string const& text);
+    void check ();
+
+    Output m_output;
+    std::size_t const m_bufferSize;
+    std::string m_buffer;
+    bool m_streaming;
+
+    // One entry for each open object or array
+    std::vector <Level> m_levels;
+};
+
+} // namespace Json
+
+#endif
@@ -301,6 +301,11 @@ public:
     ///
     /// Equivalent to jsonvalue[jsonvalue.size()] = value;
     Value& append ( const Value& value );
+    /// \brief Append value to array at the end, taking its contents.
+    ///
+    /// Subtrees built by getJson are moved into place instead of being
+    /// copied node by node.
+    Value& append ( Value&& value );
 
     /// Access an object value by name, create a null member if it does not exist.
     Value& operator[] ( const char* key );
@@ -84,11 +84,97 @@ public:
         pass ();
     }
 
+    void
+    test_stream ()
+    {
+        Json::Value inner (Json::objectValue);
+        inner["b"] = "two";
+        inner["a"] = 1;
+        inner["c"] = Json::arrayValue;
+        inner["c"].append (true);
+        inner["c"].append (Json::Value ());
+
+        Json::Value whole (Json::objectValue);
+        whole["list"] = Json::arrayValue;
+        whole["list"].append (inner);
+        whole["list"].append (2.5);
+        whole["name"] = "x\"y";
+
+        std::string out;
+        Json::Stream stream ([&out] (char const* data, std::size_t size)
+        {
+            out.append (data, size);
+        }, 8);
+
+        stream.startObject ();
+        stream.startArray ("list");
+        stream.append (inner);
+        stream.append (2.5);
+        stream.finish ();
+        stream.set ("name", whole["name"]);
+        stream.finish ();
+        expect (stream.depth () == 0);
+
+        // Anything past the buffer size has already gone to the output
+        expect (stream.isStreaming ());
+        stream.flush ();
+        expect (stream.release ().empty ());
+
+        Json::FastWriter w;
+        expect (out + "\n" == w.write (whole));
+
+        // Nothing is output until the buffer fills
+        std::string none;
+        Json::Stream small ([&none] (char const* data, std::size_t size)
+        {
+            none.append (data, size);
+        });
+
+        small.startObject ();
+        small.setMembers (inner);
+        small.finish ();
+        expect (! small.isStreaming ());
+        expect (none.empty ());
+        expect (small.release () + "\n" == w.write (inner));
+    }
+
+    void
+    test_append ()
+    {
+        Json::Value source (Json::objectValue);
+        source["name"] = "source";
+        source["list"] = Json::arrayValue;
+        source["list"].append (1);
+        source["list"].append ("two");
+        source["inner"]["flag"] = true;
+        Json::Value const copy (source);
+
+        Json::Value array (Json::arrayValue);
+        array.append (copy);
+        Json::Value& appended = array.append (std::move (source));
+        expect (array.size () == 2);
+        expect (&appended == &array[1u]);
+        expect (appended == copy);
+        expect (array[0u] == copy);
+
+        // The source is left empty but can still be used
+        expect (source.isNull ());
+        source["name"] = "reused";
+        expect (source.isObject ());
+        expect (source["name"].asString () == "reused");
+        array.append (std::move (source));
+        expect (array.size () == 3);
+        expect (array[2u]["name"].asString () == "reused");
+        expect (array[1u] == copy);
+    }
+
     void run ()
     {
         testBadJson ();
         test_copy ();
         test_move ();
+        test_append ();
+        test_stream ();
     }
 };
 
@@ -0,0 +1,227 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+namespace Json
+{
+
+Stream::Stream (Output const& output, std::size_t bufferSize)
+    : m_output (output)
+    , m_bufferSize (bufferSize)
+    , m_streaming (false)
+{
+    m_buffer.reserve (bufferSize);
+}
+
+void Stream::startObject ()
+{
+    separate ();
+    open ('{', '}');
+}
+
+void Stream::startArray ()
+{
+    separate ();
+    open ('[', ']');
+}
+
+void Stream::startObject (char const* key)
+{
+    writeKey (key);
+    open ('{', '}');
+}
+
+void Stream::startArray (char const* key)
+{
+    writeKey (key);
+    open ('[', ']');
+}
+
+void Stream::finish ()
+{
+    JSON_ASSERT_MESSAGE (! m_levels.empty (), "Json::Stream has nothing open");
+
+    m_buffer += m_levels.back ().closer;
+    m_levels.pop_back ();
+    check ();
+}
+
+std::size_t Stream::depth () const
+{
+    return m_levels.size ();
+}
+
+void Stream::append (Value const& value)
+{
+    separate ();
+    writeValue (value);
+    check ();
+}
+
+void Stream::set (char const* key, Value const& value)
+{
+    writeKey (key);
+    writeValue (value);
+    check ();
+}
+
+void Stream::setMembers (Value const& object)
+{
+    if (! object.isObject ())
+        return;
+
+    for (Value::const_iterator it = object.begin (); it != object.end (); ++it)
+        set (it.memberName (), *it);
+}
+
+void Stream::flush ()
+{
+    if (m_buffer.empty ())
+        return;
+
+    m_streaming = true;
+    m_output (m_buffer.data (), m_buffer.size ());
+    m_buffer.clear ();
+}
+
+bool Stream::isStreaming () const
+{
+    return m_streaming;
+}
+
+std::string Stream::release ()
+{
+    std::string text;
+    text.swap (m_buffer);
+    return text;
+}
+
+void Stream::open (char opener, char closer)
+{
+    m_buffer += opener;
+
+    Level const level = { closer, true };
+    m_levels.push_back (level);
+}
+
+void Stream::separate ()
+{
+    if (m_levels.empty ())
+        return;
+
+    if (m_levels.back ().empty)
+        m_levels.back ().empty = false;
+    else
+        m_buffer += ',';
+}
+
+void Stream::writeKey (char const* key)
+{
+    JSON_ASSERT_MESSAGE (! m_levels.empty () && m_levels.back ().closer == '}',
+        "Json::Stream key outside of an object");
+
+    separate ();
+    write (valueToQuotedString (key));
+    m_buffer += ':';
+}
+
+void Stream::writeValue (Value const& value)
+{
+    switch (value.type ())
+    {
+    case nullValue:
+        write ("null");
+        break;
+
+    case intValue:
+        write (valueToString (value.asInt ()));
+        break;
+
+    case uintValue:
+        write (valueToString (value.asUInt ()));
+        break;
+
+    case realValue:
+        write (valueToString (value.asDouble ()));
+        break;
+
+    case stringValue:
+        write (valueToQuotedString (value.asCString ()));
+        break;
+
+    case booleanValue:
+        write (valueToString (value.asBool ()));
+        break;
+
+    case arrayValue:
+    {
+        m_buffer += '[';
+        Value::UInt const size = value.size ();
+
+        for (Value::UInt index = 0; index < size; ++index)
+        {
+            if (index > 0)
+                m_buffer += ',';
+
+            writeValue (value[index]);
+        }
+
+        m_buffer += ']';
+    }
+    break;
+
+    case objectValue:
+    {
+        // Members come out in key order, as from getMemberNames, but
+        // without copying the names first
+        m_buffer += '{';
+
+        for (Value::const_iterator it = value.begin (); it != value.end (); ++it)
+        {
+            if (it != value.begin ())
+                m_buffer += ',';
+
+            write (valueToQuotedString (it.memberName ()));
+            m_buffer += ':';
+            writeValue (*it);
+        }
+
+        m_buffer += '}';
+    }
+    break;
+    }
+}
+
+void Stream::write (char const* text)
+{
+    m_buffer += text;
+}
+
+void Stream::write (std::string const& text)
+{
+    m_buffer += text;
+}
+
+void Stream::check ()
+{
+    if (m_buffer.size () >= m_bufferSize)
+        flush ();
+}
+
+} // namespace Json
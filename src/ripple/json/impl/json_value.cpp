@@ -1152,8 +1152,7 @@ Value::operator[] ( UInt index )
     if ( it != value_.map_->end ()  &&  (*it).first == key )
         return (*it).second;
 
-    ObjectValues::value_type defaultValue ( key, null );
-    it = value_.map_->insert ( it, defaultValue );
+    it = value_.map_->emplace_hint ( it, key, null );
     return (*it).second;
 #else
     return value_.array_->resolveReference ( index );
@@ -1208,8 +1207,8 @@ Value::resolveReference ( const char* key,
     if ( it != value_.map_->end ()  &&  (*it).first == actualKey )
         return (*it).second;
 
-    ObjectValues::value_type defaultValue ( actualKey, null );
-    it = value_.map_->insert ( it, defaultValue );
+    // Built in place, so a member name is duplicated only once
+    it = value_.map_->emplace_hint ( it, actualKey, null );
     Value& value = (*it).second;
     return value;
 #else
@@ -1300,6 +1299,12 @@ Value::append ( const Value& value )
     return (*this)[size ()] = value;
 }
 
+Value&
+Value::append ( Value&& value )
+{
+    return (*this)[size ()] = std::move (value);
+}
+
 
 Value
 Value::get ( const char* key,
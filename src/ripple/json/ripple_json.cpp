@@ -43,6 +43,7 @@
 #include "impl/json_reader.cpp"
 #include "impl/json_value.cpp"
 #include "impl/json_writer.cpp"
+#include "impl/json_stream.cpp"
 
 #include "impl/Tests.cpp"
 
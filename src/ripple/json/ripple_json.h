@@ -47,6 +47,7 @@
 #include "api/json_value.h"
 #include "api/json_reader.h"
 #include "api/json_writer.h"
+#include "api/json_stream.h"
 
 #include "api/JsonPropertyStream.h"
 
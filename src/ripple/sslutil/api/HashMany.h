@@ -0,0 +1,67 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_SSLUTIL_HASHMANY_H_INCLUDED
+#define RIPPLE_SSLUTIL_HASHMANY_H_INCLUDED
+
+namespace ripple {
+
+/** A message to be hashed by hashMany.
+    The message is an optional 32-bit prefix, stored big-endian, followed
+    by up to two byte ranges. This covers the hash prefixed forms of the
+    SHAMap nodes without having to copy them into a Serializer first.
+    The data is not copied and must remain valid until hashMany returns.
+*/
+struct HashManyInput
+{
+    HashManyInput ();
+    HashManyInput (void const* data, std::size_t size);
+    HashManyInput (std::uint32_t prefix, void const* data, std::size_t size);
+
+    // Add a second byte range to the message
+    void append (void const* data, std::size_t size);
+
+    // The length of the message in bytes
+    std::size_t size () const;
+
+    bool                    hasPrefix;
+    std::uint32_t           prefix;
+    unsigned char const*    data[2];
+    std::size_t             length[2];
+};
+
+/** Compute the SHA-512Half of many independent messages.
+    The SHA-512Half is the first 256 bits of the SHA-512 digest, as returned
+    by Serializer::getSHA512Half. When the processor supports it, several
+    messages are hashed at once in the lanes of a SIMD register. Otherwise
+    the messages are hashed one at a time.
+*/
+void hashMany (HashManyInput const* inputs, uint256* outputs, std::size_t count);
+
+/** Hash each message one at a time with OpenSSL.
+    This is what hashMany falls back to. It is exposed for testing.
+*/
+void hashManyScalar (HashManyInput const* inputs, uint256* outputs, std::size_t count);
+
+/** Returns true if hashMany will use a vectorized implementation. */
+bool hashManyIsVectorized ();
+
+}
+
+#endif
@@ -0,0 +1,737 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include "../../../beast/beast/unit_test/suite.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// The vectorized kernels need per-function target attributes and
+// runtime CPU detection, which only GCC and Clang give us.
+#ifndef RIPPLE_HASHMANY_AVX2
+# if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#  define RIPPLE_HASHMANY_AVX2 1
+# else
+#  define RIPPLE_HASHMANY_AVX2 0
+# endif
+#endif
+
+// The AVX-512 intrinsics need a newer compiler
+#ifndef RIPPLE_HASHMANY_AVX512
+# if RIPPLE_HASHMANY_AVX2 && \
+     ((defined (__clang__) && (__clang_major__ >= 4)) || \
+      (!defined (__clang__) && (__GNUC__ >= 6)))
+#  define RIPPLE_HASHMANY_AVX512 1
+# else
+#  define RIPPLE_HASHMANY_AVX512 0
+# endif
+#endif
+
+#if RIPPLE_HASHMANY_AVX2
+#include <immintrin.h>
+#endif
+
+namespace ripple {
+
+HashManyInput::HashManyInput ()
+    : hasPrefix (false)
+    , prefix (0)
+{
+    data[0] = data[1] = nullptr;
+    length[0] = length[1] = 0;
+}
+
+HashManyInput::HashManyInput (void const* d, std::size_t size)
+    : hasPrefix (false)
+    , prefix (0)
+{
+    data[0] = static_cast <unsigned char const*> (d);
+    length[0] = size;
+    data[1] = nullptr;
+    length[1] = 0;
+}
+
+HashManyInput::HashManyInput (std::uint32_t p, void const* d, std::size_t size)
+    : hasPrefix (true)
+    , prefix (p)
+{
+    data[0] = static_cast <unsigned char const*> (d);
+    length[0] = size;
+    data[1] = nullptr;
+    length[1] = 0;
+}
+
+void HashManyInput::append (void const* d, std::size_t size)
+{
+    assert (length[1] == 0);
+    data[1] = static_cast <unsigned char const*> (d);
+    length[1] = size;
+}
+
+std::size_t HashManyInput::size () const
+{
+    return (hasPrefix ? 4 : 0) + length[0] + length[1];
+}
+
+//------------------------------------------------------------------------------
+
+void hashManyScalar (HashManyInput const* inputs, uint256* outputs, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        HashManyInput const& in (inputs[i]);
+
+        SHA512_CTX ctx;
+        SHA512_Init (&ctx);
+
+        if (in.hasPrefix)
+        {
+            unsigned char be_prefix[4];
+            be_prefix[0] = static_cast<unsigned char> (in.prefix >> 24);
+            be_prefix[1] = static_cast<unsigned char> ((in.prefix >> 16) & 0xff);
+            be_prefix[2] = static_cast<unsigned char> ((in.prefix >> 8) & 0xff);
+            be_prefix[3] = static_cast<unsigned char> (in.prefix & 0xff);
+            SHA512_Update (&ctx, be_prefix, 4);
+        }
+
+        if (in.length[0] != 0)
+            SHA512_Update (&ctx, in.data[0], in.length[0]);
+
+        if (in.length[1] != 0)
+            SHA512_Update (&ctx, in.data[1], in.length[1]);
+
+        unsigned char digest[64];
+        SHA512_Final (digest, &ctx);
+        memcpy (outputs[i].begin (), digest, 256 / 8);
+    }
+}
+
+#if RIPPLE_HASHMANY_AVX2
+
+namespace detail {
+
+static std::uint64_t const sha512InitialState[8] =
+{
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static std::uint64_t const sha512RoundConstants[80] =
+{
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/** The position of one message as it moves through a lane. */
+struct HashManyLane
+{
+    HashManyInput const*    input;
+    uint256*                output;
+    std::size_t             size;       // message length in bytes
+    std::size_t             blocks;     // padded length in 128 byte blocks
+    std::size_t             block;      // next block to hash
+};
+
+// Copy one padded 128 byte block of a message
+static void hashManyFillBlock (HashManyLane const& lane, unsigned char* out)
+{
+    std::size_t const start = lane.block * 128;
+    std::size_t pos = 0;        // offset of the current piece in the message
+    std::size_t filled = 0;     // bytes of out that hold message data
+
+    unsigned char be_prefix[4];
+    unsigned char const* pieces[3];
+    std::size_t lengths[3];
+    int n = 0;
+
+    if (lane.input->hasPrefix)
+    {
+        be_prefix[0] = static_cast<unsigned char> (lane.input->prefix >> 24);
+        be_prefix[1] = static_cast<unsigned char> ((lane.input->prefix >> 16) & 0xff);
+        be_prefix[2] = static_cast<unsigned char> ((lane.input->prefix >> 8) & 0xff);
+        be_prefix[3] = static_cast<unsigned char> (lane.input->prefix & 0xff);
+        pieces[n] = be_prefix;
+        lengths[n++] = 4;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        pieces[n] = lane.input->data[i];
+        lengths[n++] = lane.input->length[i];
+    }
+
+    for (int i = 0; (i < n) && (filled < 128); ++i)
+    {
+        std::size_t const end = pos + lengths[i];
+
+        if (end > start + filled)
+        {
+            std::size_t const offset = start + filled - pos;
+            std::size_t const count = std::min (lengths[i] - offset, 128 - filled);
+            memcpy (out + filled, pieces[i] + offset, count);
+            filled += count;
+        }
+
+        pos = end;
+    }
+
+    if (filled == 128)
+        return;
+
+    memset (out + filled, 0, 128 - filled);
+
+    // The 0x80 terminator follows the message, possibly in this block
+    if (lane.size >= start)
+        out[lane.size - start] = 0x80;
+
+    // The length in bits ends the last block
+    if (lane.block == (lane.blocks - 1))
+    {
+        std::uint64_t const bits = static_cast<std::uint64_t> (lane.size) * 8;
+
+        for (int i = 0; i < 8; ++i)
+            out[127 - i] = static_cast<unsigned char> (bits >> (i * 8));
+    }
+}
+
+/** Hash messages several at a time, one per lane of a SIMD register.
+    The compression function works on one block from every lane at once.
+    A lane takes the next message as soon as it finishes the last one,
+    so messages of different lengths keep all the lanes busy.
+*/
+template <int Lanes, void (*Compress) (std::uint64_t (*)[Lanes], unsigned char const (*)[128])>
+static void hashManyLanes (HashManyInput const* inputs, uint256* outputs, std::size_t count)
+{
+    HashManyLane lane[Lanes];
+    bool active[Lanes];
+    unsigned char blocks[Lanes][128];
+    std::uint64_t state[8][Lanes];  // word j of lane i is state[j][i]
+    std::size_t next = 0;
+
+    for (int i = 0; i < Lanes; ++i)
+    {
+        active[i] = false;
+
+        for (int j = 0; j < 8; ++j)
+            state[j][i] = 0;
+    }
+
+    while (1)
+    {
+        bool any = false;
+
+        for (int i = 0; i < Lanes; ++i)
+        {
+            if (!active[i] && (next < count))
+            {
+                lane[i].input = &inputs[next];
+                lane[i].output = &outputs[next];
+                lane[i].size = inputs[next].size ();
+                lane[i].blocks = (lane[i].size + 17 + 127) / 128;
+                lane[i].block = 0;
+                active[i] = true;
+                ++next;
+
+                for (int j = 0; j < 8; ++j)
+                    state[j][i] = sha512InitialState[j];
+            }
+
+            if (active[i])
+            {
+                hashManyFillBlock (lane[i], blocks[i]);
+                any = true;
+            }
+            else
+                memset (blocks[i], 0, 128);
+        }
+
+        if (!any)
+            break;
+
+        Compress (state, blocks);
+
+        for (int i = 0; i < Lanes; ++i)
+        {
+            if (active[i] && (++lane[i].block == lane[i].blocks))
+            {
+                unsigned char* out = lane[i].output->begin ();
+
+                // The first four words, big-endian, are the SHA-512Half
+                for (int j = 0; j < 4; ++j)
+                    for (int k = 0; k < 8; ++k)
+                        out[j * 8 + k] = static_cast<unsigned char> (
+                            state[j][i] >> (56 - k * 8));
+
+                active[i] = false;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+#define RIPPLE_HASHMANY_AVX2_TARGET __attribute__ ((target ("avx2")))
+
+#define RIPPLE_HASHMANY_ROTR256(x, n) \
+    _mm256_or_si256 (_mm256_srli_epi64 ((x), (n)), _mm256_slli_epi64 ((x), 64 - (n)))
+
+// Load the words t through t + 3 of each lane's block, byte swapped
+// and transposed so that each register holds one word of every lane
+RIPPLE_HASHMANY_AVX2_TARGET
+static inline void hashManyLoadWordsAVX2 (__m256i* w, unsigned char const (*blocks)[128], int t)
+{
+    __m256i const bswap = _mm256_set_epi8 (
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256i const r0 = _mm256_shuffle_epi8 (_mm256_loadu_si256 (
+        reinterpret_cast<__m256i const*> (blocks[0] + t * 8)), bswap);
+    __m256i const r1 = _mm256_shuffle_epi8 (_mm256_loadu_si256 (
+        reinterpret_cast<__m256i const*> (blocks[1] + t * 8)), bswap);
+    __m256i const r2 = _mm256_shuffle_epi8 (_mm256_loadu_si256 (
+        reinterpret_cast<__m256i const*> (blocks[2] + t * 8)), bswap);
+    __m256i const r3 = _mm256_shuffle_epi8 (_mm256_loadu_si256 (
+        reinterpret_cast<__m256i const*> (blocks[3] + t * 8)), bswap);
+
+    __m256i const t0 = _mm256_unpacklo_epi64 (r0, r1);
+    __m256i const t1 = _mm256_unpackhi_epi64 (r0, r1);
+    __m256i const t2 = _mm256_unpacklo_epi64 (r2, r3);
+    __m256i const t3 = _mm256_unpackhi_epi64 (r2, r3);
+
+    w[0] = _mm256_permute2x128_si256 (t0, t2, 0x20);
+    w[1] = _mm256_permute2x128_si256 (t1, t3, 0x20);
+    w[2] = _mm256_permute2x128_si256 (t0, t2, 0x31);
+    w[3] = _mm256_permute2x128_si256 (t1, t3, 0x31);
+}
+
+// The SHA-512 compression function on one block in each of four lanes
+RIPPLE_HASHMANY_AVX2_TARGET
+static void hashManyCompressAVX2 (std::uint64_t (*state)[4], unsigned char const (*blocks)[128])
+{
+    __m256i w[80];
+
+    for (int t = 0; t < 16; t += 4)
+        hashManyLoadWordsAVX2 (w + t, blocks, t);
+
+    for (int t = 16; t < 80; ++t)
+    {
+        __m256i const s0 = _mm256_xor_si256 (
+            _mm256_xor_si256 (RIPPLE_HASHMANY_ROTR256 (w[t - 15], 1),
+                RIPPLE_HASHMANY_ROTR256 (w[t - 15], 8)),
+            _mm256_srli_epi64 (w[t - 15], 7));
+        __m256i const s1 = _mm256_xor_si256 (
+            _mm256_xor_si256 (RIPPLE_HASHMANY_ROTR256 (w[t - 2], 19),
+                RIPPLE_HASHMANY_ROTR256 (w[t - 2], 61)),
+            _mm256_srli_epi64 (w[t - 2], 6));
+        w[t] = _mm256_add_epi64 (
+            _mm256_add_epi64 (w[t - 16], s0),
+            _mm256_add_epi64 (w[t - 7], s1));
+    }
+
+    __m256i v[8];
+
+    for (int j = 0; j < 8; ++j)
+        v[j] = _mm256_loadu_si256 (reinterpret_cast<__m256i const*> (state[j]));
+
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3];
+    __m256i e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int t = 0; t < 80; ++t)
+    {
+        __m256i const S1 = _mm256_xor_si256 (
+            _mm256_xor_si256 (RIPPLE_HASHMANY_ROTR256 (e, 14),
+                RIPPLE_HASHMANY_ROTR256 (e, 18)),
+            RIPPLE_HASHMANY_ROTR256 (e, 41));
+        __m256i const ch = _mm256_xor_si256 (
+            _mm256_and_si256 (e, f), _mm256_andnot_si256 (e, g));
+        __m256i const t1 = _mm256_add_epi64 (
+            _mm256_add_epi64 (_mm256_add_epi64 (h, S1), _mm256_add_epi64 (ch, w[t])),
+            _mm256_set1_epi64x (static_cast<long long> (sha512RoundConstants[t])));
+        __m256i const S0 = _mm256_xor_si256 (
+            _mm256_xor_si256 (RIPPLE_HASHMANY_ROTR256 (a, 28),
+                RIPPLE_HASHMANY_ROTR256 (a, 34)),
+            RIPPLE_HASHMANY_ROTR256 (a, 39));
+        __m256i const maj = _mm256_or_si256 (
+            _mm256_and_si256 (a, b), _mm256_and_si256 (c, _mm256_or_si256 (a, b)));
+        __m256i const t2 = _mm256_add_epi64 (S0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi64 (d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi64 (t1, t2);
+    }
+
+    v[0] = _mm256_add_epi64 (v[0], a);
+    v[1] = _mm256_add_epi64 (v[1], b);
+    v[2] = _mm256_add_epi64 (v[2], c);
+    v[3] = _mm256_add_epi64 (v[3], d);
+    v[4] = _mm256_add_epi64 (v[4], e);
+    v[5] = _mm256_add_epi64 (v[5], f);
+    v[6] = _mm256_add_epi64 (v[6], g);
+    v[7] = _mm256_add_epi64 (v[7], h);
+
+    for (int j = 0; j < 8; ++j)
+        _mm256_storeu_si256 (reinterpret_cast<__m256i*> (state[j]), v[j]);
+}
+
+#undef RIPPLE_HASHMANY_ROTR256
+#undef RIPPLE_HASHMANY_AVX2_TARGET
+
+//------------------------------------------------------------------------------
+
+#if RIPPLE_HASHMANY_AVX512
+
+#define RIPPLE_HASHMANY_AVX512_TARGET __attribute__ ((target ("avx512f,avx512bw")))
+
+// Three way exclusive or, and the SHA-2 choose and majority functions
+#define RIPPLE_HASHMANY_XOR3(x, y, z) _mm512_ternarylogic_epi64 ((x), (y), (z), 0x96)
+#define RIPPLE_HASHMANY_CH(x, y, z) _mm512_ternarylogic_epi64 ((x), (y), (z), 0xCA)
+#define RIPPLE_HASHMANY_MAJ(x, y, z) _mm512_ternarylogic_epi64 ((x), (y), (z), 0xE8)
+
+// The SHA-512 compression function on one block in each of eight lanes
+RIPPLE_HASHMANY_AVX512_TARGET
+static void hashManyCompressAVX512 (std::uint64_t (*state)[8], unsigned char const (*blocks)[128])
+{
+    __m512i const index = _mm512_set_epi64 (
+        7 * 128, 6 * 128, 5 * 128, 4 * 128, 3 * 128, 2 * 128, 1 * 128, 0);
+    __m512i const bswap = _mm512_broadcast_i32x4 (_mm_set_epi8 (
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7));
+
+    __m512i w[80];
+
+    for (int t = 0; t < 16; ++t)
+        w[t] = _mm512_shuffle_epi8 (_mm512_i64gather_epi64 (
+            index, blocks[0] + t * 8, 1), bswap);
+
+    for (int t = 16; t < 80; ++t)
+    {
+        __m512i const s0 = RIPPLE_HASHMANY_XOR3 (
+            _mm512_ror_epi64 (w[t - 15], 1), _mm512_ror_epi64 (w[t - 15], 8),
+            _mm512_srli_epi64 (w[t - 15], 7));
+        __m512i const s1 = RIPPLE_HASHMANY_XOR3 (
+            _mm512_ror_epi64 (w[t - 2], 19), _mm512_ror_epi64 (w[t - 2], 61),
+            _mm512_srli_epi64 (w[t - 2], 6));
+        w[t] = _mm512_add_epi64 (
+            _mm512_add_epi64 (w[t - 16], s0),
+            _mm512_add_epi64 (w[t - 7], s1));
+    }
+
+    __m512i v[8];
+
+    for (int j = 0; j < 8; ++j)
+        v[j] = _mm512_loadu_si512 (state[j]);
+
+    __m512i a = v[0], b = v[1], c = v[2], d = v[3];
+    __m512i e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int t = 0; t < 80; ++t)
+    {
+        __m512i const S1 = RIPPLE_HASHMANY_XOR3 (
+            _mm512_ror_epi64 (e, 14), _mm512_ror_epi64 (e, 18), _mm512_ror_epi64 (e, 41));
+        __m512i const t1 = _mm512_add_epi64 (
+            _mm512_add_epi64 (_mm512_add_epi64 (h, S1),
+                _mm512_add_epi64 (RIPPLE_HASHMANY_CH (e, f, g), w[t])),
+            _mm512_set1_epi64 (static_cast<long long> (sha512RoundConstants[t])));
+        __m512i const S0 = RIPPLE_HASHMANY_XOR3 (
+            _mm512_ror_epi64 (a, 28), _mm512_ror_epi64 (a, 34), _mm512_ror_epi64 (a, 39));
+        __m512i const t2 = _mm512_add_epi64 (S0, RIPPLE_HASHMANY_MAJ (a, b, c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi64 (d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi64 (t1, t2);
+    }
+
+    v[0] = _mm512_add_epi64 (v[0], a);
+    v[1] = _mm512_add_epi64 (v[1], b);
+    v[2] = _mm512_add_epi64 (v[2], c);
+    v[3] = _mm512_add_epi64 (v[3], d);
+    v[4] = _mm512_add_epi64 (v[4], e);
+    v[5] = _mm512_add_epi64 (v[5], f);
+    v[6] = _mm512_add_epi64 (v[6], g);
+    v[7] = _mm512_add_epi64 (v[7], h);
+
+    for (int j = 0; j < 8; ++j)
+        _mm512_storeu_si512 (state[j], v[j]);
+}
+
+#undef RIPPLE_HASHMANY_MAJ
+#undef RIPPLE_HASHMANY_CH
+#undef RIPPLE_HASHMANY_XOR3
+#undef RIPPLE_HASHMANY_AVX512_TARGET
+
+#endif
+
+//------------------------------------------------------------------------------
+
+enum HashManyKernel
+{
+    hashManyScalarKernel,
+    hashManyAVX2Kernel,
+    hashManyAVX512Kernel
+};
+
+static HashManyKernel hashManyGetKernel ()
+{
+    __builtin_cpu_init ();
+
+#if RIPPLE_HASHMANY_AVX512
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512bw"))
+        return hashManyAVX512Kernel;
+#endif
+
+    if (__builtin_cpu_supports ("avx2"))
+        return hashManyAVX2Kernel;
+
+    return hashManyScalarKernel;
+}
+
+static HashManyKernel hashManyKernel ()
+{
+    static HashManyKernel const kernel = hashManyGetKernel ();
+    return kernel;
+}
+
+}
+
+bool hashManyIsVectorized ()
+{
+    return detail::hashManyKernel () != detail::hashManyScalarKernel;
+}
+
+void hashMany (HashManyInput const* inputs, uint256* outputs, std::size_t count)
+{
+    // With a single message, OpenSSL's single buffer code is faster
+    if (count < 2)
+    {
+        hashManyScalar (inputs, outputs, count);
+        return;
+    }
+
+    switch (detail::hashManyKernel ())
+    {
+#if RIPPLE_HASHMANY_AVX512
+    case detail::hashManyAVX512Kernel:
+        detail::hashManyLanes <8, detail::hashManyCompressAVX512> (inputs, outputs, count);
+        break;
+#endif
+
+    case detail::hashManyAVX2Kernel:
+        detail::hashManyLanes <4, detail::hashManyCompressAVX2> (inputs, outputs, count);
+        break;
+
+    default:
+        hashManyScalar (inputs, outputs, count);
+        break;
+    };
+}
+
+#else
+
+bool hashManyIsVectorized ()
+{
+    return false;
+}
+
+void hashMany (HashManyInput const* inputs, uint256* outputs, std::size_t count)
+{
+    hashManyScalar (inputs, outputs, count);
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+
+class HashMany_test : public beast::unit_test::suite
+{
+public:
+    // Messages of every length around the block boundaries, with and
+    // without a prefix, split across both byte ranges
+    void testMatchesScalar ()
+    {
+        testcase ("matches scalar");
+
+        Blob data (1024);
+
+        for (std::size_t i = 0; i < data.size (); ++i)
+            data[i] = static_cast<unsigned char> ((i * 131) + (i >> 8));
+
+        std::vector<HashManyInput> inputs;
+
+        for (std::size_t size = 0; size < 400; ++size)
+        {
+            inputs.push_back (HashManyInput (&data[size % 7], size));
+            inputs.push_back (HashManyInput (0x4D494E00 + size, &data[0], size));
+
+            HashManyInput split (0x534E4400, &data[0], size / 2);
+            split.append (&data[512], size - (size / 2));
+            inputs.push_back (split);
+        }
+
+        std::vector<uint256> expected (inputs.size ());
+        std::vector<uint256> actual (inputs.size ());
+
+        hashManyScalar (&inputs[0], &expected[0], inputs.size ());
+        hashMany (&inputs[0], &actual[0], inputs.size ());
+
+        std::size_t mismatched = 0;
+
+        for (std::size_t i = 0; i < inputs.size (); ++i)
+            if (expected[i] != actual[i])
+                ++mismatched;
+
+        expect (mismatched == 0, "hashMany differs from SHA512");
+
+        // A single message takes the scalar path
+        hashMany (&inputs[5], &actual[0], 1);
+        expect (actual[0] == expected[5], "hashMany differs from SHA512");
+    }
+
+    void testKnownAnswer ()
+    {
+        testcase ("known answer");
+
+        // SHA-512 ("abc"), from FIPS 180-2
+        unsigned char const abc[] = { 'a', 'b', 'c' };
+        uint256 expected;
+        expected.SetHex ("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a");
+
+        // The bytes of the digest are stored in order, SetHex reverses them
+        uint256 reversed;
+        std::reverse_copy (expected.begin (), expected.end (), reversed.begin ());
+
+        HashManyInput inputs[3] =
+        {
+            HashManyInput (abc, 3),
+            HashManyInput (abc, 1),
+            HashManyInput (abc, 3)
+        };
+        inputs[1].append (abc + 1, 2);
+
+        uint256 outputs[3];
+        hashMany (inputs, outputs, 3);
+
+        expect (outputs[0] == reversed, "wrong SHA512 of abc");
+        expect (outputs[1] == reversed, "wrong SHA512 of abc");
+        expect (outputs[2] == reversed, "wrong SHA512 of abc");
+    }
+
+    void run ()
+    {
+        testKnownAnswer ();
+        testMatchesScalar ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(HashMany,sslutil,ripple);
+
+//------------------------------------------------------------------------------
+
+/** Compares hashMany against hashing one node at a time. */
+class HashMany_timing_test : public beast::unit_test::suite
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    // Time hashing a batch of messages the size of a SHAMap inner node
+    // (prefix plus sixteen 256-bit hashes) or account state leaf
+    void testTiming (std::string const& name, std::size_t size, std::size_t count)
+    {
+        testcase (name);
+
+        Blob data (size * count);
+
+        for (std::size_t i = 0; i < data.size (); ++i)
+            data[i] = static_cast<unsigned char> (i * 7);
+
+        std::vector<HashManyInput> inputs;
+
+        for (std::size_t i = 0; i < count; ++i)
+            inputs.push_back (HashManyInput (0x4D494E00, &data[i * size], size));
+
+        std::vector<uint256> expected (count);
+        std::vector<uint256> actual (count);
+
+        int const rounds = 20;
+
+        clock_type::time_point start = clock_type::now ();
+
+        // One SHA512 call per message, as Serializer::getPrefixHash does
+        for (int i = 0; i < rounds; ++i)
+            for (std::size_t j = 0; j < count; ++j)
+                hashManyScalar (&inputs[j], &expected[j], 1);
+
+        clock_type::duration const single = clock_type::now () - start;
+
+        start = clock_type::now ();
+
+        for (int i = 0; i < rounds; ++i)
+            hashMany (&inputs[0], &actual[0], count);
+
+        clock_type::duration const batch = clock_type::now () - start;
+
+        expect (expected == actual, "hashMany differs from SHA512");
+
+        log <<
+            count << " x " << size << " bytes, " << rounds << " rounds: " <<
+            "one at a time " << std::chrono::duration_cast <
+                std::chrono::milliseconds> (single).count () << "ms, " <<
+            "hashMany " << std::chrono::duration_cast <
+                std::chrono::milliseconds> (batch).count () << "ms" <<
+            (hashManyIsVectorized () ? "" : " (not vectorized)");
+    }
+
+    void run ()
+    {
+        testTiming ("inner nodes", 512, 50000);
+        testTiming ("state leaves", 180, 50000);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(HashMany_timing,sslutil,ripple);
+
+}
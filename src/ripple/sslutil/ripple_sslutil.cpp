@@ -25,3 +25,4 @@
 #include "impl/ECDSACanonical.cpp"
 #include "impl/DHUtil.cpp"
 #include "impl/HashUtilities.cpp"
+#include "impl/HashMany.cpp"
@@ -32,6 +32,7 @@
 #include "api/CBigNum.h"
 #include "api/DHUtil.h"
 #include "api/HashUtilities.h"
+#include "api/HashMany.h"
 #include "api/ECDSACanonical.h"
 
 #endif
@@ -479,6 +479,7 @@ public:
         {
             // first time switching to this ledger
             mPrevLedgerHash = lclHash;
+            getApp().getOPs ().setConsensusLCL (lclHash);
 
             if (mHaveCorrectLCL && mProposing && mOurPosition)
             {
@@ -888,37 +889,30 @@ private:
                 = boost::make_shared<Ledger> (false
                 , boost::ref (*mPreviousLedger));
 
-            // Set up to write SHAMap changes to our database, 
-            //   perform updates, extract changes
-            newLCL->peekTransactionMap ()->armDirty ();
-            newLCL->peekAccountStateMap ()->armDirty ();
+            // Hash the state map once, after all the changes are made
+            newLCL->peekAccountStateMap ()->setDeferHash (true);
+
+            // Perform updates, then write the SHAMap changes to our database
             WriteLog (lsDEBUG, LedgerConsensus) 
                 << "Applying consensus set transactions to the"
                 << " last closed ledger";
             applyTransactions (set, newLCL, newLCL, failedTransactions, false);
             newLCL->updateSkipList ();
             newLCL->setClosed ();
-            boost::shared_ptr<SHAMap::DirtySet> acctNodes
-                = newLCL->peekAccountStateMap ()->disarmDirty ();
-            boost::shared_ptr<SHAMap::DirtySet> txnNodes
-                = newLCL->peekTransactionMap ()->disarmDirty ();
 
-            // write out dirty nodes (temporarily done here)
-            int fc;
+            newLCL->peekAccountStateMap ()->updateHashes (
+                &getApp().getJobQueue ());
 
-            while ((fc = newLCL->peekAccountStateMap()->flushDirty (
-                *acctNodes, 256, hotACCOUNT_NODE, newLCL->getLedgerSeq ())) > 0)
-            {
-                WriteLog (lsTRACE, LedgerConsensus) 
-                    << "Flushed " << fc << " dirty state nodes";
-            }
+            // write out dirty nodes (temporarily done here)
+            int fc = newLCL->peekAccountStateMap()->flushDirty (
+                hotACCOUNT_NODE, newLCL->getLedgerSeq ());
+            WriteLog (lsTRACE, LedgerConsensus) 
+                << "Flushed " << fc << " dirty state nodes";
 
-            while ((fc = newLCL->peekTransactionMap()->flushDirty (
-                *txnNodes, 256, hotTRANSACTION_NODE, newLCL->getLedgerSeq ())) > 0)
-            {
-                WriteLog (lsTRACE, LedgerConsensus) 
-                    << "Flushed " << fc << " dirty transaction nodes";
-            }
+            fc = newLCL->peekTransactionMap()->flushDirty (
+                hotTRANSACTION_NODE, newLCL->getLedgerSeq ());
+            WriteLog (lsTRACE, LedgerConsensus) 
+                << "Flushed " << fc << " dirty transaction nodes";
 
             newLCL->setAccepted (closeTime, mCloseResolution, closeTimeCorrect);
 
@@ -0,0 +1,373 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include "../main/Tuning.h"
+
+#include "../../beast/beast/unit_test/suite.h"
+
+namespace ripple {
+
+SETUP_LOG (InflationVotes)
+
+InflationVotes::InflationVotes ()
+{
+}
+
+InflationVotes::Tally InflationVotes::getTally (Ledger::ref ledger)
+{
+    std::lock_guard <std::mutex> sl (mLock);
+
+    update (ledger);
+
+    return makeTally (mVotes);
+}
+
+void InflationVotes::updateLater (Ledger::ref ledger)
+{
+    std::lock_guard <std::mutex> sl (mPendingLock);
+
+    bool const queued = !!mPending;
+    mPending = ledger;
+
+    if (!queued)
+        getApp().getJobQueue ().addJob (jtINFLATION, "InflationVotes::update",
+            BIND_TYPE (&InflationVotes::doUpdate, this, P_1));
+}
+
+InflationVotes::Tally InflationVotes::countVotes (Ledger::ref ledger)
+{
+    VoteMap votes;
+    countAll (votes, ledger);
+    return makeTally (votes);
+}
+
+// Call with mLock held
+void InflationVotes::update (Ledger::ref ledger)
+{
+    if (mLedger && (mLedger->getHash () == ledger->getHash ()))
+        return;
+
+    try
+    {
+        if (mLedger)
+        {
+            SHAMap::Delta delta;
+
+            if (mLedger->peekAccountStateMap ()->compare (
+                ledger->peekAccountStateMap (), delta, inflationVoteDifferences))
+            {
+                WriteLog (lsTRACE, InflationVotes) << "Moving votes from ledger " <<
+                    mLedger->getLedgerSeq () << " to " << ledger->getLedgerSeq () <<
+                    ", " << delta.size () << " changes";
+
+                BOOST_FOREACH (SHAMap::Delta::value_type& it, delta)
+                {
+                    addVote (mVotes, it.second.first, false);
+                    addVote (mVotes, it.second.second, true);
+                }
+
+                mLedger = ledger;
+                return;
+            }
+
+            WriteLog (lsDEBUG, InflationVotes) << "Too many changes between ledger " <<
+                mLedger->getLedgerSeq () << " and " << ledger->getLedgerSeq () <<
+                ", counting votes again";
+        }
+
+        VoteMap votes;
+        countAll (votes, ledger);
+        mVotes.swap (votes);
+        mLedger = ledger;
+    }
+    catch (...)
+    {
+        // The votes may have been partly moved
+        mLedger.reset ();
+        mVotes.clear ();
+        throw;
+    }
+}
+
+void InflationVotes::doUpdate (Job&)
+{
+    Ledger::pointer ledger;
+
+    {
+        std::lock_guard <std::mutex> sl (mPendingLock);
+        ledger.swap (mPending);
+    }
+
+    if (!ledger)
+        return;
+
+    try
+    {
+        std::lock_guard <std::mutex> sl (mLock);
+        update (ledger);
+    }
+    catch (SHAMapMissingNode const& mn)
+    {
+        WriteLog (lsINFO, InflationVotes) << "Missing node updating votes: " << mn;
+    }
+}
+
+void InflationVotes::addVote (VoteMap& votes, SHAMapItem::ref item, bool add)
+{
+    if (!item)
+        return;
+
+    // Every entry starts with its sfLedgerEntryType, so the other entry
+    // types can be skipped without parsing them.
+    Blob const& data (item->peekData ());
+
+    if ((data.size () < 3) || (data[0] != 0x11) ||
+        (data[1] != 0) || (data[2] != ltACCOUNT_ROOT))
+        return;
+
+    SerializedLedgerEntry const sle (item->peekSerializer (), item->getTag ());
+
+    if ((sle.getType () != ltACCOUNT_ROOT) || !sle.isFieldPresent (sfInflationDest))
+        return;
+
+    uint160 const destID (sle.getFieldAccount160 (sfInflationDest));
+    std::uint64_t const balance (sle.getFieldAmount (sfBalance).getNValue ());
+    Votes& dest (votes[destID]);
+
+    if (add)
+    {
+        dest.balance += balance;
+        ++dest.voters;
+    }
+    else
+    {
+        dest.balance -= balance;
+
+        // A destination is only in the full count while someone votes for it
+        if (--dest.voters == 0)
+            votes.erase (destID);
+    }
+}
+
+void InflationVotes::countAll (VoteMap& votes, Ledger::ref ledger)
+{
+    // The walk reads every node once, keep it out of the node cache
+    NodeStore::Database::ScopedNoCache noCache;
+
+    votes = ledger->peekAccountStateMap ()->reduceLeaves (VoteMap (),
+        [] (VoteMap& part, SHAMapItem::ref item)
+        {
+            addVote (part, item, true);
+        },
+        [] (VoteMap& total, VoteMap const& part)
+        {
+            BOOST_FOREACH (VoteMap::value_type const& it, part)
+            {
+                Votes& dest (total[it.first]);
+                dest.balance += it.second.balance;
+                dest.voters += it.second.voters;
+            }
+        },
+        &getApp().getJobQueue ());
+}
+
+InflationVotes::Tally InflationVotes::makeTally (VoteMap const& votes)
+{
+    Tally tally;
+
+    BOOST_FOREACH (VoteMap::value_type const& it, votes)
+        tally[it.first] = it.second.balance;
+
+    return tally;
+}
+
+//------------------------------------------------------------------------------
+
+class InflationVotes_test : public beast::unit_test::suite
+{
+public:
+    static int const none = -1;
+
+    struct Account
+    {
+        std::uint64_t balance;
+        int dest;           // Account voted for, or none
+    };
+
+    typedef std::map <int, Account> Model;
+
+    static uint160 accountID (int i)
+    {
+        return uint160 (std::uint64_t (i + 1));
+    }
+
+    // Write the accounts in the model which differ from the ledger
+    static void write (Ledger::ref ledger, Model const& model, Model const& before)
+    {
+        BOOST_FOREACH (Model::value_type const& it, model)
+        {
+            Model::const_iterator const old = before.find (it.first);
+
+            if ((old != before.end ()) && (old->second.balance == it.second.balance) &&
+                (old->second.dest == it.second.dest))
+                continue;
+
+            SLE::pointer sle = boost::make_shared<SLE> (ltACCOUNT_ROOT,
+                Ledger::getAccountRootIndex (accountID (it.first)));
+            sle->setFieldAccount (sfAccount, accountID (it.first));
+            sle->setFieldAmount (sfBalance, STAmount (it.second.balance));
+            sle->setFieldU32 (sfSequence, 1);
+
+            if (it.second.dest != none)
+                sle->setFieldAccount (sfInflationDest, accountID (it.second.dest));
+
+            ledger->writeBack ((old == before.end ()) ? lepCREATE : lepNONE, sle);
+        }
+
+        BOOST_FOREACH (Model::value_type const& it, before)
+        {
+            if (model.find (it.first) == model.end ())
+                ledger->peekAccountStateMap ()->delItem (
+                    Ledger::getAccountRootIndex (accountID (it.first)));
+        }
+    }
+
+    static InflationVotes::Tally makeTally (Model const& model)
+    {
+        InflationVotes::Tally tally;
+
+        BOOST_FOREACH (Model::value_type const& it, model)
+        {
+            if (it.second.dest != none)
+                tally[accountID (it.second.dest)] += it.second.balance;
+        }
+
+        return tally;
+    }
+
+    void run ()
+    {
+        RippleAddress const seed = RippleAddress::createSeedGeneric ("masterpassphrase");
+        Ledger::pointer ledger = boost::make_shared<Ledger> (
+            RippleAddress::createAccountPublic (seed), SYSTEM_CURRENCY_START);
+
+        InflationVotes votes;
+        Model model;
+
+        // Each step changes the model, writes it to the next ledger and
+        // checks the running tally against a full count
+        auto step = [&] (std::string const& name, std::function <void ()> const& change, bool check)
+        {
+            testcase (name);
+
+            Model const before = model;
+            change ();
+
+            ledger->setClosed ();
+            ledger = boost::make_shared<Ledger> (true, boost::ref (*ledger));
+            write (ledger, model, before);
+            ledger->updateHash ();
+
+            if (!check)
+                return;
+
+            InflationVotes::Tally const counted = InflationVotes::countVotes (ledger);
+
+            expect (counted == makeTally (model), "Full count matches the accounts");
+            expect (votes.getTally (ledger) == counted, "Running tally matches the full count");
+        };
+
+        step ("create", [&] ()
+        {
+            for (int i = 0; i < 12; ++i)
+            {
+                Account account = { std::uint64_t (1000 * (i + 1)), (i % 4 == 3) ? none : 20 + (i % 3) };
+                model[i] = account;
+            }
+        }, true);
+
+        step ("balances", [&] ()
+        {
+            model[0].balance += 500;
+            model[1].balance -= 700;
+            model[5].balance = 1;
+        }, true);
+
+        step ("destinations", [&] ()
+        {
+            model[0].dest = 21;
+            model[3].dest = 20;
+            model[4].dest = none;
+            model[5].dest = 5;
+            model[6].balance += 100;
+            model[6].dest = 22;
+        }, true);
+
+        step ("create and delete", [&] ()
+        {
+            Account account = { 2500, 22 };
+            model[12] = account;
+            model.erase (2);
+            model.erase (7);
+        }, true);
+
+        step ("zero balance", [&] ()
+        {
+            model[0].balance = 0;
+            model[1].balance = 0;
+            model[3].balance = 0;
+        }, true);
+
+        step ("from zero", [&] ()
+        {
+            model[0].balance = 4000;
+            model[3].balance = 10;
+            model[3].dest = 21;
+        }, true);
+
+        step ("last voter leaves", [&] ()
+        {
+            for (auto& it : model)
+            {
+                if (it.second.dest == 22)
+                    it.second.dest = none;
+            }
+        }, true);
+
+        // Move the tally over several ledgers at once
+        step ("skipped ledger", [&] ()
+        {
+            model[8].balance += 300;
+            model.erase (9);
+        }, false);
+
+        step ("several ledgers", [&] ()
+        {
+            model[8].dest = 22;
+            model[10].balance = 0;
+            Account account = { 700, 20 };
+            model[13] = account;
+        }, true);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(InflationVotes,ripple_app,ripple);
+
+}
@@ -0,0 +1,81 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#ifndef RIPPLE_INFLATIONVOTES_H_INCLUDED
+#define RIPPLE_INFLATIONVOTES_H_INCLUDED
+
+namespace ripple {
+
+/** Running tally of the inflation votes in the account state.
+
+    An account votes with its balance for the account named in its
+    sfInflationDest field. Counting the votes used to mean reading every
+    entry in the voting ledger while the inflation transaction was being
+    applied. Instead the tally is kept for one ledger and moved forward as
+    ledgers are accepted, by comparing the state maps and recounting only
+    the account roots that changed. When the gap is too large to compare
+    cheaply, the votes are counted from scratch.
+*/
+class InflationVotes : public beast::LeakChecked <InflationVotes>
+{
+public:
+    /** Total balance voting for each account. */
+    typedef std::map <uint160, std::uint64_t> Tally;
+
+    InflationVotes ();
+
+    /** Return the votes in a closed ledger. */
+    Tally getTally (Ledger::ref ledger);
+
+    /** Move the tally to a newly accepted ledger in a job. */
+    void updateLater (Ledger::ref ledger);
+
+    /** Count the votes by reading every entry in the ledger. */
+    static Tally countVotes (Ledger::ref ledger);
+
+private:
+    struct Votes
+    {
+        Votes () : balance (0), voters (0) { }
+
+        std::uint64_t balance;
+        int voters;
+    };
+
+    typedef ripple::unordered_map <uint160, Votes> VoteMap;
+
+    void update (Ledger::ref ledger);
+    void doUpdate (Job&);
+
+    static void addVote (VoteMap& votes, SHAMapItem::ref item, bool add);
+    static void countAll (VoteMap& votes, Ledger::ref ledger);
+    static Tally makeTally (VoteMap const& votes);
+
+    std::mutex mLock;
+    Ledger::pointer mLedger;    // The ledger the votes were counted in
+    VoteMap mVotes;
+
+    std::mutex mPendingLock;
+    Ledger::pointer mPending;   // The ledger the update job will move to
+};
+
+}
+
+#endif
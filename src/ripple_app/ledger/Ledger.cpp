@@ -21,6 +21,8 @@
 
 #include "../../beast/beast/unit_test/suite.h"
 
+#include <chrono>
+
 namespace ripple {
 
 SETUP_LOG (Ledger)
@@ -57,12 +59,9 @@ Ledger::Ledger (const RippleAddress& masterID, std::uint64_t startAmount)
 
     WriteLog (lsTRACE, Ledger) << "root account: " << startAccount->peekSLE ().getJson (0);
 
-    mAccountStateMap->armDirty ();
-
     writeBack (lepCREATE, startAccount->getSLE ());
 
-    auto dirtyNodes = mAccountStateMap->disarmDirty();
-    mAccountStateMap->flushDirty (*dirtyNodes, 256, hotACCOUNT_NODE, mLedgerSeq);
+    mAccountStateMap->flushDirty (hotACCOUNT_NODE, mLedgerSeq);
 
     initializeFees ();
 }
@@ -1027,14 +1026,12 @@ static void stateItemFullAppender(Json::Value& value, SLE::ref sle)
     value.append (sle->getJson (0));
 }
 
-Json::Value Ledger::getJson (int options)
+Json::Value Ledger::getJsonHeader (int options)
 {
     Json::Value ledger (Json::objectValue);
 
     bool bFull = is_bit_set (options, LEDGER_JSON_FULL);
 
-    ScopedLockType sl (mLock);
-
     ledger[jss::seqNum]                = beast::lexicalCastThrow <std::string> (mLedgerSeq); // DEPRECATED
     ledger[jss::parent_hash]           = to_string (mParentHash);
     ledger[jss::ledger_index]          = beast::lexicalCastThrow <std::string> (mLedgerSeq);
@@ -1069,6 +1066,48 @@ Json::Value Ledger::getJson (int options)
         ledger[jss::closed] = false;
     }
 
+    return ledger;
+}
+
+Json::Value Ledger::getTxJson (SHAMapItem::ref item, SHAMapTreeNode::TNType type, int options)
+{
+    if (!is_bit_set (options, LEDGER_JSON_FULL) && !is_bit_set (options, LEDGER_JSON_EXPAND))
+        return to_string (item->getTag ());
+
+    if (type == SHAMapTreeNode::tnTRANSACTION_NM)
+    {
+        SerializerIterator sit (item->peekSerializer ());
+        SerializedTransaction txn (sit);
+        return txn.getJson (0);
+    }
+
+    if (type == SHAMapTreeNode::tnTRANSACTION_MD)
+    {
+        SerializerIterator sit (item->peekSerializer ());
+        Serializer sTxn (sit.getVL ());
+
+        SerializerIterator tsit (sTxn);
+        SerializedTransaction txn (tsit);
+
+        TransactionMetaSet meta (item->getTag (), mLedgerSeq, sit.getVL ());
+        Json::Value txJson = txn.getJson (0);
+        txJson[jss::metaData] = meta.getJson (0);
+        return txJson;
+    }
+
+    Json::Value error = Json::objectValue;
+    error[to_string (item->getTag ())] = type;
+    return error;
+}
+
+Json::Value Ledger::getJson (int options)
+{
+    bool bFull = is_bit_set (options, LEDGER_JSON_FULL);
+
+    ScopedLockType sl (mLock);
+
+    Json::Value ledger (getJsonHeader (options));
+
     if (mTransactionMap && (bFull || is_bit_set (options, LEDGER_JSON_DUMP_TSTR)))
     {
         Json::Value& txns = (ledger[jss::transactions] = Json::arrayValue);
@@ -1076,38 +1115,7 @@ Json::Value Ledger::getJson (int options)
 
         for (SHAMapItem::pointer item = mTransactionMap->peekFirstItem (type); !!item;
                 item = mTransactionMap->peekNextItem (item->getTag (), type))
-        {
-            if (bFull || is_bit_set (options, LEDGER_JSON_EXPAND))
-            {
-                if (type == SHAMapTreeNode::tnTRANSACTION_NM)
-                {
-                    SerializerIterator sit (item->peekSerializer ());
-                    SerializedTransaction txn (sit);
-                    txns.append (txn.getJson (0));
-                }
-                else if (type == SHAMapTreeNode::tnTRANSACTION_MD)
-                {
-                    SerializerIterator sit (item->peekSerializer ());
-                    Serializer sTxn (sit.getVL ());
-
-                    SerializerIterator tsit (sTxn);
-                    SerializedTransaction txn (tsit);
-
-                    TransactionMetaSet meta (item->getTag (), mLedgerSeq, sit.getVL ());
-                    Json::Value txJson = txn.getJson (0);
-                    txJson[jss::metaData] = meta.getJson (0);
-                    txns.append (txJson);
-                }
-                else
-                {
-                    Json::Value error = Json::objectValue;
-                    error[to_string (item->getTag ())] = type;
-                    txns.append (error);
-                }
-            }
-            else txns.append (to_string (item->getTag ()));
-        }
-
+            txns.append (getTxJson (item, type, options));
     }
 
     if (mAccountStateMap && (bFull || is_bit_set (options, LEDGER_JSON_DUMP_STATE)))
@@ -1122,6 +1130,56 @@ Json::Value Ledger::getJson (int options)
     return ledger;
 }
 
+void Ledger::addJson (Json::Stream& stream, int options)
+{
+    bool bFull = is_bit_set (options, LEDGER_JSON_FULL);
+
+    Json::Value header;
+
+    // Writing can wait on a slow client, so the lock is only held for the
+    // header. The maps are walked through snapshots and don't need it.
+    {
+        ScopedLockType sl (mLock);
+        header = getJsonHeader (options);
+    }
+
+    stream.startObject (jss::ledger);
+    stream.setMembers (header);
+
+    if (mTransactionMap && (bFull || is_bit_set (options, LEDGER_JSON_DUMP_TSTR)))
+    {
+        stream.startArray (jss::transactions);
+        SHAMapTreeNode::TNType type;
+
+        for (SHAMapItem::pointer item = mTransactionMap->peekFirstItem (type); !!item;
+                item = mTransactionMap->peekNextItem (item->getTag (), type))
+            stream.append (getTxJson (item, type, options));
+
+        stream.finish ();
+    }
+
+    if (mAccountStateMap && (bFull || is_bit_set (options, LEDGER_JSON_DUMP_STATE)))
+    {
+        stream.startArray (jss::accountState);
+
+        // The ordered visit calls back on this thread, in key order
+        if (bFull || is_bit_set (options, LEDGER_JSON_EXPAND))
+            visitStateItems ([&stream] (SLE::ref sle)
+            {
+                stream.append (sle->getJson (0));
+            });
+        else
+            mAccountStateMap->visitLeaves ([&stream] (SHAMapItem::ref smi)
+            {
+                stream.append (to_string (smi->getTag ()));
+            });
+
+        stream.finish ();
+    }
+
+    stream.finish ();
+}
+
 void Ledger::setAcquiring (void)
 {
     if (!mTransactionMap || !mAccountStateMap) throw std::runtime_error ("invalid map");
@@ -1265,7 +1323,8 @@ void Ledger::visitStateItems (std::function<void (SLE::ref)> function)
     try
     {
         if (mAccountStateMap)
-            mAccountStateMap->visitLeaves(BIND_TYPE(&visitHelper, std::ref(function), P_1));
+            mAccountStateMap->visitLeavesParallel(BIND_TYPE(&visitHelper, std::ref(function), P_1),
+                true, &getApp().getJobQueue());
     }
     catch (SHAMapMissingNode&)
     {
@@ -1742,7 +1801,10 @@ bool Ledger::walkLedger ()
     std::vector <SHAMapMissingNode> missingNodes1;
     std::vector <SHAMapMissingNode> missingNodes2;
 
-    mAccountStateMap->walkMap (missingNodes1, 32);
+    // A full walk shouldn't push the working set out of the node cache
+    NodeStore::Database::ScopedNoCache noCache;
+
+    mAccountStateMap->walkMap (missingNodes1, 32, &getApp().getJobQueue ());
 
     if (ShouldLog (lsINFO, Ledger) && !missingNodes1.empty ())
     {
@@ -1750,7 +1812,7 @@ bool Ledger::walkLedger ()
         Log (lsINFO) << "First: " << missingNodes1[0];
     }
 
-    mTransactionMap->walkMap (missingNodes2, 32);
+    mTransactionMap->walkMap (missingNodes2, 32, &getApp().getJobQueue ());
 
     if (ShouldLog (lsINFO, Ledger) && !missingNodes2.empty ())
     {
@@ -2030,6 +2092,224 @@ public:
 
 BEAST_DEFINE_TESTSUITE(Ledger,ripple_app,ripple);
 
+//------------------------------------------------------------------------------
+
+// Times the JSON of a ledger with expanded transactions and of an
+// account_tx reply, appending each transaction by copy and by move.
+class Ledger_timing_test : public beast::unit_test::suite
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    typedef std::vector <std::pair <
+        Transaction::pointer, TransactionMetaSet::pointer>> AccountTxs;
+
+    enum
+    {
+        accounts = 64,
+        transactions = 2000,
+        rounds = 5
+    };
+
+    static uint160 accountID (int i)
+    {
+        return uint160 (std::uint64_t (i + 1));
+    }
+
+    // An open ledger following a genesis ledger holding the accounts
+    static Ledger::pointer makeLedger ()
+    {
+        RippleAddress const seed = RippleAddress::createSeedGeneric ("masterpassphrase");
+        Ledger::pointer genesis = boost::make_shared<Ledger> (
+            RippleAddress::createAccountPublic (seed), SYSTEM_CURRENCY_START);
+
+        for (int i = 0; i < accounts; ++i)
+        {
+            SLE::pointer sle = boost::make_shared<SLE> (ltACCOUNT_ROOT,
+                Ledger::getAccountRootIndex (accountID (i)));
+            sle->setFieldAccount (sfAccount, accountID (i));
+            sle->setFieldAmount (sfBalance, STAmount (std::uint64_t (100000000000)));
+            sle->setFieldU32 (sfSequence, 1);
+            genesis->writeBack (lepCREATE, sle);
+        }
+
+        genesis->updateHash ();
+        genesis->setClosed ();
+
+        return boost::make_shared<Ledger> (true, boost::ref (*genesis));
+    }
+
+    // Apply a payment and add it with its metadata, as the transaction
+    // engine does
+    static void pay (Ledger::ref ledger, std::uint32_t index, int src, int dst)
+    {
+        RippleAddress source;
+        source.setAccountID (accountID (src));
+        RippleAddress destination;
+        destination.setAccountID (accountID (dst));
+        STAmount const amount (std::uint64_t (1000000 + index));
+
+        SerializedTransaction tx (ttPAYMENT);
+        tx.setSourceAccount (source);
+        tx.setFieldAccount (sfDestination, destination);
+        tx.setFieldAmount (sfAmount, amount);
+        tx.setFieldU32 (sfSequence, index + 1);
+        tx.setFieldAmount (sfFee, STAmount (std::uint64_t (10)));
+        uint256 const txID = tx.getTransactionID ();
+
+        LedgerEntrySet les (ledger, tapNONE);
+        les.init (ledger, txID, ledger->getLedgerSeq (), tapNONE);
+        les.accountSend (accountID (src), accountID (dst), amount);
+
+        Serializer meta;
+        les.calcRawMeta (meta, tesSUCCESS, index);
+
+        for (auto const& item : les)
+        {
+            if (item.second.mAction == taaCREATE)
+                ledger->writeBack (lepCREATE, item.second.mEntry);
+            else if (item.second.mAction == taaMODIFY)
+                ledger->writeBack (lepNONE, item.second.mEntry);
+        }
+
+        Serializer s;
+        tx.add (s);
+        ledger->addTransaction (txID, s, meta);
+    }
+
+    // The transactions in the ledger, parsed as account_tx gets them
+    static AccountTxs getAccountTxs (Ledger::ref ledger)
+    {
+        AccountTxs txns;
+        SHAMap::ref map = ledger->peekTransactionMap ();
+        SHAMapTreeNode::TNType type;
+
+        for (SHAMapItem::pointer item = map->peekFirstItem (type); !!item;
+                item = map->peekNextItem (item->getTag (), type))
+        {
+            SerializerIterator sit (item->peekSerializer ());
+            Serializer sTxn (sit.getVL ());
+            SerializerIterator tsit (sTxn);
+
+            txns.push_back (std::make_pair (
+                boost::make_shared<Transaction> (
+                    boost::make_shared<SerializedTransaction> (boost::ref (tsit)), false),
+                boost::make_shared<TransactionMetaSet> (
+                    item->getTag (), ledger->getLedgerSeq (), sit.getVL ())));
+        }
+
+        return txns;
+    }
+
+    static void append (Json::Value& array, Json::Value& value, bool move)
+    {
+        if (move)
+            array.append (std::move (value));
+        else
+            array.append (value);
+    }
+
+    // The transaction list of Ledger::getJson with LEDGER_JSON_EXPAND
+    static Json::Value buildLedger (Ledger::ref ledger, bool move)
+    {
+        Json::Value txns (Json::arrayValue);
+        SHAMap::ref map = ledger->peekTransactionMap ();
+        SHAMapTreeNode::TNType type;
+
+        for (SHAMapItem::pointer item = map->peekFirstItem (type); !!item;
+                item = map->peekNextItem (item->getTag (), type))
+        {
+            SerializerIterator sit (item->peekSerializer ());
+            Serializer sTxn (sit.getVL ());
+            SerializerIterator tsit (sTxn);
+            SerializedTransaction txn (tsit);
+
+            TransactionMetaSet meta (item->getTag (), ledger->getLedgerSeq (), sit.getVL ());
+            Json::Value txJson = txn.getJson (0);
+            txJson[jss::metaData] = meta.getJson (0);
+            append (txns, txJson, move);
+        }
+
+        return txns;
+    }
+
+    // The transaction list of account_tx
+    static Json::Value buildAccountTx (AccountTxs const& txns, bool move)
+    {
+        Json::Value jvTxns (Json::arrayValue);
+
+        for (auto const& txn : txns)
+        {
+            Json::Value jvObj (Json::objectValue);
+            jvObj[jss::tx] = txn.first->getJson (1);
+            jvObj[jss::meta] = txn.second->getJson (0);
+            jvObj[jss::validated] = true;
+            append (jvTxns, jvObj, move);
+        }
+
+        return jvTxns;
+    }
+
+    // The best of several runs, in microseconds
+    template <class Function>
+    static std::int64_t time (Function f)
+    {
+        clock_type::duration best = clock_type::duration::max ();
+
+        for (int i = 0; i < rounds; ++i)
+        {
+            clock_type::time_point const start = clock_type::now ();
+            f ();
+            best = std::min (best, clock_type::now () - start);
+        }
+
+        return std::chrono::duration_cast <
+            std::chrono::microseconds> (best).count ();
+    }
+
+    void report (std::string const& name, std::int64_t copy, std::int64_t move)
+    {
+        log << name << ": copy " << copy << "us, move " << move << "us";
+    }
+
+    void run ()
+    {
+        Ledger::pointer ledger = makeLedger ();
+
+        for (int i = 0; i < transactions; ++i)
+            pay (ledger, i, i % accounts, (i + 1) % accounts);
+
+        ledger->updateHash ();
+        ledger->setClosed ();
+
+        testcase ("ledger");
+
+        int const options = LEDGER_JSON_DUMP_TSTR | LEDGER_JSON_EXPAND;
+        Json::Value const built = ledger->getJson (options);
+        expect (built[jss::transactions].size () == transactions);
+        expect (buildLedger (ledger, false) == built[jss::transactions]);
+        expect (buildLedger (ledger, true) == built[jss::transactions]);
+
+        report ("ledger",
+            time ([&] { buildLedger (ledger, false); }),
+            time ([&] { buildLedger (ledger, true); }));
+        log << "Ledger::getJson: " <<
+            time ([&] { ledger->getJson (options); }) << "us";
+
+        testcase ("account_tx");
+
+        AccountTxs const txns = getAccountTxs (ledger);
+        expect (txns.size () == transactions);
+        expect (buildAccountTx (txns, false) == buildAccountTx (txns, true));
+
+        report ("account_tx",
+            time ([&] { buildAccountTx (txns, false); }),
+            time ([&] { buildAccountTx (txns, true); }));
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(Ledger_timing,ripple_app,ripple);
+
 Ledger::StaticLockType Ledger::sPendingSaveLock;
 std::set<std::uint32_t> Ledger::sPendingSaves;
 
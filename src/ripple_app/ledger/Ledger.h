@@ -457,6 +457,14 @@ public:
     Json::Value getJson (int options);
     void addJson (Json::Value&, int options);
 
+    /** Write the ledger as the "ledger" member of the stream's open object.
+        Transactions and state entries are converted and written one at a
+        time, so only the entry being written is held as a Json::Value.
+        How much of the written text is held depends on the stream's
+        output, which may wait for it to be sent.
+    */
+    void addJson (Json::Stream&, int options);
+
     bool walkLedger ();
     bool assertSane ();
 
@@ -477,6 +485,11 @@ protected:
 private:
     void initializeFees ();
 
+    // The members of getJson other than the transactions and the state.
+    // Called holding mLock.
+    Json::Value getJsonHeader (int options);
+    Json::Value getTxJson (SHAMapItem::ref item, SHAMapTreeNode::TNType type, int options);
+
 private:
     // The basic Ledger structure, can be opened, closed, or synching
     uint256     mHash;
@@ -17,6 +17,8 @@
 */
 //==============================================================================
 
+#include "../../beast/beast/unit_test/suite.h"
+
 namespace ripple {
 
 SETUP_LOG (LedgerEntrySet)
@@ -32,6 +34,7 @@ void LedgerEntrySet::init (Ledger::ref ledger, uint256 const& transactionID,
                            std::uint32_t ledgerID, TransactionEngineParams params)
 {
     mEntries.clear ();
+    mBase.reset ();
     mLedger = ledger;
     mSet.init (transactionID, ledgerID);
     mParams = params;
@@ -41,18 +44,23 @@ void LedgerEntrySet::init (Ledger::ref ledger, uint256 const& transactionID,
 void LedgerEntrySet::clear ()
 {
     mEntries.clear ();
+    mBase.reset ();
     mSet.clear ();
 }
 
 LedgerEntrySet LedgerEntrySet::duplicate () const
 {
-    return LedgerEntrySet (mLedger, mEntries, mSet, mSeq + 1);
+    // Both sets build on the same layers from here on. The copy-on-read
+    // below still applies, since the duplicate has a higher sequence.
+    freeze ();
+    return LedgerEntrySet (mLedger, mBase, mSet, mSeq + 1);
 }
 
 void LedgerEntrySet::setTo (const LedgerEntrySet& e)
 {
     mLedger = e.mLedger;
     mEntries = e.mEntries;
+    mBase = e.mBase;
     mSet = e.mSet;
     mParams = e.mParams;
     mSeq = e.mSeq;
@@ -62,16 +70,162 @@ void LedgerEntrySet::swapWith (LedgerEntrySet& e)
 {
     std::swap (mLedger, e.mLedger);
     mEntries.swap (e.mEntries);
+    mBase.swap (e.mBase);
     mSet.swap (e.mSet);
     std::swap (mParams, e.mParams);
     std::swap (mSeq, e.mSeq);
 }
 
+void LedgerEntrySet::freeze () const
+{
+    if (mEntries.empty ())
+        return;
+
+    std::shared_ptr <Layer> layer (std::make_shared <Layer> ());
+
+    if (mBase && mBase->depth >= maxLayerDepth)
+    {
+        // Too deep, replace the whole chain with one layer
+        flatten ();
+        layer->depth = 1;
+    }
+    else
+    {
+        layer->base = mBase;
+        layer->depth = mBase ? mBase->depth + 1 : 1;
+    }
+
+    layer->entries.swap (mEntries);
+    mBase = layer;
+}
+
+void LedgerEntrySet::flatten () const
+{
+    if (!mBase)
+        return;
+
+    std::vector <Layer const*> layers;
+
+    for (Layer const* layer = mBase.get (); layer != nullptr; layer = layer->base.get ())
+        layers.push_back (layer);
+
+    // Apply the layers from the bottom up, then this set's own entries
+    EntryMap entries;
+
+    auto apply = [&entries] (EntryMap const& from)
+    {
+        for (auto const& item : from)
+        {
+            auto const result = entries.insert (item);
+
+            if (!result.second)
+                result.first->second = item.second;
+        }
+    };
+
+    for (auto it = layers.rbegin (); it != layers.rend (); ++it)
+        apply ((*it)->entries);
+
+    apply (mEntries);
+
+    for (auto it = entries.begin (); it != entries.end ();)
+    {
+        if (it->second.mAction == taaNONE)
+            it = entries.erase (it);
+        else
+            ++it;
+    }
+
+    mEntries.swap (entries);
+    mBase.reset ();
+}
+
+LedgerEntrySetEntry const* LedgerEntrySet::findEntry (uint256 const& index) const
+{
+    EntryMap::const_iterator it = mEntries.find (index);
+
+    if (it == mEntries.end ())
+    {
+        Layer const* layer = mBase.get ();
+
+        for (; layer != nullptr; layer = layer->base.get ())
+        {
+            it = layer->entries.find (index);
+
+            if (it != layer->entries.end ())
+                break;
+        }
+
+        if (layer == nullptr)
+            return nullptr;
+    }
+
+    if (it->second.mAction == taaNONE)
+        return nullptr;
+
+    return &it->second;
+}
+
+LedgerEntrySet::EntryMap::iterator LedgerEntrySet::findOwnEntry (uint256 const& index)
+{
+    EntryMap::iterator it = mEntries.find (index);
+
+    if (it != mEntries.end ())
+        return (it->second.mAction == taaNONE) ? mEntries.end () : it;
+
+    LedgerEntrySetEntry const* const entry = findEntry (index);
+
+    if (entry == nullptr)
+        return mEntries.end ();
+
+    // The SLE is still shared, getEntry copies it if the sequence says so
+    return mEntries.insert (std::make_pair (index, *entry)).first;
+}
+
+void LedgerEntrySet::insertEntry (uint256 const& index, LedgerEntrySetEntry const& entry)
+{
+    auto const result = mEntries.insert (std::make_pair (index, entry));
+
+    if (!result.second)
+    {
+        // Replaces a removed entry
+        assert (result.first->second.mAction == taaNONE);
+        result.first->second = entry;
+    }
+}
+
+void LedgerEntrySet::eraseEntry (EntryMap::iterator it)
+{
+    bool shared = false;
+
+    for (Layer const* layer = mBase.get (); layer != nullptr; layer = layer->base.get ())
+    {
+        EntryMap::const_iterator const found = layer->entries.find (it->first);
+
+        if (found != layer->entries.end ())
+        {
+            shared = found->second.mAction != taaNONE;
+            break;
+        }
+    }
+
+    if (shared)
+    {
+        // Hide the entry in the layers below
+        it->second.mEntry.reset ();
+        it->second.mAction = taaNONE;
+    }
+    else
+    {
+        mEntries.erase (it);
+    }
+}
+
 // Find an entry in the set.  If it has the wrong sequence number, copy it and update the sequence number.
 // This is basically: copy-on-read.
 SLE::pointer LedgerEntrySet::getEntry (uint256 const& index, LedgerEntryAction& action)
 {
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (index);
+    EntryMap::iterator it = findOwnEntry (index);
 
     if (it == mEntries.end ())
     {
@@ -125,23 +279,23 @@ SLE::pointer LedgerEntrySet::entryCache (LedgerEntryType letType, uint256 const&
 
 LedgerEntryAction LedgerEntrySet::hasEntry (uint256 const& index) const
 {
-    std::map<uint256, LedgerEntrySetEntry>::const_iterator it = mEntries.find (index);
+    LedgerEntrySetEntry const* const entry = findEntry (index);
 
-    if (it == mEntries.end ())
+    if (entry == nullptr)
         return taaNONE;
 
-    return it->second.mAction;
+    return entry->mAction;
 }
 
 void LedgerEntrySet::entryCache (SLE::ref sle)
 {
     assert (mLedger);
     assert (sle->isMutable () || mImmutable); // Don't put an immutable SLE in a mutable LES
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (sle->getIndex ());
+    EntryMap::iterator it = findOwnEntry (sle->getIndex ());
 
     if (it == mEntries.end ())
     {
-        mEntries.insert (std::make_pair (sle->getIndex (), LedgerEntrySetEntry (sle, taaCACHED, mSeq)));
+        insertEntry (sle->getIndex (), LedgerEntrySetEntry (sle, taaCACHED, mSeq));
         return;
     }
 
@@ -162,11 +316,11 @@ void LedgerEntrySet::entryCreate (SLE::ref sle)
 {
     assert (mLedger && !mImmutable);
     assert (sle->isMutable ());
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (sle->getIndex ());
+    EntryMap::iterator it = findOwnEntry (sle->getIndex ());
 
     if (it == mEntries.end ())
     {
-        mEntries.insert (std::make_pair (sle->getIndex (), LedgerEntrySetEntry (sle, taaCREATE, mSeq)));
+        insertEntry (sle->getIndex (), LedgerEntrySetEntry (sle, taaCREATE, mSeq));
         return;
     }
 
@@ -200,11 +354,11 @@ void LedgerEntrySet::entryModify (SLE::ref sle)
 {
     assert (sle->isMutable () && !mImmutable);
     assert (mLedger);
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (sle->getIndex ());
+    EntryMap::iterator it = findOwnEntry (sle->getIndex ());
 
     if (it == mEntries.end ())
     {
-        mEntries.insert (std::make_pair (sle->getIndex (), LedgerEntrySetEntry (sle, taaMODIFY, mSeq)));
+        insertEntry (sle->getIndex (), LedgerEntrySetEntry (sle, taaMODIFY, mSeq));
         return;
     }
 
@@ -236,12 +390,12 @@ void LedgerEntrySet::entryDelete (SLE::ref sle)
 {
     assert (sle->isMutable () && !mImmutable);
     assert (mLedger);
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (sle->getIndex ());
+    EntryMap::iterator it = findOwnEntry (sle->getIndex ());
 
     if (it == mEntries.end ())
     {
         assert (false); // deleting an entry not cached?
-        mEntries.insert (std::make_pair (sle->getIndex (), LedgerEntrySetEntry (sle, taaDELETE, mSeq)));
+        insertEntry (sle->getIndex (), LedgerEntrySetEntry (sle, taaDELETE, mSeq));
         return;
     }
 
@@ -258,7 +412,7 @@ void LedgerEntrySet::entryDelete (SLE::ref sle)
         break;
 
     case taaCREATE:
-        mEntries.erase (it);
+        eraseEntry (it);
         break;
 
     case taaDELETE:
@@ -271,6 +425,8 @@ void LedgerEntrySet::entryDelete (SLE::ref sle)
 
 bool LedgerEntrySet::hasChanges ()
 {
+    flatten ();
+
     typedef std::map<uint256, LedgerEntrySetEntry>::value_type u256_LES_pair;
     BOOST_FOREACH (u256_LES_pair & it, mEntries)
 
@@ -286,6 +442,8 @@ Json::Value LedgerEntrySet::getJson (int) const
 
     Json::Value nodes (Json::arrayValue);
 
+    flatten ();
+
     for (auto it = mEntries.begin (), end = mEntries.end (); it != end; ++it)
     {
         Json::Value entry (Json::objectValue);
@@ -360,7 +518,7 @@ Json::Value LedgerEntrySet::getJson (int) const
 SLE::pointer LedgerEntrySet::getForMod (uint256 const& node, Ledger::ref ledger,
                                         ripple::unordered_map<uint256, SLE::pointer>& newMods)
 {
-    std::map<uint256, LedgerEntrySetEntry>::iterator it = mEntries.find (node);
+    EntryMap::iterator it = findOwnEntry (node);
 
     if (it != mEntries.end ())
     {
@@ -467,6 +625,8 @@ void LedgerEntrySet::calcRawMeta (Serializer& s, TER result, std::uint32_t index
     // Entries modified only as a result of building the transaction metadata
     ripple::unordered_map<uint256, SLE::pointer> newMod;
 
+    flatten ();
+
     typedef std::map<uint256, LedgerEntrySetEntry>::value_type u256_LES_pair;
     BOOST_FOREACH (u256_LES_pair & it, mEntries)
     {
@@ -1016,22 +1176,45 @@ uint256 LedgerEntrySet::getNextLedgerIndex (uint256 const& uHash)
 {
     // find next node in ledger that isn't deleted by LES
     uint256 ledgerNext = uHash;
-    std::map<uint256, LedgerEntrySetEntry>::const_iterator it;
+    LedgerEntrySetEntry const* entry;
 
     do
     {
         ledgerNext = mLedger->getNextLedgerIndex (ledgerNext);
-        it  = mEntries.find (ledgerNext);
+        entry = findEntry (ledgerNext);
     }
-    while ((it != mEntries.end ()) && (it->second.mAction == taaDELETE));
+    while ((entry != nullptr) && (entry->mAction == taaDELETE));
+
+    // find next node in LES that isn't deleted, in this set's own entries
+    // and in each of the layers
+    uint256 lesNext;
 
-    // find next node in LES that isn't deleted
-    for (it = mEntries.upper_bound (uHash); it != mEntries.end (); ++it)
+    auto scan = [&] (EntryMap const& entries)
     {
-        // node found in LES, node found in ledger, return earliest
-        if (it->second.mAction != taaDELETE)
-            return (ledgerNext.isNonZero () && (ledgerNext < it->first)) ? ledgerNext : it->first;
-    }
+        for (auto it = entries.upper_bound (uHash); it != entries.end (); ++it)
+        {
+            if (lesNext.isNonZero () && (lesNext <= it->first))
+                break;
+
+            // The key may be hidden by a layer above
+            LedgerEntrySetEntry const* const found = findEntry (it->first);
+
+            if ((found != nullptr) && (found->mAction != taaDELETE))
+            {
+                lesNext = it->first;
+                break;
+            }
+        }
+    };
+
+    scan (mEntries);
+
+    for (Layer const* layer = mBase.get (); layer != nullptr; layer = layer->base.get ())
+        scan (layer->entries);
+
+    // node found in LES, node found in ledger, return earliest
+    if (lesNext.isNonZero ())
+        return (ledgerNext.isNonZero () && (ledgerNext < lesNext)) ? ledgerNext : lesNext;
 
     // nothing next in LES, return next ledger node
     return ledgerNext;
@@ -1717,5 +1900,354 @@ TER LedgerEntrySet::accountSend (const uint160& uSenderID, const uint160& uRecei
     return terResult;
 }
 
-} // ripple
+//------------------------------------------------------------------------------
+
+class LedgerEntrySet_test : public beast::unit_test::suite
+{
+public:
+    typedef std::function <void (LedgerEntrySet&)> Edit;
+
+    static uint256 accountIndex (int i)
+    {
+        return Ledger::getAccountRootIndex (uint160 (std::uint64_t (i + 1)));
+    }
+
+    static SLE::pointer makeAccount (int i, std::uint64_t balance)
+    {
+        uint160 const account (std::uint64_t (i + 1));
+        SLE::pointer sle = boost::make_shared<SLE> (ltACCOUNT_ROOT,
+            Ledger::getAccountRootIndex (account));
+        sle->setFieldAccount (sfAccount, account);
+        sle->setFieldAmount (sfBalance, STAmount (balance));
+        sle->setFieldU32 (sfSequence, 1);
+        return sle;
+    }
+
+    // A genesis ledger holding accounts 0 to count-1, each with 1000
+    static Ledger::pointer makeLedger (int count)
+    {
+        RippleAddress const seed = RippleAddress::createSeedGeneric ("masterpassphrase");
+        Ledger::pointer ledger = boost::make_shared<Ledger> (
+            RippleAddress::createAccountPublic (seed), SYSTEM_CURRENCY_START);
+
+        for (int i = 0; i < count; ++i)
+            ledger->writeBack (lepCREATE, makeAccount (i, 1000));
+
+        return ledger;
+    }
+
+    static void init (LedgerEntrySet& les, Ledger::ref ledger)
+    {
+        les.init (ledger, uint256 (std::uint64_t (42)), ledger->getLedgerSeq (), tapNONE);
+    }
+
+    // Balance of an account as seen by the set, 0 if it does not exist
+    static std::uint64_t getBalance (LedgerEntrySet& les, int i)
+    {
+        SLE::pointer sle = les.entryCache (ltACCOUNT_ROOT, accountIndex (i));
+        return sle ? sle->getFieldAmount (sfBalance).getNValue () : 0;
+    }
+
+    static void setBalance (LedgerEntrySet& les, int i, std::uint64_t balance)
+    {
+        SLE::pointer sle = les.entryCache (ltACCOUNT_ROOT, accountIndex (i));
+        sle->setFieldAmount (sfBalance, STAmount (balance));
+        les.entryModify (sle);
+    }
+
+    static void create (LedgerEntrySet& les, int i, std::uint64_t balance)
+    {
+        les.entryCreate (makeAccount (i, balance));
+    }
+
+    static void remove (LedgerEntrySet& les, int i)
+    {
+        les.entryDelete (les.entryCache (ltACCOUNT_ROOT, accountIndex (i)));
+    }
+
+    static std::vector <uint256> walk (LedgerEntrySet& les)
+    {
+        std::vector <uint256> keys;
+
+        for (uint256 key = les.getNextLedgerIndex (uint256 ());
+            key.isNonZero (); key = les.getNextLedgerIndex (key))
+        {
+            keys.push_back (key);
+        }
+
+        return keys;
+    }
+
+    void testDropDuplicate ()
+    {
+        testcase ("drop duplicate");
+
+        Ledger::pointer ledger = makeLedger (3);
+        LedgerEntrySet les (ledger, tapNONE);
+        init (les, ledger);
+
+        setBalance (les, 0, 2000);
+        SLE::pointer const parentEntry = les.entryCache (ltACCOUNT_ROOT, accountIndex (0));
+
+        {
+            LedgerEntrySet child = les.duplicate ();
+
+            expect (getBalance (child, 0) == 2000, "Duplicate sees the parent's change");
+            setBalance (child, 0, 3000);
+            remove (child, 1);
+            create (child, 5, 500);
+
+            expect (getBalance (child, 0) == 3000, "Duplicate sees its change");
+            expect (child.hasEntry (accountIndex (1)) == taaDELETE, "Duplicate deleted");
+            expect (child.hasEntry (accountIndex (5)) == taaCREATE, "Duplicate created");
+        }
+
+        expect (parentEntry->getFieldAmount (sfBalance).getNValue () == 2000,
+            "Parent's entry was copied, not changed");
+        expect (les.hasEntry (accountIndex (0)) == taaMODIFY, "Parent still modified");
+        expect (getBalance (les, 0) == 2000, "Parent keeps its balance");
+        expect (les.hasEntry (accountIndex (1)) == taaNONE, "Parent never saw the delete");
+        expect (getBalance (les, 1) == 1000, "Parent reads the ledger");
+        expect (les.hasEntry (accountIndex (5)) == taaNONE, "Parent never saw the create");
+        expect (getBalance (les, 5) == 0, "Created entry is gone");
+    }
+
+    void testDeleteMarker ()
+    {
+        testcase ("delete marker");
+
+        Ledger::pointer ledger = makeLedger (2);
+        LedgerEntrySet les (ledger, tapNONE);
+        init (les, ledger);
+
+        LedgerEntrySet child = les.duplicate ();
+        create (child, 7, 700);
+
+        // The created entry moves into a layer shared with the grandchild
+        LedgerEntrySet grand = child.duplicate ();
+        expect (grand.hasEntry (accountIndex (7)) == taaCREATE, "Created in a layer");
+
+        remove (grand, 7);
+        expect (grand.hasEntry (accountIndex (7)) == taaNONE, "Marker hides the layer");
+        expect (getBalance (grand, 7) == 0, "Marker hides the entry");
+        expect (child.hasEntry (accountIndex (7)) == taaCREATE, "Layer is unchanged");
+
+        // The marker itself moves into a layer
+        LedgerEntrySet great = grand.duplicate ();
+        expect (great.getLayerDepth () == 2, "Two layers");
+        expect (great.hasEntry (accountIndex (7)) == taaNONE, "Marker hides from a layer");
+        expect (walk (great) == walk (les), "Marker hidden from the walk");
+
+        int count = 0;
+
+        for (auto const& item : great)
+        {
+            if (item.first == accountIndex (7))
+                ++count;
+        }
+
+        expect (count == 0, "Flatten drops the marker");
+
+        create (great, 7, 900);
+        expect (great.hasEntry (accountIndex (7)) == taaCREATE, "Created again");
+        expect (getBalance (great, 7) == 900, "New entry is seen");
+        expect (getBalance (child, 7) == 700, "Old entry is unchanged");
+    }
+
+    void testNextIndex ()
+    {
+        testcase ("next index");
+
+        int const accounts = 40;
+        Ledger::pointer ledger = makeLedger (accounts);
+        LedgerEntrySet les (ledger, tapNONE);
+        init (les, ledger);
+
+        std::set <uint256> model;
+
+        for (uint256 key = ledger->getNextLedgerIndex (uint256 ());
+            key.isNonZero (); key = ledger->getNextLedgerIndex (key))
+        {
+            model.insert (key);
+        }
+
+        expect (model.size () == std::size_t (accounts + 1), "Ledger holds the accounts");
+
+        int created = accounts;
+
+        for (int round = 0; round < 6; ++round)
+        {
+            LedgerEntrySet child = les.duplicate ();
+
+            // Delete two ledger entries and the entry created last round
+            for (int i = round * 2; i < round * 2 + 2; ++i)
+            {
+                remove (child, i);
+                model.erase (accountIndex (i));
+            }
+
+            if (round > 0)
+            {
+                remove (child, created - 1);
+                model.erase (accountIndex (created - 1));
+            }
+
+            // Create and change some more
+            for (int i = 0; i < 3; ++i, ++created)
+            {
+                create (child, created, 100);
+                model.insert (accountIndex (created));
+            }
+
+            setBalance (child, accounts - 1, 1000 + round);
+
+            // A discarded duplicate changes nothing
+            {
+                LedgerEntrySet scratch = child.duplicate ();
+                remove (scratch, accounts - 2);
+                create (scratch, 1000, 100);
+            }
+
+            les.swapWith (child);
+
+            expect (walk (les) == std::vector <uint256> (model.begin (), model.end ()),
+                "Walk matches after round " + std::to_string (round));
+        }
+
+        les.duplicate ();
+        expect (walk (les) == std::vector <uint256> (model.begin (), model.end ()),
+            "Walk matches from a layer");
+    }
+
+    void testFlattenDepth ()
+    {
+        testcase ("flatten depth");
+
+        Ledger::pointer ledger = makeLedger (12);
+        LedgerEntrySet les (ledger, tapNONE);
+        init (les, ledger);
+
+        expect (les.getLayerDepth () == 0, "No layers");
+        les.duplicate ();
+        expect (les.getLayerDepth () == 0, "Nothing to freeze");
+
+        for (int i = 0; i < 8; ++i)
+        {
+            setBalance (les, i, 2000 + i);
+            les.duplicate ();
+            expect (les.getLayerDepth () == i + 1, "Depth grows");
+        }
+
+        setBalance (les, 8, 3000);
+        LedgerEntrySet child = les.duplicate ();
+        expect (les.getLayerDepth () == 1, "Flattened to one layer");
+        expect (child.getLayerDepth () == 1, "Duplicate shares the layer");
+
+        for (int i = 0; i < 8; ++i)
+        {
+            expect (getBalance (les, i) == 2000 + i, "Change kept by flatten");
+            expect (getBalance (child, i) == 2000 + i, "Duplicate sees the change");
+        }
+
+        expect (getBalance (les, 8) == 3000, "Last change kept");
+        expect (getBalance (les, 9) == 1000, "Unchanged entry");
+    }
+
+    void testSwap ()
+    {
+        testcase ("swap");
+
+        Ledger::pointer ledger = makeLedger (4);
+        LedgerEntrySet les (ledger, tapNONE);
+        init (les, ledger);
+
+        setBalance (les, 0, 2000);
+        LedgerEntrySet child = les.duplicate ();
+        setBalance (child, 1, 3000);
+        remove (child, 2);
+
+        les.swapWith (child);
+
+        expect (les.getSeq () == 1, "Sequence swapped");
+        expect (child.getSeq () == 0, "Sequence swapped");
+        expect (getBalance (les, 0) == 2000, "Shared change");
+        expect (getBalance (les, 1) == 3000, "Swapped in change");
+        expect (les.hasEntry (accountIndex (2)) == taaDELETE, "Swapped in delete");
+        expect (getBalance (child, 1) == 1000, "Swapped out");
+        expect (child.hasEntry (accountIndex (2)) == taaNONE, "Swapped out");
+
+        LedgerEntrySet empty;
+        empty.swapWith (les);
+        expect (!les.isValid (), "Swapped with an empty set");
+        expect (empty.isValid (), "Swapped with an empty set");
+        expect (getBalance (empty, 1) == 3000, "Entries follow the swap");
+    }
+
+    void testMeta ()
+    {
+        testcase ("metadata");
+
+        Ledger::pointer ledger = makeLedger (6);
+
+        std::vector <Edit> edits;
+        edits.push_back ([] (LedgerEntrySet& les) { setBalance (les, 0, 1500); });
+        edits.push_back ([] (LedgerEntrySet& les) { remove (les, 1); });
+        edits.push_back ([] (LedgerEntrySet& les) { create (les, 10, 100); });
+        edits.push_back ([] (LedgerEntrySet& les) { create (les, 11, 200); });
+        edits.push_back ([] (LedgerEntrySet& les) { getBalance (les, 2); });
+        edits.push_back ([] (LedgerEntrySet& les) { remove (les, 11); });
+        edits.push_back ([] (LedgerEntrySet& les) { setBalance (les, 0, 1700); });
+        edits.push_back ([] (LedgerEntrySet& les) { setBalance (les, 10, 300); });
+        edits.push_back ([] (LedgerEntrySet& les) { setBalance (les, 3, 1000); });
+
+        // A set that is never duplicated has no layers, like the flat
+        // set every transaction used before.
+        LedgerEntrySet flat (ledger, tapNONE);
+        init (flat, ledger);
+
+        for (auto const& edit : edits)
+            edit (flat);
+
+        LedgerEntrySet layered (ledger, tapNONE);
+        init (layered, ledger);
+
+        for (auto const& edit : edits)
+        {
+            LedgerEntrySet child = layered.duplicate ();
+            edit (child);
+
+            {
+                LedgerEntrySet scratch = child.duplicate ();
+                setBalance (scratch, 4, 5);
+                remove (scratch, 5);
+            }
+
+            layered.swapWith (child);
+        }
+
+        expect (layered.getLayerDepth () > 1, "Edits are layered");
+
+        Serializer flatMeta;
+        flat.calcRawMeta (flatMeta, tesSUCCESS, 0);
+
+        Serializer layeredMeta;
+        layered.calcRawMeta (layeredMeta, tesSUCCESS, 0);
 
+        expect (flatMeta.getDataLength () > 0, "Metadata written");
+        expect (layeredMeta.peekData () == flatMeta.peekData (), "Metadata matches");
+    }
+
+    void run ()
+    {
+        testDropDuplicate ();
+        testDeleteMarker ();
+        testNextIndex ();
+        testFlattenDepth ();
+        testSwap ();
+        testMeta ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(LedgerEntrySet,ripple_app,ripple);
+
+} // ripple
@@ -72,6 +72,14 @@ public:
     (because it's cheaper, can be checkpointed, and so on). When the
     transaction finishes, the LES is committed into the ledger to make
     the modifications. The transaction metadata is built from the LES too.
+
+    Checkpoints are cheap. Each set keeps only its own changes in a map,
+    on top of a chain of immutable layers it may share with the sets it
+    was duplicated from. duplicate() moves the changes into a new layer
+    which the parent and the child then both build on, so it costs the
+    same however many entries the set holds. An entry is copied up into
+    a set's own map the first time that set touches it, and discarding a
+    child or swapping it with another set never touches the layers.
 */
 class LedgerEntrySet
     : public CountedObject <LedgerEntrySet>
@@ -99,7 +107,7 @@ public:
         return mImmutable;
     }
 
-    LedgerEntrySet duplicate () const;  // Make a duplicate of this set
+    LedgerEntrySet duplicate () const;  // Make a duplicate of this set, without copying its entries
 
     void setTo (const LedgerEntrySet&); // Set this set to have the same contents as another
 
@@ -120,6 +128,12 @@ public:
         return mSeq;
     }
 
+    // Number of shared layers under this set's own entries
+    int getLayerDepth () const
+    {
+        return mBase ? mBase->depth : 0;
+    }
+
     TransactionEngineParams getParams () const
     {
         return mParams;
@@ -226,26 +240,32 @@ public:
     void calcRawMeta (Serializer&, TER result, std::uint32_t index);
 
     // iterator functions
+    // These merge any shared layers into this set's own map first
     typedef std::map<uint256, LedgerEntrySetEntry>::iterator                iterator;
     typedef std::map<uint256, LedgerEntrySetEntry>::const_iterator          const_iterator;
     bool isEmpty () const
     {
+        flatten ();
         return mEntries.empty ();
     }
     std::map<uint256, LedgerEntrySetEntry>::const_iterator begin () const
     {
+        flatten ();
         return mEntries.begin ();
     }
     std::map<uint256, LedgerEntrySetEntry>::const_iterator end () const
     {
+        flatten ();
         return mEntries.end ();
     }
     std::map<uint256, LedgerEntrySetEntry>::iterator begin ()
     {
+        flatten ();
         return mEntries.begin ();
     }
     std::map<uint256, LedgerEntrySetEntry>::iterator end ()
     {
+        flatten ();
         return mEntries.end ();
     }
 
@@ -255,20 +275,52 @@ public:
     }
 
 private:
+    typedef std::map<uint256, LedgerEntrySetEntry> EntryMap;
+
+    // Entries shared by the sets duplicated from a common ancestor.
+    // A key in a layer hides the same key in the layers below it, and an
+    // entry with the action taaNONE records that the key was removed.
+    struct Layer
+    {
+        EntryMap entries;
+        std::shared_ptr <Layer const> base;
+        int depth;
+    };
+
+    // Past this many layers, duplicate() merges them into one
+    static int const maxLayerDepth = 8;
+
     Ledger::pointer mLedger;
-    std::map<uint256, LedgerEntrySetEntry>  mEntries; // cannot be unordered!
+    mutable EntryMap mEntries; // cannot be unordered!
+    mutable std::shared_ptr <Layer const> mBase;
     TransactionMetaSet mSet;
     TransactionEngineParams mParams;
     int mSeq;
     bool mImmutable;
 
-    LedgerEntrySet (Ledger::ref ledger, const std::map<uint256, LedgerEntrySetEntry>& e,
+    LedgerEntrySet (Ledger::ref ledger, std::shared_ptr <Layer const> const& base,
                     const TransactionMetaSet & s, int m) :
-        mLedger (ledger), mEntries (e), mSet (s), mParams (tapNONE), mSeq (m), mImmutable (false)
+        mLedger (ledger), mBase (base), mSet (s), mParams (tapNONE), mSeq (m), mImmutable (false)
     {
         ;
     }
 
+    // Move this set's own entries into a new shared layer
+    void freeze () const;
+
+    // Merge the shared layers into this set's own entries
+    void flatten () const;
+
+    // Find the entry for a key, looking through the layers
+    LedgerEntrySetEntry const* findEntry (uint256 const& index) const;
+
+    // Find the entry for a key in this set's own map, copying it up from
+    // the layers if necessary. Returns mEntries.end () if there is none.
+    EntryMap::iterator findOwnEntry (uint256 const& index);
+
+    void insertEntry (uint256 const& index, LedgerEntrySetEntry const& entry);
+    void eraseEntry (EntryMap::iterator it);
+
     SLE::pointer getForMod (uint256 const & node, Ledger::ref ledger,
                             ripple::unordered_map<uint256, SLE::pointer>& newMods);
 
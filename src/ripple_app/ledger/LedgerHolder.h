@@ -22,16 +22,13 @@
 
 namespace ripple {
 
-// Can std::atomic<std::shared_ptr>> make this lock free?
-
 /** Hold a ledger in a thread-safe way.
+    The held ledger is immutable and is swapped atomically, so readers never
+    wait for a lock.
 */
 class LedgerHolder
 {
 public:
-    typedef RippleMutex LockType;
-    typedef std::lock_guard <LockType> ScopedLockType;
-
     // Update the held ledger
     void set (Ledger::pointer ledger)
     {
@@ -39,19 +36,13 @@ public:
         if (ledger && !ledger->isImmutable ())
            ledger = boost::make_shared <Ledger> (*ledger, false);
 
-        {
-            ScopedLockType sl (m_lock);
-
-            m_heldLedger = ledger;
-        }
+        boost::atomic_store (&m_heldLedger, ledger);
     }
 
     // Return the (immutable) held ledger
     Ledger::pointer get ()
     {
-        ScopedLockType sl (m_lock);
-
-        return m_heldLedger;
+        return boost::atomic_load (&m_heldLedger);
     }
 
     // Return a mutable snapshot of the held ledger
@@ -64,14 +55,11 @@ public:
 
     bool empty ()
     {
-        ScopedLockType sl (m_lock);
-
-        return m_heldLedger == nullptr;
+        return get () == nullptr;
     }
 
 private:
 
-    LockType m_lock;
     Ledger::pointer m_heldLedger;
 
 };
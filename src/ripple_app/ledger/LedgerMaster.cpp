@@ -47,7 +47,7 @@ public:
     LedgerHolder mCurrentLedger;        // The ledger we are currently processiong
     LedgerHolder mClosedLedger;         // The ledger that most recently closed
     LedgerHolder mValidLedger;          // The highest-sequence ledger we have fully accepted
-    Ledger::pointer mPubLedger;         // The last ledger we have published
+    LedgerHolder mPubLedger;            // The last ledger we have published
     Ledger::pointer mPathLedger;        // The last ledger we did pathfinding against
 
     LedgerHistory mLedgerHistory;
@@ -59,6 +59,8 @@ public:
 
     std::unique_ptr <LedgerCleaner> mLedgerCleaner;
 
+    InflationVotes              mInflationVotes;
+
     int                         mMinValidations;    // The minimum validations to publish a ledger
     uint256                     mLastValidateHash;
     std::uint32_t               mLastValidateSeq;
@@ -180,7 +182,7 @@ public:
 
     void setPubLedger(Ledger::ref l)
     {
-        mPubLedger = l;
+        mPubLedger.set (l);
         mPubLedgerClose = l->getCloseTimeNC();
         mPubLedgerSeq = l->getLedgerSeq();
     }
@@ -379,6 +381,17 @@ public:
         return mCompleteLedgers.clearValue (seq);
     }
 
+    void clearPriorLedgers (std::uint32_t seq)
+    {
+        ScopedLockType sl (mCompleteLock);
+        for (std::uint32_t v = mCompleteLedgers.getFirst ();
+            (v != RangeSet::absent) && (v < seq);
+                v = mCompleteLedgers.getFirst ())
+        {
+            mCompleteLedgers.clearValue (v);
+        }
+    }
+
     // returns Ledgers we have all the nodes for
     bool getFullValidatedRange (std::uint32_t& minVal, std::uint32_t& maxVal)
     {
@@ -618,8 +631,11 @@ public:
             ScopedLockType ml (m_mutex);
 
             if (ledger->getLedgerSeq() > mValidLedgerSeq)
+            {
                 setValidLedger(ledger);
-            if (!mPubLedger)
+                mInflationVotes.updateLater(ledger);
+            }
+            if (mPubLedger.empty ())
             {
                 setPubLedger(ledger);
                 getApp().getOrderBookDB().setup(ledger);
@@ -744,7 +760,7 @@ public:
         ledger->setValidated();
         ledger->setFull();
         setValidLedger(ledger);
-        if (!mPubLedger)
+        if (mPubLedger.empty ())
         {
             ledger->pendSaveValidated(true, true);
             setPubLedger(ledger);
@@ -896,7 +912,7 @@ public:
                     std::uint32_t missing;
                     {
                         ScopedLockType sl (mCompleteLock);
-                        missing = mCompleteLedgers.prevMissing(mPubLedger->getLedgerSeq());
+                        missing = mCompleteLedgers.prevMissing(mPubLedger.get ()->getLedgerSeq());
                     }
                     WriteLog (lsTRACE, LedgerMaster) << "tryAdvance discovered missing " << missing;
                     if ((missing != RangeSet::absent) && (missing > 0) &&
@@ -995,6 +1011,9 @@ public:
 
                         setFullLedger(ledger, true, true);
                         getApp().getOPs().pubLedger(ledger);
+
+                        BOOST_FOREACH (callback const& c, mOnValidate)
+                            c (ledger);
                     }
 
                     setPubLedger(ledger);
@@ -1014,7 +1033,7 @@ public:
         std::list<Ledger::pointer> ret;
 
         WriteLog (lsTRACE, LedgerMaster) << "findNewLedgersToPublish<";
-        if (!mPubLedger)
+        if (mPubLedger.empty ())
         {
             WriteLog (lsINFO, LedgerMaster) << "First published ledger will be " << mValidLedgerSeq;
             ret.push_back (mValidLedger.get ());
@@ -1238,6 +1257,11 @@ public:
         newPFWork("pf:newOBDB");
     }
 
+    InflationVotes& getInflationVotes ()
+    {
+        return mInflationVotes;
+    }
+
     /** A thread needs to be dispatched to handle pathfinding work of some kind
     */
     void newPFWork (const char *name)
@@ -1274,9 +1298,9 @@ public:
     }
 
     // This is the last ledger we published to clients and can lag the validated ledger
-    Ledger::ref getPublishedLedger ()
+    Ledger::pointer getPublishedLedger ()
     {
-        return mPubLedger;
+        return mPubLedger.get ();
     }
 
     int getMinValidations ()
@@ -62,7 +62,7 @@ public:
     virtual Ledger::pointer getValidatedLedger () = 0;
 
     // This is the last ledger we published to clients and can lag the validated ledger
-    virtual Ledger::ref getPublishedLedger () = 0;
+    virtual Ledger::pointer getPublishedLedger () = 0;
 
     virtual int getPublishedLedgerAge () = 0;
     virtual int getValidatedLedgerAge () = 0;
@@ -118,6 +118,10 @@ public:
     virtual bool haveLedgerRange (std::uint32_t from, std::uint32_t to) = 0;
     virtual bool haveLedger (std::uint32_t seq) = 0;
     virtual void clearLedger (std::uint32_t seq) = 0;
+
+    /** Forget that we have any ledger before the given one. */
+    virtual void clearPriorLedgers (std::uint32_t seq) = 0;
+
     virtual bool getValidatedRange (std::uint32_t& minVal, std::uint32_t& maxVal) = 0;
     virtual bool getFullValidatedRange (std::uint32_t& minVal, std::uint32_t& maxVal) = 0;
 
@@ -138,6 +142,9 @@ public:
     virtual bool isNewPathRequest () = 0;
     virtual void newOrderBookDB () = 0;
 
+    /** The inflation votes, kept up to date as ledgers are validated. */
+    virtual InflationVotes& getInflationVotes () = 0;
+
     virtual bool fixIndex (LedgerIndex ledgerIndex, LedgerHash const& ledgerHash) = 0;
     virtual void doLedgerCleaner(const Json::Value& parameters) = 0;
 
@@ -317,24 +317,33 @@ void BookListeners::removeSubscriber (std::uint64_t seq)
 
 void BookListeners::publish (Json::Value const& jvObj)
 {
-    Json::FastWriter jfwWriter;
-    std::string sObj = jfwWriter.write (jvObj);
+    std::vector <InfoSub::pointer> listeners;
 
-    ScopedLockType sl (mLock);
-    NetworkOPs::SubMapType::const_iterator it = mListeners.begin ();
-
-    while (it != mListeners.end ())
     {
-        InfoSub::pointer p = it->second.lock ();
+        ScopedLockType sl (mLock);
+        NetworkOPs::SubMapType::const_iterator it = mListeners.begin ();
 
-        if (p)
+        while (it != mListeners.end ())
         {
-            p->send (jvObj, sObj, true);
-            ++it;
+            InfoSub::pointer p = it->second.lock ();
+
+            if (p)
+            {
+                listeners.push_back (p);
+                ++it;
+            }
+            else
+                it = mListeners.erase (it);
         }
-        else
-            it = mListeners.erase (it);
     }
+
+    if (listeners.empty ())
+        return;
+
+    InfoSub::Payload const payload (InfoSub::render (jvObj));
+
+    BOOST_FOREACH (InfoSub::ref p, listeners)
+        p->send (jvObj, payload, true);
 }
 
 } // ripple
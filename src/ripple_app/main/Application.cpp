@@ -61,6 +61,8 @@ class RPCManagerLog;
 template <> char const* LogPartition::getPartitionName <RPCManagerLog> () { return "RPCManager"; }
 class AmendmentTableLog;
 template <> char const* LogPartition::getPartitionName <AmendmentTableLog>() { return "AmendmentTable"; }
+class OnlineDeleteLog;
+template <> char const* LogPartition::getPartitionName <OnlineDeleteLog> () { return "OnlineDelete"; }
 
 template <> char const* LogPartition::getPartitionName <CollectorManager> () { return "Collector"; }
 
@@ -201,6 +203,7 @@ public:
     std::unique_ptr <UniqueNodeList> m_deprecatedUNL;
     std::unique_ptr <RPCHTTPServer> m_rpcHTTPServer;
     RPCServerHandler m_rpcServerHandler;
+    std::unique_ptr <OnlineDelete> m_onlineDelete;
     std::unique_ptr <NodeStore::Database> m_nodeStore;
     std::unique_ptr <SNTPClient> m_sntpClient;
     std::unique_ptr <TxQueue> m_txQueue;
@@ -274,7 +277,7 @@ public:
             "full_below", get_seconds_clock (), m_collectorManager->collector (),
                 fullBelowTargetSize, fullBelowExpirationSeconds))
 
-        , m_nodeStoreScheduler (*this)
+        , m_nodeStoreScheduler (*this, m_collectorManager->group ("nodestore"))
 
         // The JobQueue has to come pretty early since
         // almost everything is a Stoppable child of the JobQueue.
@@ -298,7 +301,7 @@ public:
 
         , m_orderBookDB (*m_jobQueue)
 
-        , m_pathRequests ( new PathRequests (
+        , m_pathRequests ( new PathRequests (*m_jobQueue,
             LogPartition::getJournal <PathRequestLog> (), m_collectorManager->collector ()))
 
         , m_ledgerMaster (LedgerMaster::New (
@@ -322,9 +325,17 @@ public:
 
         , m_rpcServerHandler (*m_networkOPs, *m_resourceManager) // passive object, not a Service
 
-        , m_nodeStore (m_nodeStoreManager->make_Database ("NodeStore.main", m_nodeStoreScheduler,
-            LogPartition::getJournal <NodeObject> (), 4, // four read threads for now
-                getConfig ().nodeDatabase, getConfig ().ephemeralNodeDatabase))
+        , m_onlineDelete ((OnlineDelete::getLedgersToKeep (getConfig ().nodeDatabase) > 0)
+            ? OnlineDelete::New (*this, *m_nodeStoreManager, m_nodeStoreScheduler,
+                getConfig ().nodeDatabase, LogPartition::getJournal <OnlineDeleteLog> ())
+            : nullptr)
+
+        , m_nodeStore (m_onlineDelete
+            ? m_onlineDelete->makeDatabase ("NodeStore.main", 4, // four read threads for now
+                getConfig ().ephemeralNodeDatabase)
+            : m_nodeStoreManager->make_Database ("NodeStore.main", m_nodeStoreScheduler,
+                LogPartition::getJournal <NodeObject> (), 4, // four read threads for now
+                    getConfig ().nodeDatabase, getConfig ().ephemeralNodeDatabase))
 
         , m_sntpClient (SNTPClient::New (*this))
 
@@ -380,6 +391,9 @@ public:
 
         add (m_ledgerMaster->getPropertySource ());
 
+        if (m_onlineDelete)
+            add (*m_onlineDelete);
+
         // VFALCO TODO remove these once the call is thread safe.
         HashMaps::getInstance ().initializeNonce <size_t> ();
     }
@@ -662,6 +676,14 @@ public:
 
         m_ledgerMaster->setMinValidations (getConfig ().VALIDATION_QUORUM);
 
+        if (m_onlineDelete)
+        {
+            LedgerMaster::callback onValidated (std::bind (
+                &OnlineDelete::onLedgerValidated, m_onlineDelete.get (),
+                    std::placeholders::_1));
+            m_ledgerMaster->addValidateCallback (onValidated);
+        }
+
         if (getConfig ().START_UP == Config::FRESH)
         {
             m_journal.info << "Starting new Ledger";
@@ -692,6 +714,10 @@ public:
 
         m_orderBookDB.setup (getApp().getLedgerMaster ().getCurrentLedger ());
 
+        if (getConfig ().ephemeralNodeDatabase ["warm"].getIntValue () != 0)
+            m_jobQueue->addJob (jtWARM, "NodeStore::warm",
+                BIND_TYPE (&ApplicationImp::doWarm, this, P_1));
+
         //
         // Begin validation and ip maintenance.
         // - LocalCredentials maintains local information: including identity and network connection persistence information.
@@ -706,11 +732,13 @@ public:
             getUNL ().nodeBootstrap ();
 
         mValidations->tune (getConfig ().getSize (siValidationsSize), getConfig ().getSize (siValidationsAge));
-        m_nodeStore->tune (getConfig ().getSize (siNodeCacheSize), getConfig ().getSize (siNodeCacheAge));
+        m_nodeStore->tune (getConfig ().getSize (siNodeCacheSize), getConfig ().getSize (siNodeCacheAge),
+            std::size_t (getConfig ().getSize (siNodeCacheMB)) << 20);
         m_ledgerMaster->tune (getConfig ().getSize (siLedgerSize), getConfig ().getSize (siLedgerAge));
         m_sleCache.setTargetSize (getConfig ().getSize (siSLECacheSize));
         m_sleCache.setTargetAge (getConfig ().getSize (siSLECacheAge));
-        SHAMap::setTreeCache (getConfig ().getSize (siTreeCacheSize), getConfig ().getSize (siTreeCacheAge));
+        SHAMap::setTreeCache (getConfig ().getSize (siTreeCacheSize), getConfig ().getSize (siTreeCacheAge),
+            std::size_t (getConfig ().getSize (siTreeCacheMB)) << 20);
 
 
         //----------------------------------------------------------------------
@@ -1090,6 +1118,58 @@ public:
         m_sweepTimer.setExpiration (getConfig ().getSize (siSweepInterval));
     }
 
+    // Load the state nodes of the last full ledger into the fast NodeStore
+    // backend, for when it doesn't keep its contents between launches.
+    void doWarm (Job&)
+    {
+        Ledger::pointer const ledger (Ledger::getLastFullLedger ());
+
+        if (! ledger)
+            return;
+
+        // A full walk shouldn't push the working set out of the node cache
+        NodeStore::Database::ScopedNoCache noCache;
+
+        LedgerIndex const seq = ledger->getLedgerSeq ();
+        NodeStore::Batch batch;
+        std::size_t count = 0;
+        bool room = true;
+
+        try
+        {
+            ledger->peekAccountStateMap ()->visitNodes (
+                [&] (SHAMapTreeNode& node)
+                {
+                    Serializer s;
+                    node.addRaw (s, snfPREFIX);
+                    batch.push_back (NodeObject::createObject (hotACCOUNT_NODE,
+                        seq, std::move (s.modData ()), node.getNodeHash ()));
+
+                    if (batch.size () >= warmBatchSize)
+                    {
+                        count += batch.size ();
+                        room = m_nodeStore->warm (batch);
+                        batch.clear ();
+                    }
+
+                    return room && ! isStopping ();
+                });
+        }
+        catch (SHAMapMissingNode const& e)
+        {
+            m_journal.warning << "Fast backend warming stopped: " << e;
+        }
+
+        if (room && ! batch.empty ())
+        {
+            count += batch.size ();
+            m_nodeStore->warm (batch);
+        }
+
+        m_journal.info << "Warmed the fast backend with " << count <<
+            " nodes of ledger " << seq;
+    }
+
 
 private:
     void updateTables ();
@@ -1396,6 +1476,17 @@ void ApplicationImp::updateTables ()
         exit (1);
     }
 
+    // Online deletion must not throw away history we promise to keep
+    std::uint32_t const ledgersToKeep (
+        OnlineDelete::getLedgersToKeep (getConfig ().nodeDatabase));
+
+    if ((ledgersToKeep > 0) && (getConfig ().LEDGER_HISTORY > ledgersToKeep))
+    {
+        Log (lsFATAL) << "The [node_db] online_delete setting must not be less than [ledger_history]";
+        StopSustain ();
+        exit (1);
+    }
+
     if (getConfig ().doImport)
     {
         NodeStore::DummyScheduler scheduler;
@@ -1408,7 +1499,11 @@ void ApplicationImp::updateTables ()
             "Node import from '" << source->getName () << "' to '"
                                  << getApp().getNodeStore().getName () << "'.";
 
-        getApp().getNodeStore().import (*source);
+        // Lets an interrupted import pick up where it left off
+        boost::filesystem::path const checkpoint (
+            getConfig ().DATA_DIR / "import.checkpoint");
+
+        getApp().getNodeStore().import (*source, checkpoint.string ());
     }
 }
 
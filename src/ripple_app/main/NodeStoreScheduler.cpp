@@ -19,10 +19,12 @@
 
 namespace ripple {
 
-NodeStoreScheduler::NodeStoreScheduler (Stoppable& parent)
+NodeStoreScheduler::NodeStoreScheduler (Stoppable& parent,
+    beast::insight::Collector::ptr const& collector)
     : Stoppable ("NodeStoreScheduler", parent)
     , m_jobQueue (nullptr)
     , m_taskCount (0)
+    , m_stats (collector)
 {
 }
 
@@ -63,7 +65,17 @@ void NodeStoreScheduler::onFetch (NodeStore::FetchReport const& report)
     if (report.wentToDisk)
         m_jobQueue->addLoadEvents (
             report.isAsync ? jtNS_ASYNC_READ : jtNS_SYNC_READ,
-                1, report.elapsed);
+                report.fetchCount, report.elapsed);
+
+    if (report.fastHits > 0 || report.fastMisses > 0)
+    {
+        m_stats.fast_hit += report.fastHits;
+        m_stats.fast_miss += report.fastMisses;
+        m_stats.fast_fetch.notify (report.fastElapsed);
+    }
+
+    if (report.backendElapsed.count () > 0)
+        m_stats.backend_fetch.notify (report.backendElapsed);
 }
 
 void NodeStoreScheduler::onBatchWrite (NodeStore::BatchWriteReport const& report)
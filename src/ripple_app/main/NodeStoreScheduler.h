@@ -22,13 +22,16 @@
 
 namespace ripple {
 
-/** A NodeStore::Scheduler which uses the JobQueue and implements the Stoppable API. */
+/** A NodeStore::Scheduler which uses the JobQueue and implements the Stoppable API.
+    Fetches are also reported as insight metrics, per storage tier.
+*/
 class NodeStoreScheduler
     : public NodeStore::Scheduler
     , public beast::Stoppable
 {
 public:
-    NodeStoreScheduler (Stoppable& parent);
+    NodeStoreScheduler (Stoppable& parent,
+        beast::insight::Collector::ptr const& collector);
 
     // VFALCO NOTE This is a temporary hack to solve the problem
     //             of circular dependency.
@@ -42,10 +45,26 @@ public:
     void onBatchWrite (NodeStore::BatchWriteReport const& report) override;
 
 private:
+    struct Stats
+    {
+        explicit Stats (beast::insight::Collector::ptr const& collector)
+            : fast_hit (collector->make_meter ("fast_hit"))
+            , fast_miss (collector->make_meter ("fast_miss"))
+            , fast_fetch (collector->make_event ("fast_fetch"))
+            , backend_fetch (collector->make_event ("backend_fetch"))
+            { }
+
+        beast::insight::Meter fast_hit;
+        beast::insight::Meter fast_miss;
+        beast::insight::Event fast_fetch;
+        beast::insight::Event backend_fetch;
+    };
+
     void doTask (NodeStore::Task& task, Job&);
 
     JobQueue* m_jobQueue;
     std::atomic <int> m_taskCount;
+    Stats m_stats;
 };
 
 } // ripple
@@ -0,0 +1,498 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+namespace ripple {
+
+class OnlineDeleteImp
+    : public OnlineDelete
+    , public beast::Thread
+    , public beast::LeakChecked <OnlineDeleteImp>
+{
+public:
+    // Smallest online_delete value we accept, so that a rotation
+    // cannot happen while its ledger is still being acquired.
+    static std::uint32_t const minimumLedgersToKeep = 256;
+
+    // Nodes copied into the writable backend per batch
+    static std::size_t const copyBatchSize = 256;
+
+    // Ledgers removed from the SQL databases per statement
+    static LedgerIndex const deleteBatchSize = 100;
+
+    // Pause between SQL statements, to let other users have the database
+    static int const deletePauseMilliseconds = 100;
+
+    struct State
+    {
+        State ()
+            : lastRotated (0)
+            , rotating (false)
+        {
+        }
+
+        Ledger::pointer validated;  // Newest validated ledger not yet seen
+        LedgerIndex lastRotated;    // Ledger at which the writable backend began
+        bool rotating;              // A rotation is in progress
+    };
+
+    typedef beast::SharedData <State> SharedState;
+
+    NodeStore::Manager& m_manager;
+    NodeStore::Scheduler& m_scheduler;
+    NodeStore::Parameters const m_parameters;
+    beast::Journal m_journal;
+    std::uint32_t const m_ledgersToKeep;
+    beast::File const m_directory;
+    SharedState m_state;
+
+    // Owned by the Application, valid after makeDatabase
+    NodeStore::DatabaseRotating* m_database;
+
+    //--------------------------------------------------------------------------
+
+    OnlineDeleteImp (
+        Stoppable& parent,
+        NodeStore::Manager& manager,
+        NodeStore::Scheduler& scheduler,
+        NodeStore::Parameters const& nodeDatabase,
+        beast::Journal journal)
+        : OnlineDelete (parent)
+        , Thread ("OnlineDelete")
+        , m_manager (manager)
+        , m_scheduler (scheduler)
+        , m_parameters (nodeDatabase)
+        , m_journal (journal)
+        , m_ledgersToKeep (getLedgersToKeep (nodeDatabase))
+        , m_directory (nodeDatabase ["path"])
+        , m_database (nullptr)
+    {
+        if (m_directory.getFullPathName ().isEmpty ())
+            throw std::runtime_error (
+                "online_delete requires a path in the [node_db] section");
+    }
+
+    ~OnlineDeleteImp ()
+    {
+        stopThread ();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // Stoppable
+    //
+    //--------------------------------------------------------------------------
+
+    void onPrepare ()
+    {
+    }
+
+    void onStart ()
+    {
+        startThread ();
+    }
+
+    void onStop ()
+    {
+        m_journal.info << "Stopping";
+        signalThreadShouldExit ();
+        notify ();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // PropertyStream
+    //
+    //--------------------------------------------------------------------------
+
+    void onWrite (beast::PropertyStream::Map& map)
+    {
+        SharedState::Access state (m_state);
+
+        map["status"] = state->rotating ? "rotating" : "idle";
+        map["ledgers_to_keep"] = m_ledgersToKeep;
+        map["last_rotated"] = state->lastRotated;
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // OnlineDelete
+    //
+    //--------------------------------------------------------------------------
+
+    std::unique_ptr <NodeStore::Database> makeDatabase (
+        std::string const& name,
+        int readThreads,
+        NodeStore::Parameters const& fastBackendParameters)
+    {
+        assert (m_database == nullptr);
+
+        std::vector <LedgerIndex> seqs (findBackends ());
+
+        // Only the newest two are in use. Anything older was left behind
+        // by a rotation that did not get to delete it.
+        while (seqs.size () > 2)
+        {
+            m_journal.warning << "Removing stale backend " << seqs.front ();
+            getBackendDirectory (seqs.front ()).deleteRecursively ();
+            seqs.erase (seqs.begin ());
+        }
+
+        if (seqs.empty ())
+            seqs.push_back (0);
+
+        std::unique_ptr <NodeStore::Backend> archive;
+        if (seqs.size () > 1)
+            archive = makeBackend (seqs.front ());
+
+        std::unique_ptr <NodeStore::Backend> writable (
+            makeBackend (seqs.back ()));
+
+        {
+            // Zero means a fresh start, the first validated ledger takes its place
+            SharedState::Access state (m_state);
+            state->lastRotated = seqs.back ();
+        }
+
+        std::unique_ptr <NodeStore::DatabaseRotating> database (
+            m_manager.make_DatabaseRotating (name, m_scheduler, m_journal,
+                readThreads, std::move (writable), std::move (archive),
+                    fastBackendParameters));
+
+        m_database = database.get ();
+
+        return std::move (database);
+    }
+
+    void onLedgerValidated (Ledger::ref ledger)
+    {
+        {
+            SharedState::Access state (m_state);
+
+            if (state->rotating)
+                return;
+
+            state->validated = ledger;
+        }
+
+        notify ();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // OnlineDeleteImp
+    //
+    //--------------------------------------------------------------------------
+
+    void run ()
+    {
+        m_journal.debug << "Started";
+
+        while (! this->threadShouldExit ())
+        {
+            this->wait ();
+
+            Ledger::pointer validated;
+            {
+                SharedState::Access state (m_state);
+                validated.swap (state->validated);
+            }
+
+            if (validated && ! this->threadShouldExit ())
+                checkRotate (validated);
+        }
+
+        stopped ();
+    }
+
+    void checkRotate (Ledger::ref validated)
+    {
+        LedgerIndex const seq = validated->getLedgerSeq ();
+        LedgerIndex lastRotated;
+
+        {
+            SharedState::Access state (m_state);
+
+            if (state->lastRotated == 0)
+                state->lastRotated = seq;
+
+            lastRotated = state->lastRotated;
+
+            if (seq < lastRotated + m_ledgersToKeep)
+                return;
+
+            state->rotating = true;
+        }
+
+        m_journal.info << "Rotating at ledger " << seq <<
+            ", keeping ledgers from " << lastRotated;
+
+        bool const rotated = doRotate (validated, lastRotated);
+
+        SharedState::Access state (m_state);
+        if (rotated)
+            state->lastRotated = seq;
+        state->rotating = false;
+    }
+
+    /** Rotate the backends.
+        @return `true` if the new writable backend is in place.
+    */
+    bool doRotate (Ledger::ref validated, LedgerIndex lastRotated)
+    {
+        LedgerIndex const seq = validated->getLedgerSeq ();
+
+        if (m_database->hasArchive ())
+        {
+            Ledger::pointer ledger (
+                getApp().getLedgerMaster ().getLedgerBySeq (lastRotated));
+
+            if (! ledger)
+            {
+                // Then the validated ledger becomes the oldest one we keep
+                m_journal.warning << "Ledger " << lastRotated <<
+                    " is not available, keeping ledgers from " << seq;
+                ledger = validated;
+                lastRotated = seq;
+            }
+
+            // The archive goes away, so everything before this is lost
+            getApp().getLedgerMaster ().clearPriorLedgers (lastRotated);
+
+            if (! copyLedger (ledger))
+                return false;
+
+            if (! pruneTable (getApp().getLedgerDB (), "Ledgers", lastRotated) ||
+                ! pruneTable (getApp().getTxnDB (), "Transactions", lastRotated) ||
+                ! pruneTable (getApp().getTxnDB (), "AccountTransactions", lastRotated))
+                return false;
+        }
+
+        std::shared_ptr <NodeStore::Backend> archive (
+            m_database->rotate (makeBackend (seq)));
+
+        if (archive != nullptr)
+        {
+            // The old archive is the oldest of the three backends now
+            beast::File const directory (
+                getBackendDirectory (findBackends ().front ()));
+
+            // Wait for fetches and writes still using the old archive
+            while (! archive.unique () || archive->getWriteLoad () > 0)
+            {
+                if (this->threadShouldExit ())
+                {
+                    // The directory is removed when the database is next opened
+                    return true;
+                }
+
+                sleep (deletePauseMilliseconds);
+            }
+
+            archive.reset ();
+
+            if (! directory.deleteRecursively ())
+                m_journal.error << "Unable to remove '" <<
+                    directory.getFullPathName () << "'";
+        }
+
+        m_journal.info << "Rotated at ledger " << seq;
+
+        return true;
+    }
+
+    /** Copy a ledger's header and nodes into the writable backend.
+        @return `false` if the ledger is missing nodes or we are stopping.
+    */
+    bool copyLedger (Ledger::ref ledger)
+    {
+        // A full walk shouldn't push the working set out of the node cache
+        NodeStore::Database::ScopedNoCache noCache;
+
+        LedgerIndex const seq = ledger->getLedgerSeq ();
+        NodeStore::Batch batch;
+        batch.reserve (copyBatchSize);
+
+        {
+            Serializer s (128);
+            s.add32 (HashPrefix::ledgerMaster);
+            ledger->addRaw (s);
+            batch.push_back (NodeObject::createObject (hotLEDGER, seq,
+                std::move (s.modData ()), ledger->getHash ()));
+        }
+
+        try
+        {
+            if (! copyMap (*ledger->peekAccountStateMap (), hotACCOUNT_NODE, seq, batch) ||
+                ! copyMap (*ledger->peekTransactionMap (), hotTRANSACTION_NODE, seq, batch))
+                return false;
+        }
+        catch (SHAMapMissingNode const& e)
+        {
+            m_journal.warning << "Ledger " << seq << " is incomplete: " << e;
+            return false;
+        }
+
+        if (! batch.empty ())
+            m_database->copyToWritable (batch);
+
+        return true;
+    }
+
+    bool copyMap (SHAMap& map, NodeObjectType type, LedgerIndex seq,
+        NodeStore::Batch& batch)
+    {
+        return map.visitNodes ([this, type, seq, &batch] (SHAMapTreeNode& node)
+        {
+            Serializer s;
+            node.addRaw (s, snfPREFIX);
+            batch.push_back (NodeObject::createObject (type, seq,
+                std::move (s.modData ()), node.getNodeHash ()));
+
+            if (batch.size () >= copyBatchSize)
+            {
+                m_database->copyToWritable (batch);
+                batch.clear ();
+
+                if (this->threadShouldExit ())
+                    return false;
+            }
+
+            return true;
+        });
+    }
+
+    /** Delete rows for ledgers before the given one, a few at a time.
+        @return `false` if we are stopping.
+    */
+    bool pruneTable (DatabaseCon* con, std::string const& table,
+        LedgerIndex before)
+    {
+        LedgerIndex first;
+
+        {
+            DeprecatedScopedLock sl (con->getDBLock ());
+            Database* db = con->getDB ();
+
+            if (! db->executeSQL ("SELECT MIN(LedgerSeq) AS Seq FROM " + table + ";") ||
+                ! db->startIterRows ())
+                return true;
+
+            bool const empty = db->getNull ("Seq");
+            first = empty ? before : static_cast <LedgerIndex> (db->getBigInt ("Seq"));
+            db->endIterRows ();
+        }
+
+        while (first < before)
+        {
+            first = std::min (first + deleteBatchSize, before);
+
+            {
+                DeprecatedScopedLock sl (con->getDBLock ());
+                con->getDB ()->executeSQL (boost::str (boost::format (
+                    "DELETE FROM %s WHERE LedgerSeq < %u;") % table % first));
+            }
+
+            if (this->threadShouldExit ())
+                return false;
+
+            sleep (deletePauseMilliseconds);
+        }
+
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+
+    beast::File getBackendDirectory (LedgerIndex seq) const
+    {
+        return m_directory.getChildFile (beast::String (seq));
+    }
+
+    /** Returns the sequence numbers of the backend directories, oldest first. */
+    std::vector <LedgerIndex> findBackends () const
+    {
+        std::vector <LedgerIndex> seqs;
+
+        beast::Array <beast::File> children;
+        m_directory.findChildFiles (children, beast::File::findDirectories, false);
+
+        for (int i = 0; i < children.size (); ++i)
+        {
+            beast::String const name (children [i].getFileName ());
+
+            if (! name.isEmpty () && name.containsOnly ("0123456789"))
+                seqs.push_back (static_cast <LedgerIndex> (name.getLargeIntValue ()));
+        }
+
+        std::sort (seqs.begin (), seqs.end ());
+
+        return seqs;
+    }
+
+    std::unique_ptr <NodeStore::Backend> makeBackend (LedgerIndex seq)
+    {
+        beast::File const directory (getBackendDirectory (seq));
+        directory.createDirectory ();
+
+        NodeStore::Parameters parameters (m_parameters);
+        parameters.set ("path", directory.getFullPathName ());
+
+        return m_manager.make_Backend (parameters, m_scheduler, m_journal);
+    }
+};
+
+//------------------------------------------------------------------------------
+
+OnlineDelete::OnlineDelete (Stoppable& parent)
+    : Stoppable ("OnlineDelete", parent)
+    , beast::PropertyStream::Source ("online_delete")
+{
+}
+
+OnlineDelete::~OnlineDelete ()
+{
+}
+
+std::uint32_t OnlineDelete::getLedgersToKeep (
+    NodeStore::Parameters const& nodeDatabase)
+{
+    int const ledgers (nodeDatabase ["online_delete"].getIntValue ());
+
+    if (ledgers <= 0)
+        return 0;
+
+    if (ledgers < int (OnlineDeleteImp::minimumLedgersToKeep))
+        throw std::runtime_error (
+            "online_delete must be at least 256 ledgers");
+
+    return static_cast <std::uint32_t> (ledgers);
+}
+
+OnlineDelete* OnlineDelete::New (
+    Stoppable& parent,
+    NodeStore::Manager& manager,
+    NodeStore::Scheduler& scheduler,
+    NodeStore::Parameters const& nodeDatabase,
+    beast::Journal journal)
+{
+    return new OnlineDeleteImp (parent, manager, scheduler,
+        nodeDatabase, journal);
+}
+
+}
@@ -0,0 +1,84 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_APP_ONLINEDELETE_H_INCLUDED
+#define RIPPLE_APP_ONLINEDELETE_H_INCLUDED
+
+namespace ripple {
+
+/** Deletes old ledger history while the server is running.
+
+    When the [node_db] section has an online_delete setting, the node store
+    is split over two backends, each in its own numbered directory under the
+    configured path. New objects go to the writable backend, and fetches fall
+    back to the archive. Every online_delete validated ledgers the backends
+    are rotated: a fresh writable backend is created, the old writable one
+    becomes the archive, and the old archive is deleted in one go.
+
+    Before rotating, everything reachable from the ledger at which the
+    current writable backend was created is copied into it, so that the
+    backend which survives holds every ledger from that point on. Ledgers
+    older than that are forgotten, and their rows are removed from the
+    ledger and transaction databases a few at a time.
+*/
+class OnlineDelete
+    : public beast::Stoppable
+    , public beast::PropertyStream::Source
+{
+protected:
+    explicit OnlineDelete (Stoppable& parent);
+
+public:
+    /** Create a new object.
+        The caller receives ownership and must delete the object when done.
+    */
+    static OnlineDelete* New (
+        Stoppable& parent,
+        NodeStore::Manager& manager,
+        NodeStore::Scheduler& scheduler,
+        NodeStore::Parameters const& nodeDatabase,
+        beast::Journal journal);
+
+    /** Destroy the object. */
+    virtual ~OnlineDelete () = 0;
+
+    /** Returns the number of validated ledgers to keep.
+        This is zero if online deletion is not configured. A value that is
+        too small to be safe throws an exception.
+    */
+    static std::uint32_t getLedgersToKeep (
+        NodeStore::Parameters const& nodeDatabase);
+
+    /** Open the backends and create the main node store database.
+        This must be called once, before the Stoppable is started.
+    */
+    virtual std::unique_ptr <NodeStore::Database> makeDatabase (
+        std::string const& name,
+        int readThreads,
+        NodeStore::Parameters const& fastBackendParameters) = 0;
+
+    /** Called when a ledger is fully validated.
+        This does not block, rotation happens on the object's own thread.
+    */
+    virtual void onLedgerValidated (Ledger::ref ledger) = 0;
+};
+
+}
+
+#endif
@@ -27,6 +27,9 @@ class RPCHTTPServerImp
     , public HTTP::Handler
 {
 public:
+    // Most reply bytes queued on a session before the handler waits
+    static std::size_t const maxPendingBytes = 4 * Json::Stream::defaultBufferSize;
+
     Resource::Manager& m_resourceManager;
     beast::Journal m_journal;
     JobQueue& m_jobQueue;
@@ -156,8 +159,35 @@ public:
 
     void processSession (Job& job, HTTP::Session& session)
     {
-        session.write (m_deprecatedHandler.processRequest (
-            session.content(), session.remoteAddress().at_port(0)));
+        // A reply that fits in the stream's buffer is sent whole, with a
+        // Content-Length. A larger one is sent as it is written, after
+        // headers without a length, and ends when the session closes.
+        // While streaming, the handler waits whenever more than a few
+        // buffers are queued, so a slow client holds back the handler
+        // instead of the whole reply piling up in memory.
+        bool streaming (false);
+
+        Json::Stream stream ([&session, &streaming] (char const* data, std::size_t size)
+        {
+            if (! streaming)
+            {
+                session.write (HTTPStreamHeader ());
+                streaming = true;
+            }
+
+            session.write (data, size);
+            session.waitForWrites (maxPendingBytes);
+        });
+
+        std::string const error (m_deprecatedHandler.processRequest (
+            session.content(), session.remoteAddress().at_port(0), stream));
+
+        if (! error.empty ())
+            session.write (error);
+        else if (stream.isStreaming ())
+            stream.flush ();
+        else
+            session.write (HTTPReply (200, stream.release ()));
 
         session.close();
     }
@@ -27,6 +27,34 @@ enum
     fullBelowTargetSize = 524288
 
     ,fullBelowExpirationSeconds = 600
+
+    // Nodes per batch when warming the fast NodeStore backend
+    ,warmBatchSize = 256
+
+    // Most jobs updating path requests at the same time
+    ,pathFindJobLimit = 4
+
+    // Fewest path requests worth giving to another job
+    ,pathFindJobRequests = 8
+
+    // Most ledgers whose metadata is replayed to carry trust lines forward
+    ,lineCacheCatchUpLedgers = 8
+
+    // Trust lines not asked for in this many ledgers are not carried forward
+    ,lineCacheIdleLedgers = 256
+
+    // Most state changes applied to the inflation votes before recounting
+    ,inflationVoteDifferences = 65536
+
+    // Subtrees per thread when walking a map in parallel
+    ,traverseSubtreesPerJob = 4
+
+    // Subtrees per thread when walking a map in parallel in key order.
+    // There are many more, so the ones walked ahead are a small part.
+    ,traverseOrderedSubtreesPerJob = 64
+
+    // Subtrees each thread may walk ahead of an ordered visit
+    ,traverseOrderedAheadPerJob = 2
 };
 
 }
@@ -77,6 +77,31 @@ void AccountItems::fillItems (const uint160& accountID, Ledger::ref ledger)
     }
 }
 
+void AccountItems::updateItem (uint160 const& accountID, uint256 const& index,
+                               SerializedLedgerEntry::ref ledgerEntry)
+{
+    AccountItem::pointer item;
+
+    if (ledgerEntry)
+        item = mOfType->makeItem (accountID, ledgerEntry);
+
+    for (Container::iterator it = mItems.begin (); it != mItems.end (); ++it)
+    {
+        if ((*it)->peekSLE ().getIndex () == index)
+        {
+            if (item)
+                *it = item;
+            else
+                mItems.erase (it);
+
+            return;
+        }
+    }
+
+    if (item)
+        mItems.push_back (item);
+}
+
 Json::Value AccountItems::getJson (int v)
 {
     Json::Value ret (Json::arrayValue);
@@ -43,6 +43,13 @@ public:
         return mItems;
     }
 
+    /** Bring the item for one ledger entry up to date.
+        The item is replaced, added at the end, or removed if the entry
+        no longer exists.
+    */
+    void updateItem (uint160 const& accountID, uint256 const& index,
+                     SerializedLedgerEntry::ref ledgerEntry);
+
     // VFALCO TODO What is the int for?
     Json::Value getJson (int);
 
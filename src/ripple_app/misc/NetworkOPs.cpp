@@ -333,6 +333,7 @@ public:
     }
     void storeProposal (LedgerProposal::ref proposal,    const RippleAddress& peerPublic);
     uint256 getConsensusLCL ();
+    void setConsensusLCL (uint256 const& hash);
     void reportFeeChange ();
 
     void updateLocalTx (Ledger::ref newValidLedger) override
@@ -446,6 +447,13 @@ private:
 
     void pubServer ();
 
+    typedef std::vector <InfoSub::pointer> Listeners;
+
+    // Adds the live subscribers in the map to the list, dropping the ones
+    // that have gone away. Called holding mLock; the sends are made after
+    // it is released so a slow subscriber cannot hold up the others.
+    static void getListeners (SubMapType& subMap, Listeners& listeners);
+
 private:
     clock_type& m_clock;
 
@@ -466,7 +474,7 @@ private:
 
     LockType mLock;
 
-    OperatingMode                       mMode;
+    std::atomic <OperatingMode>         mMode;
     bool                                mNeedNetworkLedger;
     bool                                mProposing, mValidating;
     bool                                m_amendmentBlocked;
@@ -474,6 +482,7 @@ private:
     beast::DeadlineTimer                m_heartbeatTimer;
     beast::DeadlineTimer                m_clusterTimer;
     boost::shared_ptr<LedgerConsensus>  mConsensus;
+    boost::shared_ptr<uint256 const>    mConsensusLCL;  // Swapped atomically, for readers without the master lock
     ripple::unordered_map < uint160,
           std::list<LedgerProposal::pointer> > mStoredProposals;
 
@@ -1468,6 +1477,7 @@ int NetworkOPsImp::beginConsensus (uint256 const& networkClosed, Ledger::pointer
     mConsensus = make_LedgerConsensus (m_clock, *m_localTX, networkClosed,
         prevLedger, m_ledgerMaster.getCurrentLedger ()->getCloseTimeNC (),
             *m_feeVote);
+    setConsensusLCL (mConsensus->getLCL ());
 
     m_journal.debug << "Initiating consensus engine";
     return mConsensus->startup ();
@@ -1504,10 +1514,15 @@ bool NetworkOPsImp::haveConsensusObject ()
 
 uint256 NetworkOPsImp::getConsensusLCL ()
 {
-    if (!haveConsensusObject ())
-        return uint256 ();
+    boost::shared_ptr<uint256 const> const lcl (boost::atomic_load (&mConsensusLCL));
 
-    return mConsensus->getLCL ();
+    return lcl ? *lcl : uint256 ();
+}
+
+void NetworkOPsImp::setConsensusLCL (uint256 const& hash)
+{
+    boost::atomic_store (&mConsensusLCL, boost::shared_ptr<uint256 const> (
+        boost::make_shared<uint256> (hash)));
 }
 
 void NetworkOPsImp::processTrustedProposal (LedgerProposal::pointer proposal,
@@ -1657,6 +1672,7 @@ void NetworkOPsImp::endConsensus (bool correctLCL)
     }
 
     mConsensus = boost::shared_ptr<LedgerConsensus> ();
+    boost::atomic_store (&mConsensusLCL, boost::shared_ptr<uint256 const> ());
 }
 
 void NetworkOPsImp::consensusViewChange ()
@@ -1665,46 +1681,49 @@ void NetworkOPsImp::consensusViewChange ()
         setMode (omCONNECTED);
 }
 
+void NetworkOPsImp::getListeners (SubMapType& subMap, Listeners& listeners)
+{
+    SubMapType::const_iterator it = subMap.begin ();
+
+    while (it != subMap.end ())
+    {
+        InfoSub::pointer p = it->second.lock ();
+
+        if (p)
+        {
+            listeners.push_back (p);
+            ++it;
+        }
+        else
+        {
+            it = subMap.erase (it);
+        }
+    }
+}
+
 void NetworkOPsImp::pubServer ()
 {
-    // VFALCO TODO Don't hold the lock across calls to send...make a copy of the
-    //             list into a local array while holding the lock then release the
-    //             lock and call send on everyone.
-    //
-    ScopedLockType sl (mLock);
+    Json::Value jvObj (Json::objectValue);
+    Listeners listeners;
 
-    if (!mSubServer.empty ())
     {
-        Json::Value jvObj (Json::objectValue);
+        ScopedLockType sl (mLock);
+
+        if (mSubServer.empty ())
+            return;
 
         jvObj [jss::type]          = "serverStatus";
         jvObj [jss::server_status] = strOperatingMode ();
         jvObj [jss::load_base]     = (mLastLoadBase = getApp().getFeeTrack ().getLoadBase ());
         jvObj [jss::load_factor]   = (mLastLoadFactor = getApp().getFeeTrack ().getLoadFactor ());
 
-        Json::FastWriter w;
-        std::string sObj = w.write (jvObj);
-
-        NetworkOPsImp::SubMapType::const_iterator it = mSubServer.begin ();
+        getListeners (mSubServer, listeners);
+    }
 
-        while (it != mSubServer.end ())
-        {
-            InfoSub::pointer p = it->second.lock ();
+    InfoSub::Payload const payload (InfoSub::render (jvObj));
 
-            // VFALCO TODO research the possibility of using thread queues and linearizing
-            //             the deletion of subscribers with the sending of JSON data.
-            if (p)
-            {
-                p->send (jvObj, sObj, true);
-
-                ++it;
-            }
-            else
-            {
-                it = mSubServer.erase (it);
-            }
-        }
-    }
+    BOOST_FOREACH (InfoSub::ref p, listeners)
+        p->send (jvObj, payload, true);
 }
 
 void NetworkOPsImp::setMode (OperatingMode om)
@@ -2344,23 +2363,19 @@ Json::Value NetworkOPsImp::pubBootstrapAccountInfo (Ledger::ref lpAccepted, cons
 void NetworkOPsImp::pubProposedTransaction (Ledger::ref lpCurrent, SerializedTransaction::ref stTxn, TER terResult)
 {
     Json::Value jvObj   = transJson (*stTxn, terResult, false, lpCurrent);
+    Listeners listeners;
 
     {
         ScopedLockType sl (mLock);
-        NetworkOPsImp::SubMapType::const_iterator it = mSubRTTransactions.begin ();
+        getListeners (mSubRTTransactions, listeners);
+    }
 
-        while (it != mSubRTTransactions.end ())
-        {
-            InfoSub::pointer p = it->second.lock ();
+    if (!listeners.empty ())
+    {
+        InfoSub::Payload const payload (InfoSub::render (jvObj));
 
-            if (p)
-            {
-                p->send (jvObj, true);
-                ++it;
-            }
-            else
-                it = mSubRTTransactions.erase (it);
-        }
+        BOOST_FOREACH (InfoSub::ref p, listeners)
+            p->send (jvObj, payload, true);
     }
     AcceptedLedgerTx alt (stTxn, terResult);
     m_journal.trace << "pubProposed: " << alt.getJson ();
@@ -2375,43 +2390,36 @@ void NetworkOPsImp::pubLedger (Ledger::ref accepted)
     AcceptedLedger::pointer alpAccepted = AcceptedLedger::makeAcceptedLedger (accepted);
     Ledger::ref lpAccepted = alpAccepted->getLedger ();
 
+    Listeners listeners;
+
     {
         ScopedLockType sl (mLock);
+        getListeners (mSubLedger, listeners);
+    }
 
-        if (!mSubLedger.empty ())
-        {
-            Json::Value jvObj (Json::objectValue);
+    if (!listeners.empty ())
+    {
+        Json::Value jvObj (Json::objectValue);
 
-            jvObj[jss::type]           = jss::ledgerClosed;
-            jvObj[jss::ledger_index]   = lpAccepted->getLedgerSeq ();
-            jvObj[jss::ledger_hash]    = to_string (lpAccepted->getHash ());
-            jvObj[jss::ledger_time]    = Json::Value::UInt (lpAccepted->getCloseTimeNC ());
+        jvObj[jss::type]           = jss::ledgerClosed;
+        jvObj[jss::ledger_index]   = lpAccepted->getLedgerSeq ();
+        jvObj[jss::ledger_hash]    = to_string (lpAccepted->getHash ());
+        jvObj[jss::ledger_time]    = Json::Value::UInt (lpAccepted->getCloseTimeNC ());
 
-            jvObj[jss::fee_ref]        = Json::UInt (lpAccepted->getReferenceFeeUnits ());
-            jvObj[jss::fee_base]       = Json::UInt (lpAccepted->getBaseFee ());
-            jvObj[jss::reserve_base]   = Json::UInt (lpAccepted->getReserve (0));
-            jvObj[jss::reserve_inc]    = Json::UInt (lpAccepted->getReserveInc ());
+        jvObj[jss::fee_ref]        = Json::UInt (lpAccepted->getReferenceFeeUnits ());
+        jvObj[jss::fee_base]       = Json::UInt (lpAccepted->getBaseFee ());
+        jvObj[jss::reserve_base]   = Json::UInt (lpAccepted->getReserve (0));
+        jvObj[jss::reserve_inc]    = Json::UInt (lpAccepted->getReserveInc ());
 
-            jvObj[jss::txn_count]      = Json::UInt (alpAccepted->getTxnCount ());
+        jvObj[jss::txn_count]      = Json::UInt (alpAccepted->getTxnCount ());
 
-            if (mMode >= omSYNCING)
-                jvObj[jss::validated_ledgers]  = getApp().getLedgerMaster ().getCompleteLedgers ();
+        if (mMode >= omSYNCING)
+            jvObj[jss::validated_ledgers]  = getApp().getLedgerMaster ().getCompleteLedgers ();
 
-            NetworkOPsImp::SubMapType::const_iterator it = mSubLedger.begin ();
+        InfoSub::Payload const payload (InfoSub::render (jvObj));
 
-            while (it != mSubLedger.end ())
-            {
-                InfoSub::pointer p = it->second.lock ();
-
-                if (p)
-                {
-                    p->send (jvObj, true);
-                    ++it;
-                }
-                else
-                    it = mSubLedger.erase (it);
-            }
-        }
+        BOOST_FOREACH (InfoSub::ref p, listeners)
+            p->send (jvObj, payload, true);
     }
 
     // Don't lock since pubAcceptedTransaction is locking.
@@ -2473,41 +2481,20 @@ void NetworkOPsImp::pubValidatedTransaction (Ledger::ref alAccepted, const Accep
     Json::Value jvObj   = transJson (*alTx.getTxn (), alTx.getResult (), true, alAccepted);
     jvObj[jss::meta] = alTx.getMeta ()->getJson (0);
 
-    Json::FastWriter w;
-    std::string sObj = w.write (jvObj);
+    Listeners listeners;
 
     {
         ScopedLockType sl (mLock);
+        getListeners (mSubTransactions, listeners);
+        getListeners (mSubRTTransactions, listeners);
+    }
 
-        NetworkOPsImp::SubMapType::const_iterator it = mSubTransactions.begin ();
-
-        while (it != mSubTransactions.end ())
-        {
-            InfoSub::pointer p = it->second.lock ();
-
-            if (p)
-            {
-                p->send (jvObj, sObj, true);
-                ++it;
-            }
-            else
-                it = mSubTransactions.erase (it);
-        }
-
-        it = mSubRTTransactions.begin ();
-
-        while (it != mSubRTTransactions.end ())
-        {
-            InfoSub::pointer p = it->second.lock ();
+    if (!listeners.empty ())
+    {
+        InfoSub::Payload const payload (InfoSub::render (jvObj));
 
-            if (p)
-            {
-                p->send (jvObj, sObj, true);
-                ++it;
-            }
-            else
-                it = mSubRTTransactions.erase (it);
-        }
+        BOOST_FOREACH (InfoSub::ref p, listeners)
+            p->send (jvObj, payload, true);
     }
     getApp().getOrderBookDB ().processTxn (alAccepted, alTx, jvObj);
     pubAccountTransaction (alAccepted, alTx, true);
@@ -2587,12 +2574,11 @@ void NetworkOPsImp::pubAccountTransaction (Ledger::ref lpCurrent, const Accepted
         if (alTx.isApplied ())
             jvObj[jss::meta] = alTx.getMeta ()->getJson (0);
 
-        Json::FastWriter w;
-        std::string sObj = w.write (jvObj);
+        InfoSub::Payload const payload (InfoSub::render (jvObj));
 
         BOOST_FOREACH (InfoSub::ref isrListener, notify)
         {
-            isrListener->send (jvObj, sObj, true);
+            isrListener->send (jvObj, payload, true);
         }
     }
 }
@@ -269,7 +269,12 @@ public:
     virtual void storeProposal (LedgerProposal::ref proposal,
         const RippleAddress& peerPublic) = 0;
 
+    // The last closed ledger of the consensus round, or zero if there is
+    // no round. This does not need the master lock.
     virtual uint256 getConsensusLCL () = 0;
+
+    // Called by the consensus round when its last closed ledger changes
+    virtual void setConsensusLCL (uint256 const& hash) = 0;
     
     virtual void reportFeeChange () = 0;
 
@@ -173,6 +173,44 @@ public:
         pSt.reset ();
     }
 
+    void for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+        // Readers of different ranges share the connection
+        DeprecatedScopedLock sl (m_db->getDBLock());
+
+        // Keys are stored as hex, which sorts the same as the binary key
+        SqliteStatement pSt (m_db->getDB()->getSqliteDB(),
+            "SELECT ObjType,LedgerIndex,Object,Hash FROM CommittedObjects "
+                "WHERE Hash BETWEEN ? AND ?;");
+
+        pSt.bind (1, to_string (first));
+        pSt.bind (2, to_string (last));
+
+        uint256 hash;
+
+        while (pSt.isRow (pSt.step()))
+        {
+            hash.SetHexExact(pSt.getString(3));
+
+            Blob data (pSt.getBlob (2));
+            NodeObject::Ptr const object (NodeObject::createObject (
+                getTypeFromString (pSt.peekString (0)),
+                pSt.getUInt32 (1),
+                std::move(data),
+                hash));
+
+            f (object);
+        }
+
+        pSt.reset ();
+    }
+
+    bool hasOrderedKeys ()
+    {
+        return true;
+    }
+
     int getWriteLoad ()
     {
         return 0;
@@ -326,6 +326,84 @@ void PathRequest::resetLevel (int l)
         iLastLevel = l;
 }
 
+uint256 PathRequest::getPathKey (int level, RippleAddress const& srcAccount,
+    RippleAddress const& dstAccount, STAmount const& dstAmount,
+    currIssuer_t const& currIssuer, STPathSet const& spsPaths)
+{
+    Serializer s;
+    s.add32 (level);
+    s.add160 (srcAccount.getAccountID ());
+    s.add160 (dstAccount.getAccountID ());
+    dstAmount.add (s);
+    s.add160 (currIssuer.first);
+    s.add160 (currIssuer.second);
+    spsPaths.add (s);
+    return s.getSHA512Half ();
+}
+
+RippleLineCache::PathResult PathRequest::findPaths (RippleLineCache::ref cache,
+    int iLevel, currIssuer_t const& currIssuer, STPathSet spsPaths)
+{
+    RippleLineCache::PathResult result;
+
+    result.paths = spsPaths;
+
+    bool valid;
+    Pathfinder pf (cache, raSrcAccount, raDstAccount,
+                   currIssuer.first, currIssuer.second, saDstAmount, valid);
+    CondLog (!valid, lsDEBUG, PathRequest) << iIdentifier << " PF request not valid";
+
+    STPath extraPath;
+    if (valid && pf.findPaths (iLevel, 4, spsPaths, extraPath))
+    {
+        LedgerEntrySet                      lesSandbox (cache->getLedger (), tapNONE);
+        std::vector<PathState::pointer>     vpsExpanded;
+        STAmount                            saMaxAmountAct;
+        STAmount                            saDstAmountAct;
+        STAmount                            saMaxAmount (currIssuer.first,
+                currIssuer.second.isNonZero () ? currIssuer.second :
+                (currIssuer.first.isZero () ? ACCOUNT_STR : raSrcAccount.getAccountID ()), 1);
+        saMaxAmount.negate ();
+        m_journal.debug << iIdentifier << " Paths found, calling rippleCalc";
+        TER terResult = RippleCalc::rippleCalc (lesSandbox, saMaxAmountAct, saDstAmountAct,
+                                                vpsExpanded, saMaxAmount, saDstAmount,
+                                                raDstAccount.getAccountID (), raSrcAccount.getAccountID (),
+                                                spsPaths, false, false, false, true);
+
+
+        if ((extraPath.size() > 0) && ((terResult == terNO_LINE) || (terResult == tecPATH_PARTIAL)))
+        {
+            m_journal.debug << iIdentifier << " Trying with an extra path element";
+            spsPaths.addPath(extraPath);
+            vpsExpanded.clear ();
+            terResult = RippleCalc::rippleCalc (lesSandbox, saMaxAmountAct, saDstAmountAct,
+                                                vpsExpanded, saMaxAmount, saDstAmount,
+                                                raDstAccount.getAccountID (), raSrcAccount.getAccountID (),
+                                                spsPaths, false, false, false, true);
+            m_journal.debug << iIdentifier << " Extra path element gives " << transHuman (terResult);
+        }
+
+        if (terResult == tesSUCCESS)
+        {
+            Json::Value jvEntry (Json::objectValue);
+            jvEntry["source_amount"]    = saMaxAmountAct.getJson (0);
+            jvEntry["paths_computed"]   = spsPaths.getJson (0);
+            result.alternative = jvEntry;
+        }
+        else
+        {
+            m_journal.debug << iIdentifier << " rippleCalc returns " << transHuman (terResult);
+        }
+
+        result.paths = spsPaths;
+    }
+    else
+    {
+        m_journal.debug << iIdentifier << " No paths found";
+    }
+
+    return result;
+}
 Json::Value PathRequest::doUpdate (RippleLineCache::ref cache, bool fast)
 {
     m_journal.debug << iIdentifier << " update " << (fast ? "fast" : "normal");
@@ -404,58 +482,20 @@ Json::Value PathRequest::doUpdate (RippleLineCache::ref cache, bool fast)
             if (m_journal.debug)
                 m_journal.debug << iIdentifier << " Trying to find paths: " << test.getFullText ();
         }
-        bool valid;
         STPathSet& spsPaths = mContext[currIssuer];
-        Pathfinder pf (cache, raSrcAccount, raDstAccount,
-                       currIssuer.first, currIssuer.second, saDstAmount, valid);
-        CondLog (!valid, lsDEBUG, PathRequest) << iIdentifier << " PF request not valid";
 
-        STPath extraPath;
-        if (valid && pf.findPaths (iLevel, 4, spsPaths, extraPath))
-        {
-            LedgerEntrySet                      lesSandbox (cache->getLedger (), tapNONE);
-            std::vector<PathState::pointer>     vpsExpanded;
-            STAmount                            saMaxAmountAct;
-            STAmount                            saDstAmountAct;
-            STAmount                            saMaxAmount (currIssuer.first,
-                    currIssuer.second.isNonZero () ? currIssuer.second :
-                    (currIssuer.first.isZero () ? ACCOUNT_STR : raSrcAccount.getAccountID ()), 1);
-            saMaxAmount.negate ();
-            m_journal.debug << iIdentifier << " Paths found, calling rippleCalc";
-            TER terResult = RippleCalc::rippleCalc (lesSandbox, saMaxAmountAct, saDstAmountAct,
-                                                    vpsExpanded, saMaxAmount, saDstAmount,
-                                                    raDstAccount.getAccountID (), raSrcAccount.getAccountID (),
-                                                    spsPaths, false, false, false, true);
-
-
-            if ((extraPath.size() > 0) && ((terResult == terNO_LINE) || (terResult == tecPATH_PARTIAL)))
-            {
-                m_journal.debug << iIdentifier << " Trying with an extra path element";
-                spsPaths.addPath(extraPath);
-                vpsExpanded.clear ();
-                terResult = RippleCalc::rippleCalc (lesSandbox, saMaxAmountAct, saDstAmountAct,
-                                                    vpsExpanded, saMaxAmount, saDstAmount,
-                                                    raDstAccount.getAccountID (), raSrcAccount.getAccountID (),
-                                                    spsPaths, false, false, false, true);
-                m_journal.debug << iIdentifier << " Extra path element gives " << transHuman (terResult);
-            }
+        // Requests with the same question share the answer
+        RippleLineCache::PathResult const result = cache->getPaths (
+            getPathKey (iLevel, raSrcAccount, raDstAccount, saDstAmount,
+                currIssuer, spsPaths),
+            [&] () { return findPaths (cache, iLevel, currIssuer, spsPaths); });
 
-            if (terResult == tesSUCCESS)
-            {
-                Json::Value jvEntry (Json::objectValue);
-                jvEntry["source_amount"]    = saMaxAmountAct.getJson (0);
-                jvEntry["paths_computed"]   = spsPaths.getJson (0);
-                found  = true;
-                jvArray.append (jvEntry);
-            }
-            else
-            {
-                m_journal.debug << iIdentifier << " rippleCalc returns " << transHuman (terResult);
-            }
-        }
-        else
+        spsPaths = result.paths;
+
+        if (!result.alternative.isNull ())
         {
-            m_journal.debug << iIdentifier << " No paths found";
+            found = true;
+            jvArray.append (result.alternative);
         }
     }
 
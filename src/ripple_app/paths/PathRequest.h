@@ -67,11 +67,20 @@ public:
     Json::Value doUpdate (const boost::shared_ptr<RippleLineCache>&, bool fast); // update jvStatus
     InfoSub::pointer getSubscriber ();
 
+    // Identifies the question asked by findPaths, so that requests asking
+    // the same one can share the result
+    static uint256 getPathKey (int level, RippleAddress const& srcAccount,
+        RippleAddress const& dstAccount, STAmount const& dstAmount,
+        currIssuer_t const& currIssuer, STPathSet const& spsPaths);
+
 private:
     void setValid ();
     void resetLevel (int level);
     int parseJson (const Json::Value&, bool complete);
 
+    RippleLineCache::PathResult findPaths (RippleLineCache::ref cache,
+        int iLevel, currIssuer_t const& currIssuer, STPathSet spsPaths);
+
     beast::Journal m_journal;
 
     typedef RippleRecursiveMutex LockType;
@@ -17,6 +17,13 @@
 */
 //==============================================================================
 
+#include "../main/Tuning.h"
+
+#include "../../beast/beast/unit_test/suite.h"
+
+#include <condition_variable>
+#include <thread>
+
 namespace ripple {
 
 /** Get the current RippleLineCache, updating it if necessary.
@@ -24,31 +31,189 @@ namespace ripple {
 */
 RippleLineCache::pointer PathRequests::getLineCache (Ledger::pointer& ledger, bool authoritative)
 {
+    std::uint32_t lgrSeq = ledger->getLedgerSeq();
+    RippleLineCache::pointer previous;
+
+    {
+        ScopedLockType sl (mLock);
+
+        std::uint32_t lineSeq = mLineCache ? mLineCache->getLedger()->getLedgerSeq() : 0;
+
+        if ( (lineSeq != 0) &&                                  // have a ledger
+             !(authoritative && (lgrSeq > lineSeq)) &&          // not a newer authoritative ledger
+             !(authoritative && ((lgrSeq + 8)  < lineSeq)) &&   // did not jump way back
+             !(lgrSeq > (lineSeq + 8)))                         // did not jump way forward
+        {
+            ledger = mLineCache->getLedger();
+            return mLineCache;
+        }
+
+        previous = mLineCache;
+    }
+
+    // Carrying the trust lines forward reads every ledger in between, so the
+    // new cache is built without holding the lock
+    ledger = boost::make_shared<Ledger>(*ledger, false); // Take a snapshot of the ledger
+    RippleLineCache::pointer cache = boost::make_shared<RippleLineCache> (ledger);
+
+    // Keep the trust lines that did not change
+    if (previous && !cache->carryForward (*previous))
+        mJournal.debug << "Trust lines not carried forward to ledger " << lgrSeq;
+
     ScopedLockType sl (mLock);
 
-    std::uint32_t lineSeq = mLineCache ? mLineCache->getLedger()->getLedgerSeq() : 0;
-    std::uint32_t lgrSeq = ledger->getLedgerSeq();
+    // Another caller may have put in a newer cache meanwhile
+    if ((mLineCache == previous) || (mLineCache->getLedger()->getLedgerSeq() < lgrSeq))
+        mLineCache = cache;
+
+    return cache;
+}
 
-    if ( (lineSeq == 0) ||                                 // no ledger
-         (authoritative && (lgrSeq > lineSeq)) ||          // newer authoritative ledger
-         (authoritative && ((lgrSeq + 8)  < lineSeq)) ||   // we jumped way back for some reason
-         (lgrSeq > (lineSeq + 8)))                         // we jumped way forward for some reason
+/** Path requests being updated in parallel against one snapshot.
+    Each thread that joins in takes requests until none are left, so the
+    pass completes even if none of the jobs we queued get to run.
+*/
+struct PathRequests::UpdateJobs
+{
+    std::vector<PathRequest::wptr> requests;
+    RippleLineCache::pointer cache;
+    LedgerIndex index;
+    bool newRequests;
+
+    std::atomic<std::size_t> next;
+    std::atomic<bool> stop;         // Leave the remaining requests alone
+    std::atomic<bool> mustBreak;    // A new request came in
+    std::atomic<int> processed;
+    std::atomic<int> removed;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::size_t remaining;
+    std::exception_ptr error;
+
+    UpdateJobs (std::vector<PathRequest::wptr> const& r,
+            RippleLineCache::ref c, LedgerIndex i, bool n)
+        : requests (r)
+        , cache (c)
+        , index (i)
+        , newRequests (n)
+        , next (0)
+        , stop (false)
+        , mustBreak (false)
+        , processed (0)
+        , removed (0)
+        , remaining (r.size ())
     {
-        ledger = boost::make_shared<Ledger>(*ledger, false); // Take a snapshot of the ledger
-        mLineCache = boost::make_shared<RippleLineCache> (ledger);
     }
-    else
+
+    void run (PathRequests& owner, CancelCallback const& shouldCancel)
     {
-        ledger = mLineCache->getLedger();
+        for (std::size_t i = next++; i < requests.size (); i = next++)
+        {
+            if (!stop && shouldCancel ())
+                stop = true;
+
+            if (!stop)
+            {
+                try
+                {
+                    owner.updateRequest (requests[i], *this);
+                }
+                catch (...)
+                {
+                    std::lock_guard <std::mutex> sl (lock);
+
+                    if (!error)
+                        error = std::current_exception ();
+
+                    stop = true;
+                }
+
+                if (!newRequests && getApp().getLedgerMaster().isNewPathRequest())
+                {
+                    // We weren't handling new requests and then there was a new request
+                    mustBreak = true;
+                    stop = true;
+                }
+            }
+
+            std::lock_guard <std::mutex> sl (lock);
+
+            if (--remaining == 0)
+                cond.notify_all ();
+        }
+    }
+
+    void wait ()
+    {
+        std::unique_lock <std::mutex> sl (lock);
+
+        while (remaining != 0)
+            cond.wait (sl);
+    }
+};
+
+void PathRequests::updateRequest (PathRequest::wref wRequest, UpdateJobs& jobs)
+{
+    PathRequest::pointer pRequest = wRequest.lock ();
+
+    if (pRequest)
+    {
+        if (!pRequest->needsUpdate (jobs.newRequests, jobs.index))
+            return;
+
+        InfoSub::pointer ipSub = pRequest->getSubscriber ();
+        if (ipSub)
+        {
+            ipSub->getConsumer ().charge (Resource::feePathFindUpdate);
+            if (!ipSub->getConsumer ().warn ())
+            {
+                Json::Value update = pRequest->doUpdate (jobs.cache, false);
+                pRequest->updateComplete ();
+                update["type"] = "find_path";
+                ipSub->send (update, false);
+                ++jobs.processed;
+                return;
+            }
+        }
     }
-    return mLineCache;
+
+    jobs.removed += removeRequest (pRequest);
+}
+
+int PathRequests::removeRequest (PathRequest::ref pRequest)
+{
+    int removed = 0;
+
+    ScopedLockType sl (mLock);
+
+    // Remove any dangling weak pointers or weak pointers that refer to this path request.
+    std::vector<PathRequest::wptr>::iterator it = mRequests.begin();
+    while (it != mRequests.end())
+    {
+        PathRequest::pointer itRequest = it->lock ();
+        if (!itRequest || (itRequest == pRequest))
+        {
+            ++removed;
+            it = mRequests.erase (it);
+        }
+        else
+            ++it;
+    }
+
+    return removed;
+}
+
+void PathRequests::runUpdateJobs (boost::shared_ptr<UpdateJobs> jobs, Job& job)
+{
+    jobs->run (*this, job.getCancelCallback ());
 }
 
 void PathRequests::updateAll (Ledger::ref inLedger, CancelCallback shouldCancel)
 {
     std::vector<PathRequest::wptr> requests;
 
-    LoadEvent::autoptr event (getApp().getJobQueue().getLoadEventAP(jtPATH_FIND, "PathRequest::updateAll"));
+    LoadEvent::autoptr event (mJobQueue.getLoadEventAP(jtPATH_FIND, "PathRequest::updateAll"));
 
     // Get the ledger and cache we should be using
     Ledger::pointer ledger = inLedger;
@@ -56,9 +221,10 @@ void PathRequests::updateAll (Ledger::ref inLedger, CancelCallback shouldCancel)
     {
         ScopedLockType sl (mLock);
         requests = mRequests;
-        cache = getLineCache (ledger, true);
     }
 
+    cache = getLineCache (ledger, true);
+
     bool newRequests = getApp().getLedgerMaster().isNewPathRequest();
     bool mustBreak = false;
 
@@ -66,66 +232,36 @@ void PathRequests::updateAll (Ledger::ref inLedger, CancelCallback shouldCancel)
         requests.size() << " requests";
     int processed = 0, removed = 0;
 
+    // Requests are spread over several jobs which all share the cache. The
+    // cache also remembers the paths found, so requests asking the same
+    // question of the same snapshot only do the work once.
+    int const jobLimit = std::min<int> (pathFindJobLimit,
+        std::max (1, static_cast<int> (std::thread::hardware_concurrency ())));
+
     do
     {
+        boost::shared_ptr<UpdateJobs> jobs = boost::make_shared<UpdateJobs> (
+            requests, cache, ledger->getLedgerSeq (), newRequests);
 
-        BOOST_FOREACH (PathRequest::wref wRequest, requests)
-        {
-            if (shouldCancel())
-                break;
+        int const helpers = std::min<int> (jobLimit,
+            requests.size () / pathFindJobRequests) - 1;
 
-            bool remove = true;
-            PathRequest::pointer pRequest = wRequest.lock ();
+        for (int i = 0; i < helpers; ++i)
+            mJobQueue.addJob (jtUPDATE_PF, "pf:update",
+                BIND_TYPE (&PathRequests::runUpdateJobs, this, jobs, P_1));
 
-            if (pRequest)
-            {
-                if (!pRequest->needsUpdate (newRequests, ledger->getLedgerSeq ()))
-                    remove = false;
-                else
-                {
-                    InfoSub::pointer ipSub = pRequest->getSubscriber ();
-                    if (ipSub)
-                    {
-                        ipSub->getConsumer ().charge (Resource::feePathFindUpdate);
-                        if (!ipSub->getConsumer ().warn ())
-                        {
-                            Json::Value update = pRequest->doUpdate (cache, false);
-                            pRequest->updateComplete ();
-                            update["type"] = "find_path";
-                            ipSub->send (update, false);
-                            remove = false;
-                            ++processed;
-                        }
-                    }
-                }
-            }
+        jobs->run (*this, shouldCancel);
+        jobs->wait ();
 
-            if (remove)
-            {
-                PathRequest::pointer pRequest = wRequest.lock ();
+        processed += jobs->processed;
+        removed += jobs->removed;
+        mustBreak = jobs->mustBreak;
 
-                ScopedLockType sl (mLock);
+        if (jobs->error)
+            std::rethrow_exception (jobs->error);
 
-                // Remove any dangling weak pointers or weak pointers that refer to this path request.
-                std::vector<PathRequest::wptr>::iterator it = mRequests.begin();
-                while (it != mRequests.end())
-                {
-                    PathRequest::pointer itRequest = it->lock ();
-                    if (!itRequest || (itRequest == pRequest))
-                    {
-                        ++removed;
-                        it = mRequests.erase (it);
-                    }
-                    else
-                        ++it;
-                }
-            }
-
-            mustBreak = !newRequests && getApp().getLedgerMaster().isNewPathRequest();
-            if (mustBreak) // We weren't handling new requests and then there was a new request
-                break;
-
-        }
+        if (shouldCancel ())
+            break;
 
         if (mustBreak)
         { // a new request came in while we were working
@@ -149,10 +285,10 @@ void PathRequests::updateAll (Ledger::ref inLedger, CancelCallback shouldCancel)
             if (mRequests.empty())
                 break;
             requests = mRequests;
-
-            cache = getLineCache (ledger, false);
         }
 
+        cache = getLineCache (ledger, false);
+
     }
     while (!shouldCancel ());
 
@@ -169,12 +305,7 @@ Json::Value PathRequests::makePathRequest(
         subscriber, ++mLastIdentifier, *this, mJournal);
 
     Ledger::pointer ledger = inLedger;
-    RippleLineCache::pointer cache;
-
-    {
-        ScopedLockType sl (mLock);
-        cache = getLineCache (ledger, false);
-    }
+    RippleLineCache::pointer cache = getLineCache (ledger, false);
 
     bool valid = false;
     Json::Value result = req->doCreate (ledger, cache, requestJson, valid);
@@ -204,4 +335,140 @@ Json::Value PathRequests::makePathRequest(
     return result;
 }
 
+//------------------------------------------------------------------------------
+
+class PathRequests_test : public beast::unit_test::suite
+{
+public:
+    // Keeps the updates sent for its path request
+    class Subscriber : public InfoSub
+    {
+    public:
+        Subscriber ()
+            : InfoSub (getApp().getOPs (),
+                getApp().getResourceManager ().newAdminEndpoint ("PathRequests_test"))
+        {
+        }
+
+        void send (Json::Value const& jvObj, bool)
+        {
+            std::lock_guard <std::mutex> sl (mutex);
+            updates.push_back (jvObj);
+        }
+
+        std::mutex mutex;
+        std::vector <Json::Value> updates;
+    };
+
+    static RippleAddress makeAccount (int i)
+    {
+        RippleAddress account;
+        account.setAccountID (uint160 (std::uint64_t (i + 1)));
+        return account;
+    }
+
+    // A genesis ledger holding accounts 0 to count-1
+    static Ledger::pointer makeLedger (int count)
+    {
+        RippleAddress const seed = RippleAddress::createSeedGeneric ("masterpassphrase");
+        Ledger::pointer ledger = boost::make_shared<Ledger> (
+            RippleAddress::createAccountPublic (seed), SYSTEM_CURRENCY_START);
+
+        for (int i = 0; i < count; ++i)
+        {
+            uint160 const id (makeAccount (i).getAccountID ());
+            SLE::pointer sle = boost::make_shared<SLE> (ltACCOUNT_ROOT,
+                Ledger::getAccountRootIndex (id));
+            sle->setFieldAccount (sfAccount, id);
+            sle->setFieldAmount (sfBalance, STAmount (std::uint64_t (1000000000)));
+            sle->setFieldU32 (sfSequence, 1);
+            ledger->writeBack (lepCREATE, sle);
+        }
+
+        ledger->updateHash ();
+        ledger->setClosed ();
+        return ledger;
+    }
+
+    void testConcurrentUpdates ()
+    {
+        testcase ("concurrent updates");
+
+        beast::RootStoppable root ("PathRequests_test");
+        std::unique_ptr <JobQueue> jobQueue (make_JobQueue (
+            beast::insight::NullCollector::New (), root, beast::Journal ()));
+        jobQueue->setThreadCount (4, false);
+        root.start ();
+
+        Ledger::pointer const ledger = makeLedger (12);
+        PathRequests requests (*jobQueue, beast::Journal (),
+            beast::insight::NullCollector::New ());
+
+        // Enough requests to spread over every job. There are eight
+        // questions, each asked by four requests, so the jobs both share
+        // results in the cache and compute different ones at once.
+        int const count = 8 * pathFindJobRequests * pathFindJobLimit;
+
+        std::vector <boost::shared_ptr <Subscriber>> subscribers;
+        std::vector <Json::Value> asked;
+
+        for (int i = 0; i < count; ++i)
+        {
+            Json::Value request (Json::objectValue);
+            request["source_account"] = makeAccount (i % 4).humanAccountID ();
+            request["destination_account"] = makeAccount (4 + (i % 8)).humanAccountID ();
+            request["destination_amount"] = std::to_string (1000000 * (1 + (i % 8)));
+
+            boost::shared_ptr <Subscriber> subscriber = boost::make_shared <Subscriber> ();
+            requests.makePathRequest (subscriber, ledger, request);
+            expect (subscriber->getPathRequest () != nullptr, "Request is valid");
+
+            subscribers.push_back (subscriber);
+            asked.push_back (request);
+        }
+
+        requests.updateAll (ledger, [] { return false; });
+
+        bool updated = true;
+        bool own = true;
+
+        for (int i = 0; i < count; ++i)
+        {
+            Subscriber& subscriber (*subscribers[i]);
+            std::lock_guard <std::mutex> sl (subscriber.mutex);
+
+            if (subscriber.updates.empty ())
+                updated = false;
+
+            BOOST_FOREACH (Json::Value const& update, subscriber.updates)
+            {
+                Json::Value const& alternatives = update["alternatives"];
+
+                // A direct STR payment costs what it delivers
+                if (update["source_account"] != asked[i]["source_account"] ||
+                    update["destination_account"] != asked[i]["destination_account"] ||
+                    update["destination_amount"] != asked[i]["destination_amount"] ||
+                    alternatives.size () != 1 ||
+                    alternatives[0u]["source_amount"] != asked[i]["destination_amount"])
+                {
+                    own = false;
+                }
+            }
+        }
+
+        expect (updated, "Every request is updated");
+        expect (own, "Every request gets its own result");
+
+        subscribers.clear ();
+        root.stop ();
+    }
+
+    void run ()
+    {
+        testConcurrentUpdates ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(PathRequests,ripple_app,ripple);
+
 } // ripple
@@ -25,8 +25,10 @@ namespace ripple {
 class PathRequests
 {
 public:
-    PathRequests (beast::Journal journal, beast::insight::Collector::ptr const& collector)
-        : mJournal (journal)
+    PathRequests (JobQueue& jobQueue, beast::Journal journal,
+        beast::insight::Collector::ptr const& collector)
+        : mJobQueue (jobQueue)
+        , mJournal (journal)
         , mLastIdentifier (0)
     {
         mFast = collector->make_event ("pathfind_fast");
@@ -35,6 +37,7 @@ public:
 
     void updateAll (const boost::shared_ptr<Ledger>& ledger, CancelCallback shouldCancel);
 
+    // Not to be called with mLock held, a new cache may take a while to build
     RippleLineCache::pointer getLineCache (Ledger::pointer& ledger, bool authoritative);
 
     Json::Value makePathRequest (
@@ -53,6 +56,18 @@ public:
     }
 
 private:
+    struct UpdateJobs;
+
+    // Update one request as part of a pass, or remove it if it is gone
+    void updateRequest (PathRequest::wref wRequest, UpdateJobs& jobs);
+
+    // Returns the number of entries removed
+    int removeRequest (PathRequest::ref request);
+
+    void runUpdateJobs (boost::shared_ptr<UpdateJobs> jobs, Job& job);
+
+    JobQueue&                        mJobQueue;
+
     beast::Journal                   mJournal;
 
     beast::insight::Event            mFast;
@@ -17,6 +17,10 @@
 */
 //==============================================================================
 
+#include "../main/Tuning.h"
+
+#include "../../beast/beast/unit_test/suite.h"
+
 namespace ripple {
 
 RippleLineCache::RippleLineCache (Ledger::ref l)
@@ -28,13 +32,458 @@ AccountItems& RippleLineCache::getRippleLines (const uint160& accountID)
 {
     ScopedLockType sl (mLock);
 
-    ripple::unordered_map <uint160, AccountItems::pointer>::iterator it = mRLMap.find (accountID);
+    ripple::unordered_map <uint160, Lines>::iterator it = mRLMap.find (accountID);
 
     if (it == mRLMap.end ())
-        it = mRLMap.insert (std::make_pair (accountID, boost::make_shared<AccountItems>
-                                            (boost::cref (accountID), boost::cref (mLedger), AccountItem::pointer (new RippleState ())))).first;
+    {
+        Lines lines;
+        lines.items = boost::make_shared<AccountItems> (boost::cref (accountID),
+            boost::cref (mLedger), AccountItem::pointer (new RippleState ()));
+        it = mRLMap.insert (std::make_pair (accountID, lines)).first;
+    }
+
+    it->second.used = mLedger->getLedgerSeq ();
+
+    return *it->second.items;
+}
+
+bool RippleLineCache::carryForward (RippleLineCache& previous)
+{
+    Ledger::pointer const prevLedger = previous.getLedger ();
+    std::uint32_t const seq = mLedger->getLedgerSeq ();
+    std::uint32_t const prevSeq = prevLedger->getLedgerSeq ();
+
+    if (!mLedger->isClosed () || !prevLedger->isClosed () ||
+        (seq <= prevSeq) || ((seq - prevSeq) > lineCacheCatchUpLedgers))
+        return false;
+
+    // Walk back to the previous ledger, making sure this one descends from it
+    std::vector <Ledger::pointer> ledgers;
+
+    for (Ledger::pointer ledger = mLedger; ledger->getLedgerSeq () > prevSeq;)
+    {
+        ledgers.push_back (ledger);
+
+        uint256 const parentHash = ledger->getParentHash ();
+
+        if (ledger->getLedgerSeq () == (prevSeq + 1))
+            ledger = prevLedger;
+        else
+            ledger = getApp().getLedgerMaster ().getLedgerByHash (parentHash);
+
+        if (!ledger || (ledger->getHash () != parentHash))
+            return false;
+    }
+
+    // The trust lines that changed, for the accounts on both sides
+    ripple::unordered_map <uint160, std::set <uint256>> changed;
+
+    BOOST_FOREACH (Ledger::ref ledger, ledgers)
+    {
+        AcceptedLedger::pointer accepted = AcceptedLedger::makeAcceptedLedger (ledger);
+
+        BOOST_FOREACH (AcceptedLedger::value_type const& item, accepted->getMap ())
+        {
+            BOOST_FOREACH (STObject & node, item.second->getMeta ()->getNodes ())
+            {
+                if (node.getFieldU16 (sfLedgerEntryType) != ltRIPPLE_STATE)
+                    continue;
+
+                const STObject* data = dynamic_cast<const STObject*> (node.peekAtPField (
+                    (node.getFName () == sfCreatedNode) ? sfNewFields : sfFinalFields));
+
+                if (!data || !data->isFieldPresent (sfLowLimit) ||
+                    !data->isFieldPresent (sfHighLimit))
+                    return false;
+
+                uint256 const index = node.getFieldH256 (sfLedgerIndex);
+
+                changed[data->getFieldAmount (sfLowLimit).getIssuer ()].insert (index);
+                changed[data->getFieldAmount (sfHighLimit).getIssuer ()].insert (index);
+            }
+        }
+    }
+
+    std::uint32_t const oldest = (seq > lineCacheIdleLedgers) ? (seq - lineCacheIdleLedgers) : 0;
+
+    ScopedLockType sl (mLock);
+    ScopedLockType psl (previous.mLock);
+
+    typedef ripple::unordered_map <uint160, Lines>::value_type value_type;
+    BOOST_FOREACH (value_type const& entry, previous.mRLMap)
+    {
+        if (entry.second.used < oldest)
+            continue;
+
+        auto const found = changed.find (entry.first);
+
+        if (found == changed.end ())
+        {
+            // Nothing changed, share the lines
+            mRLMap.insert (entry);
+            continue;
+        }
 
-    return *it->second;
+        // Pathfinders on the previous ledger may still use the old lines
+        Lines lines;
+        lines.items = boost::make_shared<AccountItems> (*entry.second.items);
+        lines.used = entry.second.used;
+
+        BOOST_FOREACH (uint256 const& index, found->second)
+            lines.items->updateItem (entry.first, index, mLedger->getSLEi (index));
+
+        mRLMap.insert (std::make_pair (entry.first, lines));
+    }
+
+    return true;
 }
 
+RippleLineCache::PathResult RippleLineCache::getPaths (uint256 const& key,
+    std::function <PathResult ()> const& compute)
+{
+    std::promise <PathResult> promise;
+    std::shared_future <PathResult> result;
+    bool owner = false;
+
+    {
+        ScopedLockType sl (mLock);
+
+        auto const it = mPathMap.find (key);
+
+        if (it == mPathMap.end ())
+        {
+            result = promise.get_future ().share ();
+            mPathMap.insert (std::make_pair (key, result));
+            owner = true;
+        }
+        else
+        {
+            result = it->second;
+        }
+    }
+
+    if (owner)
+    {
+        try
+        {
+            promise.set_value (compute ());
+        }
+        catch (...)
+        {
+            // Anyone waiting sees the exception, later callers try again
+            promise.set_exception (std::current_exception ());
+
+            ScopedLockType sl (mLock);
+            mPathMap.erase (key);
+            throw;
+        }
+    }
+
+    return result.get ();
+}
+
+//------------------------------------------------------------------------------
+
+class RippleLineCache_test : public beast::unit_test::suite
+{
+public:
+    typedef RippleLineCache::PathResult PathResult;
+
+    static RippleAddress makeAccount (std::uint64_t id)
+    {
+        RippleAddress account;
+        account.setAccountID (uint160 (id));
+        return account;
+    }
+
+    static PathResult makeResult (int value)
+    {
+        PathResult result;
+        result.alternative = Json::Value (value);
+        return result;
+    }
+
+    void testPathKeys ()
+    {
+        testcase ("path keys");
+
+        RippleLineCache cache ((Ledger::pointer ()));
+
+        RippleAddress const src = makeAccount (1);
+        RippleAddress const dst = makeAccount (2);
+        uint160 const currency (std::uint64_t (3));
+        uint160 const issuer (std::uint64_t (4));
+        uint160 const otherIssuer (std::uint64_t (5));
+        PathRequest::currIssuer_t const source (currency, issuer);
+        STPathSet const paths;
+
+        // The same question, then questions differing only in the
+        // amount or in the destination or source issuer
+        std::vector <uint256> keys;
+        keys.push_back (PathRequest::getPathKey (3, src, dst,
+            STAmount (currency, issuer, std::uint64_t (100)), source, paths));
+        keys.push_back (PathRequest::getPathKey (3, src, dst,
+            STAmount (currency, issuer, std::uint64_t (101)), source, paths));
+        keys.push_back (PathRequest::getPathKey (3, src, dst,
+            STAmount (currency, otherIssuer, std::uint64_t (100)), source, paths));
+        keys.push_back (PathRequest::getPathKey (3, src, dst,
+            STAmount (currency, issuer, std::uint64_t (100)),
+            PathRequest::currIssuer_t (currency, otherIssuer), paths));
+
+        expect (keys[0] == PathRequest::getPathKey (3, src, dst,
+            STAmount (currency, issuer, std::uint64_t (100)), source, paths),
+            "Same question, same key");
+
+        int computed = 0;
+
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            PathResult const result = cache.getPaths (keys[i],
+                [&] () { return makeResult (++computed); });
+
+            expect (result.alternative.asInt () == int (i + 1),
+                "Question " + std::to_string (i) + " gets its own result");
+        }
+
+        expect (computed == int (keys.size ()), "Each question is computed");
+
+        // Asking again shares the earlier results
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            PathResult const result = cache.getPaths (keys[i],
+                [&] () { return makeResult (++computed); });
+
+            expect (result.alternative.asInt () == int (i + 1),
+                "Question " + std::to_string (i) + " shares its result");
+        }
+
+        expect (computed == int (keys.size ()), "Nothing computed again");
+    }
+
+    void testComputeThrows ()
+    {
+        testcase ("compute throws");
+
+        RippleLineCache cache ((Ledger::pointer ()));
+        uint256 const key (std::uint64_t (7));
+
+        bool threw = false;
+
+        try
+        {
+            cache.getPaths (key,
+                [] () -> PathResult { throw std::runtime_error ("compute"); });
+        }
+        catch (std::runtime_error const&)
+        {
+            threw = true;
+        }
+
+        expect (threw, "Caller sees the exception");
+
+        int computed = 0;
+        PathResult result = cache.getPaths (key,
+            [&] () { return makeResult (++computed); });
+
+        expect (computed == 1, "Later request computes again");
+        expect (result.alternative.asInt () == 1, "Later request gets a result");
+
+        result = cache.getPaths (key,
+            [&] () { return makeResult (++computed); });
+
+        expect (computed == 1, "New result is shared");
+        expect (result.alternative.asInt () == 1, "New result is shared");
+    }
+
+    //--------------------------------------------------------------------------
+
+    typedef std::function <void (LedgerEntrySet&)> Edit;
+
+    static uint160 accountID (int i)
+    {
+        return uint160 (std::uint64_t (i + 1));
+    }
+
+    static uint160 currency ()
+    {
+        return uint160 (std::uint64_t (0x55534400));
+    }
+
+    // A genesis ledger holding accounts 0 to count-1
+    static Ledger::pointer makeLedger (int count)
+    {
+        RippleAddress const seed = RippleAddress::createSeedGeneric ("masterpassphrase");
+        Ledger::pointer ledger = boost::make_shared<Ledger> (
+            RippleAddress::createAccountPublic (seed), SYSTEM_CURRENCY_START);
+
+        for (int i = 0; i < count; ++i)
+        {
+            SLE::pointer sle = boost::make_shared<SLE> (ltACCOUNT_ROOT,
+                Ledger::getAccountRootIndex (accountID (i)));
+            sle->setFieldAccount (sfAccount, accountID (i));
+            sle->setFieldAmount (sfBalance, STAmount (std::uint64_t (1000000000)));
+            sle->setFieldU32 (sfSequence, 1);
+            ledger->writeBack (lepCREATE, sle);
+        }
+
+        return ledger;
+    }
+
+    // Write the changes in a set to its ledger, as the transaction engine does
+    static void writeSet (LedgerEntrySet& les, Ledger::ref ledger)
+    {
+        for (auto const& item : les)
+        {
+            switch (item.second.mAction)
+            {
+            case taaCREATE:
+                ledger->writeBack (lepCREATE, item.second.mEntry);
+                break;
+
+            case taaMODIFY:
+                ledger->writeBack (lepNONE, item.second.mEntry);
+                break;
+
+            case taaDELETE:
+                ledger->peekAccountStateMap ()->delItem (item.first);
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    // Make the edits as one transaction with metadata
+    static void apply (Ledger::ref ledger, std::uint32_t index, Edit const& edit)
+    {
+        RippleAddress account;
+        account.setAccountID (accountID (0));
+
+        SerializedTransaction tx (ttACCOUNT_SET);
+        tx.setSourceAccount (account);
+        tx.setFieldU32 (sfSequence, index + 1);
+        tx.setFieldAmount (sfFee, STAmount (std::uint64_t (10)));
+        uint256 const txID = tx.getTransactionID ();
+
+        LedgerEntrySet les (ledger, tapNONE);
+        les.init (ledger, txID, ledger->getLedgerSeq (), tapNONE);
+        edit (les);
+
+        Serializer meta;
+        les.calcRawMeta (meta, tesSUCCESS, index);
+        writeSet (les, ledger);
+
+        Serializer s;
+        tx.add (s);
+        ledger->addTransaction (txID, s, meta);
+    }
+
+    static void trustCreate (LedgerEntrySet& les, int src, int dst)
+    {
+        les.trustCreate (accountID (src) > accountID (dst), accountID (src), accountID (dst),
+            Ledger::getRippleStateIndex (accountID (src), accountID (dst), currency ()),
+            les.entryCache (ltACCOUNT_ROOT, Ledger::getAccountRootIndex (accountID (src))),
+            false, false, STAmount (currency (), ACCOUNT_ONE),
+            STAmount (currency (), accountID (src), std::uint64_t (1000)));
+    }
+
+    static void trustDelete (LedgerEntrySet& les, int a, int b)
+    {
+        uint160 const low = std::min (accountID (a), accountID (b));
+        uint160 const high = std::max (accountID (a), accountID (b));
+
+        les.trustDelete (les.entryCache (ltRIPPLE_STATE,
+            Ledger::getRippleStateIndex (low, high, currency ())), low, high);
+    }
+
+    static void credit (LedgerEntrySet& les, int issuer, int holder, std::uint64_t amount)
+    {
+        les.rippleCredit (accountID (issuer), accountID (holder),
+            STAmount (currency (), accountID (issuer), amount));
+    }
+
+    // The trust lines of an account, by ledger index
+    static std::map <uint256, Blob> getLines (RippleLineCache& cache, int i)
+    {
+        std::map <uint256, Blob> lines;
+
+        BOOST_FOREACH (AccountItem::ref item, cache.getRippleLines (accountID (i)).getItems ())
+        {
+            lines[item->peekSLE ().getIndex ()] =
+                item->peekSLE ().getSerializer ().peekData ();
+        }
+
+        return lines;
+    }
+
+    void testCarryForward ()
+    {
+        testcase ("carry forward");
+
+        int const accounts = 6;
+
+        Ledger::pointer ledger1 = makeLedger (accounts);
+        {
+            LedgerEntrySet les (ledger1, tapNONE);
+            les.init (ledger1, uint256 (), ledger1->getLedgerSeq (), tapNONE);
+            trustCreate (les, 1, 0);
+            trustCreate (les, 2, 0);
+            trustCreate (les, 3, 1);
+            trustCreate (les, 4, 3);
+            writeSet (les, ledger1);
+        }
+        ledger1->updateHash ();
+        ledger1->setClosed ();
+
+        RippleLineCache previous (ledger1);
+        std::size_t const counts [accounts] = { 2, 2, 1, 2, 1, 0 };
+
+        for (int i = 0; i < accounts; ++i)
+            expect (getLines (previous, i).size () == counts [i], "Lines in the first ledger");
+
+        // Change, delete and create lines in the next ledger
+        Ledger::pointer ledger2 = boost::make_shared<Ledger> (true, boost::ref (*ledger1));
+
+        apply (ledger2, 0, [] (LedgerEntrySet& les)
+        {
+            credit (les, 0, 1, 10);
+            trustDelete (les, 0, 2);
+            trustCreate (les, 2, 3);
+        });
+
+        apply (ledger2, 1, [] (LedgerEntrySet& les)
+        {
+            credit (les, 3, 4, 20);
+            trustCreate (les, 5, 1);
+        });
+
+        ledger2->updateHash ();
+        ledger2->setClosed ();
+
+        RippleLineCache carried (ledger2);
+        expect (carried.carryForward (previous), "Lines carried forward");
+
+        RippleLineCache fresh (ledger2);
+
+        for (int i = 0; i < accounts; ++i)
+        {
+            expect (getLines (carried, i) == getLines (fresh, i),
+                "Account " + std::to_string (i) + " has the same lines");
+        }
+
+        expect (getLines (fresh, 2).size () == 1, "Deleted and created line");
+        expect (getLines (fresh, 5).size () == 1, "Created line");
+    }
+
+    void run ()
+    {
+        testPathKeys ();
+        testComputeThrows ();
+        testCarryForward ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(RippleLineCache,ripple_app,ripple);
+
 } // ripple
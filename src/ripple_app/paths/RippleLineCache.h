@@ -23,6 +23,11 @@
 namespace ripple {
 
 // Used by Pathfinder
+//
+// The trust lines of each account are kept from one ledger to the next.
+// A cache made for a newer ledger takes them over from the previous cache
+// and replays the transaction metadata in between, so only the lines that
+// changed are read again.
 class RippleLineCache
 {
 public:
@@ -38,6 +43,29 @@ public:
 
     AccountItems& getRippleLines (const uint160& accountID);
 
+    /** Take over the trust lines of a cache for an earlier ledger.
+        Lines the ledgers in between touched are brought up to date from
+        their metadata, and accounts nobody asked about for a while are
+        left behind.
+        @return false if the ledgers in between are not all available.
+                Nothing is taken over in that case.
+    */
+    bool carryForward (RippleLineCache& previous);
+
+    /** Paths found for one source currency of a path request. */
+    struct PathResult
+    {
+        STPathSet paths;            // Paths to start from next time
+        Json::Value alternative;    // Null if the paths did not work
+    };
+
+    /** Return the result for a path finding question, computing it once.
+        Path requests asking the same question of this snapshot share one
+        result. If another thread is computing it, this waits for it.
+    */
+    PathResult getPaths (uint256 const& key,
+        std::function <PathResult ()> const& compute);
+
 private:
     typedef RippleMutex LockType;
     typedef std::lock_guard <LockType> ScopedLockType;
@@ -45,7 +73,15 @@ private:
    
     Ledger::pointer mLedger;
     
-    ripple::unordered_map <uint160, AccountItems::pointer> mRLMap;
+    struct Lines
+    {
+        AccountItems::pointer items;
+        std::uint32_t used;         // Last ledger they were asked for in
+    };
+
+    ripple::unordered_map <uint160, Lines> mRLMap;
+
+    ripple::unordered_map <uint256, std::shared_future <PathResult>> mPathMap;
 };
 
 } // ripple
@@ -87,6 +87,9 @@
 # include "node/SqliteFactory.h"
 #include "node/SqliteFactory.cpp"
 
+# include "main/OnlineDelete.h"
+#include "main/OnlineDelete.cpp"
+
 #include "main/Application.cpp"
 
 #include "main/Main.cpp"
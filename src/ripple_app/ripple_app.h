@@ -43,6 +43,8 @@
 #include <boost/weak_ptr.hpp>
 #include <boost/thread/shared_mutex.hpp>
 
+#include <future>
+
 //------------------------------------------------------------------------------
 
 #include "../ripple_basics/ripple_basics.h"
@@ -60,6 +62,7 @@
 
 #include "../../ripple/common/KeyCache.h"
 #include "../../ripple/common/TaggedCache.h"
+#include "../../ripple/common/ShardedTaggedCache.h"
 
 #include "data/Database.h"
 #include "data/DatabaseCon.h"
@@ -104,6 +107,7 @@
 #include "ledger/LedgerHolder.h"
 #include "ledger/LedgerHistory.h"
 #include "ledger/LedgerCleaner.h"
+#include "ledger/InflationVotes.h"
 #include "ledger/LedgerMaster.h"
 #include "ledger/LedgerProposal.h"
 #include "misc/NetworkOPs.h"
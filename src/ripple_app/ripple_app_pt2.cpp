@@ -34,6 +34,7 @@
 #include "main/LoadManager.cpp"
 #include "misc/NicknameState.cpp"
 #include "ledger/OrderBookDB.cpp"
+#include "ledger/InflationVotes.cpp"
 
 #include "data/Database.cpp"
 #include "data/DatabaseCon.cpp"
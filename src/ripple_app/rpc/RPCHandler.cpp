@@ -30,6 +30,7 @@ SETUP_LOG (RPCHandler)
 RPCHandler::RPCHandler (NetworkOPs* netOps)
     : mNetOps (netOps)
     , mRole (Config::FORBID)
+    , mStream (nullptr)
 {
 }
 
@@ -37,9 +38,15 @@ RPCHandler::RPCHandler (NetworkOPs* netOps, InfoSub::pointer infoSub)
     : mNetOps (netOps)
     , mInfoSub (infoSub)
     , mRole (Config::FORBID)
+    , mStream (nullptr)
 {
 }
 
+void RPCHandler::setStream (Json::Stream* stream)
+{
+    mStream = stream;
+}
+
 // Provide the JSON-RPC "result" value.
 //
 // JSON-RPC provides a method and an array of params. JSON-RPC is used as a transport for a command and a request object. The
@@ -126,26 +133,26 @@ Json::Value RPCHandler::doCommand (const Json::Value& params, int iRole, Resourc
         {   "account_tx",           &RPCHandler::doAccountTxSwitch,     false,  optNetwork  },
         {   "blacklist",            &RPCHandler::doBlackList,           true,   optNone     },
         {   "book_offers",          &RPCHandler::doBookOffers,          false,  optCurrent  },
-        {   "connect",              &RPCHandler::doConnect,             true,   optNone     },
-        {   "consensus_info",       &RPCHandler::doConsensusInfo,       true,   optNone     },
-        {   "get_counts",           &RPCHandler::doGetCounts,           true,   optNone     },
+        {   "connect",              &RPCHandler::doConnect,             true,   optLocked   },
+        {   "consensus_info",       &RPCHandler::doConsensusInfo,       true,   optLocked   },
+        {   "get_counts",           &RPCHandler::doGetCounts,           true,   optLocked   },
 		{	"inflate",				&RPCHandler::doInflate,				false,	optNone		},
-        {   "internal",             &RPCHandler::doInternal,            true,   optNone     },
-        {   "feature",              &RPCHandler::doFeature,             true,   optNone     },
+        {   "internal",             &RPCHandler::doInternal,            true,   optLocked   },
+        {   "feature",              &RPCHandler::doFeature,             true,   optLocked   },
         {   "fetch_info",           &RPCHandler::doFetchInfo,           true,   optNone     },
         {   "ledger",               &RPCHandler::doLedger,              false,  optNetwork  },
-        {   "ledger_accept",        &RPCHandler::doLedgerAccept,        false,   optCurrent  },
+        {   "ledger_accept",        &RPCHandler::doLedgerAccept,        false,   optCurrent | optLocked },
         {   "ledger_cleaner",       &RPCHandler::doLedgerCleaner,       true,   optNetwork  },
         {   "ledger_closed",        &RPCHandler::doLedgerClosed,        false,  optClosed   },
         {   "ledger_current",       &RPCHandler::doLedgerCurrent,       false,  optCurrent  },
         {   "ledger_data",          &RPCHandler::doLedgerData,          false,  optCurrent  },
         {   "ledger_entry",         &RPCHandler::doLedgerEntry,         false,  optCurrent  },
         {   "ledger_header",        &RPCHandler::doLedgerHeader,        false,  optCurrent  },
-        {   "log_level",            &RPCHandler::doLogLevel,            true,   optNone     },
+        {   "log_level",            &RPCHandler::doLogLevel,            true,   optLocked   },
         {   "logrotate",            &RPCHandler::doLogRotate,           true,   optNone     },
 //      {   "nickname_info",        &RPCHandler::doNicknameInfo,        false,  optCurrent  },
         {   "owner_info",           &RPCHandler::doOwnerInfo,           false,  optCurrent  },
-        {   "peers",                &RPCHandler::doPeers,               true,   optNone     },
+        {   "peers",                &RPCHandler::doPeers,               true,   optLocked   },
         {   "find_path",            &RPCHandler::doPathFind,            false,  optCurrent  },
         {   "ping",                 &RPCHandler::doPing,                false,  optNone     },
         {   "print",                &RPCHandler::doPrint,               true,   optNone     },
@@ -157,29 +164,29 @@ Json::Value RPCHandler::doCommand (const Json::Value& params, int iRole, Resourc
         {   "static_path_find",     &RPCHandler::doRipplePathFind,      false,  optCurrent  },
         {   "sign",                 &RPCHandler::doSign,                false,  optNone     },
         {   "submit",               &RPCHandler::doSubmit,              false,  optCurrent  },
-        {   "server_info",          &RPCHandler::doServerInfo,          false,  optNone     },
-        {   "server_state",         &RPCHandler::doServerState,         false,  optNone     },
+        {   "server_info",          &RPCHandler::doServerInfo,          false,  optLocked   },
+        {   "server_state",         &RPCHandler::doServerState,         false,  optLocked   },
         {   "sms",                  &RPCHandler::doSMS,                 true,   optNone     },
-        {   "stop",                 &RPCHandler::doStop,                true,   optNone     },
+        {   "stop",                 &RPCHandler::doStop,                true,   optLocked   },
         {   "transaction_entry",    &RPCHandler::doTransactionEntry,    false,  optCurrent  },
         {   "tx",                   &RPCHandler::doTx,                  false,  optNetwork  },
         {   "tx_history",           &RPCHandler::doTxHistory,           false,  optNone     },
-        {   "unl_add",              &RPCHandler::doUnlAdd,              true,   optNone     },
-        {   "unl_delete",           &RPCHandler::doUnlDelete,           true,   optNone     },
-        {   "unl_list",             &RPCHandler::doUnlList,             true,   optNone     },
-        {   "unl_load",             &RPCHandler::doUnlLoad,             true,   optNone     },
-        {   "unl_network",          &RPCHandler::doUnlNetwork,          true,   optNone     },
-        {   "unl_reset",            &RPCHandler::doUnlReset,            true,   optNone     },
-        {   "unl_score",            &RPCHandler::doUnlScore,            true,   optNone     },
-        {   "validation_create",    &RPCHandler::doValidationCreate,    true,   optNone     },
-        {   "validation_seed",      &RPCHandler::doValidationSeed,      true,   optNone     },
-        {   "wallet_accounts",      &RPCHandler::doWalletAccounts,      false,  optCurrent  },
+        {   "unl_add",              &RPCHandler::doUnlAdd,              true,   optLocked   },
+        {   "unl_delete",           &RPCHandler::doUnlDelete,           true,   optLocked   },
+        {   "unl_list",             &RPCHandler::doUnlList,             true,   optLocked   },
+        {   "unl_load",             &RPCHandler::doUnlLoad,             true,   optLocked   },
+        {   "unl_network",          &RPCHandler::doUnlNetwork,          true,   optLocked   },
+        {   "unl_reset",            &RPCHandler::doUnlReset,            true,   optLocked   },
+        {   "unl_score",            &RPCHandler::doUnlScore,            true,   optLocked   },
+        {   "validation_create",    &RPCHandler::doValidationCreate,    true,   optLocked   },
+        {   "validation_seed",      &RPCHandler::doValidationSeed,      true,   optLocked   },
+        {   "wallet_accounts",      &RPCHandler::doWalletAccounts,      false,  optCurrent | optLocked },
         {   "create_keys",       &RPCHandler::doWalletPropose,       false,   optNone     },
-        {   "wallet_seed",          &RPCHandler::doWalletSeed,          true,   optNone     },
+        {   "wallet_seed",          &RPCHandler::doWalletSeed,          true,   optLocked   },
 
         // Evented methods
-        {   "subscribe",            &RPCHandler::doSubscribe,           false,  optNone     },
-        {   "unsubscribe",          &RPCHandler::doUnsubscribe,         false,  optNone     },
+        {   "subscribe",            &RPCHandler::doSubscribe,           false,  optLocked   },
+        {   "unsubscribe",          &RPCHandler::doUnsubscribe,         false,  optLocked   },
     };
 
     int     i = NUMBER (commandsA);
@@ -197,7 +204,12 @@ Json::Value RPCHandler::doCommand (const Json::Value& params, int iRole, Resourc
     }
 
     {
-        Application::ScopedLockType lock (getApp().getMasterLock ());
+        // Ledgers and consensus state are read from snapshots, so only the
+        // handlers that change shared state run holding the master lock
+        Application::ScopedLockType lock (getApp().getMasterLock (), std::defer_lock);
+
+        if (commandsA[i].iOptions & optLocked)
+            lock.lock ();
 
         if ((commandsA[i].iOptions & optNetwork) && (mNetOps->getOperatingMode () < NetworkOPs::omSYNCING))
         {
@@ -48,6 +48,14 @@ public:
 
     Json::Value doRpcCommand    (const std::string& strCommand, Json::Value const& jvParams, int iRole, Resource::Charge& loadType);
 
+    /** Let handlers write their largest members straight to a stream.
+        The stream must have the result object open. Handlers that
+        support it write those members into it as they are produced and
+        leave them out of the value they return, which the caller then
+        writes as the remaining members.
+    */
+    void setStream (Json::Stream* stream);
+
 private:
     typedef Json::Value (RPCHandler::*doFuncPtr) (
         Json::Value params,
@@ -61,6 +69,7 @@ private:
         optNetwork  = 1,                // Need network
         optCurrent  = 2 + optNetwork,   // Need current ledger
         optClosed   = 4 + optNetwork,   // Need closed ledger
+        optLocked   = 8,                // Hold the master lock
     };
 
     // Utilities
@@ -139,6 +148,9 @@ private:
 
     // VFALCO TODO Create an enumeration for this.
     int                 mRole;
+
+    // Where large results go when the transport can stream them
+    Json::Stream*       mStream;
 };
 
 class RPCInternalHandler
@@ -40,6 +40,27 @@ bool RPCServerHandler::isAuthorized (
 
 std::string RPCServerHandler::processRequest (std::string const& request,
                                               beast::IP::Endpoint const& remoteIPAddress)
+{
+    std::string response;
+
+    Json::Stream stream ([&response] (char const* data, std::size_t size)
+    {
+        response.append (data, size);
+    });
+
+    std::string const error (processRequest (request, remoteIPAddress, stream));
+
+    if (! error.empty ())
+        return error;
+
+    response += stream.release ();
+
+    return createResponse (200, response);
+}
+
+std::string RPCServerHandler::processRequest (std::string const& request,
+                                              beast::IP::Endpoint const& remoteIPAddress,
+                                              Json::Stream& stream)
 {
     Json::Value jsonRequest;
     {
@@ -112,8 +133,6 @@ std::string RPCServerHandler::processRequest (std::string const& request,
         return HTTPReply (503, "Unable to service at this time");
     }
 
-    std::string response;
-   
     WriteLog (lsDEBUG, RPCServer) << "Query: " << strMethod << params;
 
     {
@@ -131,24 +150,41 @@ std::string RPCServerHandler::processRequest (std::string const& request,
         {
             usage.charge (req.fee);
             WriteLog (lsDEBUG, RPCServer) << "Reply: " << req.result;
-            return createResponse (200,
-                JSONRPCReply (req.result, Json::Value (), id));
+
+            stream.startObject ();
+            stream.set (jss::result, req.result);
+            stream.finish ();
+
+            return std::string ();
         }
     }
 
     // legacy dispatcher
     Resource::Charge fee (Resource::feeReferenceRPC);
     RPCHandler rpcHandler (&m_networkOPs);
+
+    // The result object stays open while the handler runs, so it can
+    // write its largest members straight into it
+    stream.startObject ();
+    stream.startObject (jss::result);
+    rpcHandler.setStream (&stream);
+
     Json::Value const result = rpcHandler.doRpcCommand (
         strMethod, params, role, fee);
 
+    // A handler that failed part way through can leave members open
+    while (stream.depth () > 2)
+        stream.finish ();
+
+    stream.setMembers (result);
+    stream.finish ();
+    stream.finish ();
+
     usage.charge (fee);
 
     WriteLog (lsDEBUG, RPCServer) << "Reply: " << result;
 
-    response = JSONRPCReply (result, Json::Value (), id);
-
-    return createResponse (200, response);
+    return std::string ();
 }
 
 }
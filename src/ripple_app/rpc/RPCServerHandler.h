@@ -38,6 +38,16 @@ public:
     std::string processRequest (std::string const& request,
                                 beast::IP::Endpoint const& remoteIPAddress);
 
+    /** Process a request, writing the JSON-RPC reply to the stream.
+        Handlers that produce large results write them into the stream as
+        they go, so the reply can be sent before it is complete.
+        @return An HTTP error response, or an empty string if the reply
+                was written to the stream.
+    */
+    std::string processRequest (std::string const& request,
+                                beast::IP::Endpoint const& remoteIPAddress,
+                                Json::Stream& stream);
+
 private:
     NetworkOPs& m_networkOPs;
     Resource::Manager& m_resourceManager;
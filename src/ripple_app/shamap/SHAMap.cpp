@@ -18,6 +18,12 @@
 //==============================================================================
 
 #include "../../beast/beast/unit_test/suite.h"
+#include "../main/Tuning.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace ripple {
 
@@ -38,15 +44,13 @@ SHAMap::SHAMap (SHAMapType t, FullBelowCache& fullBelowCache, std::uint32_t seq,
     , mState (smsModifying)
     , mType (t)
     , mTXMap (false)
+    , mDeferHash (false)
     , m_missing_node_handler (missing_node_handler)
 {
     assert (mSeq != 0);
-    if (t == smtSTATE)
-        mTNByID.rehash (STATE_MAP_BUCKETS);
 
     root = boost::make_shared<SHAMapTreeNode> (mSeq, SHAMapNode (0, uint256 ()));
     root->makeInner ();
-    mTNByID.replace(*root, root);
 }
 
 SHAMap::SHAMap (SHAMapType t, uint256 const& hash, FullBelowCache& fullBelowCache,
@@ -57,41 +61,60 @@ SHAMap::SHAMap (SHAMapType t, uint256 const& hash, FullBelowCache& fullBelowCach
     , mState (smsSynching)
     , mType (t)
     , mTXMap (false)
+    , mDeferHash (false)
     , m_missing_node_handler (missing_node_handler)
 {
-    if (t == smtSTATE)
-        mTNByID.rehash (STATE_MAP_BUCKETS);
-
     root = boost::make_shared<SHAMapTreeNode> (mSeq, SHAMapNode (0, uint256 ()));
     root->makeInner ();
-    mTNByID.replace(*root, root);
 }
 
-TaggedCache <uint256, SHAMapTreeNode>
+ShardedTaggedCache <uint256, SHAMapTreeNode>
     SHAMap::treeNodeCache ("TreeNodeCache", 65536, 60,
         get_seconds_clock (),
-            LogPartition::getJournal <TaggedCacheLog> ());
+            LogPartition::getJournal <TaggedCacheLog> (),
+                beast::insight::NullCollector::New (),
+                    std::mem_fn (&SHAMapTreeNode::getMemoryUsage));
 
 SHAMap::~SHAMap ()
 {
     mState = smsInvalid;
 
-    logTimedDestroy <SHAMap> (mTNByID,
-        beast::String ("mTNByID with ") +
-            beast::String::fromNumber (mTNByID.size ()) + " items");
-
-    if (mDirtyNodes)
+    if (root)
     {
-        logTimedDestroy <SHAMap> (mDirtyNodes,
-            beast::String ("mDirtyNodes with ") +
-                beast::String::fromNumber (mDirtyNodes->size ()) + " items");
+        logTimedDestroy <SHAMap> (root,
+            beast::String ("root node"));
     }
+}
+
+std::size_t SHAMap::size () const
+{
+    std::size_t count = 0;
+    std::stack<SHAMapTreeNode*> stack;
+
+    ScopedReadLockType sl (mLock);
 
     if (root)
+        stack.push (root.get ());
+
+    while (!stack.empty ())
     {
-        logTimedDestroy <SHAMap> (root,
-            beast::String ("root node"));
+        SHAMapTreeNode* node = stack.top ();
+        stack.pop ();
+        ++count;
+
+        if (node->isInner ())
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                SHAMapTreeNode* child = node->getChildPointer (i);
+
+                if (child)
+                    stack.push (child);
+            }
+        }
     }
+
+    return count;
 }
 
 void SHAMapNode::setMHash () const
@@ -120,28 +143,50 @@ SHAMap::pointer SHAMap::snapShot (bool isMutable)
         std::ref (m_fullBelowCache));
     SHAMap& newMap = *ret;
 
+    // The snapshot must not share nodes whose hashes we have yet to update
+    updateHashes ();
+
     // Return a new SHAMap that is a snapshot of this one
-    // Initially most nodes are shared and CoW is forced where needed
+    // Initially all nodes are shared and CoW is forced where needed
     {
         ScopedReadLockType sl (mLock);
         newMap.mSeq = mSeq;
-        newMap.mTNByID = mTNByID;
         newMap.root = root;
 
         if (!isMutable)
             newMap.mState = smsImmutable;
 
-        // If the existing map has any nodes it might modify, unshare ours now
+        // If the existing map has any nodes it might modify, unshare ours now.
+        // A node we own can only be below another node we own, so we only
+        // need to walk the part of the tree this map has modified.
         if (mState != smsImmutable)
         {
-            BOOST_FOREACH(NodeMap::value_type& nodeIt, mTNByID.peekMap())
+            if (root->getSeq () == mSeq)
             {
-                if (nodeIt.second->getSeq() == mSeq)
-                { // We might modify this node, so duplicate it in the snapShot
-                    SHAMapTreeNode::pointer newNode = boost::make_shared<SHAMapTreeNode> (*nodeIt.second, mSeq);
-                    newMap.mTNByID.replace (*newNode, newNode);
-                    if (newNode->isRoot ())
-                        newMap.root = newNode;
+                std::stack<SHAMapTreeNode*> stack;
+
+                newMap.root = boost::make_shared<SHAMapTreeNode> (*root, mSeq);
+                stack.push (newMap.root.get ());
+
+                while (!stack.empty ())
+                {
+                    SHAMapTreeNode* node = stack.top ();
+                    stack.pop ();
+
+                    if (!node->isInner ())
+                        continue;
+
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        SHAMapTreeNode* child = node->getChildPointer (i);
+
+                        if (child && (child->getSeq () == mSeq))
+                        { // We might modify this node, so duplicate it in the snapShot
+                            SHAMapTreeNode::pointer newNode = boost::make_shared<SHAMapTreeNode> (*child, mSeq);
+                            node->shareChild (i, newNode);
+                            stack.push (newNode.get ());
+                        }
+                    }
                 }
             }
         }
@@ -171,7 +216,7 @@ std::stack<SHAMapTreeNode::pointer> SHAMap::getStack (uint256 const& id, bool in
 
         try
         {
-            node = getNode (node->getChildNodeID (branch), node->getChildHash (branch), false);
+            node = descendThrow (node, branch);
         }
         catch (SHAMapMissingNode& mn)
         {
@@ -186,10 +231,12 @@ std::stack<SHAMapTreeNode::pointer> SHAMap::getStack (uint256 const& id, bool in
     return stack;
 }
 
-void SHAMap::dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const& target, uint256 prevHash)
+void SHAMap::dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const& target,
+                      SHAMapTreeNode::pointer child)
 {
     // walk the tree up from through the inner nodes to the root
-    // update linking hashes and add nodes to dirty list
+    // update linking hashes and hook up the (possibly new) children
+    // if hashing is deferred, just mark the nodes stale
 
     assert ((mState != smsSynching) && (mState != smsImmutable));
 
@@ -204,7 +251,7 @@ void SHAMap::dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const&
 
         returnNode (node, true);
 
-        if (!node->setChildHash (branch, prevHash))
+        if (!setChild (node.get (), branch, child))
         {
             WriteLog (lsFATAL, SHAMap) << "dirtyUp terminates early";
             assert (false);
@@ -212,52 +259,463 @@ void SHAMap::dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const&
         }
 
 #ifdef ST_DEBUG
-        WriteLog (lsTRACE, SHAMap) << "dirtyUp sets branch " << branch << " to " << prevHash;
+        WriteLog (lsTRACE, SHAMap) << "dirtyUp sets branch " << branch << " to " << child->getNodeHash ();
 #endif
-        prevHash = node->getNodeHash ();
-        assert (prevHash.isNonZero ());
+        child = node;
+        assert (mDeferHash || child->getNodeHash ().isNonZero ());
     }
 }
 
-SHAMapTreeNode::pointer SHAMap::checkCacheNode (const SHAMapNode& iNode)
+// Change a branch of a node we own, returns true if the node's hash changed
+// (or may have changed, if hashing is deferred)
+bool SHAMap::setChild (SHAMapTreeNode* node, int branch, SHAMapTreeNode::ref child)
 {
-    SHAMapTreeNode::pointer ret = mTNByID.retrieve(iNode);
-    if (ret && (ret->getSeq()!= 0))
-        ret->touch (mSeq);
-    return ret;
+    if (mDeferHash)
+    {
+        node->setChildDeferHash (branch, child);
+        return true;
+    }
+
+    return node->setChild (branch, child ? child->getNodeHash () : uint256 (), child);
 }
 
-SHAMapTreeNode::pointer SHAMap::walkTo (uint256 const& id, bool modify)
+/** Update the stale hashes of a node and the nodes below it.
+    Stale nodes are always owned by the map, and a stale node's parent is
+    also stale, so only the part of the tree that was modified is walked.
+    The nodes are hashed a level at a time, deepest first, so each level
+    can be hashed as a batch.
+*/
+void SHAMap::rehash (SHAMapTreeNode* node)
 {
-    // walk down to the terminal node for this ID
+    if (!node->isHashStale ())
+        return;
 
-    SHAMapTreeNode::pointer inNode = root;
+    std::vector<std::vector<SHAMapTreeNode*> > levels;
+    std::stack<SHAMapTreeNode*> stack;
+    stack.push (node);
 
-    while (!inNode->isLeaf ())
+    while (!stack.empty ())
     {
-        int branch = inNode->selectBranch (id);
+        node = stack.top ();
+        stack.pop ();
 
-        if (inNode->isEmptyBranch (branch))
-            return inNode;
+        std::size_t const level = node->getDepth ();
 
-        try
+        if (level >= levels.size ())
+            levels.resize (level + 1);
+
+        levels[level].push_back (node);
+
+        for (int i = 0; i < 16; ++i)
         {
-            inNode = getNode (inNode->getChildNodeID (branch), inNode->getChildHash (branch), false);
+            SHAMapTreeNode* child = node->getChildPointer (i);
+
+            if (child && child->isHashStale ())
+                stack.push (child);
         }
-        catch (SHAMapMissingNode& mn)
+    }
+
+    for (auto it = levels.rbegin (); it != levels.rend (); ++it)
+        SHAMapTreeNode::updateStaleHashes (*it);
+}
+
+/** Stale subtrees being hashed in parallel.
+    Each thread that joins in takes subtrees until none are left, so the
+    work completes even if none of the jobs we queued get to run.
+*/
+struct SHAMap::RehashJobs
+{
+    std::vector<SHAMapTreeNode*> nodes;
+    std::atomic<std::size_t> next;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::size_t remaining;
+
+    explicit RehashJobs (std::vector<SHAMapTreeNode*> const& n)
+        : nodes (n)
+        , next (0)
+        , remaining (n.size ())
+    {
+    }
+
+    void run ()
+    {
+        for (std::size_t i = next++; i < nodes.size (); i = next++)
         {
-            mn.setTargetNode (id);
-            throw;
+            SHAMap::rehash (nodes[i]);
+
+            std::lock_guard <std::mutex> sl (lock);
+
+            if (--remaining == 0)
+                cond.notify_all ();
+        }
+    }
+
+    void wait ()
+    {
+        std::unique_lock <std::mutex> sl (lock);
+
+        while (remaining != 0)
+            cond.wait (sl);
+    }
+};
+
+void SHAMap::updateHashes (JobQueue* jobQueue)
+{
+    if (!mDeferHash)
+        return;
+
+    ScopedWriteLockType sl (mLock);
+
+    if (!root->isHashStale ())
+        return;
+
+    if (jobQueue != nullptr)
+    {
+        // The subtrees of the root do not share any stale nodes
+        std::vector<SHAMapTreeNode*> nodes;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            SHAMapTreeNode* child = root->getChildPointer (i);
+
+            if (child && child->isHashStale ())
+                nodes.push_back (child);
+        }
+
+        if (nodes.size () > 1)
+        {
+            boost::shared_ptr<RehashJobs> jobs = boost::make_shared<RehashJobs> (nodes);
+
+            for (std::size_t i = 1; i < nodes.size (); ++i)
+                jobQueue->addJob (jtACCEPT, "rehashTree",
+                    BIND_TYPE (&RehashJobs::run, jobs));
+
+            jobs->run ();
+            jobs->wait ();
+        }
+    }
+
+    rehash (root.get ());
+}
+
+/** Subtrees being walked in parallel.
+    As with RehashJobs, each thread that joins in takes subtrees until none
+    are left. The calling thread also works while it waits, so the walk
+    completes even if none of the jobs we queued get to run.
+    In ordered mode the jobs stay within a window of subtrees ahead of the
+    one the caller is taking, so finished work doesn't pile up.
+*/
+struct SHAMap::WalkJobs
+{
+    std::function<void (std::size_t)> work;
+    std::size_t count;
+    std::size_t window;
+    bool noCache;                   // Keep the jobs out of the node cache too
+
+    std::atomic<std::size_t> next;
+    std::atomic<bool> stop;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::vector<char> done;
+    std::size_t taken;              // Subtrees the caller has taken
+    std::size_t remaining;
+    std::exception_ptr error;
+
+    WalkJobs (std::function<void (std::size_t)> const& w, std::size_t c, std::size_t win)
+        : work (w)
+        , count (c)
+        , window (win)
+        , noCache (NodeStore::Database::ScopedNoCache::active ())
+        , next (0)
+        , stop (false)
+        , done (c, 0)
+        , taken (0)
+        , remaining (c)
+    {
+    }
+
+    // Returns `false` if there was no subtree left to work on
+    bool runOne (bool helper)
+    {
+        std::size_t const i = next++;
+
+        if (i >= count)
+            return false;
+
+        if (helper)
+        {
+            std::unique_lock <std::mutex> sl (lock);
+
+            while (!stop && (i >= taken + window))
+                cond.wait (sl);
         }
+
+        if (!stop)
+        {
+            try
+            {
+                work (i);
+            }
+            catch (...)
+            {
+                std::lock_guard <std::mutex> sl (lock);
+
+                if (!error)
+                    error = std::current_exception ();
+
+                stop = true;
+            }
+        }
+
+        std::lock_guard <std::mutex> sl (lock);
+        done[i] = 1;
+        --remaining;
+        cond.notify_all ();
+        return true;
     }
 
-    if (inNode->getTag () != id)
-        return SHAMapTreeNode::pointer ();
+    void run (Job&)
+    {
+        if (noCache)
+        {
+            NodeStore::Database::ScopedNoCache scope;
 
-    if (modify)
-        returnNode (inNode, true);
+            while (runOne (true))
+                ;
+        }
+        else
+        {
+            while (runOne (true))
+                ;
+        }
+    }
+
+    // Wait for one subtree to be done, working on others meanwhile.
+    // Returns `false` if the walk failed.
+    bool waitFor (std::size_t i)
+    {
+        for (;;)
+        {
+            {
+                std::lock_guard <std::mutex> sl (lock);
+
+                if (done[i])
+                    return !error;
+            }
+
+            if (!runOne (false))
+            {
+                std::unique_lock <std::mutex> sl (lock);
+
+                while (!done[i])
+                    cond.wait (sl);
+
+                return !error;
+            }
+        }
+    }
 
-    return inNode;
+    void take ()
+    {
+        std::lock_guard <std::mutex> sl (lock);
+        ++taken;
+        cond.notify_all ();
+    }
+
+    // Leave the remaining subtrees alone and wait for the ones in progress
+    void finish (bool abandon)
+    {
+        if (abandon)
+        {
+            std::lock_guard <std::mutex> sl (lock);
+            stop = true;
+            cond.notify_all ();
+        }
+
+        while (runOne (false))
+            ;
+
+        std::unique_lock <std::mutex> sl (lock);
+
+        while (remaining != 0)
+            cond.wait (sl);
+    }
+};
+
+void SHAMap::runWalkJobs (std::size_t count, std::function<void (std::size_t)> const& work,
+                          std::function<void (std::size_t)> const& take, JobQueue* jobQueue)
+{
+    std::size_t const jobs = std::min<std::size_t> (count,
+        std::max (1, static_cast<int> (std::thread::hardware_concurrency ())));
+
+    // Without a take function nothing waits for the caller. With one, the
+    // work done ahead of it is held, so only a few subtrees may be.
+    boost::shared_ptr<WalkJobs> walk = boost::make_shared<WalkJobs> (
+        work, count, take ? (jobs * traverseOrderedAheadPerJob) : count);
+
+    if (jobQueue != nullptr)
+    {
+        for (std::size_t i = 1; i < jobs; ++i)
+            jobQueue->addJob (jtTRAVERSE, "walkMap",
+                BIND_TYPE (&WalkJobs::run, walk, P_1));
+    }
+
+    if (take)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!walk->waitFor (i))
+                break;
+
+            try
+            {
+                take (i);
+            }
+            catch (...)
+            {
+                walk->finish (true);
+                throw;
+            }
+
+            walk->take ();
+        }
+    }
+
+    walk->finish (false);
+
+    if (walk->error)
+        std::rethrow_exception (walk->error);
+}
+
+std::vector<SHAMapTreeNode::pointer> SHAMap::getSubtrees (bool ordered, JobQueue* jobQueue)
+{
+    std::vector<SHAMapTreeNode::pointer> subtrees;
+
+    if (!root || root->isEmpty ())
+        return subtrees;
+
+    subtrees.push_back (root);
+
+    if (jobQueue == nullptr)
+        return subtrees;
+
+    std::size_t const target =
+        (ordered ? traverseOrderedSubtreesPerJob : traverseSubtreesPerJob) *
+        std::max (1, static_cast<int> (std::thread::hardware_concurrency ()));
+
+    // Split a level at a time, so the subtrees stay in key order
+    bool split = true;
+
+    while (split && (subtrees.size () < target))
+    {
+        std::vector<SHAMapTreeNode::pointer> next;
+        split = false;
+
+        BOOST_FOREACH (SHAMapTreeNode::ref node, subtrees)
+        {
+            if (!node->isInner ())
+            {
+                next.push_back (node);
+                continue;
+            }
+
+            SHAMapTreeNode::pointer children[16];
+            getChildren (node, children);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                if (children[i])
+                    next.push_back (children[i]);
+            }
+
+            split = true;
+        }
+
+        subtrees.swap (next);
+    }
+
+    return subtrees;
+}
+
+void SHAMap::walkSubtrees (std::vector<SHAMapTreeNode::pointer> const& subtrees,
+                           std::function<void (std::size_t, SHAMapItem::ref)> const& function,
+                           bool ordered, JobQueue* jobQueue)
+{
+    // In ordered mode the items are kept until the caller takes the subtree
+    std::vector <std::vector <SHAMapItem::pointer>> items (ordered ? subtrees.size () : 0);
+
+    auto const work = [&] (std::size_t i)
+    {
+        std::stack<SHAMapTreeNode::pointer> stack;
+        stack.push (subtrees[i]);
+
+        while (!stack.empty ())
+        {
+            SHAMapTreeNode::pointer const node = stack.top ();
+            stack.pop ();
+
+            if (node->isLeaf ())
+            {
+                if (ordered)
+                    items[i].push_back (node->peekItem ());
+                else
+                    function (i, node->peekItem ());
+            }
+            else
+            {
+                SHAMapTreeNode::pointer children[16];
+                getChildren (node, children);
+
+                // Pushed last to first, so they come off in key order
+                for (int branch = 15; branch >= 0; --branch)
+                {
+                    if (children[branch])
+                        stack.push (children[branch]);
+                }
+            }
+        }
+    };
+
+    auto const take = [&] (std::size_t i)
+    {
+        std::vector <SHAMapItem::pointer> subtree;
+        subtree.swap (items[i]);
+
+        BOOST_FOREACH (SHAMapItem::ref item, subtree)
+            function (i, item);
+    };
+
+    if (ordered)
+        runWalkJobs (subtrees.size (), work, take, jobQueue);
+    else
+        runWalkJobs (subtrees.size (), work, std::function<void (std::size_t)> (), jobQueue);
+}
+
+void SHAMap::visitLeavesParallel (std::function<void (SHAMapItem::ref)> const& function,
+                                  bool ordered, JobQueue* jobQueue)
+{
+    // Make a snapshot of this map so we don't need to hold
+    // a lock on the map we're visiting
+    SHAMap::pointer const map (snapShot (false));
+
+    map->walkSubtrees (map->getSubtrees (ordered, jobQueue),
+        [&] (std::size_t, SHAMapItem::ref item)
+        {
+            function (item);
+        }, ordered, jobQueue);
+}
+
+uint256 SHAMap::getHash () const
+{
+    if (mDeferHash)
+    {
+        ScopedWriteLockType sl (mLock);
+        rehash (root.get ());
+    }
+
+    return root->getNodeHash ();
 }
 
 SHAMapTreeNode* SHAMap::walkToPointer (uint256 const& id)
@@ -271,89 +729,97 @@ SHAMapTreeNode* SHAMap::walkToPointer (uint256 const& id)
         if (inNode->isEmptyBranch (branch))
             return nullptr;
 
-        inNode = getNodePointer (inNode->getChildNodeID (branch), inNode->getChildHash (branch));
+        inNode = descendThrow (inNode, branch);
         assert (inNode);
     }
 
     return (inNode->getTag () == id) ? inNode : nullptr;
 }
 
-SHAMapTreeNode::pointer SHAMap::getNode (const SHAMapNode& id, uint256 const& hash, bool modify)
+SHAMapTreeNode* SHAMap::descend (SHAMapTreeNode* parent, int branch)
 {
-    // retrieve a node whose node hash is known
-    SHAMapTreeNode::pointer node = checkCacheNode (id);
+    // fast, but you do not hold a reference
+    SHAMapTreeNode* ret = parent->getChildPointer (branch);
 
-    if (node)
-    {
-#if BEAST_DEBUG
+    if (ret)
+        return ret;
 
-        if (node->getNodeHash () != hash)
-        {
-            WriteLog (lsFATAL, SHAMap) << "Attempt to get node, hash not in tree";
-            WriteLog (lsFATAL, SHAMap) << "ID: " << id;
-            WriteLog (lsFATAL, SHAMap) << "TgtHash " << hash;
-            WriteLog (lsFATAL, SHAMap) << "NodHash " << node->getNodeHash ();
-            throw std::runtime_error ("invalid node");
-        }
+    SHAMapTreeNode::pointer node = fetchNodeExternalNT (
+        parent->getChildNodeID (branch), parent->getChildHash (branch));
 
-#endif
-        returnNode (node, modify);
-        return node;
-    }
+    if (!node)
+        return nullptr;
 
-    return fetchNodeExternal (id, hash);
+    // Make sure all threads get the same node
+    parent->canonicalizeChild (branch, node);
+    return node.get ();
 }
 
-SHAMapTreeNode* SHAMap::getNodePointer (const SHAMapNode& id, uint256 const& hash)
+SHAMapTreeNode* SHAMap::descendThrow (SHAMapTreeNode* parent, int branch)
 {
-    // fast, but you do not hold a reference
-    SHAMapTreeNode* ret = getNodePointerNT (id, hash);
+    SHAMapTreeNode* ret = descend (parent, branch);
 
     if (!ret)
-        throw (SHAMapMissingNode (mType, id, hash));
+        throw (SHAMapMissingNode (mType, parent->getChildNodeID (branch),
+                                  parent->getChildHash (branch)));
 
     return ret;
 }
 
-SHAMapTreeNode* SHAMap::getNodePointerNT (const SHAMapNode& id, uint256 const& hash)
+SHAMapTreeNode::pointer SHAMap::descendThrow (SHAMapTreeNode::ref parent, int branch)
 {
-    SHAMapTreeNode::pointer ret = mTNByID.retrieve (id);
+    SHAMapTreeNode::pointer ret = parent->getChild (branch);
+
     if (!ret)
-        ret = fetchNodeExternalNT (id, hash);
-    return ret ? ret.get() : nullptr;
+    {
+        ret = fetchNodeExternal (parent->getChildNodeID (branch), parent->getChildHash (branch));
+        parent->canonicalizeChild (branch, ret);
+    }
+
+    return ret;
 }
 
-SHAMapTreeNode* SHAMap::getNodePointer (const SHAMapNode& id, uint256 const& hash, SHAMapSyncFilter* filter)
+SHAMapTreeNode::pointer SHAMap::descendNoStore (SHAMapTreeNode::ref parent, int branch)
 {
-    SHAMapTreeNode* ret = getNodePointerNT (id, hash, filter);
+    SHAMapTreeNode::pointer ret = parent->getChild (branch);
 
     if (!ret)
-        throw (SHAMapMissingNode (mType, id, hash));
+        ret = fetchNodeExternal (parent->getChildNodeID (branch), parent->getChildHash (branch));
 
     return ret;
 }
 
-SHAMapTreeNode* SHAMap::getNodePointerNT (const SHAMapNode& id, uint256 const& hash, SHAMapSyncFilter* filter)
+SHAMapTreeNode* SHAMap::descend (SHAMapTreeNode* parent, int branch, SHAMapSyncFilter* filter)
 {
-    SHAMapTreeNode* node = getNodePointerNT (id, hash);
+    SHAMapTreeNode* ret = descend (parent, branch);
 
-    if (!node && filter)
+    if (!ret && filter)
     { // Our regular node store didn't have the node. See if the filter does
-        Blob nodeData;
+        SHAMapTreeNode::pointer node = checkFilter (
+            parent->getChildNodeID (branch), parent->getChildHash (branch), filter);
 
-        if (filter->haveNode (id, hash, nodeData))
+        if (node)
         {
-            SHAMapTreeNode::pointer node = boost::make_shared<SHAMapTreeNode> (
-                    boost::cref (id), boost::cref (nodeData), 0, snfPREFIX, boost::cref (hash), true);
-            canonicalize (hash, node);
+            parent->canonicalizeChild (branch, node);
+            ret = node.get ();
+        }
+    }
 
-            // Canonicalize the node with mTNByID to make sure all threads gets the same node
-            // If the node is new, tell the filter
-            if (mTNByID.canonicalize (id, &node))
-                filter->gotNode (true, id, hash, nodeData, node->getType ());
+    return ret;
+}
 
-            return node.get ();
-        }
+SHAMapTreeNode::pointer SHAMap::checkFilter (const SHAMapNode& id, uint256 const& hash,
+                                             SHAMapSyncFilter* filter)
+{
+    SHAMapTreeNode::pointer node;
+    Blob nodeData;
+
+    if (filter->haveNode (id, hash, nodeData))
+    {
+        node = boost::make_shared<SHAMapTreeNode> (
+                boost::cref (id), boost::cref (nodeData), 0, snfPREFIX, boost::cref (hash), true);
+        canonicalize (hash, node);
+        filter->gotNode (true, id, hash, nodeData, node->getType ());
     }
 
     return node;
@@ -374,24 +840,12 @@ void SHAMap::returnNode(SHAMapTreeNode::pointer& node, bool modify)
 		node = boost::make_shared<SHAMapTreeNode>(*node, mSeq); // here's to the new node, same as the old node
 		assert(node->isValid());
 
-		mTNByID.replace(*node, node);
-
+		// The caller hooks the new node into its parent
 		if (node->isRoot())
 			root = node;
-
-		if (mDirtyNodes)
-			mDirtyNodes->insert(*node);
 	}
 }
 
-
-void SHAMap::trackNewNode (SHAMapTreeNode::pointer& node)
-{
-    assert (node->getSeq() == mSeq);
-    if (mDirtyNodes)
-        mDirtyNodes->insert (*node);
-}
-
 SHAMapTreeNode* SHAMap::firstBelow (SHAMapTreeNode* node)
 {
     // Return the first item below this node
@@ -406,7 +860,7 @@ SHAMapTreeNode* SHAMap::firstBelow (SHAMapTreeNode* node)
         for (int i = 0; i < 16; ++i)
             if (!node->isEmptyBranch (i))
             {
-                node = getNodePointer (node->getChildNodeID (i), node->getChildHash (i));
+                node = descendThrow (node, i);
                 foundNode = true;
                 break;
             }
@@ -427,10 +881,10 @@ SHAMapTreeNode* SHAMap::lastBelow (SHAMapTreeNode* node)
 
         bool foundNode = false;
 
-        for (int i = 15; i >= 0; ++i)
+        for (int i = 15; i >= 0; --i)
             if (!node->isEmptyBranch (i))
             {
-                node = getNodePointer (node->getChildNodeID (i), node->getChildHash (i));
+                node = descendThrow (node, i);
                 foundNode = true;
                 break;
             }
@@ -454,7 +908,7 @@ SHAMapItem::pointer SHAMap::onlyBelow (SHAMapTreeNode* node)
                 if (nextNode)
                     return SHAMapItem::pointer (); // two leaves below
 
-                nextNode = getNodePointer (node->getChildNodeID (i), node->getChildHash (i));
+                nextNode = descendThrow (node, i);
             }
 
         if (!nextNode)
@@ -471,40 +925,6 @@ SHAMapItem::pointer SHAMap::onlyBelow (SHAMapTreeNode* node)
     return node->peekItem ();
 }
 
-void SHAMap::eraseChildren (SHAMapTreeNode::pointer node)
-{
-    // this node has only one item below it, erase its children
-    bool erase = false;
-
-    while (node->isInner ())
-    {
-        for (int i = 0; i < 16; ++i)
-            if (!node->isEmptyBranch (i))
-            {
-                SHAMapTreeNode::pointer nextNode = getNode (node->getChildNodeID (i), node->getChildHash (i), false);
-
-                if (erase)
-                {
-                    returnNode (node, true);
-
-                    if (mTNByID.erase (*node))
-                        assert (false);
-                }
-
-                erase = true;
-                node = nextNode;
-                break;
-            }
-    }
-
-    returnNode (node, true);
-
-    if (mTNByID.erase (*node) == 0)
-        assert (false);
-
-    return;
-}
-
 static const SHAMapItem::pointer no_item;
 
 SHAMapItem::pointer SHAMap::peekFirstItem ()
@@ -575,7 +995,7 @@ SHAMapItem::pointer SHAMap::peekNextItem (uint256 const& id, SHAMapTreeNode::TNT
             for (int i = node->selectBranch (id) + 1; i < 16; ++i)
                 if (!node->isEmptyBranch (i))
                 {
-                    SHAMapTreeNode* firstNode = getNodePointer (node->getChildNodeID (i), node->getChildHash (i));
+                    SHAMapTreeNode* firstNode = descendThrow (node.get (), i);
                     assert (firstNode);
                     firstNode = firstBelow (firstNode);
 
@@ -614,8 +1034,7 @@ SHAMapItem::pointer SHAMap::peekPrevItem (uint256 const& id)
             {
                 if (!node->isEmptyBranch (i))
                 {
-                    node = getNode (node->getChildNodeID (i), node->getChildHash (i), false);
-                    SHAMapTreeNode* item = firstBelow (node.get ());
+                    SHAMapTreeNode* item = lastBelow (descendThrow (node.get (), i));
 
                     if (!item)
                         throw (std::runtime_error ("missing node"));
@@ -696,12 +1115,10 @@ bool SHAMap::delItem (uint256 const& id)
         return false;
 
     SHAMapTreeNode::TNType type = leaf->getType ();
-    returnNode (leaf, true);
-
-    if (mTNByID.erase (*leaf) == 0)
-        assert (false);
 
-    uint256 prevHash;
+    // What gets attached to the end of the chain
+    // (For now, nothing, since we deleted the leaf)
+    SHAMapTreeNode::pointer prevNode;
 
     while (!stack.empty ())
     {
@@ -710,7 +1127,7 @@ bool SHAMap::delItem (uint256 const& id)
         returnNode (node, true);
         assert (node->isInner ());
 
-        if (!node->setChildHash (node->selectBranch (id), prevHash))
+        if (!setChild (node.get (), node->selectBranch (id), prevNode))
         {
             assert (false);
             return true;
@@ -723,10 +1140,7 @@ bool SHAMap::delItem (uint256 const& id)
 
             if (bc == 0)
             {
-                prevHash = uint256 ();
-
-                if (!mTNByID.erase (*node))
-                    assert (false);
+                prevNode.reset ();
             }
             else if (bc == 1)
             {
@@ -734,19 +1148,15 @@ bool SHAMap::delItem (uint256 const& id)
                 SHAMapItem::pointer item = onlyBelow (node.get ());
 
                 if (item)
-                {
-                    returnNode (node, true);
-                    eraseChildren (node);
                     node->setItem (item, type);
-                }
 
-                prevHash = node->getNodeHash ();
-                assert (prevHash.isNonZero ());
+                prevNode = node;
+                assert (mDeferHash || prevNode->getNodeHash ().isNonZero ());
             }
             else
             {
-                prevHash = node->getNodeHash ();
-                assert (prevHash.isNonZero ());
+                prevNode = node;
+                assert (mDeferHash || prevNode->getNodeHash ().isNonZero ());
             }
         }
         else assert (stack.empty ());
@@ -776,28 +1186,23 @@ bool SHAMap::addGiveItem (SHAMapItem::ref item, bool isTransaction, bool hasMeta
     if (node->isLeaf () && (node->peekItem ()->getTag () == tag))
         return false;
 
-    uint256 prevHash;
     returnNode (node, true);
 
     if (node->isInner ())
     {
         // easy case, we end on an inner node
         int branch = node->selectBranch (tag);
-        assert (node->isEmptyBranch (branch));
-        SHAMapTreeNode::pointer newNode =
-            boost::make_shared<SHAMapTreeNode> (node->getChildNodeID (branch), item, type, mSeq);
 
-        if (!mTNByID.peekMap().emplace (SHAMapNode (*newNode), newNode).second)
+        if (!node->isEmptyBranch (branch))
         {
             WriteLog (lsFATAL, SHAMap) << "Node: " << *node;
-            WriteLog (lsFATAL, SHAMap) << "NewNode: " << *newNode;
-            dump ();
             assert (false);
             throw (std::runtime_error ("invalid inner node"));
         }
 
-        trackNewNode (newNode);
-        node->setChildHash (branch, newNode->getNodeHash ());
+        SHAMapTreeNode::pointer newNode =
+            boost::make_shared<SHAMapTreeNode> (node->getChildNodeID (branch), item, type, mSeq);
+        setChild (node.get (), branch, newNode);
     }
     else
     {
@@ -812,16 +1217,9 @@ bool SHAMap::addGiveItem (SHAMapItem::ref item, bool isTransaction, bool hasMeta
         while ((b1 = node->selectBranch (tag)) == (b2 = node->selectBranch (otherItem->getTag ())))
         {
             // we need a new inner node, since both go on same branch at this level
-            SHAMapTreeNode::pointer newNode =
-                boost::make_shared<SHAMapTreeNode> (mSeq, node->getChildNodeID (b1));
-            newNode->makeInner ();
-
-            if (!mTNByID.peekMap().emplace (SHAMapNode (*newNode), newNode).second)
-                assert (false);
-
             stack.push (node);
-            node = newNode;
-            trackNewNode (node);
+            node = boost::make_shared<SHAMapTreeNode> (mSeq, node->getChildNodeID (b1));
+            node->makeInner ();
         }
 
         // we can add the two leaf nodes here
@@ -829,24 +1227,14 @@ bool SHAMap::addGiveItem (SHAMapItem::ref item, bool isTransaction, bool hasMeta
         SHAMapTreeNode::pointer newNode =
             boost::make_shared<SHAMapTreeNode> (node->getChildNodeID (b1), item, type, mSeq);
         assert (newNode->isValid () && newNode->isLeaf ());
-
-        if (!mTNByID.peekMap().emplace (SHAMapNode (*newNode), newNode).second)
-            assert (false);
-
-        node->setChildHash (b1, newNode->getNodeHash ()); // OPTIMIZEME hash op not needed
-        trackNewNode (newNode);
+        setChild (node.get (), b1, newNode); // OPTIMIZEME hash op not needed
 
         newNode = boost::make_shared<SHAMapTreeNode> (node->getChildNodeID (b2), otherItem, type, mSeq);
         assert (newNode->isValid () && newNode->isLeaf ());
-
-        if (!mTNByID.peekMap().emplace (SHAMapNode (*newNode), newNode).second)
-            assert (false);
-
-        node->setChildHash (b2, newNode->getNodeHash ());
-        trackNewNode (newNode);
+        setChild (node.get (), b2, newNode);
     }
 
-    dirtyUp (stack, tag, node->getNodeHash ());
+    dirtyUp (stack, tag, node);
     return true;
 }
 
@@ -886,7 +1274,7 @@ bool SHAMap::updateGiveItem (SHAMapItem::ref item, bool isTransaction, bool hasM
         return true;
     }
 
-    dirtyUp (stack, tag, node->getNodeHash ());
+    dirtyUp (stack, tag, node);
     return true;
 }
 
@@ -906,21 +1294,25 @@ SHAMapTreeNode::pointer SHAMap::fetchNodeExternal (const SHAMapNode& id, uint256
 }
 
 // Non-blocking version
-SHAMapTreeNode* SHAMap::getNodeAsync (
-    const SHAMapNode& id,
-    uint256 const& hash,
+SHAMapTreeNode* SHAMap::descendAsync (
+    SHAMapTreeNode* parent,
+    int branch,
     SHAMapSyncFilter *filter,
-    bool& pending)
+    bool& pending,
+    NodeStore::Database::FetchWaiter& reads)
 {
     pending = false;
 
-    // If the node is in mTNByID, return it
-    SHAMapTreeNode::pointer ptr = mTNByID.retrieve (id);
-    if (ptr)
-        return ptr.get ();
+    // If the node is already hooked up, return it
+    SHAMapTreeNode* ret = parent->getChildPointer (branch);
+    if (ret)
+        return ret;
+
+    SHAMapNode const id = parent->getChildNodeID (branch);
+    uint256 const& hash = parent->getChildHash (branch);
 
     // Try the tree node cache
-    ptr = getCache (hash, id);
+    SHAMapTreeNode::pointer ptr = getCache (hash, id);
 
     if (!ptr)
     {
@@ -947,7 +1339,7 @@ SHAMapTreeNode* SHAMap::getNodeAsync (
 
             NodeObject::pointer obj;
 
-            if (!getApp().getNodeStore().asyncFetch (hash, obj))
+            if (!getApp().getNodeStore().asyncFetch (hash, obj, reads.callback ()))
             { // We would have to block
                 pending = true;
                 assert (!obj);
@@ -957,35 +1349,154 @@ SHAMapTreeNode* SHAMap::getNodeAsync (
             if (!obj)
                 return nullptr;
 
-            ptr = boost::make_shared <SHAMapTreeNode> (id, obj->getData(), 0, snfPREFIX, hash, true);
-            if (id != *ptr)
+            ptr = boost::make_shared <SHAMapTreeNode> (id, obj->getData(), 0, snfPREFIX, hash, true);
+            if (id != *ptr)
+            {
+                assert (false);
+                return nullptr;
+            }
+        }
+
+        // Put it in the tree node cache
+        canonicalize (hash, ptr);
+    }
+
+    parent->canonicalizeChild (branch, ptr);
+    return ptr.get ();
+}
+
+void SHAMap::fetchChildren (SHAMapTreeNode* parent, int branchMask)
+{
+    // We don't store proposed transaction nodes in the node store
+    if (mTXMap || !getApp().running ())
+        return;
+
+    std::vector <int> branches;
+    std::vector <uint256> hashes;
+
+    for (int branch = 0; branch < 16; ++branch)
+    {
+        if (((branchMask & (1 << branch)) == 0) ||
+            parent->isEmptyBranch (branch) || parent->getChildPointer (branch))
+            continue;
+
+        uint256 const& hash = parent->getChildHash (branch);
+        SHAMapTreeNode::pointer node = getCache (hash, parent->getChildNodeID (branch));
+
+        if (node)
+        {
+            parent->canonicalizeChild (branch, node);
+        }
+        else
+        {
+            branches.push_back (branch);
+            hashes.push_back (hash);
+        }
+    }
+
+    // A single read gains nothing from batching
+    if (hashes.size () < 2)
+        return;
+
+    std::vector <SHAMapTreeNode::pointer> nodes (readChildren (parent, branches, hashes));
+
+    // Nodes we don't have are left for the caller to deal with
+    for (std::size_t i = 0; i < nodes.size (); ++i)
+    {
+        if (nodes[i])
+            parent->canonicalizeChild (branches[i], nodes[i]);
+    }
+}
+
+void SHAMap::getChildren (SHAMapTreeNode::ref parent, SHAMapTreeNode::pointer (&children)[16])
+{
+    std::vector <int> branches;
+    std::vector <uint256> hashes;
+
+    for (int branch = 0; branch < 16; ++branch)
+    {
+        if (parent->isEmptyBranch (branch))
+            continue;
+
+        children[branch] = parent->getChild (branch);
+
+        if (!children[branch])
+            children[branch] = getCache (parent->getChildHash (branch),
+                                         parent->getChildNodeID (branch));
+
+        if (!children[branch])
+        {
+            branches.push_back (branch);
+            hashes.push_back (parent->getChildHash (branch));
+        }
+    }
+
+    if (hashes.size () > 1)
+    {
+        std::vector <SHAMapTreeNode::pointer> const nodes (
+            readChildren (parent.get (), branches, hashes));
+
+        for (std::size_t i = 0; i < nodes.size (); ++i)
+            children[branches[i]] = nodes[i];
+    }
+
+    // Anything the batch didn't get is read the usual way, which throws
+    // if the node is missing
+    BOOST_FOREACH (int branch, branches)
+    {
+        if (!children[branch])
+            children[branch] = fetchNodeExternal (parent->getChildNodeID (branch),
+                                                  parent->getChildHash (branch));
+    }
+}
+
+std::vector<SHAMapTreeNode::pointer> SHAMap::readChildren (SHAMapTreeNode* parent,
+        std::vector<int> const& branches, std::vector<uint256> const& hashes)
+{
+    std::vector <SHAMapTreeNode::pointer> nodes (hashes.size ());
+
+    // We don't store proposed transaction nodes in the node store
+    if (mTXMap || !getApp().running ())
+        return nodes;
+
+    std::vector <NodeObject::pointer> const objects (
+        getApp ().getNodeStore ().fetchBatch (hashes));
+
+    for (std::size_t i = 0; i < objects.size (); ++i)
+    {
+        if (!objects[i])
+            continue;
+
+        SHAMapNode const id (parent->getChildNodeID (branches[i]));
+
+        try
+        {
+            SHAMapTreeNode::pointer node = boost::make_shared<SHAMapTreeNode> (
+                id, objects[i]->getData (), 0, snfPREFIX, hashes[i], true);
+
+            if (id != *node)
             {
+                WriteLog (lsFATAL, SHAMap) << "id:" << id << ", got:" << *node;
                 assert (false);
-                return nullptr;
+                continue;
             }
-        }
-
-        // Put it in the tree node cache
-        canonicalize (hash, ptr);
-    }
 
-    if (id.isRoot ())
-    {
-		// JED: wtf?
-        // It is legal to replace the root
-        mTNByID.replace (id, ptr);
-        root = ptr;
+            canonicalize (hashes[i], node);
+            nodes[i] = node;
+        }
+        catch (...)
+        {
+            WriteLog (lsWARNING, SHAMap) << "readChildren gets an invalid node: " << hashes[i];
+        }
     }
-    else
-        mTNByID.canonicalize (id, &ptr);
 
-    return ptr.get ();
+    return nodes;
 }
 
 /** Look at the cache and back end (things external to this SHAMap) to
-    find a tree node. Only a read lock is required because mTNByID has its
-    own, internal synchronization. Every thread calling this function must
-    get a shared pointer to the same underlying node.
+    find a tree node. The caller is responsible for hooking the node into
+    its parent. Every thread calling this function gets a shared pointer
+    to the node in the TreeNodeCache, if there is one.
     This function does not throw.
 */
 SHAMapTreeNode::pointer SHAMap::fetchNodeExternalNT (const SHAMapNode& id, uint256 const& hash)
@@ -1046,13 +1557,6 @@ SHAMapTreeNode::pointer SHAMap::fetchNodeExternalNT (const SHAMapNode& id, uint2
         }
     }
 
-    if (id.isRoot ()) // it is legal to replace an existing root
-    {
-        mTNByID.replace(id, ret);
-        root = ret;
-    }
-    else // Make sure other threads get pointers to the same underlying object
-       mTNByID.canonicalize (id, &ret);
     return ret;
 }
 
@@ -1072,7 +1576,7 @@ bool SHAMap::fetchRoot (uint256 const& hash, SHAMapSyncFilter* filter)
     }
 
     SHAMapTreeNode::pointer newRoot = fetchNodeExternalNT(SHAMapNode(), hash);
-    
+
     if (newRoot)
     {
         root = newRoot;
@@ -1086,7 +1590,6 @@ bool SHAMap::fetchRoot (uint256 const& hash, SHAMapSyncFilter* filter)
 
         root = boost::make_shared<SHAMapTreeNode> (SHAMapNode (), nodeData,
                 mSeq - 1, snfPREFIX, hash, true);
-        mTNByID.replace(*root, root);
         filter->gotNode (true, SHAMapNode (), hash, nodeData, root->getType ());
     }
 
@@ -1094,111 +1597,134 @@ bool SHAMap::fetchRoot (uint256 const& hash, SHAMapSyncFilter* filter)
     return true;
 }
 
-/** Begin saving dirty nodes to be written later */
-int SHAMap::armDirty ()
+/** Make a modified node shareable and write it to the node store.
+    The node must be owned by this map.
+*/
+SHAMapTreeNode::pointer SHAMap::writeNode (NodeObjectType t, std::uint32_t seq,
+                                           SHAMapTreeNode::pointer node, Serializer& s)
 {
-    mDirtyNodes = boost::make_shared <DirtySet> ();
-    return ++mSeq;
-}
+    assert (node->getSeq () == mSeq);
 
-/** Write all modified nodes to the node store */
-int SHAMap::flushDirty (DirtySet& set, int maxNodes, NodeObjectType t, std::uint32_t seq)
-{
-    int flushed = 0;
-    Serializer s;
+    uint256 const nodeHash = node->getNodeHash ();
 
-    ScopedWriteLockType sl (mLock);
+    s.erase ();
+    node->addRaw (s, snfPREFIX);
+
+#ifdef BEAST_DEBUG
 
-    for (DirtySet::iterator it = set.begin (); it != set.end (); it = set.erase (it))
+    if (s.getSHA512Half () != nodeHash)
     {
-        SHAMapTreeNode::pointer node = checkCacheNode (*it);
+        WriteLog (lsFATAL, SHAMap) << *node;
+        WriteLog (lsFATAL, SHAMap) << beast::lexicalCast <std::string> (s.getDataLength ());
+        WriteLog (lsFATAL, SHAMap) << s.getSHA512Half () << " != " << nodeHash;
+        assert (false);
+    }
 
-        // Check if node was deleted
-        if (!node)
-            continue;
+#endif
 
-        uint256 const nodeHash = node->getNodeHash();
+    // No other map can see this node, so we can make it shareable in place
+    node->setSeq (0);
+    canonicalize (nodeHash, node);
 
-        s.erase ();
-        node->addRaw (s, snfPREFIX);
+    getApp().getNodeStore ().store (t, seq, std::move (s.modData ()), nodeHash);
 
-#ifdef BEAST_DEBUG
+    return node;
+}
 
-        if (s.getSHA512Half () != nodeHash)
-        {
-            WriteLog (lsFATAL, SHAMap) << *node;
-            WriteLog (lsFATAL, SHAMap) << beast::lexicalCast <std::string> (s.getDataLength ());
-            WriteLog (lsFATAL, SHAMap) << s.getSHA512Half () << " != " << nodeHash;
-            assert (false);
-        }
+/** Write all modified nodes to the node store.
+    Nodes are written children first so that a shareable node never
+    points to a node that may still be modified.
+*/
+int SHAMap::flushDirty (NodeObjectType t, std::uint32_t seq)
+{
+    int flushed = 0;
+    Serializer s;
 
-#endif
+    ScopedWriteLockType sl (mLock);
 
-        if (node->getSeq () != 0)
-        {
-            // Node is not shareable
-            // Make and share a shareable copy
-            node = boost::make_shared <SHAMapTreeNode> (*node, 0);
-            canonicalize (node->getNodeHash(), node);
-            mTNByID.replace (*node, node);
-        }
+    if (!root || (root->getSeq () == 0) || root->isEmpty ())
+        return flushed;
 
-        getApp().getNodeStore ().store (t, seq, std::move (s.modData ()), nodeHash);
+    // Nodes must be hashed before they can be written
+    rehash (root.get ());
 
-        if (flushed++ >= maxNodes)
-            return flushed;
+    // A node that is not uniquely ours must be copied before we change it.
+    // The map may already be immutable, so this is not a returnNode.
+    if (root->getSeq () != mSeq)
+        root = boost::make_shared<SHAMapTreeNode> (*root, mSeq);
+
+    if (root->isLeaf ())
+    { // special case -- root is leaf
+        root = writeNode (t, seq, root, s);
+        return 1;
     }
 
-    return flushed;
-}
+    // Stack of {parent, branch} pairs for the inner nodes being flushed
+    std::stack<std::pair<SHAMapTreeNode::pointer, int> > stack;
 
-/** Stop saving dirty nodes */
-boost::shared_ptr<SHAMap::DirtySet> SHAMap::disarmDirty ()
-{
-    ScopedWriteLockType sl (mLock);
+    SHAMapTreeNode::pointer node = root;
+    int pos = 0;
 
-    boost::shared_ptr<DirtySet> ret;
-    ret.swap (mDirtyNodes);
-    return ret;
-}
+    while (1)
+    {
+        while (pos < 16)
+        {
+            SHAMapTreeNode::pointer child;
 
-SHAMapTreeNode::pointer SHAMap::getNode (const SHAMapNode& nodeID)
-{
+            if (!node->isEmptyBranch (pos))
+                child = node->getChild (pos);
+
+            if (child && (child->getSeq () != 0))
+            {
+                // Make sure we own the child before we flush it
+                if (child->getSeq () != mSeq)
+                {
+                    child = boost::make_shared<SHAMapTreeNode> (*child, mSeq);
+                    node->shareChild (pos, child);
+                }
+
+                if (child->isInner ())
+                {
+                    // save our place and work on this node
+                    stack.push (std::make_pair (node, pos));
+                    node = child;
+                    pos = 0;
+                    continue;
+                }
 
-    SHAMapTreeNode::pointer node = checkCacheNode (nodeID);
+                node->shareChild (pos, writeNode (t, seq, child, s));
+                ++flushed;
+            }
 
-    if (node)
-        return node;
+            ++pos;
+        }
 
-    node = root;
+        // All of this node's children are flushed, flush the node
+        node = writeNode (t, seq, node, s);
+        ++flushed;
 
-    while (nodeID != *node)
-    {
-        int branch = node->selectBranch (nodeID.getNodeID ());
-        assert (branch >= 0);
+        if (stack.empty ())
+        {
+            root = node;
+            break;
+        }
 
-        if ((branch < 0) || node->isEmptyBranch (branch))
-            return SHAMapTreeNode::pointer ();
+        SHAMapTreeNode::pointer parent = stack.top ().first;
+        pos = stack.top ().second;
+        stack.pop ();
 
-        node = getNode (node->getChildNodeID (branch), node->getChildHash (branch), false);
-        assert (node);
+        parent->shareChild (pos, node);
+        node = parent;
+        ++pos;
     }
 
-    return node;
+    return flushed;
 }
 
 // This function returns NULL if no node with that ID exists in the map
 // It throws if the map is incomplete
 SHAMapTreeNode* SHAMap::getNodePointer (const SHAMapNode& nodeID)
 {
-    SHAMapTreeNode::pointer nodeptr = mTNByID.retrieve (nodeID);
-    if (nodeptr)
-    {
-        SHAMapTreeNode* ret = nodeptr.get ();
-        ret->touch(mSeq);
-        return ret;
-    }
-
     SHAMapTreeNode* node = root.get();
 
     while (nodeID != *node)
@@ -1212,7 +1738,7 @@ SHAMapTreeNode* SHAMap::getNodePointer (const SHAMapNode& nodeID)
         if ((branch < 0) || node->isEmptyBranch (branch))
             return nullptr;
 
-        node = getNodePointer (node->getChildNodeID (branch), node->getChildHash (branch));
+        node = descendThrow (node, branch);
         assert (node);
     }
 
@@ -1239,7 +1765,7 @@ bool SHAMap::getPath (uint256 const& index, std::vector< Blob >& nodes, SHANodeF
         if (inNode->isEmptyBranch (branch)) // paths leads to empty branch
             return false;
 
-        inNode = getNodePointer (inNode->getChildNodeID (branch), inNode->getChildHash (branch));
+        inNode = descendThrow (inNode, branch);
         assert (inNode);
     }
 
@@ -1258,18 +1784,15 @@ void SHAMap::dropCache ()
     ScopedWriteLockType sl (mLock);
     assert (mState == smsImmutable);
 
-    mTNByID.clear ();
-
-    if (root)
-        mTNByID.canonicalize(*root, &root);
-}
-
-void SHAMap::dropBelow (SHAMapTreeNode* d)
-{
-    if (d->isInner ())
-        for (int i = 0 ; i < 16; ++i)
-            if (!d->isEmptyBranch (i))
-                mTNByID.erase (d->getChildNodeID (i));
+    // Only nodes that have been written can be dropped. If the root
+    // has been written, so has everything below it.
+    if (root && root->isInner () && (root->getSeq () == 0))
+    {
+        // The root may be shared, so replace it with a copy that has
+        // no children loaded rather than unhooking them in place
+        root = boost::make_shared<SHAMapTreeNode> (*root, root->getSeq ());
+        root->dropChildren ();
+    }
 }
 
 void SHAMap::dump (bool hash)
@@ -1277,13 +1800,26 @@ void SHAMap::dump (bool hash)
     WriteLog (lsINFO, SHAMap) << " MAP Contains";
     ScopedWriteLockType sl (mLock);
 
-    for (ripple::unordered_map<SHAMapNode, SHAMapTreeNode::pointer, SHAMapNode_hash>::iterator it = mTNByID.peekMap().begin ();
-            it != mTNByID.peekMap().end (); ++it)
+    std::stack<SHAMapTreeNode*> stack;
+    stack.push (root.get ());
+
+    while (!stack.empty ())
     {
-        WriteLog (lsINFO, SHAMap) << it->second->getString ();
-        CondLog (hash, lsINFO, SHAMap) << it->second->getNodeHash ();
-    }
+        SHAMapTreeNode* node = stack.top ();
+        stack.pop ();
+
+        WriteLog (lsINFO, SHAMap) << node->getString ();
+        CondLog (hash, lsINFO, SHAMap) << node->getNodeHash ();
 
+        if (node->isInner ())
+            for (int i = 0; i < 16; ++i)
+            {
+                SHAMapTreeNode* child = node->getChildPointer (i);
+
+                if (child)
+                    stack.push (child);
+            }
+    }
 }
 
 SHAMapTreeNode::pointer SHAMap::getCache (uint256 const& hash, SHAMapNode const& id)
@@ -1298,6 +1834,9 @@ SHAMapTreeNode::pointer SHAMap::getCache (uint256 const& hash, SHAMapNode const&
         ret = boost::make_shared <SHAMapTreeNode> (*ret, 0);
         ret->set(id);
 
+        // The children were hooked up under the other ID
+        ret->dropChildren ();
+
         // Future fetches are likely to use the "new" ID
         treeNodeCache.canonicalize (hash, ret, true);
         assert (*ret == id);
@@ -1320,6 +1859,7 @@ void SHAMap::canonicalize (uint256 const& hash, SHAMapTreeNode::pointer& node)
         // The cache has the node with a different ID
         node = boost::make_shared <SHAMapTreeNode> (*node, 0);
         node->set (id);
+        node->dropChildren ();
 
         // Future fetches are likely to use the newer ID
         treeNodeCache.canonicalize (hash, node, true);
@@ -1344,6 +1884,427 @@ public:
         return vuc;
     }
 
+    // Keys spread over the whole tree, and pairs of keys that differ only
+    // in their last byte, so that some leaves are many levels deep.
+    static std::vector<uint256> makeKeys (int count)
+    {
+        std::vector<uint256> keys;
+
+        for (int i = 0; i < count; ++i)
+        {
+            Serializer s;
+            s.add32 (i);
+            uint256 key = s.getSHA512Half ();
+            keys.push_back (key);
+
+            if ((i % 4) == 0)
+            {
+                *(key.end () - 1) ^= 0x01;
+                keys.push_back (key);
+            }
+        }
+
+        return keys;
+    }
+
+    static SHAMapItem makeItem (uint256 const& key, int value)
+    {
+        return SHAMapItem (key, IntToVUC (value));
+    }
+
+    void testPrevLast (FullBelowCache& fullBelowCache)
+    {
+        testcase ("prev/last");
+
+        SHAMap map (smtFREE, fullBelowCache);
+        std::set<uint256> keys;
+
+        unexpected (!!map.peekLastItem (), "last item of empty map");
+
+        std::vector<uint256> const added (makeKeys (300));
+        for (std::size_t i = 0; i < added.size (); ++i)
+        {
+            map.addItem (makeItem (added[i], i), true, false);
+            keys.insert (added[i]);
+        }
+
+        SHAMapItem::pointer item = map.peekLastItem ();
+        expect (item && (item->getTag () == *keys.rbegin ()), "bad last item");
+
+        // Each key's predecessor, asked both for the key itself and for
+        // the key just after it, which is not in the map.
+        bool prevOk = true;
+        for (auto it = keys.begin (); it != keys.end (); ++it)
+        {
+            item = map.peekPrevItem (*it);
+
+            if (it == keys.begin ())
+                prevOk = prevOk && !item;
+            else
+                prevOk = prevOk && item && (item->getTag () == *std::prev (it));
+
+            uint256 after = *it;
+            ++after;
+
+            if (keys.count (after) == 0)
+            {
+                item = map.peekPrevItem (after);
+                prevOk = prevOk && item && (item->getTag () == *it);
+            }
+        }
+        expect (prevOk, "bad previous item");
+
+        // Walking backwards from the end visits every item in order
+        std::vector<uint256> walked;
+        for (item = map.peekLastItem (); item; item = map.peekPrevItem (item->getTag ()))
+            walked.push_back (item->getTag ());
+        expect (std::equal (walked.begin (), walked.end (), keys.rbegin ()) &&
+            (walked.size () == keys.size ()), "bad reverse traverse");
+
+        // Removing the last items moves the last item back
+        for (int i = 0; i < 10; ++i)
+        {
+            uint256 const last = *keys.rbegin ();
+            map.delItem (last);
+            keys.erase (last);
+
+            item = map.peekLastItem ();
+            expect (item && (item->getTag () == *keys.rbegin ()), "bad last item after delete");
+        }
+    }
+
+    void testSnapshotIsolation (FullBelowCache& fullBelowCache)
+    {
+        testcase ("snapshot isolation");
+
+        SHAMap map (smtFREE, fullBelowCache);
+        std::map<uint256, Blob> items;
+
+        std::vector<uint256> const keys (makeKeys (200));
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            map.addItem (makeItem (keys[i], i), true, false);
+            items[keys[i]] = IntToVUC (i);
+        }
+
+        uint256 const mapHash = map.getHash ();
+        SHAMap::pointer copy = map.snapShot (true);
+
+        // Change, delete and add items in the snapshot only
+        for (std::size_t i = 0; i < keys.size (); i += 3)
+            copy->updateGiveItem (boost::make_shared<SHAMapItem> (
+                makeItem (keys[i], 1000 + i)), true, false);
+
+        for (std::size_t i = 1; i < keys.size (); i += 5)
+            copy->delItem (keys[i]);
+
+        std::vector<uint256> const more (makeKeys (250));
+        for (std::size_t i = keys.size (); i < more.size (); ++i)
+            copy->addItem (makeItem (more[i], i), true, false);
+
+        expect (copy->getHash () != mapHash, "snapshot did not change");
+        expect (map.getHash () == mapHash, "original hash changed");
+
+        // Every item of the original is still there, unchanged, and
+        // there is nothing else
+        bool same = true;
+        std::size_t count = 0;
+        for (SHAMapItem::pointer item = map.peekFirstItem (); item;
+            item = map.peekNextItem (item->getTag ()))
+        {
+            auto const it = items.find (item->getTag ());
+            same = same && (it != items.end ()) && (it->second == item->peekData ());
+            ++count;
+        }
+        expect (same && (count == items.size ()), "original items changed");
+
+        // Changing the original afterwards leaves the snapshot alone
+        uint256 const copyHash = copy->getHash ();
+        map.delItem (keys[0]);
+        expect (copy->getHash () == copyHash, "snapshot hash changed");
+        expect (!!copy->peekItem (keys[0]), "snapshot item removed");
+    }
+
+    // Applies the same changes to each map in turn
+    static void change (SHAMap& map, std::vector<uint256> const& keys, int round)
+    {
+        for (std::size_t i = round; i < keys.size (); i += 3)
+            map.updateGiveItem (boost::make_shared<SHAMapItem> (
+                makeItem (keys[i], 1000 * round + i)), true, false);
+
+        for (std::size_t i = round; i < keys.size (); i += 7)
+            if (map.hasItem (keys[i]))
+                map.delItem (keys[i]);
+            else
+                map.addItem (makeItem (keys[i], i), true, false);
+    }
+
+    static std::map<uint256, Blob> getItems (SHAMap& map)
+    {
+        std::map<uint256, Blob> items;
+
+        for (SHAMapItem::pointer item = map.peekFirstItem (); item;
+            item = map.peekNextItem (item->getTag ()))
+        {
+            items[item->getTag ()] = item->peekData ();
+        }
+
+        return items;
+    }
+
+    // The maps of a ledger being accepted are built on a snapshot of the
+    // last closed ledger, flushed, and then shared with the next ledger.
+    // No step may change a node another of the maps can see.
+    void testAcceptIsolation (FullBelowCache& fullBelowCache)
+    {
+        testcase ("accept isolation");
+
+        std::vector<uint256> const keys (makeKeys (500));
+
+        SHAMap previous (smtFREE, fullBelowCache);
+        for (std::size_t i = 0; i < keys.size (); i += 2)
+            previous.addItem (makeItem (keys[i], i), true, false);
+
+        expect (previous.flushDirty (hotACCOUNT_NODE, 1) > 0, "nothing flushed");
+        previous.setImmutable ();
+
+        uint256 const previousHash = previous.getHash ();
+        std::map<uint256, Blob> const previousItems = getItems (previous);
+
+        // The ledger being accepted, and an open ledger on the same parent
+        SHAMap::pointer accepted = previous.snapShot (true);
+        SHAMap::pointer open = previous.snapShot (true);
+
+        change (*accepted, keys, 1);
+
+        // Someone takes a snapshot while the changes are not yet flushed
+        SHAMap::pointer held = accepted->snapShot (false);
+        uint256 const heldHash = held->getHash ();
+        std::map<uint256, Blob> const heldItems = getItems (*held);
+
+        change (*accepted, keys, 2);
+        change (*open, keys, 3);
+
+        expect (accepted->flushDirty (hotACCOUNT_NODE, 2) > 0, "nothing flushed");
+        accepted->setImmutable ();
+
+        uint256 const acceptedHash = accepted->getHash ();
+        std::map<uint256, Blob> const acceptedItems = getItems (*accepted);
+
+        // The next ledger changes and flushes nodes it shares with the
+        // accepted ledger
+        SHAMap::pointer next = accepted->snapShot (true);
+        change (*next, keys, 4);
+        change (*next, keys, 5);
+        next->flushDirty (hotACCOUNT_NODE, 3);
+
+        expect (next->getHash () != acceptedHash, "next ledger did not change");
+        expect (accepted->getHash () == acceptedHash, "accepted hash changed");
+        expect (getItems (*accepted) == acceptedItems, "accepted items changed");
+        expect (held->getHash () == heldHash, "held snapshot hash changed");
+        expect (getItems (*held) == heldItems, "held snapshot items changed");
+        expect (previous.getHash () == previousHash, "previous hash changed");
+        expect (getItems (previous) == previousItems, "previous items changed");
+
+        // Flushing the open ledger, built on the same parent, is also safe
+        open->flushDirty (hotACCOUNT_NODE, 2);
+        expect (accepted->getHash () == acceptedHash, "accepted hash changed by open");
+        expect (getItems (previous) == previousItems, "previous items changed by open");
+
+        expect (accepted->size () > 1, "accepted nodes not counted");
+    }
+
+    void testDeferredParallel (FullBelowCache& fullBelowCache)
+    {
+        testcase ("deferred parallel hash");
+
+        beast::RootStoppable root ("SHAMap_test");
+        std::unique_ptr <JobQueue> jobQueue (make_JobQueue (
+            beast::insight::NullCollector::New (), root, beast::Journal ()));
+        jobQueue->setThreadCount (4, false);
+        root.start ();
+
+        SHAMap deferred (smtFREE, fullBelowCache);
+        SHAMap immediate (smtFREE, fullBelowCache);
+        deferred.setDeferHash (true);
+
+        std::vector<uint256> const keys (makeKeys (2000));
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            deferred.addItem (makeItem (keys[i], i), true, false);
+            immediate.addItem (makeItem (keys[i], i), true, false);
+        }
+
+        deferred.updateHashes (jobQueue.get ());
+        expect (deferred.getHash () == immediate.getHash (), "bad parallel hash");
+
+        // Changes to a map whose hashes are already up to date
+        for (int round = 1; round < 3; ++round)
+        {
+            change (deferred, keys, round);
+            change (immediate, keys, round);
+        }
+
+        deferred.updateHashes (jobQueue.get ());
+        expect (deferred.getHash () == immediate.getHash (), "bad parallel rehash");
+
+        // A snapshot catches up on deferred hashes before sharing nodes
+        change (deferred, keys, 3);
+        change (immediate, keys, 3);
+
+        SHAMap::pointer snapshot = deferred.snapShot (false);
+        expect (snapshot->getHash () == immediate.getHash (), "bad snapshot hash");
+
+        // So does making the map immutable
+        change (deferred, keys, 4);
+        change (immediate, keys, 4);
+
+        deferred.setImmutable ();
+        expect (deferred.getHash () == immediate.getHash (), "bad immutable hash");
+        expect (snapshot->getHash () != deferred.getHash (), "snapshot changed");
+
+        root.stop ();
+    }
+
+    // Calls the function and reports whether it threw SHAMapMissingNode
+    template <class Function>
+    static bool throwsMissing (Function f)
+    {
+        try
+        {
+            f ();
+        }
+        catch (SHAMapMissingNode const&)
+        {
+            return true;
+        }
+
+        return false;
+    }
+
+    void testParallelWalk (FullBelowCache& fullBelowCache)
+    {
+        testcase ("parallel walk");
+
+        beast::RootStoppable root ("SHAMap_test");
+        std::unique_ptr <JobQueue> jobQueue (make_JobQueue (
+            beast::insight::NullCollector::New (), root, beast::Journal ()));
+        jobQueue->setThreadCount (4, false);
+        root.start ();
+
+        SHAMap map (smtFREE, fullBelowCache);
+
+        std::vector<uint256> const keys (makeKeys (3000));
+        for (std::size_t i = 0; i < keys.size (); ++i)
+            map.addItem (makeItem (keys[i], i), true, false);
+
+        map.setImmutable ();
+
+        std::vector<uint256> serial;
+        std::uint64_t serialSum = 0;
+        map.visitLeaves ([&] (SHAMapItem::ref item)
+        {
+            serial.push_back (item->getTag ());
+            serialSum += item->peekData ().front ();
+        });
+        expect (serial.size () == keys.size (), "serial walk missed items");
+
+        std::vector<uint256> sorted (serial);
+        std::sort (sorted.begin (), sorted.end ());
+
+        JobQueue* const queues[] = { jobQueue.get (), nullptr };
+
+        BOOST_FOREACH (JobQueue* queue, queues)
+        {
+            // Ordered: the same items in the same order as visitLeaves
+            std::vector<uint256> ordered;
+            map.visitLeavesParallel ([&] (SHAMapItem::ref item)
+            {
+                ordered.push_back (item->getTag ());
+            }, true, queue);
+            expect (ordered == serial, "ordered walk differs from visitLeaves");
+
+            // Unordered: the same items, in any order
+            std::mutex mutex;
+            std::vector<uint256> unordered;
+            map.visitLeavesParallel ([&] (SHAMapItem::ref item)
+            {
+                std::lock_guard <std::mutex> sl (mutex);
+                unordered.push_back (item->getTag ());
+            }, false, queue);
+            std::sort (unordered.begin (), unordered.end ());
+            expect (unordered == sorted, "unordered walk differs from visitLeaves");
+
+            // Folded: the parts are combined in key order
+            std::vector<uint256> const folded = map.reduceLeaves (std::vector<uint256> (),
+                [] (std::vector<uint256>& part, SHAMapItem::ref item)
+                {
+                    part.push_back (item->getTag ());
+                },
+                [] (std::vector<uint256>& result, std::vector<uint256> const& part)
+                {
+                    result.insert (result.end (), part.begin (), part.end ());
+                }, queue);
+            expect (folded == serial, "reduceLeaves differs from a serial fold");
+
+            std::uint64_t const sum = map.reduceLeaves (std::uint64_t (0),
+                [] (std::uint64_t& part, SHAMapItem::ref item)
+                {
+                    part += item->peekData ().front ();
+                },
+                [] (std::uint64_t& result, std::uint64_t part)
+                {
+                    result += part;
+                }, queue);
+            expect (sum == serialSum, "reduceLeaves sum differs from a serial fold");
+        }
+
+        // A copy with only the top two levels, whose other nodes are in
+        // neither the node store nor the tree node cache
+        SHAMap partial (smtFREE, fullBelowCache);
+        {
+            std::vector<SHAMapNode> nodeIDs;
+            std::list<Blob> rawNodes;
+            expect (map.getNodeFat (SHAMapNode (), nodeIDs, rawNodes, true, false), "GetNodeFat");
+
+            partial.setSynching ();
+            expect (partial.addRootNode (rawNodes.front (), snfWIRE, nullptr).isGood (), "AddRootNode");
+
+            std::list<Blob>::const_iterator raw = rawNodes.begin ();
+            for (std::size_t i = 1; i < nodeIDs.size (); ++i)
+                expect (partial.addKnownNode (nodeIDs[i], *++raw, nullptr).isGood (), "AddKnownNode");
+
+            partial.clearSynching ();
+        }
+        expect (partial.getHash () == map.getHash (), "bad partial map");
+
+        BOOST_FOREACH (JobQueue* queue, queues)
+        {
+            expect (throwsMissing ([&]
+            {
+                partial.visitLeavesParallel ([] (SHAMapItem::ref) { }, true, queue);
+            }), "ordered walk of a partial map did not throw");
+
+            expect (throwsMissing ([&]
+            {
+                partial.visitLeavesParallel ([] (SHAMapItem::ref) { }, false, queue);
+            }), "unordered walk of a partial map did not throw");
+
+            expect (throwsMissing ([&]
+            {
+                partial.reduceLeaves (0,
+                    [] (int& part, SHAMapItem::ref) { ++part; },
+                    [] (int& result, int part) { result += part; }, queue);
+            }), "reduceLeaves of a partial map did not throw");
+
+            std::vector<SHAMapMissingNode> missing;
+            partial.walkMap (missing, 32, queue);
+            expect (!missing.empty (), "walkMap found no missing nodes");
+        }
+
+        root.stop ();
+    }
+
     void run ()
     {
         testcase ("add/traverse");
@@ -1416,6 +2377,34 @@ public:
         unexpected (sMap.getHash () == mapHash, "bad snapshot");
 
         unexpected (map2->getHash () != mapHash, "bad snapshot");
+
+
+
+        testcase ("deferred hash");
+
+        SHAMap dMap (smtFREE, fullBelowCache);
+        dMap.setDeferHash (true);
+
+        dMap.addItem (i1, true, false);
+        dMap.addItem (i2, true, false);
+        dMap.addItem (i4, true, false);
+        dMap.delItem (i2.getTag ());
+        dMap.addItem (i3, true, false);
+        dMap.delItem (i1.getTag ());
+
+        unexpected (dMap.getHash () != sMap.getHash (), "bad deferred hash");
+
+        dMap.addItem (i5, true, false);
+        sMap.addItem (i5, true, false);
+        dMap.updateHashes ();
+
+        unexpected (dMap.getHash () != sMap.getHash (), "bad deferred hash");
+
+        testPrevLast (fullBelowCache);
+        testSnapshotIsolation (fullBelowCache);
+        testAcceptIsolation (fullBelowCache);
+        testDeferredParallel (fullBelowCache);
+        testParallelWalk (fullBelowCache);
     }
 };
 
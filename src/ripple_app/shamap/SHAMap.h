@@ -23,7 +23,6 @@
 #include "../ripple/radmap/ripple_radmap.h"
 #include "../main/FullBelowCache.h"
 
-#include <unordered_map>
 /*
 Used for:
 the Ledger
@@ -31,13 +30,12 @@ the set of transaction in a ledger
 Figuring the delta between two transaction sets
 
 Looks like:
-We have a hash table of all Ledger entries mTNbyID
 We have a tree of entries: root
-The tree just has id's which we then have to look up in mTNbyID?
+Each inner node holds the hashes of its children and, once they have
+been loaded, pointers to them. Children that are not loaded are fetched
+by hash from the TreeNodeCache or the NodeStore and hooked into place.
 
-there is some cache that we check when we are looking up items?
-
-What is the point of the tree?
+Nodes are shared between maps (snapshots) and copied on write.
 
 */
 
@@ -108,6 +106,12 @@ enum SHAMapState
     O(log(N)) where N is the number of nodes in the tree.
 
     See https://en.wikipedia.org/wiki/Merkle_tree
+
+    Every node carries a sequence number. A map may modify a node in place
+    only if the node's sequence matches the map's; any other node may be
+    shared with other maps and is copied before it is changed. Nodes with
+    a sequence of zero have been written to the node store and may be
+    shared through the TreeNodeCache.
  */
 class SHAMap
 //     : public CountedObject <SHAMap>
@@ -123,11 +127,6 @@ private:
     };
 
 public:
-    enum
-    {
-        STATE_MAP_BUCKETS = 1024
-    };
-
     static char const* getCountedObjectName () { return "SHAMap"; }
 
     typedef boost::shared_ptr<SHAMap> pointer;
@@ -136,8 +135,6 @@ public:
     typedef std::pair<SHAMapItem::pointer, SHAMapItem::pointer> DeltaItem;
     typedef std::pair<SHAMapItem::ref, SHAMapItem::ref> DeltaRef;
     typedef std::map<uint256, DeltaItem> Delta;
-    typedef ripple::unordered_map<SHAMapNode, SHAMapTreeNode::pointer, SHAMapNode_hash> NodeMap;
-    typedef std::unordered_set<SHAMapNode, SHAMapNode_hash> DirtySet;
 
     typedef boost::shared_mutex LockType;
     typedef boost::shared_lock<LockType> ScopedReadLockType;
@@ -153,12 +150,12 @@ public:
 
     ~SHAMap ();
 
-    std::size_t size () const noexcept
-    {
-        return mTNByID.size ();
-    }
+    // Number of this map's nodes held in memory. Nodes that are only in
+    // the node store are not fetched or counted.
+    std::size_t size () const;
 
-    // Returns a new map that's a snapshot of this one. Force CoW
+    // Returns a new map that's a snapshot of this one.
+    // Nodes are shared and copied on write
     SHAMap::pointer snapShot (bool isMutable);
 
     // Remove nodes from memory
@@ -178,14 +175,7 @@ public:
     bool addItem (const SHAMapItem & i, bool isTransaction, bool hasMeta);
     bool updateItem (const SHAMapItem & i, bool isTransaction, bool hasMeta);
     SHAMapItem getItem (uint256 const & id);
-    uint256 getHash () const
-    {
-        return root->getNodeHash ();
-    }
-    uint256 getHash ()
-    {
-        return root->getNodeHash ();
-    }
+    uint256 getHash () const;
 
     // save a copy if you have a temporary anyway
     bool updateGiveItem (SHAMapItem::ref, bool isTransaction, bool hasMeta);
@@ -205,6 +195,58 @@ public:
     SHAMapItem::pointer peekPrevItem (uint256 const& );
     void visitLeaves(std::function<void (SHAMapItem::ref)>);
 
+    /** Call the function with every node in the map, root first.
+        Nodes that have to be read are not kept in the map.
+        Stops early if the function returns `false`.
+        @return `false` if the function stopped the walk.
+        @throw SHAMapMissingNode if a node can't be read.
+    */
+    bool visitNodes (std::function<bool (SHAMapTreeNode&)> const& function);
+
+    /** Call the function with every item in the map, walking parts of the
+        map on jobs at the same time. The children of each inner node are
+        read from the node store in one batch. Nodes that have to be read
+        are not kept in the map.
+
+        If `ordered` is `true`, the function is called on this thread in key
+        order, and the jobs only walk a few small subtrees ahead of it, so
+        few items are held at once. Otherwise it is called from several
+        threads at once, in no particular order. With no job queue, this
+        thread walks the whole map.
+
+        @throw SHAMapMissingNode if a node can't be read.
+    */
+    void visitLeavesParallel (std::function<void (SHAMapItem::ref)> const& function,
+                              bool ordered, JobQueue* jobQueue);
+
+    /** Fold every item in the map into a result, walking parts of the map
+        on jobs at the same time.
+        Each part is folded into its own default constructed Result by
+        `accumulate (Result&, SHAMapItem::ref)`, then the parts are folded
+        into `result` in key order by `combine (Result&, Result const&)`.
+        @see visitLeavesParallel
+    */
+    template <class Result, class Accumulate, class Combine>
+    Result reduceLeaves (Result result, Accumulate accumulate, Combine combine,
+                         JobQueue* jobQueue)
+    {
+        SHAMap::pointer const map (snapShot (false));
+        std::vector<SHAMapTreeNode::pointer> const subtrees (map->getSubtrees (false, jobQueue));
+        std::vector<Result> results (subtrees.size ());
+
+        map->walkSubtrees (subtrees,
+            [&] (std::size_t i, SHAMapItem::ref item)
+            {
+                accumulate (results[i], item);
+            }, false, jobQueue);
+
+        for (auto const& part : results)
+            combine (result, part);
+
+        return result;
+    }
+
+
     // comparison/sync functions
     void getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint256>& hashes, int max,
                           SHAMapSyncFilter * filter);
@@ -223,6 +265,8 @@ public:
     void setImmutable ()
     {
         assert (mState != smsInvalid);
+        updateHashes ();
+        mDeferHash = false;
         mState = smsImmutable;
     }
     bool isImmutable ()
@@ -254,10 +298,20 @@ public:
     // return value: true=successfully completed, false=too different
     bool compare (SHAMap::ref otherMap, Delta & differences, int maxCount);
 
-    int armDirty ();
-    int flushDirty (DirtySet & dirtySet, int maxNodes, NodeObjectType t,
-                           std::uint32_t seq);
-    boost::shared_ptr<DirtySet> disarmDirty ();
+    // Write modified nodes to the node store and make them shareable
+    int flushDirty (NodeObjectType t, std::uint32_t seq);
+
+    // Defer updating the hashes of modified inner nodes until the map's
+    // hash is needed, so a node with many changes below it is hashed once.
+    // Until the hashes are updated, only the map's items may be accessed.
+    void setDeferHash (bool defer)
+    {
+        mDeferHash = defer;
+    }
+
+    // Bring any deferred hashes up to date. If a job queue is given,
+    // the subtrees of the root are hashed on it in parallel.
+    void updateHashes (JobQueue* jobQueue = nullptr);
 
     void setSeq (std::uint32_t seq)
     {
@@ -283,7 +337,10 @@ public:
     static Blob checkTrustedPath (uint256 const & ledgerHash, uint256 const & leafIndex,
                                   const std::list<Blob >& path);
 
-    void walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing);
+    // Read every node in the map, collecting the ones that are missing. If a
+    // job queue is given, the subtrees of the root are walked on it in parallel.
+    void walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing,
+                  JobQueue* jobQueue = nullptr);
 
     bool getPath (uint256 const & index, std::vector< Blob >& nodes, SHANodeFormat format);
 
@@ -308,14 +365,20 @@ public:
         return treeNodeCache.getCacheSize ();
     }
 
+    static std::size_t getTreeNodeBytes ()
+    {
+        return treeNodeCache.getCacheBytes ();
+    }
+
     static void sweep ()
     {
         treeNodeCache.sweep ();
     }
 
-    static void setTreeCache (int size, int age)
+    static void setTreeCache (int size, int age, std::size_t bytes)
     {
         treeNodeCache.setTargetSize (size);
+        treeNodeCache.setTargetBytes (bytes);
         treeNodeCache.setTargetAge (age);
     }
 
@@ -327,57 +390,94 @@ public:
     typedef std::pair<uint256, SHAMapNode> TNIndex;
 
 private:
-    static TaggedCache <uint256, SHAMapTreeNode> treeNodeCache;
+    static ShardedTaggedCache <uint256, SHAMapTreeNode> treeNodeCache;
 
-    void dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const & target, uint256 prevHash);
+    void dirtyUp (std::stack<SHAMapTreeNode::pointer>& stack, uint256 const & target, SHAMapTreeNode::pointer child);
+    bool setChild (SHAMapTreeNode* node, int branch, SHAMapTreeNode::ref child);
+    static void rehash (SHAMapTreeNode* node);
+    struct RehashJobs;
+    struct WalkJobs;
     std::stack<SHAMapTreeNode::pointer> getStack (uint256 const & id, bool include_nonmatching_leaf);
-    SHAMapTreeNode::pointer walkTo (uint256 const & id, bool modify);
     SHAMapTreeNode* walkToPointer (uint256 const & id);
-    SHAMapTreeNode::pointer checkCacheNode (const SHAMapNode&);
     void returnNode (SHAMapTreeNode::pointer&, bool modify);
-    void trackNewNode (SHAMapTreeNode::pointer&);
+    SHAMapTreeNode::pointer writeNode (NodeObjectType t, std::uint32_t seq,
+                                       SHAMapTreeNode::pointer node, Serializer & s);
 
-    SHAMapTreeNode::pointer getNode (const SHAMapNode & id);
-    SHAMapTreeNode::pointer getNode (const SHAMapNode & id, uint256 const & hash, bool modify);
     SHAMapTreeNode* getNodePointer (const SHAMapNode & id);
-    SHAMapTreeNode* getNodePointer (const SHAMapNode & id, uint256 const & hash);
-    SHAMapTreeNode* getNodePointerNT (const SHAMapNode & id, uint256 const & hash);
-    SHAMapTreeNode* getNodePointer (const SHAMapNode & id, uint256 const & hash, SHAMapSyncFilter * filter);
-    SHAMapTreeNode* getNodePointerNT (const SHAMapNode & id, uint256 const & hash, SHAMapSyncFilter * filter);
+
+    // Get the child on a branch of an inner node, hooking it up if needed
+    SHAMapTreeNode* descend (SHAMapTreeNode* parent, int branch);
+    SHAMapTreeNode* descendThrow (SHAMapTreeNode* parent, int branch);
+    SHAMapTreeNode::pointer descendThrow (SHAMapTreeNode::ref parent, int branch);
+    SHAMapTreeNode* descend (SHAMapTreeNode* parent, int branch, SHAMapSyncFilter * filter);
+
+    // Get the child on a branch without hooking it up
+    SHAMapTreeNode::pointer descendNoStore (SHAMapTreeNode::ref parent, int branch);
+
+    // Non-blocking version of descend, pending reads are added to the waiter
+    SHAMapTreeNode* descendAsync (SHAMapTreeNode* parent, int branch,
+                                  SHAMapSyncFilter * filter, bool& pending,
+                                  NodeStore::Database::FetchWaiter& reads);
+
+    // Hook up the children of an inner node on the given branches, reading
+    // the ones that aren't in memory from the node store in one batch
+    void fetchChildren (SHAMapTreeNode* parent, int branchMask = 0xFFFF);
+
+    // Get the children of an inner node without hooking them up, reading
+    // the ones that aren't in memory from the node store in one batch
+    void getChildren (SHAMapTreeNode::ref parent, SHAMapTreeNode::pointer (&children)[16]);
+
+    // Read the given children of an inner node from the node store in one
+    // batch. Nodes the node store doesn't have are left null.
+    std::vector<SHAMapTreeNode::pointer> readChildren (SHAMapTreeNode* parent,
+            std::vector<int> const& branches, std::vector<uint256> const& hashes);
+
+    // Split the map into subtrees in key order, enough to keep the jobs busy.
+    // An ordered walk gets many more, since only a few are walked ahead.
+    std::vector<SHAMapTreeNode::pointer> getSubtrees (bool ordered, JobQueue* jobQueue);
+
+    // Walk the subtrees, calling the function with the subtree's position
+    // and each item in it
+    void walkSubtrees (std::vector<SHAMapTreeNode::pointer> const& subtrees,
+                       std::function<void (std::size_t, SHAMapItem::ref)> const& function,
+                       bool ordered, JobQueue* jobQueue);
+
+    void walkSubtree (SHAMapTreeNode::ref top, std::vector<SHAMapMissingNode>& missingNodes,
+                      int maxMissing);
+
+    // Call the work function for each subtree, on the job queue and on this
+    // thread. If there is a take function, it is called on this thread for
+    // each subtree in turn, once the subtree's work is done.
+    static void runWalkJobs (std::size_t count, std::function<void (std::size_t)> const& work,
+                             std::function<void (std::size_t)> const& take, JobQueue* jobQueue);
+
+    SHAMapTreeNode::pointer checkFilter (const SHAMapNode & id, uint256 const & hash,
+                                         SHAMapSyncFilter * filter);
     SHAMapTreeNode* firstBelow (SHAMapTreeNode*);
     SHAMapTreeNode* lastBelow (SHAMapTreeNode*);
 
-    // Non-blocking version of getNodePointerNT
-    SHAMapTreeNode* getNodeAsync (
-        const SHAMapNode & id, uint256 const & hash, SHAMapSyncFilter * filter, bool& pending);
-
     SHAMapItem::pointer onlyBelow (SHAMapTreeNode*);
-    void eraseChildren (SHAMapTreeNode::pointer);
-    void dropBelow (SHAMapTreeNode*);
     bool hasInnerNode (const SHAMapNode & nodeID, uint256 const & hash);
     bool hasLeafNode (uint256 const & tag, uint256 const & hash);
 
     bool walkBranch (SHAMapTreeNode * node, SHAMapItem::ref otherMapItem, bool isFirstMap,
                      Delta & differences, int & maxCount);
 
-    void visitLeavesInternal (std::function<void (SHAMapItem::ref item)>& function);
-
 private:
 
     // This lock protects key SHAMap structures.
     // One may change anything with a write lock.
-    // With a read lock, one may not invalidate pointers to existing members of mTNByID
+    // With a read lock, one may only hook up children that were not loaded
     mutable LockType mLock;
 
     FullBelowCache& m_fullBelowCache;
     std::uint32_t mSeq;
     std::uint32_t mLedgerSeq; // sequence number of ledger this is part of
-	SyncUnorderedMapType< SHAMapNode, SHAMapTreeNode::pointer, SHAMapNode_hash > mTNByID;  // Tree Node by ID. hash table of all the nodes
-	boost::shared_ptr<DirtySet> mDirtyNodes;
     SHAMapTreeNode::pointer root;
     SHAMapState mState;
     SHAMapType mType;
     bool mTXMap;       // Map of transactions without metadata
+    bool mDeferHash;   // Inner node hashes are updated only when needed
     MissingNodeHandler m_missing_node_handler;
 };
 
@@ -30,11 +30,11 @@ namespace ripple {
 class SHAMapDeltaNode
 {
 public:
-    SHAMapNode mNodeID;
-    uint256 mOurHash, mOtherHash;
+    SHAMapTreeNode* mOurNode;
+    SHAMapTreeNode* mOtherNode;
 
-    SHAMapDeltaNode (const SHAMapNode& id, uint256 const& ourHash, uint256 const& otherHash) :
-        mNodeID (id), mOurHash (ourHash), mOtherHash (otherHash)
+    SHAMapDeltaNode (SHAMapTreeNode* ourNode, SHAMapTreeNode* otherNode) :
+        mOurNode (ourNode), mOtherNode (otherNode)
     {
         ;
     }
@@ -59,7 +59,7 @@ bool SHAMap::walkBranch (SHAMapTreeNode* node, SHAMapItem::ref otherMapItem, boo
             // This is an inner node, add all non-empty branches
             for (int i = 0; i < 16; ++i)
                 if (!node->isEmptyBranch (i))
-                    nodeStack.push (getNodePointer (node->getChildNodeID (i), node->getChildHash (i)));
+                    nodeStack.push (descendThrow (node, i));
         }
         else
         {
@@ -142,24 +142,22 @@ bool SHAMap::compare (SHAMap::ref otherMap, Delta& differences, int maxCount)
 
     ScopedReadLockType sl (mLock);
 
-    if (getHash () == otherMap->getHash ())
+    // Our hashes must be current, we can't update them under a read lock
+    assert (!root->isHashStale ());
+
+    if (root->getNodeHash () == otherMap->getHash ())
         return true;
 
-    nodeStack.push (SHAMapDeltaNode (SHAMapNode (), getHash (), otherMap->getHash ()));
+    nodeStack.push (SHAMapDeltaNode (root.get (), otherMap->root.get ()));
 
     while (!nodeStack.empty ())
     {
         SHAMapDeltaNode dNode (nodeStack.top ());
         nodeStack.pop ();
 
-        SHAMapTreeNode* ourNode = getNodePointer (dNode.mNodeID, dNode.mOurHash);
-        SHAMapTreeNode* otherNode = otherMap->getNodePointer (dNode.mNodeID, dNode.mOtherHash);
-
-        if (!ourNode || !otherNode)
-        {
-            assert (false);
-            throw SHAMapMissingNode (mType, dNode.mNodeID, uint256 ());
-        }
+        SHAMapTreeNode* ourNode = dNode.mOurNode;
+        SHAMapTreeNode* otherNode = dNode.mOtherNode;
+        assert (ourNode && otherNode);
 
         if (ourNode->isLeaf () && otherNode->isLeaf ())
         {
@@ -208,7 +206,7 @@ bool SHAMap::compare (SHAMap::ref otherMap, Delta& differences, int maxCount)
                     if (otherNode->isEmptyBranch (i))
                     {
                         // We have a branch, the other tree does not
-                        SHAMapTreeNode* iNode = getNodePointer (ourNode->getChildNodeID (i), ourNode->getChildHash (i));
+                        SHAMapTreeNode* iNode = descendThrow (ourNode, i);
 
                         if (!walkBranch (iNode, SHAMapItem::pointer (), true, differences, maxCount))
                             return false;
@@ -216,15 +214,14 @@ bool SHAMap::compare (SHAMap::ref otherMap, Delta& differences, int maxCount)
                     else if (ourNode->isEmptyBranch (i))
                     {
                         // The other tree has a branch, we do not
-                        SHAMapTreeNode* iNode =
-                            otherMap->getNodePointer (otherNode->getChildNodeID (i), otherNode->getChildHash (i));
+                        SHAMapTreeNode* iNode = otherMap->descendThrow (otherNode, i);
 
                         if (!otherMap->walkBranch (iNode, SHAMapItem::pointer (), false, differences, maxCount))
                             return false;
                     }
                     else // The two trees have different non-empty branches
-                        nodeStack.push (SHAMapDeltaNode (ourNode->getChildNodeID (i),
-                                                         ourNode->getChildHash (i), otherNode->getChildHash (i)));
+                        nodeStack.push (SHAMapDeltaNode (descendThrow (ourNode, i),
+                                                         otherMap->descendThrow (otherNode, i)));
                 }
         }
         else
@@ -234,28 +231,83 @@ bool SHAMap::compare (SHAMap::ref otherMap, Delta& differences, int maxCount)
     return true;
 }
 
-void SHAMap::walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing)
+void SHAMap::walkMap (std::vector<SHAMapMissingNode>& missingNodes, int maxMissing,
+                      JobQueue* jobQueue)
 {
-    std::stack<SHAMapTreeNode::pointer> nodeStack;
-
     ScopedReadLockType sl (mLock);
 
     if (!root->isInner ())  // root is only node, and we have it
         return;
 
-    nodeStack.push (root);
+    if (jobQueue == nullptr)
+    {
+        walkSubtree (root, missingNodes, maxMissing);
+        return;
+    }
+
+    // Each subtree of the root is walked by one thread
+    std::vector<SHAMapTreeNode::pointer> subtrees;
+
+    fetchChildren (root.get ());
+
+    for (int i = 0; i < 16; ++i)
+        if (!root->isEmptyBranch (i))
+        {
+            try
+            {
+                SHAMapTreeNode::pointer d = descendThrow (root, i);
+
+                if (d->isInner ())
+                    subtrees.push_back (d);
+            }
+            catch (SHAMapMissingNode& n)
+            {
+                missingNodes.push_back (n);
+
+                if (--maxMissing <= 0)
+                    return;
+            }
+        }
+
+    std::vector< std::vector<SHAMapMissingNode> > missing (subtrees.size ());
+
+    runWalkJobs (subtrees.size (),
+        [&] (std::size_t i)
+        {
+            walkSubtree (subtrees[i], missing[i], maxMissing);
+        }, std::function<void (std::size_t)> (), jobQueue);
+
+    for (std::size_t i = 0; i < missing.size (); ++i)
+        BOOST_FOREACH (SHAMapMissingNode const& n, missing[i])
+        {
+            missingNodes.push_back (n);
+
+            if (--maxMissing <= 0)
+                return;
+        }
+}
+
+void SHAMap::walkSubtree (SHAMapTreeNode::ref top, std::vector<SHAMapMissingNode>& missingNodes,
+                          int maxMissing)
+{
+    std::stack<SHAMapTreeNode::pointer> nodeStack;
+
+    nodeStack.push (top);
 
     while (!nodeStack.empty ())
     {
         SHAMapTreeNode::pointer node = nodeStack.top ();
         nodeStack.pop ();
 
+        // Read the children we don't have in one batch
+        fetchChildren (node.get ());
+
         for (int i = 0; i < 16; ++i)
             if (!node->isEmptyBranch (i))
             {
                 try
                 {
-                    SHAMapTreeNode::pointer d = getNode (node->getChildNodeID (i), node->getChildHash (i), false);
+                    SHAMapTreeNode::pointer d = descendThrow (node, i);
 
                     if (d->isInner ())
                         nodeStack.push (d);
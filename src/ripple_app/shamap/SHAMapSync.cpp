@@ -27,75 +27,50 @@ static const uint256 uZero;
 
 void SHAMap::visitLeaves (std::function<void (SHAMapItem::ref item)> function)
 {
-    // Make a snapshot of this map so we don't need to hold
-    // a lock on the map we're visiting
-    snapShot (false)->visitLeavesInternal (function);
+    // With no job queue this thread walks the map in key order
+    visitLeavesParallel (function, false, nullptr);
 }
 
-void SHAMap::visitLeavesInternal (std::function<void (SHAMapItem::ref item)>& function)
+bool SHAMap::visitNodes (std::function<bool (SHAMapTreeNode&)> const& function)
 {
-    assert (root->isValid ());
+    // Make a snapshot of this map so we don't need to hold
+    // a lock on the map we're visiting
+    SHAMap::pointer const map (snapShot (false));
 
-    if (!root || root->isEmpty ())
-        return;
+    if (!map->root || map->root->isEmpty ())
+        return true;
 
-    if (!root->isInner ())
-    {
-        function (root->peekItem ());
-        return;
-    }
+    if (!function (*map->root))
+        return false;
 
-    typedef std::pair<int, SHAMapTreeNode*> posPair;
+    // Children that are not already loaded are not hooked into the tree,
+    // so nodes we are done with can be freed as we go
+    std::stack<SHAMapTreeNode::pointer> stack;
 
-    std::stack<posPair> stack;
-    SHAMapTreeNode* node = root.get ();
-    int pos = 0;
+    if (map->root->isInner ())
+        stack.push (map->root);
 
-    while (1)
+    while (!stack.empty ())
     {
-        while (pos < 16)
+        SHAMapTreeNode::pointer const node = stack.top ();
+        stack.pop ();
+
+        for (int i = 0; i < 16; ++i)
         {
-            if (node->isEmptyBranch (pos))
-            {
-                ++pos; // move to next position
-            }
-            else
-            {
-                SHAMapTreeNode* child = getNodePointer (node->getChildNodeID (pos), node->getChildHash (pos));
-                if (child->isLeaf ())
-                {
-                    function (child->peekItem ());
-                    mTNByID.erase (*child); // don't need this leaf anymore
-                    ++pos;
-                }
-                else
-                {
-                    // If there are no more children, don't push this node
-                    while ((pos != 15) && (node->isEmptyBranch (pos + 1)))
-                           ++pos;
-
-                    if (pos != 15)
-                        stack.push (posPair (pos + 1, node)); // save next position to resume at
-                    else
-                        mTNByID.erase (*node); // don't need this inner node anymore
-
-                    // descend to the child's first position
-                    node = child;
-                    pos = 0;
-                }
-            }
-        }
+            if (node->isEmptyBranch (i))
+                continue;
 
-        // We are done with this inner node
-        mTNByID.erase (*node);
+            SHAMapTreeNode::pointer const child = map->descendNoStore (node, i);
 
-        if (stack.empty ())
-            break;
+            if (!function (*child))
+                return false;
 
-        pos = stack.top ().first;
-        node = stack.top ().second;
-        stack.pop ();
+            if (child->isInner ())
+                stack.push (child);
+        }
     }
+
+    return true;
 }
 
 class GMNEntry
@@ -144,9 +119,13 @@ void SHAMap::getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint
 
     while (1)
     {
-        std::vector <std::pair <SHAMapNode, uint256>> deferredReads;
+        // Parent node and branch of each read we deferred
+        std::vector <std::pair <SHAMapTreeNode*, int>> deferredReads;
         deferredReads.reserve (maxDefer + 16);
 
+        // Completes when all of our deferred reads are done
+        NodeStore::Database::FetchWaiter reads;
+
         std::stack <GMNEntry> stack;
 
         // Traverse the map without blocking
@@ -167,9 +146,8 @@ void SHAMap::getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint
 
                     if (! m_fullBelowCache.touch_if_exists (childHash))
                     {
-                        SHAMapNode childID = node->getChildNodeID (branch);
                         bool pending = false;
-                        SHAMapTreeNode* d = getNodeAsync (childID, childHash, filter, pending);
+                        SHAMapTreeNode* d = descendAsync (node, branch, filter, pending, reads);
 
                         if (!d)
                         {
@@ -177,7 +155,7 @@ void SHAMap::getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint
                             { // node is not in the database
                                 if (missingHashes.insert (childHash).second)
                                 {
-                                    nodeIDs.push_back (childID);
+                                    nodeIDs.push_back (node->getChildNodeID (branch));
                                     hashes.push_back (childHash);
 
                                     if (--max <= 0)
@@ -187,7 +165,7 @@ void SHAMap::getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint
                             else
                             {
                                 // read is deferred
-                                deferredReads.emplace_back (childID, childHash);
+                                deferredReads.emplace_back (node, branch);
                             }
 
                             fullBelow = false; // This node is not known full below
@@ -234,17 +212,27 @@ void SHAMap::getMissingNodes (std::vector<SHAMapNode>& nodeIDs, std::vector<uint
         if (deferredReads.empty ())
             break;
 
-        getApp().getNodeStore().waitReads();
+        reads.wait ();
+
+        // Resolve the deferred children of each parent with one batch
+        std::map <SHAMapTreeNode*, int> deferredBranches;
+        for (auto const& deferred : deferredReads)
+            deferredBranches[deferred.first] |= 1 << deferred.second;
+
+        for (auto const& parent : deferredBranches)
+            fetchChildren (parent.first, parent.second);
 
         // Process all deferred reads
-        for (auto const& node : deferredReads)
+        for (auto const& deferred : deferredReads)
         {
-            auto const& nodeID = node.first;
-            auto const& nodeHash = node.second;
-            SHAMapNode *nodePtr = getNodePointerNT (nodeID, nodeHash, filter);
+            SHAMapTreeNode* parent = deferred.first;
+            int const branch = deferred.second;
+            uint256 const& nodeHash = parent->getChildHash (branch);
+
+            SHAMapTreeNode* nodePtr = descend (parent, branch, filter);
             if (!nodePtr && missingHashes.insert (nodeHash).second)
             {
-                nodeIDs.push_back (nodeID);
+                nodeIDs.push_back (parent->getChildNodeID (branch));
                 hashes.push_back (nodeHash);
 
                 if (--max <= 0)
@@ -314,7 +302,7 @@ bool SHAMap::getNodeFat (const SHAMapNode& wanted, std::vector<SHAMapNode>& node
         for (int i = 0; i < 16; ++i)
             if (!node->isEmptyBranch (i))
             {
-                nextNode = getNodePointer (node->getChildNodeID (i), node->getChildHash (i));
+                nextNode = descendThrow (node, i);
                 ++count;
                 if (fatLeaves || nextNode->isInner ())
                 {
@@ -365,7 +353,6 @@ SHAMapAddNode SHAMap::addRootNode (Blob const& rootNode, SHANodeFormat format,
 #endif
 
     root = node;
-    mTNByID.replace(*root, root);
 
     if (root->isLeaf())
         clearSynching ();
@@ -401,7 +388,6 @@ SHAMapAddNode SHAMap::addRootNode (uint256 const& hash, Blob const& rootNode, SH
         return SHAMapAddNode::invalid ();
 
     root = node;
-    mTNByID.replace(*root, root);
 
     if (root->isLeaf())
         clearSynching ();
@@ -429,11 +415,7 @@ SHAMapAddNode SHAMap::addKnownNode (const SHAMapNode& node, Blob const& rawNode,
         return SHAMapAddNode::duplicate ();
     }
 
-    if (checkCacheNode (node)) // Do we already have this node?
-        return SHAMapAddNode::duplicate ();
-
-    SHAMapTreeNode::pointer parent = checkCacheNode(node.getParentNodeID());
-    SHAMapTreeNode* iNode = parent ? parent.get() : root.get ();
+    SHAMapTreeNode* iNode = root.get ();
 
     while (!iNode->isLeaf () && !iNode->isFullBelow () && (iNode->getDepth () < node.getDepth ()))
     {
@@ -449,7 +431,7 @@ SHAMapAddNode SHAMap::addKnownNode (const SHAMapNode& node, Blob const& rawNode,
         if (m_fullBelowCache.touch_if_exists (iNode->getChildHash (branch)))
             return SHAMapAddNode::duplicate ();
 
-        SHAMapTreeNode *nextNode = getNodePointerNT (iNode->getChildNodeID (branch), iNode->getChildHash (branch), filter);
+        SHAMapTreeNode *nextNode = descend (iNode, branch, filter);
         if (!nextNode)
         {
             if (iNode->getDepth () != (node.getDepth () - 1))
@@ -479,7 +461,9 @@ SHAMapAddNode SHAMap::addKnownNode (const SHAMapNode& node, Blob const& rawNode,
                 return SHAMapAddNode::useful ();
             }
 
-            if (mTNByID.canonicalize(node, &newNode) && filter)
+            iNode->canonicalizeChild (branch, newNode);
+
+            if (filter)
             {
                 Serializer s;
                 newNode->addRaw (s, snfPREFIX);
@@ -498,22 +482,18 @@ SHAMapAddNode SHAMap::addKnownNode (const SHAMapNode& node, Blob const& rawNode,
 bool SHAMap::deepCompare (SHAMap& other)
 {
     // Intended for debug/test only
-    std::stack<SHAMapTreeNode::pointer> stack;
+    std::stack<std::pair<SHAMapTreeNode*, SHAMapTreeNode*> > stack;
     ScopedReadLockType sl (mLock);
 
-    stack.push (root);
+    stack.push (std::make_pair (root.get (), other.root.get ()));
 
     while (!stack.empty ())
     {
-        SHAMapTreeNode::pointer node = stack.top ();
+        SHAMapTreeNode* node = stack.top ().first;
+        SHAMapTreeNode* otherNode = stack.top ().second;
         stack.pop ();
 
-        SHAMapTreeNode::pointer otherNode;
-
-        if (node->isRoot ()) otherNode = other.root;
-        else otherNode = other.getNode (*node, node->getNodeHash (), false);
-
-        if (!otherNode)
+        if (!node || !otherNode)
         {
             WriteLog (lsINFO, SHAMap) << "unable to fetch node";
             return false;
@@ -526,9 +506,6 @@ bool SHAMap::deepCompare (SHAMap& other)
 
         //      WriteLog (lsTRACE) << "Comparing inner nodes " << *node;
 
-        if (node->getNodeHash () != otherNode->getNodeHash ())
-            return false;
-
         if (node->isLeaf ())
         {
             if (!otherNode->isLeaf ()) return false;
@@ -550,7 +527,9 @@ bool SHAMap::deepCompare (SHAMap& other)
                 }
                 else
                 {
-                    SHAMapTreeNode::pointer next = getNode (node->getChildNodeID (i), node->getChildHash (i), false);
+                    if (otherNode->isEmptyBranch (i)) return false;
+
+                    SHAMapTreeNode* next = descend (node, i);
 
                     if (!next)
                     {
@@ -558,7 +537,7 @@ bool SHAMap::deepCompare (SHAMap& other)
                         return false;
                     }
 
-                    stack.push (next);
+                    stack.push (std::make_pair (next, other.descend (otherNode, i)));
                 }
             }
         }
@@ -572,10 +551,6 @@ bool SHAMap::deepCompare (SHAMap& other)
 */
 bool SHAMap::hasInnerNode (const SHAMapNode& nodeID, uint256 const& nodeHash)
 {
-    SHAMapTreeNode::pointer ptr = mTNByID.retrieve (nodeID);
-    if (ptr)
-        return ptr->getNodeHash() == nodeHash;
-
     SHAMapTreeNode* node = root.get ();
 
     while (node->isInner () && (node->getDepth () < nodeID.getDepth ()))
@@ -585,7 +560,7 @@ bool SHAMap::hasInnerNode (const SHAMapNode& nodeID, uint256 const& nodeHash)
         if (node->isEmptyBranch (branch))
             return false;
 
-        node = getNodePointer (node->getChildNodeID (branch), node->getChildHash (branch));
+        node = descendThrow (node, branch);
     }
 
     return node->getNodeHash () == nodeHash;
@@ -613,7 +588,7 @@ bool SHAMap::hasLeafNode (uint256 const& tag, uint256 const& nodeHash)
         if (nextHash == nodeHash) // Matching leaf, no need to retrieve it
             return true;
 
-        node = getNodePointer (node->getChildNodeID (branch), nextHash);
+        node = descendThrow (node, branch);
     }
     while (node->isInner());
 
@@ -683,15 +658,17 @@ void SHAMap::getFetchPack (SHAMap* have, bool includeLeaves, int max,
         func (boost::cref(node->getNodeHash ()), boost::cref(s.peekData ()));
         --max;
 
-        // 2) push non-matching child inner nodes
+        // 2) push non-matching child inner nodes, after reading all of the
+        //    children that aren't in memory at once
+        fetchChildren (node);
+
         for (int i = 0; i < 16; ++i)
         {
             if (!node->isEmptyBranch (i))
             {
                 uint256 const& childHash = node->getChildHash (i);
-                SHAMapNode childID = node->getChildNodeID (i);
 
-                SHAMapTreeNode* next = getNodePointer (childID, childHash);
+                SHAMapTreeNode* next = descendThrow (node, i);
 
                 if (next->isInner ())
                 {
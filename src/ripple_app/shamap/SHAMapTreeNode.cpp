@@ -23,25 +23,34 @@ SHAMapTreeNode::SHAMapTreeNode (std::uint32_t seq, const SHAMapNode& nodeID)
     : SHAMapNode (nodeID)
     , mHash (std::uint64_t(0))
     , mSeq (seq)
-    , mAccessSeq (seq)
     , mType (tnERROR)
     , mIsBranch (0)
     , mFullBelow (false)
+    , mHashStale (false)
 {
 }
 
 SHAMapTreeNode::SHAMapTreeNode (const SHAMapTreeNode& node, std::uint32_t seq) : SHAMapNode (node),
-    mHash (node.mHash), mSeq (seq), mType (node.mType), mIsBranch (node.mIsBranch), mFullBelow (false)
+    mHash (node.mHash), mSeq (seq), mType (node.mType), mIsBranch (node.mIsBranch), mFullBelow (false),
+    mHashStale (node.mHashStale)
 {
     if (node.mItem)
         mItem = node.mItem;
     else
+    {
         memcpy (mHashes, node.mHashes, sizeof (mHashes));
+
+        // The source may be a shared node that other threads are
+        // hooking children into
+        for (int i = 0; i < 16; ++i)
+            mChildren[i] = node.getChild (i);
+    }
 }
 
 SHAMapTreeNode::SHAMapTreeNode (const SHAMapNode& node, SHAMapItem::ref item,
                                 TNType type, std::uint32_t seq) :
-    SHAMapNode (node), mItem (item), mSeq (seq), mType (type), mIsBranch (0), mFullBelow (false)
+    SHAMapNode (node), mItem (item), mSeq (seq), mType (type), mIsBranch (0), mFullBelow (false),
+    mHashStale (false)
 {
     assert (item->peekData ().size () >= 12);
     updateHash ();
@@ -49,7 +58,8 @@ SHAMapTreeNode::SHAMapTreeNode (const SHAMapNode& node, SHAMapItem::ref item,
 
 SHAMapTreeNode::SHAMapTreeNode (const SHAMapNode& id, Blob const& rawNode, std::uint32_t seq,
                                 SHANodeFormat format, uint256 const& hash, bool hashValid) :
-    SHAMapNode (id), mSeq (seq), mType (tnERROR), mIsBranch (0), mFullBelow (false)
+    SHAMapNode (id), mSeq (seq), mType (tnERROR), mIsBranch (0), mFullBelow (false),
+    mHashStale (false)
 {
     if (format == snfWIRE)
     {
@@ -242,13 +252,12 @@ bool SHAMapTreeNode::updateHash ()
         {
             nh = Serializer::getPrefixHash (HashPrefix::innerNode, reinterpret_cast<unsigned char*> (mHashes), sizeof (mHashes));
 #if RIPPLE_VERIFY_NODEOBJECT_KEYS
-            Serializer s;
-            s.add32 (HashPrefix::innerNode);
+            SHA512HalfHasher h (HashPrefix::innerNode);
 
             for (int i = 0; i < 16; ++i)
-                s.add256 (mHashes[i]);
+                h.add256 (mHashes[i]);
 
-            assert (nh == s.getSHA512Half ());
+            assert (nh == h.getSHA512Half ());
 #endif
         }
         else
@@ -260,19 +269,17 @@ bool SHAMapTreeNode::updateHash ()
     }
     else if (mType == tnACCOUNT_STATE)
     {
-        Serializer s (mItem->peekSerializer ().getDataLength () + (256 + 32) / 8);
-        s.add32 (HashPrefix::leafNode);
-        s.addRaw (mItem->peekData ());
-        s.add256 (mItem->getTag ());
-        nh = s.getSHA512Half ();
+        SHA512HalfHasher h (HashPrefix::leafNode);
+        h.addRaw (mItem->peekData ());
+        h.add256 (mItem->getTag ());
+        nh = h.getSHA512Half ();
     }
     else if (mType == tnTRANSACTION_MD)
     {
-        Serializer s (mItem->peekSerializer ().getDataLength () + (256 + 32) / 8);
-        s.add32 (HashPrefix::txNode);
-        s.addRaw (mItem->peekData ());
-        s.add256 (mItem->getTag ());
-        nh = s.getSHA512Half ();
+        SHA512HalfHasher h (HashPrefix::txNode);
+        h.addRaw (mItem->peekData ());
+        h.add256 (mItem->getTag ());
+        nh = h.getSHA512Half ();
     }
     else
         assert (false);
@@ -308,9 +315,9 @@ void SHAMapTreeNode::addRaw (Serializer& s, SHANodeFormat format)
         }
         else
         {
-            if (getBranchCount () < 12)
+            if (getBranchCount () < 16)
             {
-                // compressed node
+                // compressed node, smaller unless every branch is used
                 for (int i = 0; i < 16; ++i)
                     if (!isEmptyBranch (i))
                     {
@@ -378,6 +385,15 @@ void SHAMapTreeNode::addRaw (Serializer& s, SHANodeFormat format)
 
 bool SHAMapTreeNode::setItem (SHAMapItem::ref i, TNType type)
 {
+    if (mType == tnINNER)
+    {
+        // An inner node is being collapsed into a leaf
+        mIsBranch = 0;
+        memset (mHashes, 0, sizeof (mHashes));
+        dropChildren ();
+        mHashStale = false;
+    }
+
     mType = type;
     mItem = i;
     assert (isLeaf ());
@@ -407,7 +423,9 @@ void SHAMapTreeNode::makeInner ()
     mItem.reset ();
     mIsBranch = 0;
     memset (mHashes, 0, sizeof (mHashes));
+    dropChildren ();
     mType = tnINNER;
+    mHashStale = false;
     mHash.zero ();
 }
 
@@ -458,11 +476,27 @@ std::string SHAMapTreeNode::getString () const
     return ret;
 }
 
-bool SHAMapTreeNode::setChildHash (int m, uint256 const& hash)
+SHAMapTreeNode* SHAMapTreeNode::getChildPointer (int m) const
+{
+    assert ((m >= 0) && (m < 16));
+    return boost::atomic_load (&mChildren[m]).get ();
+}
+
+SHAMapTreeNode::pointer SHAMapTreeNode::getChild (int m) const
+{
+    assert ((m >= 0) && (m < 16));
+    return boost::atomic_load (&mChildren[m]);
+}
+
+// Change a branch of a node we own, returns true if our hash changed
+bool SHAMapTreeNode::setChild (int m, uint256 const& hash, pointer const& child)
 {
     assert ((m >= 0) && (m < 16));
     assert (mType == tnINNER);
     assert (mSeq != 0);
+    assert (!child || (child->getNodeHash () == hash));
+
+    boost::atomic_store (&mChildren[m], child);
 
     if (mHashes[m] == hash)
         return false;
@@ -477,4 +511,105 @@ bool SHAMapTreeNode::setChildHash (int m, uint256 const& hash)
     return updateHash ();
 }
 
+// Change a branch of a node we own, leaving our hash to be
+// updated by updateStaleHash. The child's hash may be stale too.
+void SHAMapTreeNode::setChildDeferHash (int m, pointer const& child)
+{
+    assert ((m >= 0) && (m < 16));
+    assert (mType == tnINNER);
+    assert (mSeq != 0);
+
+    boost::atomic_store (&mChildren[m], child);
+
+    if (child)
+    {
+        mHashes[m] = child->getNodeHash ();
+        mIsBranch |= (1 << m);
+    }
+    else
+    {
+        mHashes[m].zero ();
+        mIsBranch &= ~ (1 << m);
+    }
+
+    mHashStale = true;
+}
+
+// Update the hashes of stale nodes from the hashes of their children,
+// which must not be stale. The nodes are hashed together as a batch.
+void SHAMapTreeNode::updateStaleHashes (std::vector<SHAMapTreeNode*> const& nodes)
+{
+    std::vector<SHAMapTreeNode*> hashed;
+    std::vector<HashManyInput> inputs;
+    hashed.reserve (nodes.size ());
+    inputs.reserve (nodes.size ());
+
+    for (auto node : nodes)
+    {
+        assert (node->mType == tnINNER);
+        assert (node->mSeq != 0);
+
+        for (int i = 0; i < 16; ++i)
+        {
+            SHAMapTreeNode* child = node->getChildPointer (i);
+
+            if (child)
+            {
+                assert (!child->isHashStale ());
+                node->mHashes[i] = child->getNodeHash ();
+            }
+        }
+
+        node->mHashStale = false;
+
+        if (node->mIsBranch == 0)
+            node->mHash.zero ();
+        else
+        {
+            hashed.push_back (node);
+            inputs.push_back (HashManyInput (HashPrefix::innerNode,
+                node->mHashes, sizeof (node->mHashes)));
+        }
+    }
+
+    if (inputs.empty ())
+        return;
+
+    std::vector<uint256> hashes (inputs.size ());
+    hashMany (&inputs.front (), &hashes.front (), inputs.size ());
+
+    for (std::size_t i = 0; i < hashed.size (); ++i)
+        hashed[i]->mHash = hashes[i];
+}
+
+// Replace a child with an equivalent node (same hash)
+void SHAMapTreeNode::shareChild (int m, pointer const& child)
+{
+    assert ((m >= 0) && (m < 16));
+    assert (mType == tnINNER);
+    assert (child && (child->getNodeHash () == mHashes[m]));
+
+    boost::atomic_store (&mChildren[m], child);
+}
+
+// Hook up a child we loaded. If another thread got there first,
+// use the node it hooked up so every thread sees the same node.
+void SHAMapTreeNode::canonicalizeChild (int m, pointer& child)
+{
+    assert ((m >= 0) && (m < 16));
+    assert (mType == tnINNER);
+    assert (child && (child->getNodeHash () == mHashes[m]));
+
+    pointer expected;
+
+    if (!boost::atomic_compare_exchange (&mChildren[m], &expected, child))
+        child = expected;
+}
+
+void SHAMapTreeNode::dropChildren ()
+{
+    for (int i = 0; i < 16; ++i)
+        boost::atomic_store (&mChildren[i], pointer ());
+}
+
 } // ripple
@@ -52,7 +52,7 @@ public:
 
 public:
     SHAMapTreeNode (std::uint32_t seq, const SHAMapNode & nodeID); // empty node
-    SHAMapTreeNode (const SHAMapTreeNode & node, std::uint32_t seq); // copy node from older tree
+    SHAMapTreeNode (const SHAMapTreeNode & node, std::uint32_t seq); // copy node from older tree, sharing its children
     SHAMapTreeNode (const SHAMapNode & nodeID, SHAMapItem::ref item, TNType type,
                     std::uint32_t seq);
 
@@ -73,12 +73,7 @@ public:
     }
     void setSeq (std::uint32_t s)
     {
-        mAccessSeq = mSeq = s;
-    }
-    void touch (std::uint32_t s)
-    {
-        if (mSeq != 0)
-            mAccessSeq = s;
+        mSeq = s;
     }
     uint256 const& getNodeHash () const
     {
@@ -126,7 +121,6 @@ public:
     {
         return !mItem;
     }
-    bool setChildHash (int m, uint256 const & hash);
     bool isEmptyBranch (int m) const
     {
         return (mIsBranch & (1 << m)) == 0;
@@ -140,6 +134,31 @@ public:
         return mHashes[m];
     }
 
+    // child pointer functions
+    //
+    // Children are hooked up lazily as the tree is walked. Hooking a child
+    // into a shared node is safe under a read lock, so loads and stores of
+    // the child pointers are atomic. Changing a child (setChild) requires
+    // the node to be owned by the map doing the change.
+    SHAMapTreeNode* getChildPointer (int m) const;
+    pointer getChild (int m) const;
+    bool setChild (int m, uint256 const& hash, pointer const& child);
+    void shareChild (int m, pointer const& child);
+    void canonicalizeChild (int m, pointer& child);
+    void dropChildren ();
+
+    // deferred hashing functions
+    //
+    // A map may change branches without rehashing, leaving this node's hash
+    // (and the hashes of its changed children) stale. The stale nodes are
+    // later rehashed children first, each exactly once, a level at a time.
+    void setChildDeferHash (int m, pointer const& child);
+    bool isHashStale () const
+    {
+        return mHashStale;
+    }
+    static void updateStaleHashes (std::vector<SHAMapTreeNode*> const& nodes);
+
     // item node function
     bool hasItem () const
     {
@@ -149,6 +168,14 @@ public:
     { // CAUTION: Do not modify the item
         return mItem;
     }
+    // Approximate memory used by this node and its item
+    std::size_t getMemoryUsage () const
+    {
+        std::size_t bytes = sizeof (*this);
+        if (mItem)
+            bytes += sizeof (SHAMapItem) + mItem->peekData ().capacity ();
+        return bytes;
+    }
     bool setItem (SHAMapItem::ref i, TNType type);
     uint256 const& getTag () const
     {
@@ -182,11 +209,13 @@ private:
 
     uint256             mHash;
     uint256             mHashes[16];  // hashes of the nodes under this one
+    pointer             mChildren[16]; // the nodes under this one, if loaded
     SHAMapItem::pointer mItem;
-    std::uint32_t       mSeq, mAccessSeq;
+    std::uint32_t       mSeq;
     TNType              mType;
     int                 mIsBranch;   // JED: why is this an int and not a bool? I think it is a bitfield that says if the branch at bit i is there or not
     bool                mFullBelow;
+    bool                mHashStale;  // our hash does not reflect our children
 
     bool updateHash ();
 };
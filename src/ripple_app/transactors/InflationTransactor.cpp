@@ -81,29 +81,19 @@ namespace ripple {
 		Ledger::pointer votingLedger=getApp().getLedgerMaster().getLedgerByHash(parentHash);
 		if (votingLedger)
 		{
-			std::map< uint160, uint64 > voteTally;
-			
-			// TODO: is there a better way to do this than walk every element in the ledger?
-			const SHAMap::pointer votingLedgerItems = votingLedger->peekAccountStateMap();
-			SHAMapItem::pointer item = votingLedgerItems->peekFirstItem();
-			while (item)
+			// the tally is moved to the voting ledger from the last one it was counted in
+			InflationVotes::Tally voteTally = getApp().getLedgerMaster().getInflationVotes().getTally(votingLedger);
+
+			if (getConfig().INFLATION_CHECK)
 			{
-				
-				SLE::pointer s=boost::make_shared<SLE>(item->peekSerializer(), item->getTag());
+				InflationVotes::Tally fullTally = InflationVotes::countVotes(votingLedger);
 
-				if (s->getType() == ltACCOUNT_ROOT)
+				if (fullTally != voteTally)
 				{
-					if (s->isFieldPresent(sfInflationDest))
-					{
-						uint160 addr=s->getFieldAccount160(sfInflationDest);
-						STAmount balance = s->getFieldAmount(sfBalance);
-						if (voteTally.find(addr) == voteTally.end()) voteTally[addr] = balance.getNValue();
-						else voteTally[addr] = voteTally[addr] + balance.getNValue();
-					}
-					
+					WriteLog(lsERROR, InflationTransactor) << "Inflation vote tally does not match the ledger, "
+						<< voteTally.size() << " destinations tallied, " << fullTally.size() << " counted";
+					voteTally.swap(fullTally);
 				}
-
-				item = votingLedgerItems->peekNextItem(item->getTag());
 			}
 
 			
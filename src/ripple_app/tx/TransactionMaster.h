@@ -39,7 +39,7 @@ public:
     void sweep (void);
 
 private:
-    TaggedCache <uint256, Transaction> mCache;
+    ShardedTaggedCache <uint256, Transaction> mCache;
 };
 
 } // ripple
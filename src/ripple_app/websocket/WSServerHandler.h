@@ -119,6 +119,11 @@ public:
         }
     }
 
+    static void ssendp (connection_ptr cpClient, InfoSub::Payload const& payload, bool broadcast)
+    {
+        ssendb (cpClient, *payload, broadcast);
+    }
+
     void send (connection_ptr cpClient, message_ptr mpMessage)
     {
         cpClient->get_strand ().post (BIND_TYPE (
@@ -131,6 +136,14 @@ public:
                                           &WSServerHandler<endpoint_type>::ssendb, cpClient, strMessage, broadcast));
     }
 
+    // The payload is shared by every connection the event goes to, so
+    // only the pointer is copied onto each strand.
+    void send (connection_ptr cpClient, InfoSub::Payload const& payload, bool broadcast)
+    {
+        cpClient->get_strand ().post (BIND_TYPE (
+                                          &WSServerHandler<endpoint_type>::ssendp, cpClient, payload, broadcast));
+    }
+
     void send (connection_ptr cpClient, const Json::Value& jvObj, bool broadcast)
     {
         Json::FastWriter    jfwWriter;
@@ -142,6 +142,8 @@ Config::Config ()
     PATH_SEARCH_FAST        = DEFAULT_PATH_SEARCH_FAST;
     PATH_SEARCH_MAX         = DEFAULT_PATH_SEARCH_MAX;
 
+    INFLATION_CHECK         = false;
+
     ACCOUNT_PROBE_MAX       = 10;
 
     VALIDATORS_SITE         = "";
@@ -582,6 +584,9 @@ void Config::load ()
             if (SectionSingleB (secConfig, SECTION_PATH_SEARCH_MAX, strTemp))
                 PATH_SEARCH_MAX     = beast::lexicalCastThrow <int> (strTemp);
 
+            if (SectionSingleB (secConfig, SECTION_INFLATION_CHECK, strTemp))
+                INFLATION_CHECK     = beast::lexicalCastThrow <bool> (strTemp);
+
             if (SectionSingleB (secConfig, SECTION_ACCOUNT_PROBE_MAX, strTemp))
                 ACCOUNT_PROBE_MAX   = beast::lexicalCastThrow <int> (strTemp);
 
@@ -619,9 +624,11 @@ int Config::getSize (SizedItemName item)
 
         { siNodeCacheSize,      {   16384,  32768,  131072, 262144,     0       } },
         { siNodeCacheAge,       {   60,     90,     120,    900,        0       } },
+        { siNodeCacheMB,        {   8,      16,     64,     128,        0       } },
 
         { siTreeCacheSize,      {   8192,   65536,  131072, 131072,     0       } },
         { siTreeCacheAge,       {   30,     60,     90,     120,        900     } },
+        { siTreeCacheMB,        {   8,      48,     96,     96,         0       } },
 
         { siSLECacheSize,       {   4096,   8192,   16384,  65536,      0       } },
         { siSLECacheAge,        {   30,     60,     90,     120,        300     } },
@@ -65,8 +65,10 @@ enum SizedItemName
     siValidationsAge,
     siNodeCacheSize,
     siNodeCacheAge,
+    siNodeCacheMB,
     siTreeCacheSize,
     siTreeCacheAge,
+    siTreeCacheMB,
     siSLECacheSize,
     siSLECacheAge,
     siLedgerSize,
@@ -444,6 +446,9 @@ public:
     int                         PATH_SEARCH_FAST;
     int                         PATH_SEARCH_MAX;
 
+    // Count inflation votes the slow way as well, and compare
+    bool                        INFLATION_CHECK;
+
     // Validation
     RippleAddress               VALIDATION_SEED, VALIDATION_PUB, VALIDATION_PRIV;
 
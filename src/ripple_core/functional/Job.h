@@ -34,7 +34,10 @@ enum JobType
     // earlier jobs having lower priority than later jobs. If you wish to
     // insert a job at a specific priority, simply add it at the right location.
     
+    jtWARM,          // Load a ledger into the fast NodeStore backend
     jtPACK,          // Make a fetch pack for a peer
+    jtINFLATION,     // Bring the inflation vote tally up to date
+    jtTRAVERSE,      // Walk part of a map for a bulk scan
     jtPUBOLDLEDGER,  // An old ledger has been accepted
     jtVALIDATION_ut, // A validation from an untrusted source
     jtPROOFWORK,     // A proof of work demand from another server
@@ -35,10 +35,22 @@ public:
     {        
         int maxLimit = std::numeric_limits <int>::max ();
 
+        // Load a ledger into the fast NodeStore backend
+        add (jtWARM,          "warmNodeStore",
+            1,        true,   false, 0,     0);
+
         // Make a fetch pack for a peer
         add (jtPACK,          "makeFetchPack",
             1,        true,   false, 0,     0);
 
+        // Bring the inflation vote tally up to date
+        add (jtINFLATION,     "inflationVotes",
+            1,        true,   false, 0,     0);
+
+        // Walk part of a map for a bulk scan
+        add (jtTRAVERSE,      "traverseMap",
+            maxLimit, true,   false, 0,     0);
+
         // An old ledger has been accepted
         add (jtPUBOLDLEDGER,  "publishAcqLedger",
             2,        true,   false, 10000, 15000);
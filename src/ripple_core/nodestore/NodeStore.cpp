@@ -26,15 +26,20 @@
 #include "../ripple/rocksdb/ripple_rocksdb.h"
 
 #include "../beast/beast/cxx14/memory.h"
+#include "../beast/beast/threads/ThreadLocalValue.h"
 
 #include "../../ripple/common/seconds_clock.h"
 #include "../../ripple/common/TaggedCache.h"
+#include "../../ripple/common/ShardedTaggedCache.h"
 #include "../../ripple/common/KeyCache.h"
 
 #include "impl/Tuning.h"
+#  include "impl/AdmissionFilter.h"
 #  include "impl/DecodedBlob.h"
 #  include "impl/EncodedBlob.h"
 #  include "impl/BatchWriter.h"
+#  include "impl/Importer.h"
+#  include "impl/FastTier.h"
 # include "backend/HyperDBFactory.h"
 #include "backend/HyperDBFactory.cpp"
 # include "backend/LevelDBFactory.h"
@@ -45,6 +50,8 @@
 #include "backend/NullFactory.cpp"
 # include "backend/RocksDBFactory.h"
 #include "backend/RocksDBFactory.cpp"
+# include "backend/SegmentFactory.h"
+#include "backend/SegmentFactory.cpp"
 
 #include "impl/Backend.cpp"
 #include "impl/BatchWriter.cpp"
@@ -54,13 +61,18 @@
 #include "impl/DecodedBlob.cpp"
 #include "impl/EncodedBlob.cpp"
 #include "impl/Factory.cpp"
+#include "impl/FastTier.cpp"
+#include "impl/Importer.cpp"
 #include "impl/Manager.cpp"
 #include "impl/NodeObject.cpp"
 #include "impl/Scheduler.cpp"
 #include "impl/Task.cpp"
 
 # include "tests/TestBase.h"
+#include "tests/AdmissionTests.cpp"
 #include "tests/BackendTests.cpp"
 #include "tests/BasicTests.cpp"
 #include "tests/DatabaseTests.cpp"
+#include "tests/FastTierTests.cpp"
+#include "tests/SegmentTests.cpp"
 #include "tests/TimingTests.cpp"
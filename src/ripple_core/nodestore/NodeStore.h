@@ -20,6 +20,9 @@
 #ifndef RIPPLE_NODESTORE_H_INCLUDED
 #define RIPPLE_NODESTORE_H_INCLUDED
 
+#include <condition_variable>
+#include <mutex>
+
 #include "api/NodeObject.h"
 #include "api/Types.h"
 #include "api/VisitCallback.h"
@@ -29,6 +32,7 @@
 #include "api/DummyScheduler.h"
 #include "api/Factory.h"
 #include "api/Database.h"
+#include "api/DatabaseRotating.h"
 #include "api/Manager.h"
 
 #endif
@@ -58,6 +58,18 @@ public:
     */
     virtual Status fetch (void const* key, NodeObject::Ptr* pObject) = 0;
 
+    /** Fetch a group of objects.
+        The default implementation calls fetch for each key. Backends that
+        can serve several reads at once more cheaply override it.
+        @note This will be called concurrently.
+        @param keys Pointers to the key data.
+        @param results [out] The result for each key, in the same order.
+        @param objects [out] The object for each key, or nullptr, in the
+                       same order.
+    */
+    virtual void fetchBatch (std::vector <void const*> const& keys,
+        std::vector <Status>& results, Batch& objects);
+
     /** Store a single object.
         Depending on the implementation this may happen immediately
         or deferred using a scheduled task.
@@ -67,8 +79,8 @@ public:
     virtual void store (NodeObject::Ptr const& object) = 0;
 
     /** Store a group of objects.        
-        @note This function will not be called concurrently with
-              itself or @ref store.
+        @note The persistent backends allow this to be called concurrently
+              with itself and @ref store. The memory backend does not.
     */
     virtual void storeBatch (Batch const& batch) = 0;
 
@@ -80,8 +92,33 @@ public:
     */
     virtual void for_each (std::function <void (NodeObject::Ptr)> f) = 0;
 
+    /** Visit every object with a key in a range.
+        The range includes both ends. Objects need not be visited in key
+        order. Import calls this from several threads at once, each with
+        its own range.
+        @note This may be called concurrently with itself, but not with
+              other methods.
+        @see import
+    */
+    virtual void for_each (std::function <void (NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last) = 0;
+
+    /** Returns `true` if a range of keys can be visited without reading
+        the rest of the database. Import only splits its reads into key
+        ranges when this is true.
+    */
+    virtual bool hasOrderedKeys () = 0;
+
     /** Estimate the number of write operations pending. */
     virtual int getWriteLoad () = 0;
+
+protected:
+    /** Returns the indexes of the keys in ascending key order.
+        Ordered stores find neighbouring keys faster when they are read
+        one after another.
+    */
+    static std::vector <std::size_t> getKeyOrder (
+        std::vector <void const*> const& keys, std::size_t keyBytes);
 };
 
 }
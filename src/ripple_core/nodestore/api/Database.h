@@ -39,6 +39,9 @@ namespace NodeStore {
 class Database
 {
 public:
+    /** Called with the result of an asynchronous fetch. */
+    typedef std::function <void (NodeObject::pointer const&)> FetchCallback;
+
     /** Destroy the node store.
         All pending operations are completed, pending writes flushed,
         and files closed before this returns.
@@ -62,6 +65,18 @@ public:
     */
     virtual NodeObject::pointer fetch (uint256 const& hash) = 0;
 
+    /** Fetch a group of objects.
+        This is the same as calling fetch for each hash, except that the
+        objects which are not cached are read from the backend together.
+
+        @note This can be called concurrently.
+        @param hashes The keys of the objects to retrieve.
+        @return The objects in the same order as the keys, with nullptr for
+                any that couldn't be retrieved.
+    */
+    virtual std::vector <NodeObject::pointer> fetchBatch (
+        std::vector <uint256> const& hashes) = 0;
+
     /** Fetch an object without waiting.
         If I/O is required to determine whether or not the object is present,
         `false` is returned. Otherwise, `true` is returned and `object` is set
@@ -75,9 +90,17 @@ public:
     */
     virtual bool asyncFetch (uint256 const& hash, NodeObject::pointer& object) = 0;
 
-    /** Wait for all currently pending async reads to complete.
+    /** Fetch an object without waiting, and be told when it arrives.
+        This is the same as the other asyncFetch, except that `callback` is
+        always called exactly once with the result. If the operation
+        completes it is called before this returns, otherwise it is called
+        from an I/O thread when the scheduled read finishes.
+
+        @note This can be called concurrently.
+        @see FetchWaiter
     */
-    virtual void waitReads () = 0;
+    virtual bool asyncFetch (uint256 const& hash, NodeObject::pointer& object,
+                             FetchCallback const& callback) = 0;
 
     /** Get the maximum number of async reads the node store prefers.
         @return The number of async reads preferred.
@@ -110,8 +133,42 @@ public:
     */
     virtual void for_each(std::function <void(NodeObject::Ptr)> f) = 0;
 
-    /** Import objects from another database. */
-    virtual void import (Database& source) = 0;
+    /** Visit every object with a key in a range.
+        The range includes both ends.
+
+        @note This may be called concurrently with itself, but not with
+              other methods.
+        @see import
+    */
+    virtual void for_each(std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last) = 0;
+
+    /** Returns `true` if every backend can visit a range of keys without
+        reading the rest.
+        @see Backend::hasOrderedKeys
+    */
+    virtual bool hasOrderedKeys () = 0;
+
+    /** Import objects from another database.
+        The source is read and the objects are checked and written on
+        several threads. With a checkpoint file, an import that was
+        interrupted continues where it left off when it is run again with
+        the same file. The file is removed when the import completes.
+
+        @param source The database to copy from.
+        @param checkpoint The path of the checkpoint file, or empty for none.
+    */
+    virtual void import (Database& source,
+        std::string const& checkpoint = std::string ()) = 0;
+
+    /** Copy objects into the fast backend ahead of time.
+        This is used at startup, when the fast backend may have lost its
+        contents, to load the nodes that are likely to be read soon.
+        Nothing already in the fast backend is evicted to make room.
+
+        @return `false` if there is no fast backend or it is full.
+    */
+    virtual bool warm (Batch const& batch) = 0;
 
     /** Retrieve the estimated number of pending write operations.
         This is used for diagnostics.
@@ -121,12 +178,65 @@ public:
     // VFALCO TODO Document this.
     virtual float getCacheHitRate () = 0;
 
-    // VFALCO TODO Document this.
-    //        TODO Document the parameter meanings.
-    virtual void tune (int size, int age) = 0;
+    /** Retrieve the approximate memory used by objects in the cache. */
+    virtual std::size_t getCacheBytes () = 0;
+
+    /** Retrieve the approximate memory used by the negative cache. */
+    virtual std::size_t getNegativeCacheBytes () = 0;
+
+    /** Set the cache limits.
+        @param size The target number of cached objects, or zero for no limit.
+        @param age The target age of cached objects, in seconds.
+        @param bytes The target memory used by cached objects, or zero for
+                     no limit. The negative cache is given a small share
+                     of this on top.
+    */
+    virtual void tune (int size, int age, std::size_t bytes) = 0;
 
     // VFALCO TODO Document this.
     virtual void sweep () = 0;
+
+    //--------------------------------------------------------------------------
+
+    /** Keeps fetches on the current thread from filling the cache.
+        Bulk walks over a whole ledger hold one of these while they run, so
+        that the nodes they read from disk do not push the working set out
+        of the cache. Objects that are already cached are still returned.
+        Scopes may be nested.
+    */
+    class ScopedNoCache : public beast::Uncopyable
+    {
+    public:
+        ScopedNoCache ();
+        ~ScopedNoCache ();
+
+        /** Returns `true` if the current thread is inside a scope. */
+        static bool active ();
+    };
+
+    /** Waits for a group of asynchronous fetches.
+        Each callback handed out counts as one outstanding fetch, until it
+        is called. The destructor waits for any that are left.
+    */
+    class FetchWaiter : public beast::Uncopyable
+    {
+    public:
+        FetchWaiter ();
+        ~FetchWaiter ();
+
+        /** Returns a callback to pass to asyncFetch. */
+        FetchCallback callback ();
+
+        /** Block until every callback handed out has been called. */
+        void wait ();
+
+    private:
+        void onFetch ();
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        int m_pending;
+    };
 };
 
 }
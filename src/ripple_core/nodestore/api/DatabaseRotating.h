@@ -0,0 +1,69 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_NODESTORE_DATABASEROTATING_H_INCLUDED
+#define RIPPLE_NODESTORE_DATABASEROTATING_H_INCLUDED
+
+namespace ripple {
+namespace NodeStore {
+
+/** A Database whose old objects can be dropped a backend at a time.
+
+    There are two backends. New objects are written to the writable one,
+    and fetches look in the writable one and then in the archive. Rotating
+    makes the writable backend the archive and starts a new writable one,
+    and the old archive is handed back so its files can be removed.
+
+    Anything that is only in the archive is lost at the next rotation, so
+    objects that must be kept are copied into the writable backend first.
+
+    @see Manager::make_DatabaseRotating
+*/
+class DatabaseRotating : public Database
+{
+public:
+    /** Write objects straight to the writable backend.
+        This is used to carry objects forward before a rotation. The
+        objects are written before this returns, and are not cached.
+
+        @note This can be called concurrently with fetches and stores.
+    */
+    virtual void copyToWritable (Batch const& batch) = 0;
+
+    /** Returns `true` if there is an archive backend. */
+    virtual bool hasArchive () = 0;
+
+    /** Make a new backend the writable one.
+        The writable backend becomes the archive. The previous archive is
+        returned, or nullptr if there was none. Fetches that started
+        before the rotation may still hold references to it for a moment,
+        so the caller should wait until it is the only owner before
+        removing any files. When an archive is dropped the cache is
+        cleared, so its objects can't be served from there either.
+
+        @note This can be called concurrently with fetches and stores.
+    */
+    virtual std::shared_ptr <Backend> rotate (
+        std::unique_ptr <Backend> newBackend) = 0;
+};
+
+}
+}
+
+#endif
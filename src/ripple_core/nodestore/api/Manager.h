@@ -55,7 +55,9 @@ public:
             HyperLevelDB, LevelDBFactory, SQLite, MDB
 
         If the fastBackendParameter is omitted or empty, no ephemeral database
-        is used. If the scheduler parameter is omited or unspecified, a
+        is used. Its 'max_mb' key, when present, bounds the ephemeral
+        database, which then drops the objects that are not being read.
+        If the scheduler parameter is omited or unspecified, a
         synchronous scheduler is used which performs all tasks immediately on
         the caller's thread.
 
@@ -73,6 +75,24 @@ public:
         Scheduler& scheduler, beast::Journal journal, int readThreads,
             Parameters const& backendParameters,
                 Parameters fastBackendParameters = Parameters ()) = 0;
+
+    /** Construct a node store database that can drop old objects.
+
+        The backends are created by the caller, usually with make_Backend,
+        so that it can choose where each one lives.
+
+        @param writable The backend new objects are written to.
+        @param archive [optional] The backend holding the previous objects.
+
+        The other parameters are the same as for make_Database.
+
+        @see DatabaseRotating
+    */
+    virtual std::unique_ptr <DatabaseRotating> make_DatabaseRotating (
+        std::string const& name, Scheduler& scheduler, beast::Journal journal,
+            int readThreads, std::unique_ptr <Backend> writable,
+                std::unique_ptr <Backend> archive,
+                    Parameters fastBackendParameters = Parameters ()) = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -30,6 +30,15 @@ struct FetchReport
     bool isAsync;
     bool wentToDisk;
     bool wasFound;
+    int fetchCount;
+
+    // Objects found in the fast backend, and those it didn't have
+    int fastHits;
+    int fastMisses;
+
+    // Time spent in the fast backend, and in the main backend
+    std::chrono::microseconds fastElapsed;
+    std::chrono::microseconds backendElapsed;
 };
 
 /** Contains information about a batch write operation. */
@@ -28,6 +28,7 @@ class LevelDBBackend
 public:
     beast::Journal m_journal;
     size_t const m_keyBytes;
+    bool const m_compactInnerNodes;
     Scheduler& m_scheduler;
     BatchWriter m_batch;
     std::string m_name;
@@ -37,6 +38,7 @@ public:
         Scheduler& scheduler, beast::Journal journal)
         : m_journal (journal)
         , m_keyBytes (keyBytes)
+        , m_compactInnerNodes (EncodedBlob::compactInnerNodes (keyValues))
         , m_scheduler (scheduler)
         , m_batch (*this, scheduler)
         , m_name (keyValues ["path"].toStdString ())
@@ -98,15 +100,48 @@ public:
     Status
     fetch (void const* key, NodeObject::Ptr* pObject)
     {
-        pObject->reset ();
-
-        Status status (ok);
-
         leveldb::ReadOptions const options;
         leveldb::Slice const slice (static_cast <char const*> (key), m_keyBytes);
+
+        std::string string;
+
+        return decode (key, m_db->Get (options, slice, &string), string, pObject);
+    }
+
+    void
+    fetchBatch (std::vector <void const*> const& keys,
+        std::vector <Status>& results, Batch& objects)
+    {
+        results.resize (keys.size ());
+        objects.resize (keys.size ());
+
+        // Read in key order from a single snapshot, so that neighbouring
+        // keys are found in blocks that were just loaded.
+        leveldb::ReadOptions options;
+        options.snapshot = m_db->GetSnapshot ();
+
         std::string string;
 
-        leveldb::Status getStatus = m_db->Get (options, slice, &string);
+        for (auto const i : getKeyOrder (keys, m_keyBytes))
+        {
+            leveldb::Slice const slice (
+                static_cast <char const*> (keys [i]), m_keyBytes);
+
+            results [i] = decode (keys [i],
+                m_db->Get (options, slice, &string), string, &objects [i]);
+        }
+
+        m_db->ReleaseSnapshot (options.snapshot);
+    }
+
+    // Turn the outcome of a Get into a fetch result
+    Status
+    decode (void const* key, leveldb::Status const& getStatus,
+        std::string const& string, NodeObject::Ptr* pObject)
+    {
+        pObject->reset ();
+
+        Status status (ok);
 
         if (getStatus.ok ())
         {
@@ -153,7 +188,7 @@ public:
     {
         leveldb::WriteBatch wb;
 
-        EncodedBlob encoded;
+        EncodedBlob encoded (m_compactInnerNodes);
 
         for (auto const& e : batch)
         {
@@ -207,6 +242,46 @@ public:
         }
     }
 
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+        leveldb::ReadOptions const options;
+
+        std::unique_ptr <leveldb::Iterator> it (m_db->NewIterator (options));
+
+        leveldb::Slice const end (reinterpret_cast <char const*> (
+            last.begin ()), m_keyBytes);
+
+        for (it->Seek (leveldb::Slice (reinterpret_cast <char const*> (
+                first.begin ()), m_keyBytes));
+            it->Valid () && it->key ().compare (end) <= 0; it->Next ())
+        {
+            if (it->key ().size () == m_keyBytes)
+            {
+                DecodedBlob decoded (it->key ().data (),
+                    it->value ().data (), it->value ().size ());
+
+                if (decoded.wasOk ())
+                {
+                    f (decoded.createObject ());
+                }
+                else
+                {
+                    // Uh oh, corrupted data!
+                    if (m_journal.fatal) m_journal.fatal <<
+                        "Corrupt NodeObject #" << uint256 (it->key ().data ());
+                }
+            }
+        }
+    }
+
+    bool
+    hasOrderedKeys ()
+    {
+        return true;
+    }
+
     int
     getWriteLoad ()
     {
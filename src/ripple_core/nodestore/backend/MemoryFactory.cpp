@@ -93,6 +93,21 @@ public:
             f (e.second);
     }
 
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+        for (auto iter (m_map.lower_bound (first));
+            iter != m_map.end () && iter->first <= last; ++iter)
+            f (iter->second);
+    }
+
+    bool
+    hasOrderedKeys ()
+    {
+        return true;
+    }
+
     int
     getWriteLoad ()
     {
@@ -58,6 +58,18 @@ public:
     {
     }
 
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+    }
+
+    bool
+    hasOrderedKeys ()
+    {
+        return true;
+    }
+
     int
     getWriteLoad ()
     {
@@ -82,6 +82,7 @@ class RocksDBBackend
 public:
     beast::Journal m_journal;
     size_t const m_keyBytes;
+    bool const m_compactInnerNodes;
     Scheduler& m_scheduler;
     BatchWriter m_batch;
     std::string m_name;
@@ -91,6 +92,7 @@ public:
         Scheduler& scheduler, beast::Journal journal, RocksDBEnv* env)
         : m_journal (journal)
         , m_keyBytes (keyBytes)
+        , m_compactInnerNodes (EncodedBlob::compactInnerNodes (keyValues))
         , m_scheduler (scheduler)
         , m_batch (*this, scheduler)
         , m_name (keyValues ["path"].toStdString ())
@@ -186,16 +188,44 @@ public:
     Status
     fetch (void const* key, NodeObject::Ptr* pObject)
     {
-        pObject->reset ();
-
-        Status status (ok);
-
         rocksdb::ReadOptions const options;
         rocksdb::Slice const slice (static_cast <char const*> (key), m_keyBytes);
 
         std::string string;
 
-        rocksdb::Status getStatus = m_db->Get (options, slice, &string);
+        return decode (key, m_db->Get (options, slice, &string), string, pObject);
+    }
+
+    void
+    fetchBatch (std::vector <void const*> const& keys,
+        std::vector <Status>& results, Batch& objects)
+    {
+        results.resize (keys.size ());
+        objects.resize (keys.size ());
+
+        std::vector <rocksdb::Slice> slices;
+        slices.reserve (keys.size ());
+        for (auto const key : keys)
+            slices.emplace_back (static_cast <char const*> (key), m_keyBytes);
+
+        rocksdb::ReadOptions const options;
+        std::vector <std::string> strings;
+
+        std::vector <rocksdb::Status> const getStatus (
+            m_db->MultiGet (options, slices, &strings));
+
+        for (std::size_t i = 0; i < keys.size (); ++i)
+            results [i] = decode (keys [i], getStatus [i], strings [i], &objects [i]);
+    }
+
+    // Turn the outcome of a Get into a fetch result
+    Status
+    decode (void const* key, rocksdb::Status const& getStatus,
+        std::string const& string, NodeObject::Ptr* pObject)
+    {
+        pObject->reset ();
+
+        Status status (ok);
 
         if (getStatus.ok ())
         {
@@ -244,7 +274,7 @@ public:
     {
         rocksdb::WriteBatch wb;
 
-        EncodedBlob encoded;
+        EncodedBlob encoded (m_compactInnerNodes);
 
         for (auto const& e : batch)
         {
@@ -298,6 +328,46 @@ public:
         }
     }
 
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+        rocksdb::ReadOptions const options;
+
+        std::unique_ptr <rocksdb::Iterator> it (m_db->NewIterator (options));
+
+        rocksdb::Slice const end (reinterpret_cast <char const*> (
+            last.begin ()), m_keyBytes);
+
+        for (it->Seek (rocksdb::Slice (reinterpret_cast <char const*> (
+                first.begin ()), m_keyBytes));
+            it->Valid () && it->key ().compare (end) <= 0; it->Next ())
+        {
+            if (it->key ().size () == m_keyBytes)
+            {
+                DecodedBlob decoded (it->key ().data (),
+                    it->value ().data (), it->value ().size ());
+
+                if (decoded.wasOk ())
+                {
+                    f (decoded.createObject ());
+                }
+                else
+                {
+                    // Uh oh, corrupted data!
+                    if (m_journal.fatal) m_journal.fatal <<
+                        "Corrupt NodeObject #" << uint256 (it->key ().data ());
+                }
+            }
+        }
+    }
+
+    bool
+    hasOrderedKeys ()
+    {
+        return true;
+    }
+
     int
     getWriteLoad ()
     {
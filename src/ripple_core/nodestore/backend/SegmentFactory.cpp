@@ -0,0 +1,833 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#if RIPPLE_SEGMENTDB_AVAILABLE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+namespace ripple {
+namespace NodeStore {
+
+/** Open addressing hash table from key prefixes to record locations.
+
+    Keys are hashes, so their first eight bytes are used directly, both as
+    the prefix and to choose the slot. Different keys can share a prefix,
+    so a match is only a candidate, and the caller compares the full key
+    stored with the record. Each entry takes 16 bytes.
+*/
+class SegmentIndex
+{
+public:
+    struct Entry
+    {
+        std::uint64_t prefix;
+        std::uint32_t segment;  // zero marks an empty slot
+        std::uint32_t offset;
+    };
+
+    SegmentIndex ()
+        : m_table (minimumCapacity)
+        , m_size (0)
+    {
+    }
+
+    std::size_t size () const
+    {
+        return m_size;
+    }
+
+    std::size_t capacity () const
+    {
+        return m_table.size ();
+    }
+
+    void insert (std::uint64_t prefix, std::uint32_t segment, std::uint32_t offset)
+    {
+        assert (segment != 0);
+
+        // Keep the load factor under 70%
+        if ((m_size + 1) * 10 > m_table.size () * 7)
+            rehash (m_table.size () * 2);
+
+        Entry e;
+        e.prefix = prefix;
+        e.segment = segment;
+        e.offset = offset;
+        place (m_table, e);
+        ++m_size;
+    }
+
+    /** Call the function with each location stored under the prefix.
+        Stops when the function returns `true`.
+        @return `true` if the function returned `true`.
+    */
+    template <class Function>
+    bool find (std::uint64_t prefix, Function f) const
+    {
+        std::size_t const mask (m_table.size () - 1);
+
+        for (std::size_t i (prefix & mask); m_table [i].segment != 0; i = (i + 1) & mask)
+        {
+            if (m_table [i].prefix == prefix &&
+                f (m_table [i].segment, m_table [i].offset))
+                return true;
+        }
+
+        return false;
+    }
+
+    /** Remove every location in the segment. */
+    void eraseSegment (std::uint32_t segment)
+    {
+        std::vector <Entry> table (m_table.size ());
+
+        m_size = 0;
+        for (auto const& e : m_table)
+        {
+            if (e.segment != 0 && e.segment != segment)
+            {
+                place (table, e);
+                ++m_size;
+            }
+        }
+
+        m_table.swap (table);
+    }
+
+private:
+    static std::size_t const minimumCapacity = 1024;
+
+    static void place (std::vector <Entry>& table, Entry const& e)
+    {
+        std::size_t const mask (table.size () - 1);
+
+        std::size_t i (e.prefix & mask);
+        while (table [i].segment != 0)
+            i = (i + 1) & mask;
+
+        table [i] = e;
+    }
+
+    void rehash (std::size_t capacity)
+    {
+        std::vector <Entry> table (capacity);
+
+        for (auto const& e : m_table)
+        {
+            if (e.segment != 0)
+                place (table, e);
+        }
+
+        m_table.swap (table);
+    }
+
+    std::vector <Entry> m_table;
+    std::size_t m_size;
+};
+
+//------------------------------------------------------------------------------
+
+/** An append-only file of records, mapped into memory for reading.
+
+    A record is the key, the size of the value as a big-endian 32-bit
+    number, and then the value in the EncodedBlob format. A new file is
+    extended to its full size up front. The unused tail reads as zeroes,
+    so a record with an empty value marks the end.
+
+    Records are written with pwrite, so that running out of disk space is
+    an error rather than a signal, and read through the mapping without
+    an intermediate copy.
+*/
+class Segment : public beast::Uncopyable
+{
+public:
+    static std::size_t const headerBytes = sizeof (std::uint32_t);
+
+    Segment (std::string const& path, std::uint32_t id,
+        std::size_t keyBytes, std::size_t capacity)
+        : m_path (path)
+        , m_id (id)
+        , m_keyBytes (keyBytes)
+        , m_capacity (capacity)
+        , m_fd (-1)
+        , m_data (nullptr)
+        , m_size (0)
+        , m_remove (false)
+    {
+        m_fd = ::open (m_path.c_str (), O_RDWR | O_CREAT, 0644);
+        if (m_fd == -1)
+            fail ("Unable to open segment");
+
+        struct stat st;
+        if (::fstat (m_fd, &st) != 0)
+            fail ("Unable to stat segment");
+
+        if (st.st_size == 0)
+        {
+            if (::ftruncate (m_fd, m_capacity) != 0)
+                fail ("Unable to size segment");
+        }
+        else
+        {
+            // An existing segment keeps the size it was created with
+            m_capacity = static_cast <std::size_t> (st.st_size);
+        }
+
+        void* const data (::mmap (nullptr, m_capacity, PROT_READ, MAP_SHARED, m_fd, 0));
+        if (data == MAP_FAILED)
+            fail ("Unable to map segment");
+
+        m_data = static_cast <unsigned char const*> (data);
+    }
+
+    ~Segment ()
+    {
+        if (m_data != nullptr)
+            ::munmap (const_cast <unsigned char*> (m_data), m_capacity);
+
+        if (m_fd != -1)
+            ::close (m_fd);
+
+        if (m_remove)
+            ::unlink (m_path.c_str ());
+    }
+
+    std::uint32_t getId () const
+    {
+        return m_id;
+    }
+
+    /** Returns the number of bytes of records. */
+    std::size_t getSize () const
+    {
+        return m_size.load ();
+    }
+
+    std::size_t getCapacity () const
+    {
+        return m_capacity;
+    }
+
+    unsigned char const* getKey (std::uint32_t offset) const
+    {
+        return m_data + offset;
+    }
+
+    unsigned char const* getValue (std::uint32_t offset) const
+    {
+        return m_data + offset + m_keyBytes + headerBytes;
+    }
+
+    std::uint32_t getValueBytes (std::uint32_t offset) const
+    {
+        std::uint32_t bytes;
+        memcpy (&bytes, m_data + offset + m_keyBytes, sizeof (bytes));
+        return beast::ByteOrder::swapIfLittleEndian (bytes);
+    }
+
+    /** Call the function with each record that lies before the limit.
+        @return The offset just past the last record.
+    */
+    template <class Function>
+    std::size_t scan (Function f, std::size_t limit) const
+    {
+        std::size_t offset (0);
+
+        while (offset + m_keyBytes + headerBytes <= limit)
+        {
+            std::uint32_t const bytes (getValueBytes (offset));
+
+            if (bytes == 0 || offset + getRecordBytes (bytes) > limit)
+                break;
+
+            f (static_cast <std::uint32_t> (offset));
+            offset += getRecordBytes (bytes);
+        }
+
+        return offset;
+    }
+
+    /** Find the end of the records in an existing segment. */
+    template <class Function>
+    void recover (Function f)
+    {
+        m_size = scan (f, m_capacity);
+    }
+
+    /** Append a record.
+        @return `false` if the segment doesn't have room for it.
+    */
+    bool append (void const* key, void const* value,
+        std::uint32_t bytes, std::uint32_t& offset)
+    {
+        std::size_t const size (m_size.load ());
+
+        if (size + getRecordBytes (bytes) > m_capacity)
+            return false;
+
+        m_buffer.resize (getRecordBytes (bytes));
+        std::uint32_t const header (beast::ByteOrder::swapIfLittleEndian (bytes));
+        memcpy (&m_buffer [0], key, m_keyBytes);
+        memcpy (&m_buffer [m_keyBytes], &header, headerBytes);
+        memcpy (&m_buffer [m_keyBytes + headerBytes], value, bytes);
+
+        std::size_t written (0);
+        while (written < m_buffer.size ())
+        {
+            ssize_t const result (::pwrite (m_fd, &m_buffer [written],
+                m_buffer.size () - written, size + written));
+
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                fail ("Unable to write segment");
+            }
+
+            written += result;
+        }
+
+        offset = static_cast <std::uint32_t> (size);
+        m_size = size + m_buffer.size ();
+        return true;
+    }
+
+    /** Delete the file once the last reference goes away. */
+    void remove ()
+    {
+        m_remove = true;
+    }
+
+private:
+    std::size_t getRecordBytes (std::uint32_t bytes) const
+    {
+        return m_keyBytes + headerBytes + bytes;
+    }
+
+    void fail (std::string const& what)
+    {
+        throw std::runtime_error (what + " '" + m_path + "': " +
+            std::strerror (errno));
+    }
+
+    std::string const m_path;
+    std::uint32_t const m_id;
+    std::size_t const m_keyBytes;
+    std::size_t m_capacity;
+    int m_fd;
+    unsigned char const* m_data;
+    std::atomic <std::size_t> m_size;
+    std::atomic <bool> m_remove;
+
+    // Only used by the writer
+    std::vector <unsigned char> m_buffer;
+};
+
+//------------------------------------------------------------------------------
+
+/** Stores objects in a series of append-only segment files.
+
+    Objects are content-addressed and never change, so nothing is ever
+    rewritten: new objects are appended to the current segment, and when
+    it fills up a new one is started. An in-memory index, rebuilt from the
+    segments when the backend is opened, maps each key to its record.
+
+    Space is reclaimed a whole segment at a time with deleteSegment. An
+    object still needed after that is stored again first, which copies it
+    into the current segment.
+*/
+class SegmentBackend
+    : public Backend
+    , public BatchWriter::Callback
+    , public beast::LeakChecked <SegmentBackend>
+{
+public:
+    typedef std::shared_ptr <Segment> SegmentPtr;
+
+    static std::size_t const defaultSegmentMegabytes = 256;
+    static std::size_t const maxSegmentMegabytes = 4095;
+    static std::size_t const indexShards = 16;
+
+    beast::Journal m_journal;
+    size_t const m_keyBytes;
+    bool const m_compactInnerNodes;
+    Scheduler& m_scheduler;
+    beast::File m_path;
+    std::size_t m_segmentBytes;
+
+    // Serialises writers, and protects m_current
+    std::mutex m_writeMutex;
+    SegmentPtr m_current;
+
+    // Every segment by id, oldest first
+    std::mutex m_segmentMutex;
+    std::map <std::uint32_t, SegmentPtr> m_segments;
+
+    // The key index, split by key to spread out the locking
+    struct IndexShard
+    {
+        std::mutex mutex;
+        SegmentIndex index;
+    };
+
+    std::array <IndexShard, indexShards> m_index;
+
+    // Declared last, so that pending writes are flushed first
+    BatchWriter m_batch;
+
+    SegmentBackend (size_t keyBytes, Parameters const& keyValues,
+        Scheduler& scheduler, beast::Journal journal)
+        : m_journal (journal)
+        , m_keyBytes (keyBytes)
+        , m_compactInnerNodes (EncodedBlob::compactInnerNodes (keyValues))
+        , m_scheduler (scheduler)
+        , m_segmentBytes (defaultSegmentMegabytes << 20)
+        , m_batch (*this, scheduler)
+    {
+        assert (m_keyBytes >= sizeof (std::uint64_t) + 1);
+
+        if (keyValues ["path"].isEmpty ())
+            throw std::runtime_error ("Missing path in SegmentFactory backend");
+
+        m_path = beast::File (keyValues ["path"]);
+
+        if (! keyValues ["segment_mb"].isEmpty ())
+        {
+            int const mb (keyValues ["segment_mb"].getIntValue ());
+            if (mb < 1 || mb > int (maxSegmentMegabytes))
+                throw std::runtime_error ("Invalid segment_mb in SegmentFactory backend");
+            m_segmentBytes = std::size_t (mb) << 20;
+        }
+
+        beast::Result const result (m_path.createDirectory ());
+        if (result.failed ())
+            throw std::runtime_error ("Unable to create segment directory: " +
+                result.getErrorMessage ().toStdString ());
+
+        open ();
+    }
+
+    std::string
+    getName ()
+    {
+        return m_path.getFullPathName ().toStdString ();
+    }
+
+    //--------------------------------------------------------------------------
+
+    Status
+    fetch (void const* key, NodeObject::Ptr* pObject)
+    {
+        pObject->reset ();
+
+        SegmentPtr segment;
+        std::uint32_t offset;
+
+        if (! find (key, segment, offset))
+            return notFound;
+
+        DecodedBlob decoded (key, segment->getValue (offset),
+            segment->getValueBytes (offset));
+
+        if (! decoded.wasOk ())
+            return dataCorrupt;
+
+        *pObject = decoded.createObject ();
+        return ok;
+    }
+
+    void
+    store (NodeObject::ref object)
+    {
+        m_batch.store (object);
+    }
+
+    void
+    storeBatch (Batch const& batch)
+    {
+        std::lock_guard <std::mutex> lock (m_writeMutex);
+
+        EncodedBlob encoded (m_compactInnerNodes);
+
+        for (auto const& e : batch)
+        {
+            encoded.prepare (e);
+
+            // Objects never change, so one copy per segment is enough.
+            // A copy in an older segment doesn't count: storing the object
+            // again carries it forward, so it survives deleteSegment.
+            if (contains (m_current, encoded.getKey ()))
+                continue;
+
+            append (encoded);
+        }
+    }
+
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f)
+    {
+        for (auto const& segment : getSegmentList ())
+        {
+            segment->scan ([&](std::uint32_t offset)
+            {
+                DecodedBlob decoded (segment->getKey (offset),
+                    segment->getValue (offset), segment->getValueBytes (offset));
+
+                if (decoded.wasOk ())
+                {
+                    f (decoded.createObject ());
+                }
+                else
+                {
+                    // Uh oh, corrupted data!
+                    if (m_journal.fatal) m_journal.fatal <<
+                        "Corrupt NodeObject #" << uint256::fromVoid (segment->getKey (offset));
+                }
+            }, segment->getSize ());
+        }
+    }
+
+    void
+    for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
+    {
+        // Segments are in write order, so every key is looked at, but
+        // only the objects in the range are decoded. Import avoids this
+        // by making one pass, since hasOrderedKeys returns false.
+        for (auto const& segment : getSegmentList ())
+        {
+            segment->scan ([&](std::uint32_t offset)
+            {
+                unsigned char const* const key (segment->getKey (offset));
+
+                if (memcmp (key, first.begin (), m_keyBytes) < 0 ||
+                    memcmp (key, last.begin (), m_keyBytes) > 0)
+                    return;
+
+                DecodedBlob decoded (key,
+                    segment->getValue (offset), segment->getValueBytes (offset));
+
+                if (decoded.wasOk ())
+                {
+                    f (decoded.createObject ());
+                }
+                else
+                {
+                    // Uh oh, corrupted data!
+                    if (m_journal.fatal) m_journal.fatal <<
+                        "Corrupt NodeObject #" << uint256::fromVoid (key);
+                }
+            }, segment->getSize ());
+        }
+    }
+
+    bool
+    hasOrderedKeys ()
+    {
+        // A range can only be found by scanning every segment
+        return false;
+    }
+
+    int
+    getWriteLoad ()
+    {
+        return m_batch.getWriteLoad ();
+    }
+
+    //--------------------------------------------------------------------------
+
+    void
+    writeBatch (Batch const& batch)
+    {
+        storeBatch (batch);
+    }
+
+    //--------------------------------------------------------------------------
+
+    /** Returns the ids of the segments, oldest first. */
+    std::vector <std::uint32_t>
+    getSegments ()
+    {
+        std::vector <std::uint32_t> ids;
+        for (auto const& segment : getSegmentList ())
+            ids.push_back (segment->getId ());
+        return ids;
+    }
+
+    /** Start writing to a new segment.
+        @return The id of the segment that was being written.
+    */
+    std::uint32_t
+    rotate ()
+    {
+        std::lock_guard <std::mutex> lock (m_writeMutex);
+        return rotateLocked ();
+    }
+
+    /** Delete a segment and forget every object in it.
+        The segment being written can't be deleted, rotate first.
+        @return `false` if there is no such segment, or it is current.
+    */
+    bool
+    deleteSegment (std::uint32_t id)
+    {
+        std::lock_guard <std::mutex> lock (m_writeMutex);
+
+        if (m_current->getId () == id)
+            return false;
+
+        SegmentPtr segment (getSegment (id));
+        if (! segment)
+            return false;
+
+        for (auto& shard : m_index)
+        {
+            std::lock_guard <std::mutex> lock (shard.mutex);
+            shard.index.eraseSegment (id);
+        }
+
+        {
+            std::lock_guard <std::mutex> lock (m_segmentMutex);
+            m_segments.erase (id);
+        }
+
+        // The file goes away when the last reader lets go of it
+        segment->remove ();
+
+        if (m_journal.info) m_journal.info <<
+            "Deleted segment " << id << " of '" << getName () << "'";
+
+        return true;
+    }
+
+private:
+    void
+    open ()
+    {
+        beast::Array <beast::File> files;
+        m_path.findChildFiles (files, beast::File::findFiles, false, "*.seg");
+
+        std::vector <std::uint32_t> ids;
+        for (int i = 0; i < files.size (); ++i)
+        {
+            std::string const name (
+                files [i].getFileNameWithoutExtension ().toStdString ());
+            std::uint32_t const id (std::strtoul (name.c_str (), nullptr, 16));
+            if (id != 0)
+                ids.push_back (id);
+        }
+        std::sort (ids.begin (), ids.end ());
+
+        for (auto const id : ids)
+        {
+            SegmentPtr const segment (openSegment (id));
+
+            segment->recover ([&](std::uint32_t offset)
+            {
+                insert (segment->getKey (offset), id, offset);
+            });
+
+            m_segments [id] = segment;
+            m_current = segment;
+        }
+
+        if (! m_current)
+        {
+            m_current = openSegment (1);
+            m_segments [1] = m_current;
+        }
+    }
+
+    SegmentPtr
+    openSegment (std::uint32_t id)
+    {
+        char name [16];
+        std::snprintf (name, sizeof (name), "%08x.seg", id);
+
+        return std::make_shared <Segment> (
+            m_path.getChildFile (name).getFullPathName ().toStdString (),
+                id, m_keyBytes, m_segmentBytes);
+    }
+
+    // Called with the write lock held
+    std::uint32_t
+    rotateLocked ()
+    {
+        std::uint32_t const id (m_current->getId ());
+
+        SegmentPtr const segment (openSegment (id + 1));
+
+        {
+            std::lock_guard <std::mutex> lock (m_segmentMutex);
+            m_segments [segment->getId ()] = segment;
+        }
+
+        m_current = segment;
+        return id;
+    }
+
+    // Called with the write lock held
+    void
+    append (EncodedBlob const& encoded)
+    {
+        std::uint32_t const bytes (static_cast <std::uint32_t> (encoded.getSize ()));
+        std::uint32_t offset;
+
+        if (! m_current->append (encoded.getKey (), encoded.getData (), bytes, offset))
+        {
+            rotateLocked ();
+
+            if (! m_current->append (encoded.getKey (), encoded.getData (), bytes, offset))
+                throw std::runtime_error ("NodeObject is larger than a segment");
+        }
+
+        insert (encoded.getKey (), m_current->getId (), offset);
+    }
+
+    static std::uint64_t
+    getPrefix (void const* key)
+    {
+        std::uint64_t prefix;
+        memcpy (&prefix, key, sizeof (prefix));
+        return prefix;
+    }
+
+    IndexShard&
+    getShard (void const* key)
+    {
+        // Use a byte that isn't part of the prefix
+        unsigned char const* const p (static_cast <unsigned char const*> (key));
+        return m_index [p [sizeof (std::uint64_t)] % indexShards];
+    }
+
+    void
+    insert (void const* key, std::uint32_t id, std::uint32_t offset)
+    {
+        IndexShard& shard (getShard (key));
+        std::lock_guard <std::mutex> lock (shard.mutex);
+        shard.index.insert (getPrefix (key), id, offset);
+    }
+
+    bool
+    find (void const* key, SegmentPtr& segment, std::uint32_t& offset)
+    {
+        IndexShard& shard (getShard (key));
+        std::lock_guard <std::mutex> lock (shard.mutex);
+
+        return shard.index.find (getPrefix (key),
+            [&](std::uint32_t id, std::uint32_t at)
+            {
+                SegmentPtr const candidate (getSegment (id));
+
+                if (! candidate ||
+                    memcmp (candidate->getKey (at), key, m_keyBytes) != 0)
+                    return false;
+
+                segment = candidate;
+                offset = at;
+                return true;
+            });
+    }
+
+    // True if the segment holds a record for the key
+    bool
+    contains (SegmentPtr const& segment, void const* key)
+    {
+        IndexShard& shard (getShard (key));
+        std::lock_guard <std::mutex> lock (shard.mutex);
+
+        return shard.index.find (getPrefix (key),
+            [&](std::uint32_t id, std::uint32_t at)
+            {
+                return id == segment->getId () &&
+                    memcmp (segment->getKey (at), key, m_keyBytes) == 0;
+            });
+    }
+
+    SegmentPtr
+    getSegment (std::uint32_t id)
+    {
+        std::lock_guard <std::mutex> lock (m_segmentMutex);
+
+        auto const iter (m_segments.find (id));
+        if (iter == m_segments.end ())
+            return SegmentPtr ();
+
+        return iter->second;
+    }
+
+    std::vector <SegmentPtr>
+    getSegmentList ()
+    {
+        std::lock_guard <std::mutex> lock (m_segmentMutex);
+
+        std::vector <SegmentPtr> list;
+        list.reserve (m_segments.size ());
+        for (auto const& entry : m_segments)
+            list.push_back (entry.second);
+        return list;
+    }
+};
+
+//------------------------------------------------------------------------------
+
+class SegmentFactory : public Factory
+{
+public:
+    beast::String
+    getName () const
+    {
+        return "Segment";
+    }
+
+    std::unique_ptr <Backend>
+    createInstance (
+        size_t keyBytes,
+        Parameters const& keyValues,
+        Scheduler& scheduler,
+        beast::Journal journal)
+    {
+        return std::make_unique <SegmentBackend> (
+            keyBytes, keyValues, scheduler, journal);
+    }
+};
+
+//------------------------------------------------------------------------------
+
+std::unique_ptr <Factory>
+make_SegmentFactory ()
+{
+    return std::make_unique <SegmentFactory> ();
+}
+
+}
+}
+
+#endif
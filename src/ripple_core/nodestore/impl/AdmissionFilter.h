@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_NODESTORE_ADMISSIONFILTER_H_INCLUDED
+#define RIPPLE_NODESTORE_ADMISSIONFILTER_H_INCLUDED
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace ripple {
+namespace NodeStore {
+
+/** Decides which objects read from the backend are worth caching.
+
+    Every miss is remembered in a small Bloom filter. When the cache is
+    full, an object is only admitted if its key has missed before within
+    the recent window. A scan that reads each node once therefore cannot
+    push out the working set, while a node that keeps coming back is
+    admitted on its second miss.
+
+    There are two filters, current and previous. Misses are added to the
+    current one, and when it has seen as many keys as the cache holds it
+    becomes the previous one and a cleared filter takes its place. So the
+    window always covers between one and two cache sizes worth of misses,
+    and the false positive rate stays bounded however long a scan runs.
+
+    Keys are hashes already, so the bit indexes are taken directly from
+    their bits.
+*/
+class AdmissionFilter
+{
+public:
+    explicit AdmissionFilter (std::size_t capacity)
+    {
+        setCapacity (capacity);
+    }
+
+    /** Size the filter for a cache holding about this many objects. */
+    void setCapacity (std::size_t capacity)
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+
+        std::size_t size = minimumCapacity;
+        while (size < capacity)
+            size <<= 1;
+
+        m_current.assign (size * bitsPerKey / 64, 0);
+        m_previous.assign (size * bitsPerKey / 64, 0);
+        m_mask = static_cast <std::uint32_t> (size * bitsPerKey - 1);
+        m_capacity = size;
+        m_inserted = 0;
+    }
+
+    /** Record a miss on the key.
+        @return `true` if the key has missed before and should be cached.
+    */
+    bool admit (uint256 const& key)
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+
+        std::uint32_t index[ways];
+        getIndexes (key, index);
+
+        if (test (m_current, index))
+            return true;
+
+        bool const seen = test (m_previous, index);
+
+        // Remember the key for the next miss
+        for (int i = 0; i < ways; ++i)
+            m_current [index[i] >> 6] |= std::uint64_t (1) << (index[i] & 63);
+
+        if (++m_inserted >= m_capacity)
+        {
+            m_previous.swap (m_current);
+            std::fill (m_current.begin (), m_current.end (), 0);
+            m_inserted = 0;
+        }
+
+        return seen;
+    }
+
+    /** Returns `true` if the key has missed within the window. */
+    bool contains (uint256 const& key) const
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+
+        std::uint32_t index[ways];
+        getIndexes (key, index);
+
+        return test (m_current, index) || test (m_previous, index);
+    }
+
+private:
+    typedef std::vector <std::uint64_t> Bits;
+
+    static int const ways = 4;
+    static std::size_t const bitsPerKey = 16;
+    static std::size_t const minimumCapacity = 1024;
+
+    void getIndexes (uint256 const& key, std::uint32_t* index) const
+    {
+        unsigned char const* const p (key.begin ());
+        for (int i = 0; i < ways; ++i)
+        {
+            std::uint32_t v;
+            memcpy (&v, p + 4 * i, sizeof (v));
+            index[i] = v & m_mask;
+        }
+    }
+
+    static bool test (Bits const& bits, std::uint32_t const* index)
+    {
+        for (int i = 0; i < ways; ++i)
+        {
+            if ((bits [index[i] >> 6] & (std::uint64_t (1) << (index[i] & 63))) == 0)
+                return false;
+        }
+        return true;
+    }
+
+    std::mutex mutable m_mutex;
+    Bits m_current;
+    Bits m_previous;
+    std::uint32_t m_mask;
+    std::size_t m_capacity;
+    std::size_t m_inserted;
+};
+
+}
+}
+
+#endif
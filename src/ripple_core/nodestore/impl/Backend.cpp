@@ -24,5 +24,31 @@ Backend::~Backend ()
 {
 }
 
+void Backend::fetchBatch (std::vector <void const*> const& keys,
+    std::vector <Status>& results, Batch& objects)
+{
+    results.resize (keys.size ());
+    objects.resize (keys.size ());
+
+    for (std::size_t i = 0; i < keys.size (); ++i)
+        results [i] = fetch (keys [i], &objects [i]);
+}
+
+std::vector <std::size_t> Backend::getKeyOrder (
+    std::vector <void const*> const& keys, std::size_t keyBytes)
+{
+    std::vector <std::size_t> order (keys.size ());
+    for (std::size_t i = 0; i < order.size (); ++i)
+        order [i] = i;
+
+    std::sort (order.begin (), order.end (),
+        [&keys, keyBytes](std::size_t lhs, std::size_t rhs)
+        {
+            return memcmp (keys [lhs], keys [rhs], keyBytes) < 0;
+        });
+
+    return order;
+}
+
 }
 }
@@ -24,5 +24,66 @@ Database::~Database ()
 {
 }
 
+//------------------------------------------------------------------------------
+
+static beast::ThreadLocalValue <int>& noCacheDepth ()
+{
+    static beast::ThreadLocalValue <int> depth;
+    return depth;
+}
+
+Database::ScopedNoCache::ScopedNoCache ()
+{
+    ++noCacheDepth ().get ();
+}
+
+Database::ScopedNoCache::~ScopedNoCache ()
+{
+    --noCacheDepth ().get ();
+}
+
+bool Database::ScopedNoCache::active ()
+{
+    return noCacheDepth ().get () > 0;
+}
+
+//------------------------------------------------------------------------------
+
+Database::FetchWaiter::FetchWaiter ()
+    : m_pending (0)
+{
+}
+
+Database::FetchWaiter::~FetchWaiter ()
+{
+    wait ();
+}
+
+Database::FetchCallback Database::FetchWaiter::callback ()
+{
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+        ++m_pending;
+    }
+
+    return std::bind (&FetchWaiter::onFetch, this);
+}
+
+void Database::FetchWaiter::wait ()
+{
+    std::unique_lock <std::mutex> lock (m_mutex);
+    while (m_pending > 0)
+        m_cond.wait (lock);
+}
+
+void Database::FetchWaiter::onFetch ()
+{
+    // Notify while holding the lock, once wait() can return
+    // this object may be destroyed.
+    std::lock_guard <std::mutex> lock (m_mutex);
+    if (--m_pending == 0)
+        m_cond.notify_all ();
+}
+
 }
 }
@@ -30,60 +30,88 @@ namespace ripple {
 namespace NodeStore {
 
 class DatabaseImp
-    : public Database
+    : public DatabaseRotating
     , public beast::LeakChecked <DatabaseImp>
 {
 public:
+    // The negative cache is limited to this fraction of the byte budget
+    static std::size_t const negativeCacheShare = 16;
+
     beast::Journal m_journal;
     Scheduler& m_scheduler;
-    // Persistent key/value storage.
-    std::unique_ptr <Backend> m_backend;
+    // Persistent key/value storage, new objects are written here.
+    std::shared_ptr <Backend> m_backend;
+    // Older objects, when the database is rotated. May be null.
+    std::shared_ptr <Backend> m_archiveBackend;
+    // Protects m_backend and m_archiveBackend, which rotate replaces
+    std::mutex mutable m_rotateMutex;
     // Larger key/value storage, but not necessarily persistent.
-    std::unique_ptr <Backend> m_fastBackend;
+    std::unique_ptr <FastTier> m_fastBackend;
 
     // Positive cache
-    TaggedCache <uint256, NodeObject> m_cache;
+    ShardedTaggedCache <uint256, NodeObject> m_cache;
 
     // Negative cache
     KeyCache <uint256> m_negCache;
 
-    std::mutex                m_readLock;
-    std::condition_variable   m_readCondVar;
-    std::condition_variable   m_readGenCondVar;
-    std::set <uint256>        m_readSet;        // set of reads to do
-    uint256                   m_readLast;       // last hash read
+    // Decides which objects fetched from the backend go in m_cache
+    AdmissionFilter m_admission;
+
+    // The async reads for one read thread. Keys are spread over the
+    // queues by their bits, so producers rarely share a lock.
+    struct ReadQueue
+    {
+        ReadQueue ()
+            : shut (false)
+        {
+        }
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        // Keys to read, each with the callbacks waiting for it
+        std::map <uint256, std::vector <FetchCallback>> pending;
+        // Last key read, reads sweep through the keys in order
+        uint256 last;
+        bool shut;
+    };
+
+    std::vector <std::unique_ptr <ReadQueue>> m_readQueues;
     std::vector <std::thread> m_readThreads;
-    bool                      m_readShut;
-    uint64_t                  m_readGen;        // current read generation
 
     DatabaseImp (std::string const& name,
                  Scheduler& scheduler,
                  int readThreads,
                  std::unique_ptr <Backend> backend,
-                 std::unique_ptr <Backend> fastBackend,
-                 beast::Journal journal)
+                 std::unique_ptr <FastTier> fastBackend,
+                 beast::Journal journal,
+                 std::unique_ptr <Backend> archiveBackend = nullptr)
         : m_journal (journal)
         , m_scheduler (scheduler)
         , m_backend (std::move (backend))
+        , m_archiveBackend (std::move (archiveBackend))
         , m_fastBackend (std::move (fastBackend))
         , m_cache ("NodeStore", cacheTargetSize, cacheTargetSeconds,
-            get_seconds_clock (), LogPartition::getJournal <TaggedCacheLog> ())
+            get_seconds_clock (), LogPartition::getJournal <TaggedCacheLog> (),
+                beast::insight::NullCollector::New (), &DatabaseImp::getCost)
         , m_negCache ("NodeStore", get_seconds_clock (),
             cacheTargetSize, cacheTargetSeconds)
-        , m_readShut (false)
-        , m_readGen (0)
+        , m_admission (cacheTargetSize)
     {
         for (int i = 0; i < readThreads; ++i)
-            m_readThreads.push_back (std::thread (&DatabaseImp::threadEntry, this));
+            m_readQueues.emplace_back (new ReadQueue);
+
+        for (auto& queue : m_readQueues)
+            m_readThreads.push_back (std::thread (
+                &DatabaseImp::threadEntry, this, std::ref (*queue)));
     }
 
     ~DatabaseImp ()
     {
+        for (auto& queue : m_readQueues)
         {
-            std::unique_lock <std::mutex> lock (m_readLock);
-            m_readShut = true;
-            m_readCondVar.notify_all ();
-            m_readGenCondVar.notify_all ();
+            std::unique_lock <std::mutex> lock (queue->mutex);
+            queue->shut = true;
+            queue->cond.notify_all ();
         }
 
         for (auto& e : m_readThreads)
@@ -92,40 +120,77 @@ public:
 
     beast::String getName () const
     {
-        return m_backend->getName ();
+        return getWritableBackend ()->getName ();
+    }
+
+    std::shared_ptr <Backend> getWritableBackend () const
+    {
+        std::lock_guard <std::mutex> lock (m_rotateMutex);
+        return m_backend;
+    }
+
+    std::shared_ptr <Backend> getArchiveBackend () const
+    {
+        std::lock_guard <std::mutex> lock (m_rotateMutex);
+        return m_archiveBackend;
     }
 
     //------------------------------------------------------------------------------
 
     bool asyncFetch (uint256 const& hash, NodeObject::pointer& object)
+    {
+        return asyncFetch (hash, object, FetchCallback ());
+    }
+
+    bool asyncFetch (uint256 const& hash, NodeObject::pointer& object,
+        FetchCallback const& callback)
     {
         // See if the object is in cache
         object = m_cache.fetch (hash);
-        if (object || m_negCache.touch_if_exists (hash))
-            return true;
 
+        if (object == nullptr && ! m_negCache.touch_if_exists (hash))
         {
             // No. Post a read
-            std::unique_lock <std::mutex> lock (m_readLock);
-            if (m_readSet.insert (hash).second)
-                m_readCondVar.notify_one ();
+            if (! m_readQueues.empty () && postRead (hash, callback))
+                return false;
+
+            // Without read threads, just read it now
+            object = doTimedFetch (hash, false);
         }
 
-        return false;
+        if (callback)
+            callback (object);
+
+        return true;
     }
 
-    void waitReads ()
+    // Returns false if the read can't be queued because we are stopping
+    bool postRead (uint256 const& hash, FetchCallback const& callback)
     {
-        {
-            std::unique_lock <std::mutex> lock (m_readLock);
+        ReadQueue& queue (getReadQueue (hash));
+        std::unique_lock <std::mutex> lock (queue.mutex);
 
-            // Wake in two generations
-            std::uint64_t const wakeGeneration = m_readGen + 2;
+        if (queue.shut)
+            return false;
 
-            while (!m_readShut && !m_readSet.empty () && (m_readGen < wakeGeneration))
-                m_readGenCondVar.wait (lock);
-        }
+        auto const result (queue.pending.emplace (
+            hash, std::vector <FetchCallback> ()));
+
+        if (callback)
+            result.first->second.push_back (callback);
+
+        if (result.second)
+            queue.cond.notify_one ();
 
+        return true;
+    }
+
+    ReadQueue& getReadQueue (uint256 const& hash)
+    {
+        // Keys are hashes already, any of their bits will do
+        std::uint32_t v;
+        memcpy (&v, hash.begin (), sizeof (v));
+        return *m_readQueues [v % m_readQueues.size ()];
     }
 
     int getDesiredAsyncReadCount ()
@@ -141,12 +206,23 @@ public:
         return doTimedFetch (hash, false);
     }
 
+    std::vector <NodeObject::Ptr> fetchBatch (
+        std::vector <uint256> const& hashes) override
+    {
+        return doTimedFetchBatch (hashes, false);
+    }
+
     /** Perform a fetch and report the time it took */
     NodeObject::Ptr doTimedFetch (uint256 const& hash, bool isAsync)
     {
         FetchReport report;
         report.isAsync = isAsync;
         report.wentToDisk = false;
+        report.fetchCount = 1;
+        report.fastHits = 0;
+        report.fastMisses = 0;
+        report.fastElapsed = std::chrono::microseconds::zero ();
+        report.backendElapsed = std::chrono::microseconds::zero ();
 
         auto const before = std::chrono::steady_clock::now();
         NodeObject::Ptr ret = doFetch (hash, report);
@@ -159,6 +235,31 @@ public:
         return ret;
     }
 
+    /** Perform a batch fetch and report the time it took */
+    std::vector <NodeObject::Ptr> doTimedFetchBatch (
+        std::vector <uint256> const& hashes, bool isAsync)
+    {
+        FetchReport report;
+        report.isAsync = isAsync;
+        report.wentToDisk = false;
+        report.fetchCount = 0;
+        report.fastHits = 0;
+        report.fastMisses = 0;
+        report.fastElapsed = std::chrono::microseconds::zero ();
+        report.backendElapsed = std::chrono::microseconds::zero ();
+
+        auto const before = std::chrono::steady_clock::now();
+        std::vector <NodeObject::Ptr> ret (doFetchBatch (hashes, report));
+        report.elapsed = std::chrono::duration_cast <std::chrono::milliseconds>
+            (std::chrono::steady_clock::now() - before);
+
+        report.wasFound = std::any_of (ret.begin (), ret.end (),
+            [](NodeObject::Ptr const& object) { return object != nullptr; });
+        m_scheduler.onFetch (report);
+
+        return ret;
+    }
+
     NodeObject::Ptr doFetch (uint256 const& hash, FetchReport &report)
     {
         // See if the object already exists in the cache
@@ -180,22 +281,132 @@ public:
         //
         if (m_fastBackend != nullptr)
         {
-            obj = fetchInternal (*m_fastBackend, hash);
+            auto const before = std::chrono::steady_clock::now();
+            checkStatus (m_fastBackend->fetch (hash, &obj), hash);
+            report.fastElapsed += std::chrono::duration_cast <
+                std::chrono::microseconds> (std::chrono::steady_clock::now() - before);
 
             // If we found the object, avoid storing it again later.
             if (obj != nullptr)
+            {
                 foundInFastBackend = true;
+                ++report.fastHits;
+            }
+            else
+            {
+                ++report.fastMisses;
+            }
         }
 
         // Are we still without an object?
         //
         if (obj == nullptr)
         {
+            auto const before = std::chrono::steady_clock::now();
+
             // Yes so at last we will try the main database.
             //
-            obj = fetchInternal (*m_backend, hash);
+            obj = fetchInternal (*getWritableBackend (), hash);
+
+            // And then the older objects, if the database rotates
+            //
+            if (obj == nullptr)
+            {
+                std::shared_ptr <Backend> const archive (getArchiveBackend ());
+                if (archive != nullptr)
+                    obj = fetchInternal (*archive, hash);
+            }
+
+            report.backendElapsed += std::chrono::duration_cast <
+                std::chrono::microseconds> (std::chrono::steady_clock::now() - before);
+        }
+
+        return onFetched (hash, obj, foundInFastBackend, report.isAsync);
+    }
+
+    std::vector <NodeObject::Ptr> doFetchBatch (
+        std::vector <uint256> const& hashes, FetchReport& report)
+    {
+        std::vector <NodeObject::Ptr> objects (hashes.size ());
+
+        // Indexes of the objects that have to come from the database(s)
+        std::vector <std::size_t> wanted;
+
+        for (std::size_t i = 0; i < hashes.size (); ++i)
+        {
+            objects [i] = m_cache.fetch (hashes [i]);
+
+            if (objects [i] == nullptr && ! m_negCache.touch_if_exists (hashes [i]))
+                wanted.push_back (i);
+        }
+
+        if (wanted.empty ())
+            return objects;
+
+        report.wentToDisk = true;
+        report.fetchCount = static_cast <int> (wanted.size ());
+
+        std::vector <bool> foundInFastBackend (hashes.size (), false);
+        std::vector <std::size_t> remaining (wanted);
+
+        if (m_fastBackend != nullptr)
+        {
+            auto const before = std::chrono::steady_clock::now();
+            fetchBatchInternal (*m_fastBackend, hashes, wanted, objects);
+            report.fastElapsed += std::chrono::duration_cast <
+                std::chrono::microseconds> (std::chrono::steady_clock::now() - before);
+
+            // Only ask the main database for what is still missing
+            remaining.clear ();
+            for (auto const i : wanted)
+            {
+                if (objects [i] != nullptr)
+                    foundInFastBackend [i] = true;
+                else
+                    remaining.push_back (i);
+            }
+
+            report.fastHits += static_cast <int> (wanted.size () - remaining.size ());
+            report.fastMisses += static_cast <int> (remaining.size ());
+        }
+
+        if (! remaining.empty ())
+        {
+            auto const before = std::chrono::steady_clock::now();
+
+            fetchBatchInternal (*getWritableBackend (), hashes, remaining, objects);
+
+            std::shared_ptr <Backend> const archive (getArchiveBackend ());
+            if (archive != nullptr)
+            {
+                std::vector <std::size_t> older;
+                for (auto const i : remaining)
+                {
+                    if (objects [i] == nullptr)
+                        older.push_back (i);
+                }
+
+                if (! older.empty ())
+                    fetchBatchInternal (*archive, hashes, older, objects);
+            }
+
+            report.backendElapsed += std::chrono::duration_cast <
+                std::chrono::microseconds> (std::chrono::steady_clock::now() - before);
+        }
+
+        for (auto const i : wanted)
+        {
+            objects [i] = onFetched (hashes [i], objects [i],
+                foundInFastBackend [i], report.isAsync);
         }
 
+        return objects;
+    }
+
+    // Cache the result of a fetch that went to the database(s)
+    NodeObject::Ptr onFetched (uint256 const& hash, NodeObject::Ptr obj,
+        bool foundInFastBackend, bool isAsync)
+    {
         if (obj == nullptr)
         {
 
@@ -210,16 +421,21 @@ public:
         }
         else
         {
-            // Ensure all threads get the same object
+            // Ensure all threads get the same object. Once the cache is
+            // full, an object read only once recently is handed back
+            // without being cached, so that a scan can't flush it. Async
+            // reads are always cached, someone is about to ask for them.
             //
-            m_cache.canonicalize (hash, obj);
+            if (isAsync || shouldCache (hash))
+                m_cache.canonicalize (hash, obj);
 
             if (! foundInFastBackend)
             {
-                // If we have a fast back end, store it there for later.
+                // If we have a fast back end, it is kept there for later
+                // once it has been read more than once.
                 //
                 if (m_fastBackend != nullptr)
-                    m_fastBackend->store (obj);
+                    m_fastBackend->promote (obj);
 
                 // Since this was a 'hard' fetch, we will log it.
                 //
@@ -238,6 +454,37 @@ public:
 
         Status const status = backend.fetch (hash.begin (), &object);
 
+        checkStatus (status, hash);
+
+        return object;
+    }
+
+    // The source is a Backend or the FastTier
+    template <class Source>
+    void fetchBatchInternal (Source& backend,
+        std::vector <uint256> const& hashes,
+            std::vector <std::size_t> const& indexes,
+                std::vector <NodeObject::Ptr>& objects)
+    {
+        std::vector <void const*> keys;
+        keys.reserve (indexes.size ());
+        for (auto const i : indexes)
+            keys.push_back (hashes [i].begin ());
+
+        std::vector <Status> results;
+        Batch found;
+
+        backend.fetchBatch (keys, results, found);
+
+        for (std::size_t k = 0; k < indexes.size (); ++k)
+        {
+            checkStatus (results [k], hashes [indexes [k]]);
+            objects [indexes [k]] = found [k];
+        }
+    }
+
+    void checkStatus (Status status, uint256 const& hash)
+    {
         switch (status)
         {
         case ok:
@@ -256,8 +503,31 @@ public:
                 "Unknown status=" << status;
             break;
         }
+    }
 
-        return object;
+    bool shouldCache (uint256 const& hash)
+    {
+        if (ScopedNoCache::active ())
+            return false;
+
+        // Always record the miss, so the key is known if it comes back
+        if (m_admission.admit (hash))
+            return true;
+
+        return ! cacheFull ();
+    }
+
+    bool cacheFull ()
+    {
+        int const size = m_cache.getTargetSize ();
+        if (size != 0 && m_cache.getCacheSize () >= size)
+            return true;
+
+        std::size_t const bytes = m_cache.getTargetBytes ();
+        if (bytes != 0 && m_cache.getCacheBytes () >= bytes)
+            return true;
+
+        return false;
     }
 
     //------------------------------------------------------------------------------
@@ -275,7 +545,7 @@ public:
 
         m_cache.canonicalize (hash, object, true);
 
-        m_backend->store (object);
+        getWritableBackend ()->store (object);
 
         m_negCache.erase (hash);
 
@@ -290,95 +560,180 @@ public:
         return m_cache.getHitRate ();
     }
 
-    void tune (int size, int age)
+    std::size_t getCacheBytes ()
+    {
+        return m_cache.getCacheBytes ();
+    }
+
+    std::size_t getNegativeCacheBytes ()
+    {
+        return m_negCache.bytes ();
+    }
+
+    void tune (int size, int age, std::size_t bytes)
     {
         m_cache.setTargetSize (size);
+        m_cache.setTargetBytes (bytes);
         m_cache.setTargetAge (age);
         m_negCache.setTargetSize (size);
+        m_negCache.setTargetBytes (bytes / negativeCacheShare);
         m_negCache.setTargetAge (age);
+        m_admission.setCapacity (size);
+    }
+
+    // Approximate memory used by a cached object
+    static std::size_t getCost (NodeObject const& object)
+    {
+        return sizeof (NodeObject) + object.getData ().capacity ();
     }
 
     void sweep ()
     {
         m_cache.sweep ();
         m_negCache.sweep ();
+
+        if (m_fastBackend != nullptr)
+            m_fastBackend->sweep ();
     }
 
     int getWriteLoad ()
     {
-        return m_backend->getWriteLoad ();
+        return getWritableBackend ()->getWriteLoad ();
+    }
+
+    //------------------------------------------------------------------------------
+
+    void copyToWritable (Batch const& batch)
+    {
+        // The disk backends' batch writes are safe alongside their own
+        // batch writers, so this doesn't have to go through them.
+        getWritableBackend ()->storeBatch (batch);
+    }
+
+    bool hasArchive ()
+    {
+        return getArchiveBackend () != nullptr;
+    }
+
+    std::shared_ptr <Backend> rotate (std::unique_ptr <Backend> newBackend)
+    {
+        std::shared_ptr <Backend> newArchive (std::move (newBackend));
+
+        {
+            std::lock_guard <std::mutex> lock (m_rotateMutex);
+            // newArchive ends up holding the old archive
+            std::swap (m_backend, newArchive);
+            std::swap (m_archiveBackend, newArchive);
+        }
+
+        // The cache may still hold objects from the dropped archive, and
+        // can't tell them apart from the ones that were copied forward.
+        if (newArchive != nullptr)
+            m_cache.clear ();
+
+        return newArchive;
     }
 
     //------------------------------------------------------------------------------
 
     // Entry point for async read threads
-    void threadEntry ()
+    void threadEntry (ReadQueue& queue)
     {
         beast::Thread::setCurrentThreadName ("prefetch");
         while (1)
         {
-            uint256 hash;
+            std::vector <uint256> hashes;
+            std::vector <std::vector <FetchCallback>> callbacks;
 
             {
-                std::unique_lock <std::mutex> lock (m_readLock);
+                std::unique_lock <std::mutex> lock (queue.mutex);
 
-                while (!m_readShut && m_readSet.empty ())
-                {
-                    // all work is done
-                    m_readGenCondVar.notify_all ();
-                    m_readCondVar.wait (lock);
-                }
+                while (!queue.shut && queue.pending.empty ())
+                    queue.cond.wait (lock);
 
-                if (m_readShut)
+                if (queue.shut)
                     break;
 
-                // Read in key order to make the back end more efficient
-                std::set <uint256>::iterator it = m_readSet.lower_bound (m_readLast);
-                if (it == m_readSet.end ())
-                {
-                    it = m_readSet.begin ();
+                // Read in key order to make the back end more efficient,
+                // taking a run of neighbouring keys to read together
+                auto it = queue.pending.lower_bound (queue.last);
+                if (it == queue.pending.end ())
+                    it = queue.pending.begin ();
 
-                    // A generation has completed
-                    ++m_readGen;
-                    m_readGenCondVar.notify_all ();
+                while (it != queue.pending.end () &&
+                    hashes.size () < asyncReadBatchSize)
+                {
+                    hashes.push_back (it->first);
+                    callbacks.push_back (std::move (it->second));
+                    it = queue.pending.erase (it);
                 }
+                queue.last = hashes.back ();
+            }
+
+            // Perform the reads
+            std::vector <NodeObject::Ptr> const objects (
+                doTimedFetchBatch (hashes, true));
 
-                hash = *it;
-                m_readSet.erase (it);
-                m_readLast = hash;
+            for (std::size_t i = 0; i < objects.size (); ++i)
+            {
+                for (auto const& callback : callbacks [i])
+                    callback (objects [i]);
             }
+        }
 
-            // Perform the read
-            doTimedFetch (hash, true);
-         }
-     }
+        // Nobody must be left waiting on a read that will never happen
+        std::unique_lock <std::mutex> lock (queue.mutex);
+        for (auto const& entry : queue.pending)
+        {
+            for (auto const& callback : entry.second)
+                callback (NodeObject::Ptr ());
+        }
+        queue.pending.clear ();
+    }
 
     //------------------------------------------------------------------------------
 
     void for_each (std::function <void(NodeObject::Ptr)> f)
     {
-        m_backend->for_each (f);
+        getWritableBackend ()->for_each (f);
+
+        std::shared_ptr <Backend> const archive (getArchiveBackend ());
+        if (archive != nullptr)
+            archive->for_each (f);
     }
 
-    void import (Database& source)
+    void for_each (std::function <void(NodeObject::Ptr)> f,
+        uint256 const& first, uint256 const& last)
     {
-        Batch b;
-        b.reserve (batchWritePreallocationSize);
+        getWritableBackend ()->for_each (f, first, last);
 
-        source.for_each ([&](NodeObject::Ptr object)
-        {
-            if (b.size () >= batchWritePreallocationSize)
-            {
-                this->m_backend->storeBatch (b);
-                b.clear ();
-                b.reserve (batchWritePreallocationSize);
-            }
+        std::shared_ptr <Backend> const archive (getArchiveBackend ());
+        if (archive != nullptr)
+            archive->for_each (f, first, last);
+    }
+
+    bool hasOrderedKeys ()
+    {
+        std::shared_ptr <Backend> const archive (getArchiveBackend ());
+
+        return getWritableBackend ()->hasOrderedKeys () &&
+            (archive == nullptr || archive->hasOrderedKeys ());
+    }
 
-            b.push_back (object);
-        });
+    void import (Database& source, std::string const& checkpoint)
+    {
+        std::shared_ptr <Backend> const backend (getWritableBackend ());
+
+        Importer importer (source, *backend, checkpoint, m_journal);
+        importer.run ();
+    }
+
+    bool warm (Batch const& batch)
+    {
+        if (m_fastBackend == nullptr)
+            return false;
 
-        if (! b.empty ())
-            m_backend->storeBatch (b);
+        return m_fastBackend->warm (batch);
     }
 };
 
@@ -28,8 +28,18 @@ DecodedBlob::DecodedBlob (void const* key, void const* value, int valueBytes)
 
         0...3       LedgerIndex     32-bit big endian integer
         4...7       Unused?         An unused copy of the LedgerIndex
-        8           char            One of NodeObjectType
+        8           char            One of NodeObjectType, with the
+                                    compactInnerNode bit set if the
+                                    body is a compact inner node
         9...end                     The body of the object data
+
+        Compact inner node body:
+
+        9...10      Branches        16-bit big endian bitmap of the
+                                    non-empty branches, branch 0 in
+                                    the high bit
+        11...end    Hashes          32 bytes for each non-empty branch,
+                                    in branch order
     */
 
     m_success = false;
@@ -39,6 +49,7 @@ DecodedBlob::DecodedBlob (void const* key, void const* value, int valueBytes)
     m_objectType = hotUNKNOWN;
     m_objectData = nullptr;
     m_dataBytes = beast::bmax (0, valueBytes - 9);
+    m_compact = false;
 
     if (valueBytes > 4)
     {
@@ -51,7 +62,8 @@ DecodedBlob::DecodedBlob (void const* key, void const* value, int valueBytes)
     if (valueBytes > 8)
     {
         unsigned char const* byte = static_cast <unsigned char const*> (value);
-        m_objectType = static_cast <NodeObjectType> (byte [8]);
+        m_compact = (byte [8] & compactInnerNode) != 0;
+        m_objectType = static_cast <NodeObjectType> (byte [8] & ~compactInnerNode);
     }
 
     if (valueBytes > 9)
@@ -66,14 +78,35 @@ DecodedBlob::DecodedBlob (void const* key, void const* value, int valueBytes)
 
         case hotLEDGER:
         case hotTRANSACTION:
+            m_success = ! m_compact;
+            break;
+
         case hotACCOUNT_NODE:
         case hotTRANSACTION_NODE:
-            m_success = true;
+            if (m_compact)
+            {
+                int branchCount = 0;
+                if (m_dataBytes >= 2)
+                {
+                    for (std::uint32_t b = getBranches (m_objectData); b != 0; b &= b - 1)
+                        ++branchCount;
+                }
+                m_success = (m_dataBytes == 2 + 32 * branchCount);
+            }
+            else
+            {
+                m_success = true;
+            }
             break;
         }
     }
 }
 
+std::uint32_t DecodedBlob::getBranches (unsigned char const* body)
+{
+    return (std::uint32_t (body [0]) << 8) | body [1];
+}
+
 NodeObject::Ptr DecodedBlob::createObject ()
 {
     bassert (m_success);
@@ -82,9 +115,36 @@ NodeObject::Ptr DecodedBlob::createObject ()
 
     if (m_success)
     {
-        Blob data (m_dataBytes);
+        Blob data;
+
+        if (m_compact)
+        {
+            data.resize (innerNodeBytes, 0);
+
+            std::uint32_t const prefix (HashPrefix::innerNode);
+            data [0] = static_cast <unsigned char> (prefix >> 24);
+            data [1] = static_cast <unsigned char> (prefix >> 16);
+            data [2] = static_cast <unsigned char> (prefix >> 8);
+            data [3] = static_cast <unsigned char> (prefix);
+
+            std::uint32_t const branches (getBranches (m_objectData));
+            unsigned char const* hash (m_objectData + 2);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                if (branches & (1 << (15 - i)))
+                {
+                    memcpy (&data [4 + 32 * i], hash, 32);
+                    hash += 32;
+                }
+            }
+        }
+        else
+        {
+            data.resize (m_dataBytes);
 
-        memcpy (data.data (), m_objectData, m_dataBytes);
+            memcpy (data.data (), m_objectData, m_dataBytes);
+        }
 
         object = NodeObject::createObject (
             m_objectType, m_ledgerIndex, std::move(data), uint256::fromVoid(m_key));
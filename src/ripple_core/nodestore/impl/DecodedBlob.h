@@ -36,6 +36,19 @@ namespace NodeStore {
 class DecodedBlob
 {
 public:
+    /** Set in the type byte when the body is a compact inner node.
+
+        A SHAMap inner node is stored as a 16 bit map of its non-empty
+        branches followed by the hash of each of those branches, instead of
+        the hash prefix and all sixteen hashes. The object's data is put
+        back into the full form when it is decoded, so the node hash and
+        everything above the database are unaffected.
+    */
+    static unsigned char const compactInnerNode = 0x80;
+
+    /** Size of an inner node in full form: the prefix and sixteen hashes. */
+    static int const innerNodeBytes = 4 + 16 * 32;
+
     /** Construct the decoded blob from raw data. */
     DecodedBlob (void const* key, void const* value, int valueBytes);
 
@@ -45,6 +58,9 @@ public:
     /** Create a NodeObject from this data. */
     NodeObject::Ptr createObject ();
 
+private:
+    static std::uint32_t getBranches (unsigned char const* body);
+
 private:
     bool m_success;
 
@@ -53,6 +69,7 @@ private:
     NodeObjectType m_objectType;
     unsigned char const* m_objectData;
     int m_dataBytes;
+    bool m_compact;
 };
 
 }
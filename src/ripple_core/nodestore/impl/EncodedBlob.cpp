@@ -20,13 +20,38 @@
 namespace ripple {
 namespace NodeStore {
 
+EncodedBlob::EncodedBlob (bool compactInnerNodes)
+    : m_compactInnerNodes (compactInnerNodes)
+    , m_key (nullptr)
+    , m_size (0)
+{
+}
+
+bool
+EncodedBlob::compactInnerNodes (Parameters const& keyValues)
+{
+    return keyValues ["compact_inner_nodes"].getIntValue () != 0;
+}
+
 void
 EncodedBlob::prepare (NodeObject::Ptr const& object)
 {
     m_key = object->getHash ().begin ();
 
+    Blob const& data (object->getData ());
+
+    int branchCount = 16;
+    if (m_compactInnerNodes && isInnerNode (object))
+        branchCount = getBranchCount (data);
+
+    // With every branch in use the compact form is two bytes bigger
+    bool const compact (branchCount < 16);
+
     // This is how many bytes we need in the flat data
-    m_size = object->getData ().size () + 9;
+    if (compact)
+        m_size = 9 + 2 + 32 * branchCount;
+    else
+        m_size = data.size () + 9;
 
     m_data.ensureSize (m_size);
 
@@ -45,8 +70,75 @@ EncodedBlob::prepare (NodeObject::Ptr const& object)
 
         buf [8] = static_cast <unsigned char> (object->getType ());
 
-        memcpy (&buf [9], object->getData ().data (), object->getData ().size ());
+        if (compact)
+        {
+            // Only the non-empty branches are kept, see DecodedBlob
+            buf [8] |= DecodedBlob::compactInnerNode;
+
+            std::uint32_t branches = 0;
+            unsigned char* hash = &buf [11];
+
+            for (int i = 0; i < 16; ++i)
+            {
+                unsigned char const* const branch (&data [4 + 32 * i]);
+
+                if (! isZero (branch))
+                {
+                    branches |= 1 << (15 - i);
+                    memcpy (hash, branch, 32);
+                    hash += 32;
+                }
+            }
+
+            buf [9] = static_cast <unsigned char> (branches >> 8);
+            buf [10] = static_cast <unsigned char> (branches);
+        }
+        else
+        {
+            memcpy (&buf [9], data.data (), data.size ());
+        }
+    }
+}
+
+bool
+EncodedBlob::isInnerNode (NodeObject::Ptr const& object)
+{
+    NodeObjectType const type (object->getType ());
+    Blob const& data (object->getData ());
+
+    if ((type != hotACCOUNT_NODE && type != hotTRANSACTION_NODE) ||
+        data.size () != DecodedBlob::innerNodeBytes)
+        return false;
+
+    std::uint32_t const prefix (HashPrefix::innerNode);
+
+    return data [0] == static_cast <unsigned char> (prefix >> 24) &&
+        data [1] == static_cast <unsigned char> (prefix >> 16) &&
+        data [2] == static_cast <unsigned char> (prefix >> 8) &&
+        data [3] == static_cast <unsigned char> (prefix);
+}
+
+int
+EncodedBlob::getBranchCount (Blob const& data)
+{
+    int count = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        if (! isZero (&data [4 + 32 * i]))
+            ++count;
+    }
+    return count;
+}
+
+bool
+EncodedBlob::isZero (unsigned char const* hash)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        if (hash [i] != 0)
+            return false;
     }
+    return true;
 }
 
 }
@@ -24,18 +24,35 @@ namespace ripple {
 namespace NodeStore {
 
 /** Utility for producing flattened node objects.
+    SHAMap inner nodes may be written in a compact form which leaves out
+    the empty branches. Builds older than the compact form cannot read
+    it, so it is only written when the backend's settings ask for it.
     @note This defines the database format of a NodeObject!
+    @see DecodedBlob
 */
 // VFALCO TODO Make allocator aware and use short_alloc
 struct EncodedBlob
 {
 public:
+    explicit EncodedBlob (bool compactInnerNodes = false);
+
+    /** Returns `true` if the backend settings turn on compact inner nodes.
+        This is the `compact_inner_nodes` key, and it defaults to off.
+    */
+    static bool compactInnerNodes (Parameters const& keyValues);
+
     void prepare (NodeObject::Ptr const& object);
     void const* getKey () const noexcept { return m_key; }
     size_t getSize () const noexcept { return m_size; }
     void const* getData () const noexcept { return m_data.getData (); }
 
 private:
+    static bool isInnerNode (NodeObject::Ptr const& object);
+    static int getBranchCount (Blob const& data);
+    static bool isZero (unsigned char const* hash);
+
+private:
+    bool m_compactInnerNodes;
     void const* m_key;
     beast::MemoryBlock m_data;
     size_t m_size;
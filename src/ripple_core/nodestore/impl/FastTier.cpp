@@ -0,0 +1,361 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+namespace ripple {
+namespace NodeStore {
+
+FastTier::FastTier (Manager& manager, Parameters const& parameters,
+    Scheduler& scheduler, beast::Journal journal)
+    : m_manager (manager)
+    , m_parameters (parameters)
+    , m_scheduler (scheduler)
+    , m_journal (journal)
+    , m_capacity (static_cast <std::size_t> (std::max <std::int64_t> (0,
+        parameters ["max_mb"].getLargeIntValue ())) * 1024 * 1024)
+    , m_directory (parameters ["path"].isEmpty ()
+        ? beast::File::nonexistent () : beast::File (parameters ["path"]))
+    , m_currentGeneration (0)
+    , m_oldGeneration (0)
+    , m_admission (fastTierAdmissionKeys)
+    , m_bytes (0)
+    , m_hits (0)
+    , m_misses (0)
+    , m_promotions (0)
+    , m_rotations (0)
+{
+    if (m_capacity == 0)
+    {
+        m_current = m_manager.make_Backend (m_parameters, m_scheduler, m_journal);
+        return;
+    }
+
+    std::vector <Generation> generations (findGenerations ());
+
+    // Only the newest two are in use. Anything older was dropped by
+    // a rotation and not removed before we stopped.
+    while (generations.size () > 2)
+    {
+        getDirectory (generations.front ()).deleteRecursively ();
+        generations.erase (generations.begin ());
+    }
+
+    if (generations.empty ())
+        generations.push_back (1);
+
+    m_currentGeneration = generations.back ();
+    m_current = makeBackend (m_currentGeneration);
+
+    if (generations.size () > 1)
+    {
+        m_oldGeneration = generations.front ();
+        m_old = makeBackend (m_oldGeneration);
+    }
+
+    // Carry on filling what the last run left, the tier starts out warm
+    m_bytes = getDiskBytes (m_currentGeneration);
+
+    if (m_journal.info) m_journal.info <<
+        "Fast backend generation " << m_currentGeneration << " holds " <<
+            (m_bytes.load () >> 20) << "MB of " << (m_capacity >> 20) << "MB";
+}
+
+FastTier::~FastTier ()
+{
+    // Dropped generations that are still on disk are removed on the next open
+}
+
+std::string FastTier::getName ()
+{
+    std::shared_ptr <Backend> current;
+    std::shared_ptr <Backend> old;
+    getBackends (current, old);
+
+    return current->getName ();
+}
+
+Status FastTier::fetch (uint256 const& hash, NodeObject::Ptr* object)
+{
+    std::shared_ptr <Backend> current;
+    std::shared_ptr <Backend> old;
+    getBackends (current, old);
+
+    Status status = current->fetch (hash.begin (), object);
+
+    if (*object == nullptr && old != nullptr)
+    {
+        Status const oldStatus = old->fetch (hash.begin (), object);
+
+        // Keep an error from the current generation unless it doesn't matter
+        if (*object != nullptr || status == ok || status == notFound)
+            status = oldStatus;
+
+        // Still being read, so keep it through the next rotation
+        if (*object != nullptr)
+            add (current, *object);
+    }
+
+    if (*object != nullptr)
+        ++m_hits;
+    else
+        ++m_misses;
+
+    return status;
+}
+
+void FastTier::fetchBatch (std::vector <void const*> const& keys,
+    std::vector <Status>& results, Batch& objects)
+{
+    std::shared_ptr <Backend> current;
+    std::shared_ptr <Backend> old;
+    getBackends (current, old);
+
+    current->fetchBatch (keys, results, objects);
+
+    if (old != nullptr)
+    {
+        std::vector <void const*> missing;
+        std::vector <std::size_t> indexes;
+
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            if (objects [i] == nullptr)
+            {
+                missing.push_back (keys [i]);
+                indexes.push_back (i);
+            }
+        }
+
+        if (! missing.empty ())
+        {
+            std::vector <Status> oldResults;
+            Batch found;
+
+            old->fetchBatch (missing, oldResults, found);
+
+            for (std::size_t k = 0; k < missing.size (); ++k)
+            {
+                std::size_t const i (indexes [k]);
+
+                if (found [k] != nullptr ||
+                    results [i] == ok || results [i] == notFound)
+                    results [i] = oldResults [k];
+
+                if (found [k] != nullptr)
+                {
+                    objects [i] = found [k];
+                    add (current, found [k]);
+                }
+            }
+        }
+    }
+
+    std::size_t const hits (std::count_if (objects.begin (), objects.end (),
+        [](NodeObject::Ptr const& object) { return object != nullptr; }));
+    m_hits += hits;
+    m_misses += keys.size () - hits;
+}
+
+void FastTier::store (NodeObject::Ptr const& object)
+{
+    std::shared_ptr <Backend> current;
+    std::shared_ptr <Backend> old;
+    getBackends (current, old);
+
+    add (current, object);
+}
+
+bool FastTier::promote (NodeObject::Ptr const& object)
+{
+    // The first read only records the key
+    if (! m_admission.admit (object->getHash ()))
+        return false;
+
+    store (object);
+    ++m_promotions;
+    return true;
+}
+
+bool FastTier::warm (Batch const& batch)
+{
+    if (m_capacity != 0 && m_bytes.load () >= m_capacity / 2)
+        return false;
+
+    std::shared_ptr <Backend> current;
+    std::shared_ptr <Backend> old;
+    getBackends (current, old);
+
+    current->storeBatch (batch);
+
+    std::size_t bytes = 0;
+    for (auto const& object : batch)
+        bytes += getCost (*object);
+
+    m_bytes += bytes;
+
+    // Rotating here would evict, so leave that to the next store
+    return m_capacity == 0 || m_bytes.load () < m_capacity / 2;
+}
+
+void FastTier::sweep ()
+{
+    std::lock_guard <std::mutex> lock (m_rotateMutex);
+
+    for (auto iter = m_retired.begin (); iter != m_retired.end ();)
+    {
+        // Wait for fetches and writes still using the generation
+        if (! iter->backend.unique () || iter->backend->getWriteLoad () > 0)
+        {
+            ++iter;
+            continue;
+        }
+
+        iter->backend.reset ();
+
+        if (m_directory != beast::File::nonexistent ())
+        {
+            beast::File const directory (getDirectory (iter->generation));
+
+            if (! directory.deleteRecursively ())
+                m_journal.error << "Unable to remove '" <<
+                    directory.getFullPathName () << "'";
+        }
+
+        iter = m_retired.erase (iter);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void FastTier::getBackends (std::shared_ptr <Backend>& current,
+    std::shared_ptr <Backend>& old) const
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+    current = m_current;
+    old = m_old;
+}
+
+void FastTier::add (std::shared_ptr <Backend> const& current,
+    NodeObject::Ptr const& object)
+{
+    current->store (object);
+
+    if (m_capacity != 0 && (m_bytes += getCost (*object)) >= m_capacity / 2)
+        rotate ();
+}
+
+void FastTier::rotate ()
+{
+    std::lock_guard <std::mutex> rotateLock (m_rotateMutex);
+
+    // Another thread may have rotated while we waited
+    if (m_bytes.load () < m_capacity / 2)
+        return;
+
+    // Only changed while holding m_rotateMutex, which we have
+    Generation const generation (m_currentGeneration + 1);
+
+    std::shared_ptr <Backend> fresh (makeBackend (generation));
+
+    Retired dropped;
+
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+
+        dropped.backend = std::move (m_old);
+        dropped.generation = m_oldGeneration;
+
+        m_old = std::move (m_current);
+        m_oldGeneration = m_currentGeneration;
+
+        m_current = std::move (fresh);
+        m_currentGeneration = generation;
+    }
+
+    m_bytes = 0;
+    ++m_rotations;
+
+    if (dropped.backend != nullptr)
+        m_retired.push_back (std::move (dropped));
+
+    if (m_journal.debug) m_journal.debug <<
+        "Fast backend rotated to generation " << generation;
+}
+
+beast::File FastTier::getDirectory (Generation generation) const
+{
+    return m_directory.getChildFile (beast::String (generation));
+}
+
+std::vector <FastTier::Generation> FastTier::findGenerations () const
+{
+    std::vector <Generation> generations;
+
+    if (m_directory == beast::File::nonexistent ())
+        return generations;
+
+    beast::Array <beast::File> children;
+    m_directory.findChildFiles (children, beast::File::findDirectories, false);
+
+    for (int i = 0; i < children.size (); ++i)
+    {
+        beast::String const name (children [i].getFileName ());
+
+        if (! name.isEmpty () && name.containsOnly ("0123456789"))
+            generations.push_back (static_cast <Generation> (
+                name.getLargeIntValue ()));
+    }
+
+    std::sort (generations.begin (), generations.end ());
+
+    return generations;
+}
+
+std::size_t FastTier::getDiskBytes (Generation generation) const
+{
+    std::size_t bytes = 0;
+
+    if (m_directory == beast::File::nonexistent ())
+        return bytes;
+
+    beast::Array <beast::File> files;
+    getDirectory (generation).findChildFiles (files, beast::File::findFiles, true);
+
+    for (int i = 0; i < files.size (); ++i)
+        bytes += static_cast <std::size_t> (files [i].getSize ());
+
+    return bytes;
+}
+
+std::unique_ptr <Backend> FastTier::makeBackend (Generation generation)
+{
+    Parameters parameters (m_parameters);
+
+    if (m_directory != beast::File::nonexistent ())
+    {
+        beast::File const directory (getDirectory (generation));
+        directory.createDirectory ();
+        parameters.set ("path", directory.getFullPathName ());
+    }
+
+    return m_manager.make_Backend (parameters, m_scheduler, m_journal);
+}
+
+}
+}
@@ -0,0 +1,177 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#ifndef RIPPLE_NODESTORE_FASTTIER_H_INCLUDED
+#define RIPPLE_NODESTORE_FASTTIER_H_INCLUDED
+
+#include <atomic>
+#include <mutex>
+
+namespace ripple {
+namespace NodeStore {
+
+/** The fast backend in front of a Database's main backend.
+
+    New objects are written through to it. Objects read from the main
+    backend are only promoted on their second recent read, using an
+    AdmissionFilter, so a walk over the whole store can't fill it with
+    nodes that will not be wanted again.
+
+    With a capacity, set in megabytes by 'max_mb', the objects are kept
+    in two generations, each a backend of its own in a numbered
+    subdirectory of the path. Writes go to the current generation. When
+    it holds half the capacity it becomes the old generation, the previous
+    old generation is dropped, and a new one is started. Objects found in
+    the old generation are copied forward, so whatever is still being
+    read survives the next rotation and whatever isn't goes with its
+    generation. This approximates LRU eviction without needing a backend
+    that can delete single objects. Dropped generations are removed from
+    disk by sweep() once nothing is using them.
+
+    Without a capacity, the backend at the path is used as is and grows
+    without limit, as before.
+*/
+class FastTier
+{
+public:
+    FastTier (Manager& manager, Parameters const& parameters,
+        Scheduler& scheduler, beast::Journal journal);
+
+    ~FastTier ();
+
+    std::string getName ();
+
+    /** Fetch an object, looking in the current and then the old generation.
+        @see Backend::fetch
+    */
+    Status fetch (uint256 const& hash, NodeObject::Ptr* object);
+
+    /** Fetch a group of objects.
+        @see Backend::fetchBatch
+    */
+    void fetchBatch (std::vector <void const*> const& keys,
+        std::vector <Status>& results, Batch& objects);
+
+    /** Store a new object. */
+    void store (NodeObject::Ptr const& object);
+
+    /** Offer an object that was read from the main backend.
+        @return `true` if it was read recently before and was stored.
+    */
+    bool promote (NodeObject::Ptr const& object);
+
+    /** Store objects read ahead of time, without evicting anything.
+        @return `false` once the current generation is full.
+    */
+    bool warm (Batch const& batch);
+
+    /** Remove dropped generations that are no longer in use. */
+    void sweep ();
+
+    std::uint64_t getHits () const
+    {
+        return m_hits.load ();
+    }
+
+    std::uint64_t getMisses () const
+    {
+        return m_misses.load ();
+    }
+
+    std::uint64_t getPromotions () const
+    {
+        return m_promotions.load ();
+    }
+
+    std::uint64_t getRotations () const
+    {
+        return m_rotations.load ();
+    }
+
+    /** Returns the approximate bytes held in the current generation. */
+    std::size_t getBytes () const
+    {
+        return m_bytes.load ();
+    }
+
+    /** Returns the approximate bytes an object takes in the tier. */
+    static std::size_t getCost (NodeObject const& object)
+    {
+        return NodeObject::keyBytes + object.getData ().size ();
+    }
+
+private:
+    typedef std::uint64_t Generation;
+
+    struct Retired
+    {
+        std::shared_ptr <Backend> backend;
+        Generation generation;
+    };
+
+    void getBackends (std::shared_ptr <Backend>& current,
+        std::shared_ptr <Backend>& old) const;
+
+    void add (std::shared_ptr <Backend> const& current,
+        NodeObject::Ptr const& object);
+
+    void rotate ();
+
+    beast::File getDirectory (Generation generation) const;
+    std::vector <Generation> findGenerations () const;
+    std::size_t getDiskBytes (Generation generation) const;
+    std::unique_ptr <Backend> makeBackend (Generation generation);
+
+private:
+    Manager& m_manager;
+    Parameters const m_parameters;
+    Scheduler& m_scheduler;
+    beast::Journal m_journal;
+
+    // Bytes the tier may hold, zero for no limit
+    std::size_t const m_capacity;
+
+    // Holds the numbered generations, unset if the backend has no path
+    beast::File const m_directory;
+
+    // Protects the backends and generation numbers
+    std::mutex mutable m_mutex;
+    std::shared_ptr <Backend> m_current;
+    std::shared_ptr <Backend> m_old;
+    Generation m_currentGeneration;
+    Generation m_oldGeneration;
+
+    // Serializes rotate and sweep, and protects m_retired
+    std::mutex m_rotateMutex;
+    std::vector <Retired> m_retired;
+
+    AdmissionFilter m_admission;
+
+    std::atomic <std::size_t> m_bytes;
+    std::atomic <std::uint64_t> m_hits;
+    std::atomic <std::uint64_t> m_misses;
+    std::atomic <std::uint64_t> m_promotions;
+    std::atomic <std::uint64_t> m_rotations;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,386 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+namespace ripple {
+namespace NodeStore {
+
+Importer::WorkQueue::WorkQueue (std::size_t capacity)
+    : m_capacity (capacity)
+    , m_closed (false)
+{
+}
+
+void Importer::WorkQueue::push (Work&& work)
+{
+    std::unique_lock <std::mutex> lock (m_mutex);
+
+    while (m_work.size () >= m_capacity)
+        m_cond.wait (lock);
+
+    m_work.push_back (std::move (work));
+    m_cond.notify_all ();
+}
+
+bool Importer::WorkQueue::pop (Work& work)
+{
+    std::unique_lock <std::mutex> lock (m_mutex);
+
+    while (m_work.empty () && ! m_closed)
+        m_cond.wait (lock);
+
+    if (m_work.empty ())
+        return false;
+
+    work = std::move (m_work.front ());
+    m_work.pop_front ();
+    m_cond.notify_all ();
+    return true;
+}
+
+void Importer::WorkQueue::close ()
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+    m_closed = true;
+    m_cond.notify_all ();
+}
+
+//------------------------------------------------------------------------------
+
+Importer::Importer (Database& source, Backend& dest,
+    std::string const& checkpoint, beast::Journal journal)
+    : m_source (source)
+    , m_dest (dest)
+    , m_checkpoint (checkpoint.empty ()
+        ? beast::File::nonexistent ()
+        : beast::File::getCurrentWorkingDirectory ().getChildFile (checkpoint))
+    , m_journal (journal)
+    , m_partitions (importPartitions)
+    , m_activeReaders (0)
+    , m_read (importQueueBatches)
+    , m_verified (importQueueBatches)
+    , m_activeVerifiers (0)
+    , m_rejected (0)
+    , m_partitionsDone (0)
+    , m_objects (0)
+    , m_bytes (0)
+{
+}
+
+Importer::~Importer ()
+{
+}
+
+void Importer::run ()
+{
+    m_start = m_lastReport = clock_type::now ();
+
+    loadCheckpoint ();
+
+    for (int i = 0; i < importPartitions; ++i)
+    {
+        if (! m_partitions [i].done)
+            m_pending.push_back (i);
+    }
+
+    // Without ordered keys each partition would be a full scan of the
+    // source, so one thread reads it once and sorts the objects instead.
+    bool const ordered (m_source.hasOrderedKeys ());
+
+    int const readers = ordered ? std::min <int> (importReadThreads,
+        std::max <int> (1, m_pending.size ())) : 1;
+    int const verifiers = std::max (1u, std::thread::hardware_concurrency ());
+
+    m_activeReaders = readers;
+    m_activeVerifiers = verifiers;
+
+    std::vector <std::thread> threads;
+
+    for (int i = 0; i < readers; ++i)
+        threads.push_back (std::thread (ordered
+            ? &Importer::readThread : &Importer::scanThread, this));
+
+    for (int i = 0; i < verifiers; ++i)
+        threads.push_back (std::thread (&Importer::verifyThread, this));
+
+    // Only the writing thread touches the partitions and the checkpoint,
+    // so every write happens here.
+    Work work;
+    while (m_verified.pop (work))
+        write (work);
+
+    for (auto& thread : threads)
+        thread.join ();
+
+    report (true);
+
+    if (m_checkpoint != beast::File::nonexistent ())
+        m_checkpoint.deleteFile ();
+}
+
+void Importer::readThread ()
+{
+    for (;;)
+    {
+        int partition;
+
+        {
+            std::lock_guard <std::mutex> lock (m_readMutex);
+
+            if (m_pending.empty ())
+                break;
+
+            partition = m_pending.front ();
+            m_pending.pop_front ();
+        }
+
+        Work work (partition);
+        int batches = 0;
+
+        m_source.for_each ([&](NodeObject::Ptr object)
+        {
+            add (work, batches, object);
+        }, getFirstKey (partition), getLastKey (partition));
+
+        finish (work, batches);
+    }
+
+    std::lock_guard <std::mutex> lock (m_readMutex);
+
+    if (--m_activeReaders == 0)
+        m_read.close ();
+}
+
+void Importer::scanThread ()
+{
+    std::vector <Work> work;
+    std::vector <int> batches (importPartitions, 0);
+    std::vector <bool> wanted (importPartitions, false);
+
+    work.reserve (importPartitions);
+    for (int i = 0; i < importPartitions; ++i)
+        work.push_back (Work (i));
+
+    {
+        std::lock_guard <std::mutex> lock (m_readMutex);
+
+        for (auto const partition : m_pending)
+            wanted [partition] = true;
+        m_pending.clear ();
+    }
+
+    m_source.for_each ([&](NodeObject::Ptr object)
+    {
+        int const partition (object->getHash ().cbegin () [0]);
+
+        if (wanted [partition])
+            add (work [partition], batches [partition], object);
+    });
+
+    for (int i = 0; i < importPartitions; ++i)
+    {
+        if (wanted [i])
+            finish (work [i], batches [i]);
+    }
+
+    std::lock_guard <std::mutex> lock (m_readMutex);
+
+    if (--m_activeReaders == 0)
+        m_read.close ();
+}
+
+void Importer::add (Work& work, int& batches, NodeObject::Ptr const& object)
+{
+    work.batch.push_back (object);
+
+    if (work.batch.size () >= importBatchSize)
+    {
+        int const partition (work.partition);
+
+        ++batches;
+        m_read.push (std::move (work));
+        work = Work (partition);
+    }
+}
+
+void Importer::finish (Work& work, int batches)
+{
+    // The last batch goes even if it is empty, so the
+    // writer knows when the partition is complete.
+    work.batches = batches + 1;
+    m_read.push (std::move (work));
+}
+
+void Importer::verifyThread ()
+{
+    Work work;
+
+    while (m_read.pop (work))
+    {
+        Batch verified;
+        verified.reserve (work.batch.size ());
+
+        for (auto const& object : work.batch)
+        {
+            Blob const& data (object->getData ());
+
+            if (Serializer::getSHA512Half (data.data (), data.size ()) == object->getHash ())
+            {
+                verified.push_back (object);
+            }
+            else
+            {
+                ++m_rejected;
+                m_journal.warning <<
+                    "Skipping NodeObject #" << object->getHash () <<
+                    ", its data does not match its key";
+            }
+        }
+
+        work.batch.swap (verified);
+        m_verified.push (std::move (work));
+    }
+
+    if (--m_activeVerifiers == 0)
+        m_verified.close ();
+}
+
+void Importer::write (Work const& work)
+{
+    if (! work.batch.empty ())
+        m_dest.storeBatch (work.batch);
+
+    m_objects += work.batch.size ();
+    for (auto const& object : work.batch)
+        m_bytes += object->getData ().size ();
+
+    Partition& partition (m_partitions [work.partition]);
+
+    ++partition.written;
+
+    if (work.batches != 0)
+        partition.batches = work.batches;
+
+    if (partition.written == partition.batches)
+    {
+        partition.done = true;
+        ++m_partitionsDone;
+        saveCheckpoint (work.partition);
+    }
+
+    report (false);
+}
+
+//------------------------------------------------------------------------------
+
+void Importer::loadCheckpoint ()
+{
+    if (m_checkpoint == beast::File::nonexistent ())
+        return;
+
+    beast::String const header ("import " + m_source.getName ());
+
+    if (m_checkpoint.existsAsFile ())
+    {
+        beast::StringArray lines;
+        m_checkpoint.readLines (lines);
+
+        if (lines.size () > 0 && lines [0] == header)
+        {
+            for (int i = 1; i < lines.size (); ++i)
+            {
+                // A line cut short by a crash is ignored
+                beast::String const line (lines [i].trim ());
+                if (line.isEmpty () || ! line.containsOnly ("0123456789"))
+                    continue;
+
+                int const partition (line.getIntValue ());
+                if (partition < importPartitions && ! m_partitions [partition].done)
+                {
+                    m_partitions [partition].done = true;
+                    ++m_partitionsDone;
+                }
+            }
+
+            m_journal.warning << "Resuming import, " << m_partitionsDone <<
+                " of " << int (importPartitions) << " partitions are done";
+            return;
+        }
+
+        m_journal.warning << "Ignoring checkpoint '" <<
+            m_checkpoint.getFullPathName () << "' from a different import";
+    }
+
+    if (! m_checkpoint.replaceWithText (header + "\n"))
+        m_journal.error << "Unable to write checkpoint '" <<
+            m_checkpoint.getFullPathName () << "'";
+}
+
+void Importer::saveCheckpoint (int partition)
+{
+    if (m_checkpoint == beast::File::nonexistent ())
+        return;
+
+    if (! m_checkpoint.appendText (beast::String (partition) + "\n"))
+        m_journal.error << "Unable to write checkpoint '" <<
+            m_checkpoint.getFullPathName () << "'";
+}
+
+void Importer::report (bool final)
+{
+    clock_type::time_point const now (clock_type::now ());
+
+    if (! final && (now - m_lastReport) < std::chrono::seconds (importReportSeconds))
+        return;
+
+    m_lastReport = now;
+
+    double const seconds (std::chrono::duration <double> (now - m_start).count ());
+    double const megabytes (m_bytes / (1024.0 * 1024.0));
+
+    beast::Journal::Stream stream (final ? m_journal.info : m_journal.debug);
+    stream <<
+        (final ? "Imported " : "Importing, ") <<
+        m_partitionsDone << "/" << int (importPartitions) << " partitions, " <<
+        m_objects << " objects, " <<
+        std::uint64_t (megabytes) << " MB in " <<
+        std::uint64_t (seconds) << " seconds (" <<
+        std::uint64_t ((seconds > 0) ? (megabytes / seconds) : 0) << " MB/s)";
+
+    if (final && m_rejected > 0)
+        m_journal.error << m_rejected.load () <<
+            " objects did not match their keys and were not imported";
+}
+
+uint256 Importer::getFirstKey (int partition)
+{
+    uint256 key;
+    key.begin () [0] = static_cast <unsigned char> (partition);
+    return key;
+}
+
+uint256 Importer::getLastKey (int partition)
+{
+    uint256 key;
+    memset (key.begin (), 0xff, key.size ());
+    key.begin () [0] = static_cast <unsigned char> (partition);
+    return key;
+}
+
+}
+}
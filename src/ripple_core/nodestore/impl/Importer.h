@@ -0,0 +1,170 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef RIPPLE_NODESTORE_IMPORTER_H_INCLUDED
+#define RIPPLE_NODESTORE_IMPORTER_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace ripple {
+namespace NodeStore {
+
+/** Copies every object from a database into a backend.
+
+    The key space is split into partitions by the first byte of the key.
+    Reader threads each take a partition at a time and walk it in the
+    source. A source without ordered keys is read once by a single thread
+    instead, which sorts the objects into their partitions. Full batches
+    go to a pool of threads that check each object's key against the hash
+    of its data, and objects that pass are written to the destination in
+    batches from the calling thread.
+
+    When a checkpoint file is given, it starts with a line naming the
+    source, and the index of each partition is added on its own line once
+    all of the partition's objects are written. Running the import again
+    from the same source with the same file skips those partitions. The
+    file is removed when the import completes.
+*/
+class Importer
+{
+public:
+    Importer (Database& source, Backend& dest,
+        std::string const& checkpoint, beast::Journal journal);
+
+    ~Importer ();
+
+    /** Run the import.
+        This returns when every partition has been copied.
+    */
+    void run ();
+
+private:
+    struct Work
+    {
+        Work ()
+            : partition (0)
+            , batches (0)
+        {
+        }
+
+        explicit Work (int partition_)
+            : partition (partition_)
+            , batches (0)
+        {
+            batch.reserve (importBatchSize);
+        }
+
+        int partition;
+        Batch batch;
+
+        // Set on the final batch of a partition, to the number of batches
+        int batches;
+    };
+
+    // A queue of work which blocks the producer when it is full
+    class WorkQueue
+    {
+    public:
+        explicit WorkQueue (std::size_t capacity);
+
+        void push (Work&& work);
+
+        /** Returns `false` once the queue is closed and empty. */
+        bool pop (Work& work);
+
+        void close ();
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        std::deque <Work> m_work;
+        std::size_t const m_capacity;
+        bool m_closed;
+    };
+
+    struct Partition
+    {
+        Partition ()
+            : done (false)
+            , written (0)
+            , batches (0)
+        {
+        }
+
+        bool done;
+        int written;
+        int batches;
+    };
+
+    void readThread ();
+    void scanThread ();
+    void verifyThread ();
+
+    // Adds an object to a partition's batch, queueing the batch when full
+    void add (Work& work, int& batches, NodeObject::Ptr const& object);
+
+    // Queues the last batch of a partition
+    void finish (Work& work, int batches);
+
+    void write (Work const& work);
+
+    void loadCheckpoint ();
+    void saveCheckpoint (int partition);
+    void report (bool final);
+
+    static uint256 getFirstKey (int partition);
+    static uint256 getLastKey (int partition);
+
+private:
+    typedef std::chrono::steady_clock clock_type;
+
+    Database& m_source;
+    Backend& m_dest;
+    beast::File const m_checkpoint;
+    beast::Journal m_journal;
+
+    std::vector <Partition> m_partitions;
+
+    // Partitions not yet handed to a reader
+    std::mutex m_readMutex;
+    std::deque <int> m_pending;
+    int m_activeReaders;
+
+    WorkQueue m_read;
+    WorkQueue m_verified;
+    std::atomic <int> m_activeVerifiers;
+    std::atomic <std::uint64_t> m_rejected;
+
+    // Only used by the writing thread
+    int m_partitionsDone;
+    std::uint64_t m_objects;
+    std::uint64_t m_bytes;
+    clock_type::time_point m_start;
+    clock_type::time_point m_lastReport;
+};
+
+}
+}
+
+#endif
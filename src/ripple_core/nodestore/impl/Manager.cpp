@@ -62,6 +62,10 @@ public:
     #if RIPPLE_ROCKSDB_AVAILABLE
         add_factory (make_RocksDBFactory ());
     #endif
+
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        add_factory (make_SegmentFactory ());
+    #endif
     }
 
     Factory* find (std::string const& name) const
@@ -113,6 +117,18 @@ public:
         return backend;
     }
 
+    std::unique_ptr <FastTier>
+    make_FastTier (
+        Parameters const& parameters,
+        Scheduler& scheduler,
+        beast::Journal journal)
+    {
+        if (parameters.size () == 0)
+            return nullptr;
+
+        return std::make_unique <FastTier> (*this, parameters, scheduler, journal);
+    }
+
     std::unique_ptr <Database>
     make_Database (
         std::string const& name,
@@ -125,14 +141,30 @@ public:
         std::unique_ptr <Backend> backend (make_Backend (
             backendParameters, scheduler, journal));
 
-        std::unique_ptr <Backend> fastBackend (
-            (fastBackendParameters.size () > 0)
-                ? make_Backend (fastBackendParameters, scheduler, journal)
-                : nullptr);
+        std::unique_ptr <FastTier> fastBackend (
+            make_FastTier (fastBackendParameters, scheduler, journal));
 
         return std::make_unique <DatabaseImp> (name, scheduler, readThreads,
             std::move (backend), std::move (fastBackend), journal);
     }
+
+    std::unique_ptr <DatabaseRotating>
+    make_DatabaseRotating (
+        std::string const& name,
+        Scheduler& scheduler,
+        beast::Journal journal,
+        int readThreads,
+        std::unique_ptr <Backend> writable,
+        std::unique_ptr <Backend> archive,
+        Parameters fastBackendParameters)
+    {
+        std::unique_ptr <FastTier> fastBackend (
+            make_FastTier (fastBackendParameters, scheduler, journal));
+
+        return std::make_unique <DatabaseImp> (name, scheduler, readThreads,
+            std::move (writable), std::move (fastBackend), journal,
+                std::move (archive));
+    }
 };
 
 //------------------------------------------------------------------------------
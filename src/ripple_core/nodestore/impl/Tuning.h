@@ -33,6 +33,27 @@ enum
 
     // Fraction of the cache one query source can take
     ,asyncDivider = 8
+
+    // Most keys an async read thread passes to the backend at once
+    ,asyncReadBatchSize = 16
+
+    // Key ranges an import is split into, one per value of the first key byte
+    ,importPartitions = 256
+
+    // Objects per batch passed between the import threads
+    ,importBatchSize = 256
+
+    // Batches waiting between each stage of an import
+    ,importQueueBatches = 32
+
+    // Threads reading partitions from the import source
+    ,importReadThreads = 4
+
+    // Seconds between progress reports during an import
+    ,importReportSeconds = 10
+
+    // Keys the fast backend's admission filter remembers
+    ,fastTierAdmissionKeys = 1048576
 };
 
 }
@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include "../../../beast/beast/chrono/manual_clock.h"
+#include "../../../beast/modules/beast_core/maths/Random.h"
+
+namespace ripple {
+namespace NodeStore {
+
+class NodeStoreAdmission_test : public beast::unit_test::suite
+{
+public:
+    static uint256 makeKey (std::uint32_t a, std::uint32_t b,
+        std::uint32_t c, std::uint32_t d)
+    {
+        uint256 key;
+        std::uint32_t const words [] = { a, b, c, d };
+        memcpy (key.begin (), words, sizeof (words));
+        return key;
+    }
+
+    void testFilter ()
+    {
+        testcase ("filter");
+
+        AdmissionFilter f (1024);
+
+        uint256 const key (makeKey (1, 2, 3, 4));
+
+        expect (! f.contains (key));
+        expect (! f.admit (key), "First miss should not be admitted");
+        expect (f.contains (key));
+        expect (f.admit (key), "Second miss should be admitted");
+
+        // The key is forgotten after two windows of other misses
+        beast::Random r (1);
+        for (int i = 0; i < 2 * 1024; ++i)
+        {
+            uint256 other;
+            r.fillBitsRandomly (other.begin (), other.size ());
+            f.admit (other);
+        }
+        expect (! f.contains (key));
+        expect (! f.admit (key));
+
+        f.setCapacity (4096);
+        expect (! f.contains (key));
+    }
+
+    void testScopedNoCache ()
+    {
+        testcase ("ScopedNoCache");
+
+        expect (! Database::ScopedNoCache::active ());
+        {
+            Database::ScopedNoCache outer;
+            expect (Database::ScopedNoCache::active ());
+            {
+                Database::ScopedNoCache inner;
+                expect (Database::ScopedNoCache::active ());
+            }
+            expect (Database::ScopedNoCache::active ());
+        }
+        expect (! Database::ScopedNoCache::active ());
+    }
+
+    void run ()
+    {
+        testFilter ();
+        testScopedNoCache ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(NodeStoreAdmission,ripple_core,ripple);
+
+//------------------------------------------------------------------------------
+
+// Replays a synthetic ledger sequence through the positive cache, with and
+// without the admission filter, and reports the hit rate seen by the
+// working set. Each ledger reads a skewed sample of a slowly drifting set
+// of hot nodes, and every so often a full walk reads a large number of
+// nodes exactly once.
+//
+class NodeStoreAdmission_timing_test : public beast::unit_test::suite
+{
+public:
+    typedef TaggedCache <uint256, int> Cache;
+    typedef beast::manual_clock <std::chrono::seconds> clock_type;
+
+    enum
+    {
+        cacheSize = 16384,
+        cacheSeconds = 300,
+        secondsPerLedger = 5,
+
+        ledgers = 400,
+        hotNodes = 12000,
+        hotReadsPerLedger = 4000,
+        driftPerLedger = 20,
+
+        scanInterval = 25,
+        scanNodes = 300000
+    };
+
+    static uint256 nodeKey (std::int64_t id)
+    {
+        beast::Random r (id);
+        uint256 key;
+        r.fillBitsRandomly (key.begin (), key.size ());
+        return key;
+    }
+
+    struct Result
+    {
+        std::uint64_t hits;
+        std::uint64_t reads;
+
+        float rate () const
+        {
+            return reads ? (100.0f * hits) / reads : 0;
+        }
+    };
+
+    static bool read (Cache& cache, AdmissionFilter* filter, uint256 const& key)
+    {
+        if (cache.fetch (key))
+            return true;
+
+        // Same decision as DatabaseImp::shouldCache
+        bool const admit = (filter == nullptr) || filter->admit (key) ||
+            cache.getCacheSize () < cache.getTargetSize ();
+
+        if (admit)
+        {
+            boost::shared_ptr <int> data (boost::make_shared <int> (0));
+            cache.canonicalize (key, data);
+        }
+        return false;
+    }
+
+    Result replay (bool useFilter)
+    {
+        beast::Journal const j;
+        clock_type clock;
+        clock.set (0);
+
+        Cache cache ("replay", cacheSize, cacheSeconds, clock, j);
+        AdmissionFilter filter (cacheSize);
+        AdmissionFilter* const f (useFilter ? &filter : nullptr);
+
+        beast::Random r (42);
+        Result result = { 0, 0 };
+        std::int64_t nextScanNode = std::int64_t (1) << 40;
+
+        for (int ledger = 0; ledger < ledgers; ++ledger)
+        {
+            std::int64_t const base = std::int64_t (ledger) * driftPerLedger;
+
+            for (int i = 0; i < hotReadsPerLedger; ++i)
+            {
+                // Skewed towards the low end of the working set
+                double const u = r.nextDouble ();
+                std::int64_t const id = base +
+                    static_cast <std::int64_t> (u * u * hotNodes);
+
+                // Skip the warm-up ledgers
+                bool const hit = read (cache, f, nodeKey (id));
+                if (ledger >= scanInterval)
+                {
+                    ++result.reads;
+                    if (hit)
+                        ++result.hits;
+                }
+            }
+
+            if ((ledger % scanInterval) == (scanInterval - 1))
+            {
+                for (int i = 0; i < scanNodes; ++i)
+                    read (cache, f, nodeKey (nextScanNode++));
+            }
+
+            clock.set ((ledger + 1) * secondsPerLedger);
+            cache.sweep ();
+        }
+
+        return result;
+    }
+
+    void run ()
+    {
+        Result const before (replay (false));
+        Result const after (replay (true));
+
+        log <<
+            "Working set hit rate over " << ledgers << " ledgers: " <<
+            "always admit " << before.rate () << "%, " <<
+            "admission filter " << after.rate () << "%";
+
+        pass ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(NodeStoreAdmission_timing,ripple_core,ripple);
+
+}
+}
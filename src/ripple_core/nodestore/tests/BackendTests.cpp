@@ -76,6 +76,11 @@ public:
             std::unique_ptr <Backend> backend (manager->make_Backend (
                 params, scheduler, j));
 
+            // Read it back in with one call, which keeps the order
+            Batch batchCopy;
+            fetchBatchCopyOfBatch (*backend, &batchCopy, batch);
+            expect (areBatchesEqual (batch, batchCopy), "Should be equal");
+
             // Read it back in
             Batch copy;
             fetchCopyOfBatch (*backend, &copy, batch);
@@ -105,6 +110,10 @@ public:
     #if RIPPLE_ROCKSDB_AVAILABLE
         testBackend ("rocksdb", seedValue);
     #endif
+
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testBackend ("segment", seedValue);
+    #endif
     }
 };
 
@@ -70,6 +70,75 @@ public:
         }
     }
 
+    // Checks the compact encoding of inner nodes
+    void testInnerNodes (std::int64_t const seedValue)
+    {
+        testcase ("inner nodes");
+
+        beast::Random r (seedValue);
+
+        for (int branchCount = 0; branchCount <= 16; ++branchCount)
+        {
+            Serializer s;
+            s.add32 (HashPrefix::innerNode);
+
+            // Spread the non-empty branches around
+            int const offset = r.nextInt (16);
+            for (int i = 0; i < 16; ++i)
+            {
+                uint256 hash;
+                if (((i + offset) % 16) < branchCount)
+                    r.fillBitsRandomly (hash.begin (), hash.size ());
+                s.add256 (hash);
+            }
+
+            uint256 const key (s.getSHA512Half ());
+            NodeObject::Ptr const object (NodeObject::createObject (
+                hotACCOUNT_NODE, 1, std::move (s.modData ()), key));
+
+            // The full form is written unless asked for otherwise
+            EncodedBlob full;
+            full.prepare (object);
+
+            expect (full.getSize () == 9 + DecodedBlob::innerNodeBytes,
+                "Should store the full node");
+
+            DecodedBlob decodedFull (full.getKey (), full.getData (), full.getSize ());
+            expect (decodedFull.wasOk (), "Should be ok");
+
+            if (decodedFull.wasOk ())
+                expect (object->isCloneOf (decodedFull.createObject ()), "Should be clones");
+
+            // A node with every branch in use is smaller in the full form
+            EncodedBlob encoded (true);
+            encoded.prepare (object);
+
+            if (branchCount < 16)
+            {
+                expect (encoded.getSize () == 9 + 2 + 32 * branchCount,
+                    "Should only store the non-empty branches");
+            }
+            else
+            {
+                expect (encoded.getSize () == full.getSize (),
+                    "Should store the full node");
+            }
+
+            DecodedBlob decoded (encoded.getKey (), encoded.getData (), encoded.getSize ());
+            expect (decoded.wasOk (), "Should be ok");
+
+            if (decoded.wasOk ())
+                expect (object->isCloneOf (decoded.createObject ()), "Should be clones");
+
+            // A body that does not match the branch map is corrupt
+            if (branchCount > 0 && branchCount < 16)
+            {
+                DecodedBlob truncated (encoded.getKey (), encoded.getData (), encoded.getSize () - 1);
+                expect (! truncated.wasOk (), "Should not be ok");
+            }
+        }
+    }
+
     void run ()
     {
         std::int64_t const seedValue = 50;
@@ -77,6 +146,8 @@ public:
         testBatches (seedValue);
 
         testBlobs (seedValue);
+
+        testInnerNodes (seedValue);
     }
 };
 
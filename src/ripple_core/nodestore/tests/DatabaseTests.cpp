@@ -147,6 +147,12 @@ public:
                 std::unique_ptr <Database> db (manager->make_Database (
                     "test", scheduler, j, 2, nodeParams));
 
+                // Read it back in with one call, the cache is still empty
+                // so this goes to the backend
+                Batch batchCopy;
+                fetchBatchCopyOfBatch (*db, &batchCopy, batch);
+                expect (areBatchesEqual (batch, batchCopy), "Should be equal");
+
                 // Read it back in
                 Batch copy;
                 fetchCopyOfBatch (*db, &copy, batch);
@@ -189,6 +195,10 @@ public:
         testNodeStore ("rocksdb", useEphemeralDatabase, true, seedValue);
     #endif
 
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testNodeStore ("segment", useEphemeralDatabase, true, seedValue);
+    #endif
+
     #if RIPPLE_ENABLE_SQLITE_BACKEND_TESTS
         testNodeStore ("sqlite", useEphemeralDatabase, true, seedValue);
     #endif
@@ -196,6 +206,169 @@ public:
 
     //--------------------------------------------------------------------------
 
+    void testAsyncFetch (beast::String type, int readThreads,
+                         std::int64_t const seedValue)
+    {
+        std::unique_ptr <Manager> manager (make_Manager ());
+
+        DummyScheduler scheduler;
+
+        testcase ((beast::String ("asyncFetch '") + type + "' with " +
+            beast::String (readThreads) + " read threads").toStdString ());
+
+        beast::File const node_db (beast::File::createTempFile ("node_db"));
+        beast::StringPairArray nodeParams;
+        nodeParams.set ("type", type);
+        nodeParams.set ("path", node_db.getFullPathName ());
+
+        Batch batch;
+        createPredictableBatch (batch, 0, numObjectsToTest, seedValue);
+
+        beast::Journal j;
+
+        {
+            std::unique_ptr <Database> db (manager->make_Database (
+                "test", scheduler, j, readThreads, nodeParams));
+            storeBatch (*db, batch);
+        }
+
+        // Re-open, so that every fetch has to go to the backend
+        std::unique_ptr <Database> db (manager->make_Database (
+            "test", scheduler, j, readThreads, nodeParams));
+
+        std::mutex mutex;
+        Batch copy;
+
+        {
+            Database::FetchWaiter reads;
+
+            for (int i = 0; i < batch.size (); ++i)
+            {
+                Database::FetchCallback const done (reads.callback ());
+
+                NodeObject::Ptr object;
+                db->asyncFetch (batch [i]->getHash (), object,
+                    [&mutex, &copy, done](NodeObject::Ptr const& fetched)
+                    {
+                        if (fetched != nullptr)
+                        {
+                            std::lock_guard <std::mutex> lock (mutex);
+                            copy.push_back (fetched);
+                        }
+                        done (fetched);
+                    });
+            }
+
+            reads.wait ();
+        }
+
+        // The callbacks run in any order
+        std::sort (batch.begin (), batch.end (), NodeObject::LessThan ());
+        std::sort (copy.begin (), copy.end (), NodeObject::LessThan ());
+        expect (areBatchesEqual (batch, copy), "Should be equal");
+    }
+
+    //--------------------------------------------------------------------------
+
+    // Returns the number of objects in the batch that the backend has
+    std::size_t countFound (Backend& backend, Batch const& batch)
+    {
+        std::size_t found (0);
+        for (auto const& object : batch)
+        {
+            NodeObject::Ptr copy;
+            if (backend.fetch (object->getHash ().cbegin (), &copy) == ok)
+                ++found;
+        }
+        return found;
+    }
+
+    void testRotation (beast::String type, std::int64_t const seedValue)
+    {
+        std::unique_ptr <Manager> manager (make_Manager ());
+
+        DummyScheduler scheduler;
+
+        testcase ((beast::String ("rotation '") + type + "'").toStdString ());
+
+        beast::Journal j;
+
+        auto const makeBackend = [&]()
+        {
+            beast::StringPairArray params;
+            params.set ("type", type);
+            params.set ("path", beast::File::createTempFile (
+                "node_db").getFullPathName ());
+            return manager->make_Backend (params, scheduler, j);
+        };
+
+        Batch older;
+        createPredictableBatch (older, 0, numObjectsToTest, seedValue);
+
+        Batch newer;
+        createPredictableBatch (newer, numObjectsToTest, numObjectsToTest, seedValue);
+
+        std::unique_ptr <Backend> first (makeBackend ());
+        Backend* const firstBackend (first.get ());
+
+        std::unique_ptr <DatabaseRotating> db (manager->make_DatabaseRotating (
+            "test", scheduler, j, 2, std::move (first), nullptr));
+        expect (! db->hasArchive ());
+
+        storeBatch (*db, older);
+
+        std::unique_ptr <Backend> second (makeBackend ());
+        Backend* const secondBackend (second.get ());
+
+        expect (db->rotate (std::move (second)) == nullptr);
+        expect (db->hasArchive ());
+
+        storeBatch (*db, newer);
+        expect (countFound (*secondBackend, older) == 0);
+        expect (countFound (*secondBackend, newer) == newer.size ());
+
+        {
+            // Both backends are read
+            Batch copy;
+            fetchBatchCopyOfBatch (*db, &copy, older);
+            expect (areBatchesEqual (older, copy), "Should be equal");
+        }
+
+        // Keep half of the older objects
+        Batch const kept (older.begin (), older.begin () + older.size () / 2);
+        Batch const dropped (older.begin () + older.size () / 2, older.end ());
+
+        db->copyToWritable (kept);
+        expect (countFound (*secondBackend, kept) == kept.size ());
+        expect (countFound (*secondBackend, dropped) == 0);
+
+        // The first backend comes back, the second is now the archive
+        std::shared_ptr <Backend> archive (db->rotate (makeBackend ()));
+        expect (archive.get () == firstBackend);
+        archive.reset ();
+
+        {
+            Batch copy;
+            fetchCopyOfBatch (*db, &copy, kept);
+            expect (areBatchesEqual (kept, copy), "Should be equal");
+
+            fetchCopyOfBatch (*db, &copy, newer);
+            expect (areBatchesEqual (newer, copy), "Should be equal");
+        }
+
+        // The rest went with the first backend, even though they were
+        // cached when they were stored
+        std::size_t found (0);
+        for (auto const& object : dropped)
+        {
+            if (db->fetch (object->getHash ()) != nullptr)
+                ++found;
+        }
+        expect (found == 0, "Dropped objects should be gone");
+    }
+
+    //--------------------------------------------------------------------------
+
     void runImportTests (std::int64_t const seedValue)
     {
         testImport ("leveldb", "leveldb", seedValue);
@@ -208,6 +381,10 @@ public:
         testImport ("hyperleveldb", "hyperleveldb", seedValue);
     #endif
 
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testImport ("segment", "segment", seedValue);
+    #endif
+
     #if RIPPLE_ENABLE_SQLITE_BACKEND_TESTS
         testImport ("sqlite", "sqlite", seedValue);
     #endif
@@ -215,6 +392,76 @@ public:
 
     //--------------------------------------------------------------------------
 
+    void testImportResume (beast::String srcBackendType, std::int64_t const seedValue)
+    {
+        std::unique_ptr <Manager> manager (make_Manager ());
+
+        DummyScheduler scheduler;
+
+        testcase ((beast::String ("import resume from '") + srcBackendType + "'").toStdString ());
+
+        beast::Journal j;
+
+        Batch batch;
+        createPredictableBatch (batch, 0, numObjectsToTest, seedValue);
+
+        beast::StringPairArray srcParams;
+        srcParams.set ("type", srcBackendType);
+        srcParams.set ("path", beast::File::createTempFile ("node_db").getFullPathName ());
+
+        beast::StringPairArray destParams;
+        destParams.set ("type", "leveldb");
+        destParams.set ("path", beast::File::createTempFile ("dest_db").getFullPathName ());
+
+        std::unique_ptr <Database> src (manager->make_Database (
+            "test", scheduler, j, 2, srcParams));
+        storeBatch (*src, batch);
+
+        // A checkpoint from an import that got through the lower half
+        beast::File const checkpoint (beast::File::createTempFile ("checkpoint"));
+        beast::String text ("import " + src->getName () + "\n");
+        for (int i = 0; i < 128; ++i)
+            text << beast::String (i) << "\n";
+        checkpoint.replaceWithText (text);
+
+        {
+            std::unique_ptr <Database> dest (manager->make_Database (
+                "test", scheduler, j, 2, destParams));
+            dest->import (*src, checkpoint.getFullPathName ().toStdString ());
+        }
+
+        expect (! checkpoint.exists (), "Checkpoint should be removed");
+
+        {
+            std::unique_ptr <Database> dest (manager->make_Database (
+                "test", scheduler, j, 2, destParams));
+
+            // Only the partitions that were not done are copied
+            bool correct = true;
+            for (auto const& object : batch)
+            {
+                bool const skipped = object->getHash ().cbegin () [0] < 128;
+                if ((dest->fetch (object->getHash ()) == nullptr) != skipped)
+                    correct = false;
+            }
+            expect (correct, "Should resume after the checkpoint");
+        }
+
+        {
+            std::unique_ptr <Database> dest (manager->make_Database (
+                "test", scheduler, j, 2, destParams));
+
+            // Without a checkpoint everything is copied
+            dest->import (*src);
+
+            Batch copy;
+            fetchCopyOfBatch (*dest, &copy, batch);
+            expect (areBatchesEqual (batch, copy), "Should be equal");
+        }
+    }
+
+    //--------------------------------------------------------------------------
+
     void run ()
     {
         std::int64_t const seedValue = 50;
@@ -226,6 +473,23 @@ public:
         runBackendTests (true, seedValue);
 
         runImportTests (seedValue);
+
+        testImportResume ("leveldb", seedValue);
+
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        // Read in one pass, since segments have no ordered index
+        testImportResume ("segment", seedValue);
+    #endif
+
+        testAsyncFetch ("leveldb", 2, seedValue);
+
+        testAsyncFetch ("leveldb", 0, seedValue);
+
+        testRotation ("leveldb", seedValue);
+
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testRotation ("segment", seedValue);
+    #endif
     }
 };
 
@@ -0,0 +1,228 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+namespace ripple {
+namespace NodeStore {
+
+class NodeStoreFastTier_test : public TestBase
+{
+public:
+    // Remembers the fast backend counts from the fetch reports
+    class RecordingScheduler : public DummyScheduler
+    {
+    public:
+        RecordingScheduler ()
+            : fastHits (0)
+            , fastMisses (0)
+        {
+        }
+
+        void onFetch (FetchReport const& report) override
+        {
+            fastHits += report.fastHits;
+            fastMisses += report.fastMisses;
+        }
+
+        int fastHits;
+        int fastMisses;
+    };
+
+    static NodeObject::Ptr makeObject (int index)
+    {
+        uint256 hash;
+        hash.begin () [0] = static_cast <unsigned char> (index >> 8);
+        hash.begin () [1] = static_cast <unsigned char> (index);
+        return NodeObject::createObject (hotUNKNOWN, 0,
+            Blob (1000, static_cast <unsigned char> (index)), hash);
+    }
+
+    static bool contains (FastTier& tier, NodeObject::Ptr const& object)
+    {
+        NodeObject::Ptr found;
+        tier.fetch (object->getHash (), &found);
+        return found != nullptr;
+    }
+
+    // Store objects until the tier has rotated the given number of times
+    static void fillUntil (FastTier& tier, std::uint64_t rotations, int& next)
+    {
+        while (tier.getRotations () < rotations)
+            tier.store (makeObject (next++));
+    }
+
+    void testPromotion ()
+    {
+        testcase ("promotion");
+
+        std::unique_ptr <Manager> manager (make_Manager ());
+        DummyScheduler scheduler;
+        beast::Journal j;
+
+        beast::StringPairArray params;
+        params.set ("type", "memory");
+
+        FastTier tier (*manager, params, scheduler, j);
+
+        NodeObject::Ptr const object (makeObject (1));
+
+        expect (! tier.promote (object), "First read should not be promoted");
+        expect (! contains (tier, object));
+        expect (tier.promote (object), "Second read should be promoted");
+        expect (contains (tier, object));
+
+        expect (tier.getPromotions () == 1);
+        expect (tier.getHits () == 1);
+        expect (tier.getMisses () == 1);
+        expect (tier.getRotations () == 0);
+    }
+
+    void testEviction ()
+    {
+        testcase ("eviction");
+
+        std::unique_ptr <Manager> manager (make_Manager ());
+        DummyScheduler scheduler;
+        beast::Journal j;
+
+        beast::StringPairArray params;
+        params.set ("type", "memory");
+        params.set ("max_mb", "1");
+
+        FastTier tier (*manager, params, scheduler, j);
+
+        NodeObject::Ptr const read (makeObject (1));
+        NodeObject::Ptr const unread (makeObject (2));
+        int next = 3;
+
+        tier.store (read);
+        tier.store (unread);
+
+        // Both are in the old generation now
+        fillUntil (tier, 1, next);
+        expect (contains (tier, read));
+
+        // Only the one that was read made it into the newer generation
+        fillUntil (tier, 2, next);
+        expect (contains (tier, read), "Read object should survive");
+        expect (! contains (tier, unread), "Unread object should be evicted");
+
+        expect (tier.getBytes () < 1024 * 1024 / 2);
+    }
+
+    void testReopen ()
+    {
+        testcase ("reopen");
+
+        std::unique_ptr <Manager> manager (make_Manager ());
+        DummyScheduler scheduler;
+        beast::Journal j;
+
+        beast::File const temp_db (beast::File::createTempFile ("temp_db"));
+        beast::StringPairArray params;
+        params.set ("type", "leveldb");
+        params.set ("path", temp_db.getFullPathName ());
+        params.set ("max_mb", "1");
+
+        NodeObject::Ptr const first (makeObject (1));
+        NodeObject::Ptr last;
+
+        {
+            FastTier tier (*manager, params, scheduler, j);
+
+            tier.store (first);
+            int next = 2;
+            fillUntil (tier, 2, next);
+            last = makeObject (next);
+            tier.store (last);
+
+            // The generation dropped by the second rotation goes
+            tier.sweep ();
+
+            beast::Array <beast::File> children;
+            temp_db.findChildFiles (children, beast::File::findDirectories, false);
+            expect (children.size () == 2, "Should keep two generations");
+        }
+
+        {
+            // The newest generations are opened again
+            FastTier tier (*manager, params, scheduler, j);
+            expect (contains (tier, last));
+            expect (! contains (tier, first));
+            expect (tier.getBytes () > 0);
+        }
+
+        temp_db.deleteRecursively ();
+    }
+
+    void testReport ()
+    {
+        testcase ("fetch report");
+
+        std::unique_ptr <Manager> manager (make_Manager ());
+        RecordingScheduler scheduler;
+        beast::Journal j;
+
+        beast::File const node_db (beast::File::createTempFile ("node_db"));
+        beast::StringPairArray nodeParams;
+        nodeParams.set ("type", "leveldb");
+        nodeParams.set ("path", node_db.getFullPathName ());
+
+        beast::StringPairArray tempParams;
+        tempParams.set ("type", "memory");
+
+        Batch batch;
+        createPredictableBatch (batch, 0, 100, 1);
+
+        {
+            std::unique_ptr <Database> db (manager->make_Database (
+                "test", scheduler, j, 0, nodeParams));
+            storeBatch (*db, batch);
+        }
+
+        std::unique_ptr <Database> db (manager->make_Database (
+            "test", scheduler, j, 0, nodeParams, tempParams));
+
+        // Every read goes past the memory cache
+        Database::ScopedNoCache noCache;
+
+        for (int pass = 0; pass < 3; ++pass)
+        {
+            for (auto const& object : batch)
+                expect (db->fetch (object->getHash ()) != nullptr);
+        }
+
+        // Promoted on the second pass, found on the third
+        expect (scheduler.fastMisses == 2 * batch.size ());
+        expect (scheduler.fastHits == batch.size ());
+    }
+
+    void run ()
+    {
+        testPromotion ();
+        testEviction ();
+        testReopen ();
+        testReport ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(NodeStoreFastTier,ripple_core,ripple);
+
+}
+}
@@ -0,0 +1,196 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#if RIPPLE_SEGMENTDB_AVAILABLE
+
+namespace ripple {
+namespace NodeStore {
+
+class NodeStoreSegment_test : public TestBase
+{
+public:
+    void testIndex ()
+    {
+        testcase ("index");
+
+        SegmentIndex index;
+        std::size_t const initialCapacity (index.capacity ());
+
+        // Every prefix lands in the same few slots, so they all probe
+        int const count = 5000;
+        for (int i = 0; i < count; ++i)
+            index.insert (std::uint64_t (i) << 32, 1 + (i % 3), i);
+
+        expect (index.size () == count);
+        expect (index.capacity () > initialCapacity);
+
+        // Duplicate prefixes are all reported
+        index.insert (0, 7, 99);
+
+        int found = 0;
+        index.find (0, [&](std::uint32_t segment, std::uint32_t offset)
+        {
+            ++found;
+            expect ((segment == 1 && offset == 0) || (segment == 7 && offset == 99));
+            return false;
+        });
+        expect (found == 2);
+
+        bool ok = true;
+        for (int i = 0; i < count; ++i)
+        {
+            ok = ok && index.find (std::uint64_t (i) << 32,
+                [&](std::uint32_t segment, std::uint32_t offset)
+                {
+                    return segment == 1 + (i % 3) && offset == i;
+                });
+        }
+        expect (ok, "Should find every entry");
+        expect (! index.find (1, [](std::uint32_t, std::uint32_t) { return true; }));
+
+        index.eraseSegment (2);
+        expect (index.size () == count + 1 - count / 3);
+
+        int remaining = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (index.find (std::uint64_t (i) << 32,
+                    [](std::uint32_t segment, std::uint32_t)
+                    {
+                        return segment == 2;
+                    }))
+                expect (false, "Erased segment should be gone");
+
+            if (index.find (std::uint64_t (i) << 32,
+                    [](std::uint32_t, std::uint32_t) { return true; }))
+                ++remaining;
+        }
+        expect (remaining == count - count / 3);
+    }
+
+    //--------------------------------------------------------------------------
+
+    std::size_t countFound (Backend& backend, Batch const& batch)
+    {
+        std::size_t found (0);
+        for (auto const& object : batch)
+        {
+            NodeObject::Ptr copy;
+            if (backend.fetch (object->getHash ().begin (), &copy) == ok)
+            {
+                expect (copy->isCloneOf (object), "Should be equal");
+                ++found;
+            }
+        }
+        return found;
+    }
+
+    void testRotation (std::int64_t const seedValue)
+    {
+        testcase ("rotation");
+
+        DummyScheduler scheduler;
+        beast::Journal j;
+
+        beast::StringPairArray params;
+        beast::File const path (beast::File::createTempFile ("node_db"));
+        params.set ("path", path.getFullPathName ());
+        params.set ("segment_mb", "1");
+
+        Batch older;
+        createPredictableBatch (older, 0, numObjectsToTest, seedValue);
+
+        Batch newer;
+        createPredictableBatch (newer, numObjectsToTest, numObjectsToTest, seedValue);
+
+        std::uint32_t first;
+
+        {
+            SegmentBackend backend (NodeObject::keyBytes, params, scheduler, j);
+
+            backend.storeBatch (older);
+            first = backend.rotate ();
+            backend.storeBatch (newer);
+
+            // Storing again in the same segment adds nothing
+            backend.storeBatch (Batch (1, newer.back ()));
+
+            std::vector <std::uint32_t> const segments (backend.getSegments ());
+            expect (segments.size () >= 2);
+            expect (segments.front () == first);
+            expect (! backend.deleteSegment (segments.back ()),
+                "Should not delete the current segment");
+
+            expect (countFound (backend, older) == older.size ());
+            expect (countFound (backend, newer) == newer.size ());
+        }
+
+        {
+            // Re-open and check the index was rebuilt
+            SegmentBackend backend (NodeObject::keyBytes, params, scheduler, j);
+
+            expect (countFound (backend, older) == older.size ());
+            expect (countFound (backend, newer) == newer.size ());
+
+            std::size_t visited (0);
+            backend.for_each ([&](NodeObject::Ptr) { ++visited; });
+            expect (visited == older.size () + newer.size ());
+
+            // Carry some older objects forward before dropping them
+            Batch const kept (older.begin (), older.begin () + 10);
+            backend.rotate ();
+            backend.storeBatch (kept);
+
+            // Drop every segment written before the first rotation
+            for (auto const id : backend.getSegments ())
+            {
+                if (id <= first)
+                    expect (backend.deleteSegment (id));
+            }
+
+            expect (countFound (backend, older) == kept.size ());
+            expect (countFound (backend, kept) == kept.size ());
+            expect (countFound (backend, newer) == newer.size ());
+        }
+
+        {
+            // The deleted segments stay deleted
+            SegmentBackend backend (NodeObject::keyBytes, params, scheduler, j);
+
+            expect (backend.getSegments ().front () > first);
+            expect (countFound (backend, older) == 10);
+            expect (countFound (backend, newer) == newer.size ());
+        }
+    }
+
+    void run ()
+    {
+        int const seedValue = 50;
+
+        testIndex ();
+        testRotation (seedValue);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(NodeStoreSegment,ripple_core,ripple);
+
+}
+}
+
+#endif
@@ -66,15 +66,15 @@ public:
 
             LedgerIndex ledgerIndex = 1 + r.nextInt (1024 * 1024);
 
-            uint256 hash;
-            r.fillBitsRandomly (hash.begin (), hash.size ());
-
             int const payloadBytes = 1 + r.nextInt (maxPayloadBytes);
 
             Blob data (payloadBytes);
 
             r.fillBitsRandomly (data.data (), payloadBytes);
 
+            // Keyed by the hash of the data, like real objects
+            uint256 const hash (Serializer::getSHA512Half (data.data (), payloadBytes));
+
             return NodeObject::createObject(type, ledgerIndex, std::move(data), hash);
         }
 
@@ -152,6 +152,26 @@ public:
         }
     }
 
+    // Fetch all the hashes with one call, into another batch.
+    void fetchBatchCopyOfBatch (Backend& backend, Batch* pCopy, Batch const& batch)
+    {
+        std::vector <void const*> keys;
+        keys.reserve (batch.size ());
+
+        for (int i = 0; i < batch.size (); ++i)
+            keys.push_back (batch [i]->getHash ().cbegin ());
+
+        std::vector <Status> results;
+
+        backend.fetchBatch (keys, results, *pCopy);
+
+        expect (results.size () == batch.size (), "Should have a result per key");
+        expect (pCopy->size () == batch.size (), "Should have an object per key");
+
+        for (int i = 0; i < results.size (); ++i)
+            expect (results [i] == ok, "Should be ok");
+    }
+
     // Store all objects in a batch
     static void storeBatch (Database& db, Batch const& batch)
     {
@@ -184,6 +204,27 @@ public:
                 pCopy->push_back (object);
         }
     }
+
+    // Fetch all the hashes with one call, into another batch.
+    static void fetchBatchCopyOfBatch (Database& db,
+                                       Batch* pCopy,
+                                       Batch const& batch)
+    {
+        std::vector <uint256> hashes;
+        hashes.reserve (batch.size ());
+
+        for (int i = 0; i < batch.size (); ++i)
+            hashes.push_back (batch [i]->getHash ());
+
+        pCopy->clear ();
+        pCopy->reserve (batch.size ());
+
+        for (auto const& object : db.fetchBatch (hashes))
+        {
+            if (object != nullptr)
+                pCopy->push_back (object);
+        }
+    }
 };
 
 }
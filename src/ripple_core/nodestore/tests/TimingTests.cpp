@@ -108,6 +108,58 @@ public:
 
     //--------------------------------------------------------------------------
 
+    void testImport (beast::String type, std::int64_t const seedValue)
+    {
+        std::unique_ptr <Manager> manager (make_Manager ());
+
+        DummyScheduler scheduler;
+
+        beast::String s;
+        s << "Testing import into '" << type << "' performance";
+        testcase (s.toStdString());
+
+        beast::StringPairArray srcParams;
+        srcParams.set ("type", type);
+        srcParams.set ("path", beast::File::createTempFile ("node_db").getFullPathName ());
+
+        beast::StringPairArray destParams;
+        destParams.set ("type", type);
+        destParams.set ("path", beast::File::createTempFile ("dest_db").getFullPathName ());
+
+        Batch batch;
+        createPredictableBatch (batch, 0, numObjectsToTest, seedValue);
+
+        std::size_t bytes = 0;
+        for (auto const& object : batch)
+            bytes += object->getData ().size ();
+
+        beast::Journal j;
+
+        std::unique_ptr <Database> src (manager->make_Database (
+            "test", scheduler, j, 2, srcParams));
+        storeBatch (*src, batch);
+
+        std::unique_ptr <Database> dest (manager->make_Database (
+            "test", scheduler, j, 2, destParams));
+
+        Stopwatch t;
+        t.start ();
+        dest->import (*src);
+        double const elapsed = t.getElapsed ();
+
+        double const megabytes = bytes / (1024.0 * 1024.0);
+        s = "";
+        s << "  Import:       " << beast::String (elapsed, 2) << " seconds, " <<
+            beast::String (megabytes / std::max (elapsed, 0.001), 2) << " MB/s";
+        log << s.toStdString();
+
+        Batch copy;
+        fetchCopyOfBatch (*dest, &copy, batch);
+        expect (areBatchesEqual (batch, copy), "Should be equal");
+    }
+
+    //--------------------------------------------------------------------------
+
     void run ()
     {
         int const seedValue = 50;
@@ -122,9 +174,19 @@ public:
         testBackend ("rocksdb", seedValue);
     #endif
 
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testBackend ("segment", seedValue);
+    #endif
+
     #if RIPPLE_ENABLE_SQLITE_BACKEND_TESTS
         testBackend ("sqlite", seedValue);
     #endif
+
+        testImport ("leveldb", seedValue);
+
+    #if RIPPLE_SEGMENTDB_AVAILABLE
+        testImport ("segment", seedValue);
+    #endif
     }
 };
 
@@ -920,6 +920,73 @@ STAmount operator- (const STAmount& v1, const STAmount& v2)
         return STAmount (v1.getFName (), v1.mCurrency, v1.mIssuer, -fv, ov1, true);
 }
 
+std::uint64_t STAmount::mulDiv (std::uint64_t a, std::uint64_t b,
+                                std::uint64_t c, std::uint64_t d)
+{
+    assert (d != 0);
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 uint128;
+
+    uint128 const q = (static_cast <uint128> (a) * b + c) / d;
+
+    if ((q >> 64) != 0)
+        return std::numeric_limits <std::uint64_t>::max ();
+
+    return static_cast <std::uint64_t> (q);
+#else
+    return mulDivPortable (a, b, c, d);
+#endif
+}
+
+std::uint64_t STAmount::mulDivPortable (std::uint64_t a, std::uint64_t b,
+                                        std::uint64_t c, std::uint64_t d)
+{
+    assert (d != 0);
+
+    // Multiply in 32 bit halves
+    std::uint64_t const aLo = a & 0xffffffffull, aHi = a >> 32;
+    std::uint64_t const bLo = b & 0xffffffffull, bHi = b >> 32;
+
+    std::uint64_t const p0 = aLo * bLo;
+    std::uint64_t const p1 = aLo * bHi;
+    std::uint64_t const p2 = aHi * bLo;
+    std::uint64_t const p3 = aHi * bHi;
+
+    std::uint64_t const mid = (p0 >> 32) + (p1 & 0xffffffffull) + (p2 & 0xffffffffull);
+
+    std::uint64_t lo = (mid << 32) | (p0 & 0xffffffffull);
+    std::uint64_t hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+
+    // Can't carry out of the top, a * b + c < 2^128
+    lo += c;
+    if (lo < c)
+        ++hi;
+
+    if (hi >= d)
+        return std::numeric_limits <std::uint64_t>::max ();
+
+    // Long division, one bit at a time. The remainder stays below d, and
+    // so fits in 64 bits apart from the bit shifted out of the top.
+    std::uint64_t q = 0;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        bool const carry = (hi >> 63) != 0;
+        hi = (hi << 1) | (lo >> 63);
+        lo <<= 1;
+        q <<= 1;
+
+        if (carry || hi >= d)
+        {
+            hi -= d;
+            q |= 1;
+        }
+    }
+
+    return q;
+}
+
 STAmount STAmount::divide (const STAmount& num, const STAmount& den, const uint160& uCurrencyID, const uint160& uIssuerID)
 {
     if (den == zero)
@@ -947,19 +1014,10 @@ STAmount STAmount::divide (const STAmount& num, const STAmount& den, const uint1
         }
 
     // Compute (numerator * 10^17) / denominator
-    CBigNum v;
-
-    if ((BN_add_word64 (&v, numVal) != 1) ||
-            (BN_mul_word64 (&v, tenTo17) != 1) ||
-            (BN_div_word64 (&v, denVal) == ((std::uint64_t) - 1)))
-    {
-        throw std::runtime_error ("internal bn error");
-    }
-
     // 10^16 <= quotient <= 10^18
-    assert (BN_num_bytes (&v) <= 64);
+    std::uint64_t const v = mulDiv (numVal, tenTo17, 0, denVal);
 
-    return STAmount (uCurrencyID, uIssuerID, v.getuint64 () + 5,
+    return STAmount (uCurrencyID, uIssuerID, v + 5,
                      numOffset - denOffset - 17, num.mIsNegative != den.mIsNegative);
 }
 
@@ -1005,19 +1063,9 @@ STAmount STAmount::multiply (const STAmount& v1, const STAmount& v2, const uint1
 
     // Compute (numerator * denominator) / 10^14 with rounding
     // 10^16 <= result <= 10^18
-    CBigNum v;
-
-    if ((BN_add_word64 (&v, value1) != 1) ||
-            (BN_mul_word64 (&v, value2) != 1) ||
-            (BN_div_word64 (&v, tenTo14) == ((std::uint64_t) - 1)))
-    {
-        throw std::runtime_error ("internal bn error");
-    }
-
-    // 10^16 <= product <= 10^18
-    assert (BN_num_bytes (&v) <= 64);
+    std::uint64_t const v = mulDiv (value1, value2, 0, tenTo14);
 
-    return STAmount (uCurrencyID, uIssuerID, v.getuint64 () + 7, offset1 + offset2 + 14,
+    return STAmount (uCurrencyID, uIssuerID, v + 7, offset1 + offset2 + 14,
                      v1.mIsNegative != v2.mIsNegative);
 }
 
@@ -1191,6 +1239,27 @@ public:
         return STAmount::deserialize (sit);
     }
 
+    // The BIGNUM arithmetic that STAmount::mulDiv replaced
+    static std::uint64_t bigMulDiv (std::uint64_t a, std::uint64_t b,
+                                    std::uint64_t c, std::uint64_t d)
+    {
+        CBigNum v;
+
+        if ((BN_add_word64 (&v, a) != 1) ||
+                (BN_mul_word64 (&v, b) != 1) ||
+                (BN_add_word64 (&v, c) != 1) ||
+                (BN_div_word64 (&v, d) == ((std::uint64_t) - 1)))
+        {
+            throw std::runtime_error ("internal bn error");
+        }
+
+        // Too large a quotient gives all ones on 64 bit platforms
+        if (BN_num_bits (&v) > 64)
+            return std::numeric_limits <std::uint64_t>::max ();
+
+        return v.getuint64 ();
+    }
+
     //--------------------------------------------------------------------------
 
     bool roundTest (int n, int d, int m)
@@ -1804,6 +1873,75 @@ public:
 
     //--------------------------------------------------------------------------
 
+    void testMulDiv ()
+    {
+        testcase ("mulDiv");
+
+        std::uint64_t const max = std::numeric_limits <std::uint64_t>::max ();
+
+        std::uint64_t const edges [] =
+        {
+            0, 1, 2, 5, 7, 10,
+            tenTo14m1, tenTo14, tenTo17m1, tenTo17,
+            STAmount::cMinValue, STAmount::cMaxValue,
+            STAmount::cMaxNativeN, STAmount::cMaxNative,
+            0xffffffffull, 0x100000000ull, 0x100000001ull,
+            0x7fffffffffffffffull, 0x8000000000000000ull, max - 1, max
+        };
+
+        int const count = sizeof (edges) / sizeof (edges [0]);
+        int failures = 0;
+
+        // Every combination of the edge values
+        for (int ia = 0; ia < count; ++ia)
+            for (int ib = 0; ib < count; ++ib)
+                for (int ic = 0; ic < count; ++ic)
+                    for (int id = 0; id < count; ++id)
+                    {
+                        std::uint64_t const d = edges [id];
+                        if (d == 0)
+                            continue;
+
+                        std::uint64_t const a = edges [ia];
+                        std::uint64_t const b = edges [ib];
+                        std::uint64_t const c = edges [ic];
+
+                        std::uint64_t const expected = bigMulDiv (a, b, c, d);
+
+                        if (STAmount::mulDiv (a, b, c, d) != expected ||
+                            STAmount::mulDivPortable (a, b, c, d) != expected)
+                            ++failures;
+                    }
+
+        expect (failures == 0, "mulDiv differs at the edges");
+
+        // Random values in the ranges multiply and divide use, and the
+        // rounding terms they add
+        beast::Random r (1);
+        failures = 0;
+
+        for (int i = 0; i < 200000; ++i)
+        {
+            std::uint64_t const a = STAmount::cMinValue +
+                static_cast <std::uint64_t> (r.nextInt64 ()) % (STAmount::cMaxNative - STAmount::cMinValue);
+            std::uint64_t const b = ((i & 1) != 0) ? tenTo17 : STAmount::cMinValue +
+                static_cast <std::uint64_t> (r.nextInt64 ()) % (STAmount::cMaxValue - STAmount::cMinValue);
+            std::uint64_t const d = ((i & 1) != 0) ? STAmount::cMinValue +
+                static_cast <std::uint64_t> (r.nextInt64 ()) % (STAmount::cMaxValue - STAmount::cMinValue) : tenTo14;
+            std::uint64_t const c = r.nextBool () ? d - 1 : 0;
+
+            std::uint64_t const expected = bigMulDiv (a, b, c, d);
+
+            if (STAmount::mulDiv (a, b, c, d) != expected ||
+                STAmount::mulDivPortable (a, b, c, d) != expected)
+                ++failures;
+        }
+
+        expect (failures == 0, "mulDiv differs on random values");
+    }
+
+    //--------------------------------------------------------------------------
+
     void run ()
     {
         testSetValue ();
@@ -1812,9 +1950,78 @@ public:
         testArithmetic ();
         testUnderflow ();
         testRounding ();
+        testMulDiv ();
     }
 };
 
 BEAST_DEFINE_TESTSUITE(STAmount,ripple_data,ripple);
 
+//------------------------------------------------------------------------------
+
+// Times the multiplies and divides done while crossing offers and finding
+// paths, against the BIGNUM arithmetic they used before.
+//
+class STAmount_timing_test : public beast::unit_test::suite
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    template <class Function>
+    static std::chrono::milliseconds time (Function f)
+    {
+        clock_type::time_point const start = clock_type::now ();
+        f ();
+        return std::chrono::duration_cast <std::chrono::milliseconds> (
+            clock_type::now () - start);
+    }
+
+    void run ()
+    {
+        int const ops = 1000000;
+
+        std::vector <std::uint64_t> values;
+        beast::Random r (1);
+        for (int i = 0; i < 1024; ++i)
+            values.push_back (STAmount::cMinValue +
+                static_cast <std::uint64_t> (r.nextInt64 ()) % (STAmount::cMaxValue - STAmount::cMinValue));
+
+        std::uint64_t sink = 0;
+
+        std::chrono::milliseconds const native (time ([&]
+        {
+            for (int i = 0; i < ops; ++i)
+                sink += STAmount::mulDiv (values [i & 1023], tenTo17, 0, values [(i + 1) & 1023]);
+        }));
+
+        std::chrono::milliseconds const bignum (time ([&]
+        {
+            for (int i = 0; i < ops; ++i)
+                sink += STAmount_test::bigMulDiv (values [i & 1023], tenTo17, 0, values [(i + 1) & 1023]);
+        }));
+
+        STAmount const one (CURRENCY_ONE, ACCOUNT_ONE, 1);
+        STAmount const three (CURRENCY_ONE, ACCOUNT_ONE, 3);
+
+        std::chrono::milliseconds const amounts (time ([&]
+        {
+            STAmount v (one);
+            for (int i = 0; i < ops; ++i)
+            {
+                v = STAmount::divRound (STAmount::mulRound (v, three, true), three, false);
+                sink += v.getMantissa ();
+            }
+        }));
+
+        expect (sink != 0);
+
+        log <<
+            ops << " divides: " <<
+            "mulDiv " << native.count () << "ms, " <<
+            "BIGNUM " << bignum.count () << "ms; " <<
+            ops << " mulRound and divRound pairs " << amounts.count () << "ms";
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(STAmount_timing,ripple_data,ripple);
+
 } // ripple
@@ -1189,9 +1189,9 @@ Json::Value STArray::getJson (int p) const
             if (!object.getFName ().hasName ())
                 inner[beast::lexicalCast <std::string> (index)] = object.getJson (p);
             else
-                inner[object.getName ()] = object.getJson (p);
+                inner[object.getJsonName ()] = object.getJson (p);
 
-            v.append (inner);
+            v.append (std::move (inner));
             index++;
         }
     }
@@ -726,6 +726,18 @@ public:
         return multiply (v1, v2, v1);
     }
 
+    // Returns (a * b + c) / d, using 128 bit intermediate values. A quotient
+    // too large for 64 bits gives the largest 64 bit value, which is what
+    // the BIGNUM arithmetic this replaced returned on 64 bit platforms.
+    static std::uint64_t mulDiv (std::uint64_t a, std::uint64_t b,
+                                 std::uint64_t c, std::uint64_t d);
+
+    // The same, using only 64 bit arithmetic. mulDiv uses this where the
+    // compiler has no 128 bit integer, and it is always built so it can be
+    // tested everywhere.
+    static std::uint64_t mulDivPortable (std::uint64_t a, std::uint64_t b,
+                                         std::uint64_t c, std::uint64_t d);
+
     /* addRound, subRound can end up rounding if the amount subtracted is too small
        to make a change. Consder (X-d) where d is very small relative to X.
        If you ask to round down, then (X-d) should not be X unless d is zero.
@@ -368,20 +368,9 @@ uint256 Serializer::getSHA512Half (const unsigned char* data, int len)
 
 uint256 Serializer::getPrefixHash (std::uint32_t prefix, const unsigned char* data, int len)
 {
-    char be_prefix[4];
-    be_prefix[0] = static_cast<unsigned char> (prefix >> 24);
-    be_prefix[1] = static_cast<unsigned char> ((prefix >> 16) & 0xff);
-    be_prefix[2] = static_cast<unsigned char> ((prefix >> 8) & 0xff);
-    be_prefix[3] = static_cast<unsigned char> (prefix & 0xff);
-
-    uint256 j[2];
-    SHA512_CTX ctx;
-    SHA512_Init (&ctx);
-    SHA512_Update (&ctx, &be_prefix[0], 4);
-    SHA512_Update (&ctx, data, len);
-    SHA512_Final (reinterpret_cast<unsigned char*> (&j[0]), &ctx);
-
-    return j[0];
+    SHA512HalfHasher h (prefix);
+    h.addRaw (data, len);
+    return h.getSHA512Half ();
 }
 
 int Serializer::addVL (Blob const& vector)
@@ -688,6 +677,46 @@ Blob SerializerIterator::getRaw (int iLength)
 
 //------------------------------------------------------------------------------
 
+SHA512HalfHasher::SHA512HalfHasher ()
+{
+    SHA512_Init (&mCtx);
+}
+
+SHA512HalfHasher::SHA512HalfHasher (std::uint32_t prefix)
+{
+    SHA512_Init (&mCtx);
+    add32 (prefix);
+}
+
+void SHA512HalfHasher::addRaw (const void* ptr, std::size_t len)
+{
+    SHA512_Update (&mCtx, ptr, len);
+}
+
+void SHA512HalfHasher::add32 (std::uint32_t i)
+{
+    unsigned char be[4];
+    be[0] = static_cast<unsigned char> (i >> 24);
+    be[1] = static_cast<unsigned char> ((i >> 16) & 0xff);
+    be[2] = static_cast<unsigned char> ((i >> 8) & 0xff);
+    be[3] = static_cast<unsigned char> (i & 0xff);
+    addRaw (be, 4);
+}
+
+void SHA512HalfHasher::add256 (uint256 const& i)
+{
+    addRaw (i.begin (), i.size ());
+}
+
+uint256 SHA512HalfHasher::getSHA512Half ()
+{
+    uint256 j[2];
+    SHA512_Final (reinterpret_cast<unsigned char*> (&j[0]), &mCtx);
+    return j[0];
+}
+
+//------------------------------------------------------------------------------
+
 class Serializer_test : public beast::unit_test::suite
 {
 public:
@@ -702,6 +731,36 @@ public:
         s2.addRaw (s1.peekData ());
 
         expect (s1.getPrefixHash (0x12345600) == s2.getSHA512Half ());
+
+        testHasher ();
+    }
+
+    void testHasher ()
+    {
+        testcase ("SHA512HalfHasher");
+
+        uint256 tag;
+        tag.SetHex ("0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF");
+
+        Blob data;
+        for (int i = 0; i < 300; ++i)
+        {
+            Serializer s;
+            s.add32 (HashPrefix::leafNode);
+            s.addRaw (data);
+            s.add256 (tag);
+
+            SHA512HalfHasher h (HashPrefix::leafNode);
+            h.addRaw (data);
+            h.add256 (tag);
+            expect (h.getSHA512Half () == s.getSHA512Half (), "leaf hash");
+
+            data.push_back (static_cast<unsigned char> (i * 7));
+        }
+
+        SHA512HalfHasher empty;
+        expect (empty.getSHA512Half () ==
+            Serializer::getSHA512Half (const_byte_view ()), "empty hash");
     }
 };
 
@@ -22,6 +22,8 @@
 
 #include "../../ripple/common/byte_view.h"
 
+#include <openssl/sha.h>
+
 namespace ripple {
 
 //class CKey; // forward declaration
@@ -304,6 +306,40 @@ public:
     Blob getVL ();
 };
 
+//------------------------------------------------------------------------------
+
+/** Incrementally computes a SHA-512Half.
+    The result matches Serializer::getSHA512Half over the concatenation of
+    everything added. Use this instead of building a Serializer when the
+    bytes only exist to be hashed, such as a SHAMap leaf whose item data
+    would otherwise be copied.
+*/
+class SHA512HalfHasher
+{
+public:
+    SHA512HalfHasher ();
+
+    /** Start a hash whose message begins with a HashPrefix. */
+    explicit SHA512HalfHasher (std::uint32_t prefix);
+
+    void addRaw (const void* ptr, std::size_t len);
+    void addRaw (Blob const& vector)
+    {
+        if (!vector.empty ())
+            addRaw (&vector.front (), vector.size ());
+    }
+    void add32 (std::uint32_t);
+    void add256 (uint256 const& );
+
+    /** Returns the hash of the data added so far.
+        The hasher cannot be used again afterwards.
+    */
+    uint256 getSHA512Half ();
+
+private:
+    SHA512_CTX mCtx;
+};
+
 } // ripple
 
 #endif
@@ -46,6 +46,10 @@
 #include "../ripple_rpc/api/ErrorCodes.h"
 #include "../ripple/common/jsonrpc_fields.h"
 
+#include "../beast/modules/beast_core/maths/Random.h"
+
+#include <chrono>
+
 // VFALCO TODO fix these warnings!
 #if BEAST_MSVC
 #pragma warning (push)
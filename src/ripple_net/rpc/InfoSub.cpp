@@ -62,11 +62,17 @@ Resource::Consumer& InfoSub::getConsumer()
     return m_consumer;
 }
 
-void InfoSub::send (const Json::Value& jvObj, const std::string& sObj, bool broadcast)
+void InfoSub::send (const Json::Value& jvObj, Payload const& payload, bool broadcast)
 {
     send (jvObj, broadcast);
 }
 
+InfoSub::Payload InfoSub::render (const Json::Value& jvObj)
+{
+    Json::FastWriter w;
+    return boost::make_shared <std::string> (w.write (jvObj));
+}
+
 std::uint64_t InfoSub::getSeq ()
 {
     return mSeq;
@@ -44,6 +44,9 @@ public:
 
     typedef Resource::Consumer Consumer;
 
+    /** An event rendered once and shared by every subscriber it goes to. */
+    typedef boost::shared_ptr <std::string const> Payload;
+
 public:
     /** Abstracts the source of subscription data.
     */
@@ -107,8 +110,14 @@ public:
 
     virtual void send (const Json::Value & jvObj, bool broadcast) = 0;
 
-    // VFALCO NOTE Why is this virtual?
-    virtual void send (const Json::Value & jvObj, const std::string & sObj, bool broadcast);
+    /** Send an event that was already rendered.
+        Connections that write text queue the payload itself, so a
+        broadcast is serialized once however many subscribers it has.
+    */
+    virtual void send (const Json::Value & jvObj, Payload const& payload, bool broadcast);
+
+    /** Render an event for send. */
+    static Payload render (const Json::Value & jvObj);
 
     std::uint64_t getSeq ();
 
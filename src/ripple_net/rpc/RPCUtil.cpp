@@ -176,6 +176,32 @@ std::string HTTPReply (int nStatus, const std::string& strMsg)
     return ret;
 }
 
+std::string HTTPStreamHeader ()
+{
+    std::string ret;
+
+    ret.reserve (256);
+
+    ret.append ("HTTP/1.1 200 OK\r\n");
+    ret.append (getHTTPHeaderTimestamp ());
+
+    // There is no Content-Length, the body ends when the connection closes
+    ret.append ("Connection: close\r\n");
+
+    if (getConfig ().RPC_ALLOW_REMOTE)
+        ret.append ("Access-Control-Allow-Origin: *\r\n");
+
+    ret.append ("Content-Type: application/json; charset=UTF-8\r\n");
+
+    ret.append ("Server: " SYSTEM_NAME "-json-rpc/");
+    ret.append (BuildInfo::getFullVersionString ());
+    ret.append ("\r\n");
+
+    ret.append ("\r\n");
+
+    return ret;
+}
+
 int ReadHTTPStatus (std::basic_istream<char>& stream)
 {
     std::string str;
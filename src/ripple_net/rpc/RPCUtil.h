@@ -38,6 +38,9 @@ extern std::string createHTTPPost (const std::string& strHost, const std::string
 
 extern std::string HTTPReply (int nStatus, const std::string& strMsg);
 
+// The headers of a successful reply whose body is streamed after them
+extern std::string HTTPStreamHeader ();
+
 // VFALCO TODO Create a HTTPHeaders class with a nice interface instead of the std::map
 //
 extern bool HTTPAuthorized (std::map <std::string, std::string> const& mapHeaders);
@@ -33,6 +33,8 @@
 //        just include what is needed.
 #include "../ripple_app/ripple_app.h"
 
+#include "SendQueue.h"
+
 #include <cstdint>
 
 namespace ripple {
@@ -194,8 +196,14 @@ public:
     boost::asio::deadline_timer         m_timer;
 
     std::vector<uint8_t>                m_readBuffer;
-    std::list<Message::pointer>   mSendQ;
-    Message::pointer              mSendingPacket;
+
+    // Messages waiting for the write in progress to finish
+    SendQueue                     mSendQ;
+
+    // Messages copied into the write in progress, back to back
+    std::vector<uint8_t>          m_writeBuffer;
+    bool                          m_writing;
+
     protocol::TMStatusChange            mLastStatus;
     protocol::TMHello                   mHello;
 
@@ -235,6 +243,7 @@ public:
             , m_minLedger (0)
             , m_maxLedger (0)
             , m_timer (m_owned_socket.get_io_service())
+            , m_writing (false)
             , m_slot (slot)
             , m_was_canceled (false)
     {
@@ -272,6 +281,7 @@ public:
             , m_minLedger (0)
             , m_maxLedger (0)
             , m_timer (io_service)
+            , m_writing (false)
             , m_slot (slot)
             , m_was_canceled (false)
     {
@@ -463,14 +473,13 @@ public:
                 return;
             }
 
-            if (mSendingPacket)
-            {
-                mSendQ.push_back (packet);
-            }
-            else
-            {
-                sendPacketForce (packet);
-            }
+            if (m_detaching)
+                return;
+
+            mSendQ.push (packet);
+
+            if (! m_writing)
+                sendQueued ();
         }
     }
 
@@ -538,6 +547,12 @@ public:
         if (!!m_closedLedgerHash)
             ret["ledger"] = to_string (m_closedLedgerHash);
 
+        if (mSendQ.size () != 0)
+        {
+            ret["send_queue"] = static_cast <Json::UInt> (mSendQ.size ());
+            ret["send_queue_bytes"] = static_cast <Json::UInt> (mSendQ.bytes ());
+        }
+
         if (mLastStatus.has_newstatus ())
         {
             switch (mLastStatus.newstatus ())
@@ -671,7 +686,7 @@ private:
 
         // Call on IO strand
 
-        mSendingPacket.reset ();
+        m_writing = false;
 
         if (ec == boost::asio::error::operation_aborted)
             return;
@@ -687,15 +702,7 @@ private:
         }
 
         if (!mSendQ.empty ())
-        {
-            Message::pointer packet = mSendQ.front ();
-
-            if (packet)
-            {
-                sendPacketForce (packet);
-                mSendQ.pop_front ();
-            }
-        }
+            sendQueued ();
     }
 
     void handleReadHeader (boost::system::error_code const& ec,
@@ -1182,15 +1189,20 @@ private:
         }
     }
 
-    void sendPacketForce (const Message::pointer& packet)
+    /** Write as much of the send queue as fits in one write.
+        @see SendQueue::fill
+    */
+    void sendQueued ()
     {
         // must be on IO strand
-        if (!m_detaching)
+        if (!m_detaching && !mSendQ.empty ())
         {
-            mSendingPacket = packet;
+            mSendQ.fill (m_writeBuffer);
+
+            m_writing = true;
 
             boost::asio::async_write (getStream (),
-                boost::asio::buffer (packet->getBuffer ()),
+                boost::asio::buffer (m_writeBuffer),
                 m_strand.wrap (boost::bind (
                     &PeerImp::handleWrite,
                     boost::static_pointer_cast <PeerImp> (shared_from_this ()),
@@ -2066,13 +2078,9 @@ private:
         m_journal.trace << "Received " << (isTrusted ? "trusted" : "UNTRUSTED") <<
                            " proposal from " << m_shortId;
 
-        uint256 consensusLCL;
-        
-        {
-            Application::ScopedLockType lock (getApp ().getMasterLock ());
-            consensusLCL = getApp().getOPs ().getConsensusLCL ();
-        }
-        
+        // Published by the consensus round, so no lock is needed
+        uint256 const consensusLCL (getApp().getOPs ().getConsensusLCL ());
+
         LedgerProposal::pointer proposal = boost::make_shared<LedgerProposal> (
             prevLedger.isNonZero () ? prevLedger : consensusLCL,
             set.proposeseq (), proposeHash, set.closetime (), signerPublic, suppression);
@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#include "SendQueue.h"
+
+#include "../../beast/beast/unit_test/suite.h"
+
+namespace ripple {
+
+SendQueue::SendQueue (std::size_t maxBytes)
+    : m_maxBytes (maxBytes)
+    , m_size (0)
+    , m_bytes (0)
+{
+}
+
+void SendQueue::push (Message::pointer const& message)
+{
+    m_queue.push_back (message);
+    ++m_size;
+    m_bytes += message->getBuffer ().size ();
+}
+
+std::size_t SendQueue::fill (std::vector <uint8_t>& buffer)
+{
+    std::size_t taken = 0;
+
+    buffer.clear ();
+
+    while (!m_queue.empty ())
+    {
+        std::vector <uint8_t> const& data (m_queue.front ()->getBuffer ());
+
+        if (!buffer.empty () && (buffer.size () + data.size () > m_maxBytes))
+            break;
+
+        buffer.insert (buffer.end (), data.begin (), data.end ());
+
+        --m_size;
+        m_bytes -= data.size ();
+        m_queue.pop_front ();
+        ++taken;
+    }
+
+    return taken;
+}
+
+void SendQueue::clear ()
+{
+    m_queue.clear ();
+    m_size = 0;
+    m_bytes = 0;
+}
+
+//------------------------------------------------------------------------------
+
+class SendQueue_test : public beast::unit_test::suite
+{
+public:
+    // A message whose payload is bytes long, filled with a marker
+    static Message::pointer makeMessage (std::size_t bytes, char marker)
+    {
+        protocol::TMTransaction tm;
+        tm.set_rawtransaction (std::string (bytes, marker));
+        tm.set_status (protocol::tsNEW);
+        return boost::make_shared <Message> (tm, protocol::mtTRANSACTION);
+    }
+
+    // Append the messages to what should be written
+    static void append (std::vector <uint8_t>& expected, Message::pointer const& message)
+    {
+        expected.insert (expected.end (),
+            message->getBuffer ().begin (), message->getBuffer ().end ());
+    }
+
+    void testBudget ()
+    {
+        testcase ("budget");
+
+        SendQueue queue;
+        std::vector <Message::pointer> messages;
+        std::size_t total = 0;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            messages.push_back (makeMessage (2000, 'a' + (i % 26)));
+            queue.push (messages.back ());
+            total += messages.back ()->getBuffer ().size ();
+        }
+
+        expect (queue.size () == messages.size (), "Messages counted");
+        expect (queue.bytes () == total, "Bytes counted");
+
+        std::size_t const messageBytes = messages.front ()->getBuffer ().size ();
+        std::size_t const perWrite = SendQueue::maxWriteBytes / messageBytes;
+        std::size_t next = 0;
+        std::vector <uint8_t> buffer;
+
+        while (!queue.empty ())
+        {
+            std::size_t const taken = queue.fill (buffer);
+
+            expect (buffer.size () <= SendQueue::maxWriteBytes, "Write within the budget");
+            expect ((taken == perWrite) || (next + taken == messages.size ()),
+                "Write takes as many messages as fit");
+
+            std::vector <uint8_t> expected;
+
+            for (std::size_t i = next; i < next + taken; ++i)
+                append (expected, messages [i]);
+
+            expect (buffer == expected, "Messages written back to back in order");
+
+            next += taken;
+            expect (queue.size () == messages.size () - next, "Messages counted down");
+        }
+
+        expect (next == messages.size (), "Every message written");
+        expect (queue.size () == 0, "No messages left");
+        expect (queue.bytes () == 0, "No bytes left");
+    }
+
+    void testOversized ()
+    {
+        testcase ("oversized");
+
+        SendQueue queue;
+        Message::pointer const small1 = makeMessage (100, 'a');
+        Message::pointer const large = makeMessage (SendQueue::maxWriteBytes + 1000, 'b');
+        Message::pointer const small2 = makeMessage (100, 'c');
+
+        queue.push (small1);
+        queue.push (large);
+        queue.push (small2);
+
+        std::vector <uint8_t> buffer;
+
+        expect (queue.fill (buffer) == 1, "Small message not joined to the large one");
+        expect (buffer == small1->getBuffer (), "Small message written");
+
+        expect (queue.fill (buffer) == 1, "Large message sent alone");
+        expect (buffer == large->getBuffer (), "Large message written whole");
+
+        expect (queue.fill (buffer) == 1, "Next message after the large one");
+        expect (buffer == small2->getBuffer (), "Small message written");
+
+        expect (queue.fill (buffer) == 0, "Nothing left");
+        expect (buffer.empty (), "Nothing written");
+        expect (queue.size () == 0, "No messages left");
+        expect (queue.bytes () == 0, "No bytes left");
+    }
+
+    void testClear ()
+    {
+        testcase ("clear");
+
+        SendQueue queue;
+
+        for (int i = 0; i < 10; ++i)
+            queue.push (makeMessage (10000, 'x'));
+
+        std::vector <uint8_t> buffer;
+        queue.fill (buffer);
+        expect (queue.size () != 0, "Messages still waiting");
+
+        queue.clear ();
+        expect (queue.empty (), "Queue is empty");
+        expect (queue.size () == 0, "No messages left");
+        expect (queue.bytes () == 0, "No bytes left");
+    }
+
+    void run ()
+    {
+        testBudget ();
+        testOversized ();
+        testClear ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SendQueue,overlay,ripple);
+
+}
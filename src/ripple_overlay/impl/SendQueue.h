@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of rippled: https://github.com/ripple/rippled
+    Copyright (c) 2012, 2013 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+
+#ifndef RIPPLE_OVERLAY_SENDQUEUE_H_INCLUDED
+#define RIPPLE_OVERLAY_SENDQUEUE_H_INCLUDED
+
+#include "../api/Message.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace ripple {
+
+/** Messages waiting to be written to a peer.
+
+    The queue is only changed on the peer's strand. Its depth and size are
+    kept in atomics so they can be reported from any thread.
+*/
+class SendQueue
+{
+public:
+    /** The most queued bytes gathered into a single write */
+    static std::size_t const maxWriteBytes = 64 * 1024;
+
+    explicit SendQueue (std::size_t maxBytes = maxWriteBytes);
+
+    bool empty () const
+    {
+        return m_queue.empty ();
+    }
+
+    /** Number of messages waiting. */
+    std::size_t size () const
+    {
+        return m_size;
+    }
+
+    /** Number of bytes waiting. */
+    std::size_t bytes () const
+    {
+        return m_bytes;
+    }
+
+    void push (Message::pointer const& message);
+
+    /** Move messages from the front of the queue into one write.
+
+        Messages are copied back to back into buffer, up to the limit in
+        bytes, so that a burst of small messages costs one write and fills
+        TLS records instead of sending one record per message. A message
+        larger than the limit is still taken, on its own.
+
+        @return the number of messages taken.
+    */
+    std::size_t fill (std::vector <uint8_t>& buffer);
+
+    /** Drop every message. */
+    void clear ();
+
+private:
+    std::size_t const m_maxBytes;
+    std::deque <Message::pointer> m_queue;
+    std::atomic <std::size_t> m_size;
+    std::atomic <std::size_t> m_bytes;
+};
+
+}
+
+#endif
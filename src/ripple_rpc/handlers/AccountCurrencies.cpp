@@ -21,7 +21,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doAccountCurrencies (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     // Get the current ledger
     Ledger::pointer lpLedger;
     Json::Value jvResult (RPC::lookupLedger (params, lpLedger, *mNetOps));
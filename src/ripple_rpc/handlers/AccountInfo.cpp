@@ -28,8 +28,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doAccountInfo (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     Ledger::pointer     lpLedger;
     Json::Value         jvResult    = RPC::lookupLedger (params, lpLedger, *mNetOps);
 
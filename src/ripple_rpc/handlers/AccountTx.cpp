@@ -31,8 +31,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     RippleAddress   raAccount;
     int             limit       = params.isMember (jss::limit) ? params[jss::limit].asUInt () : -1;
     bool            bBinary     = params.isMember ("binary") && params["binary"].asBool ();
@@ -97,7 +95,21 @@ Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadT
         Json::Value ret (Json::objectValue);
 
         ret["account"] = raAccount.humanAccountID ();
-        Json::Value& jvTxns = (ret["transactions"] = Json::arrayValue);
+
+        // When the transport can take them, the transactions are written
+        // one at a time instead of being collected into the result
+        Json::Value jvTxns (Json::arrayValue);
+
+        if (mStream)
+            mStream->startArray ("transactions");
+
+        auto const append = [this, &jvTxns] (Json::Value& jvObj)
+        {
+            if (mStream)
+                mStream->append (jvObj);
+            else
+                jvTxns.append (std::move (jvObj));
+        };
 
         if (bBinary)
         {
@@ -107,7 +119,7 @@ Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadT
             for (std::vector<NetworkOPs::txnMetaLedgerType>::const_iterator it = txns.begin (), end = txns.end ();
                     it != end; ++it)
             {
-                Json::Value& jvObj = jvTxns.append (Json::objectValue);
+                Json::Value jvObj (Json::objectValue);
 
                 std::uint32_t uLedgerIndex = std::get<2> (*it);
                 jvObj["tx_blob"]           = std::get<0> (*it);
@@ -115,6 +127,7 @@ Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadT
                 jvObj["ledger_index"]      = uLedgerIndex;
                 jvObj[jss::validated]      = bValidated && uValidatedMin <= uLedgerIndex && uValidatedMax >= uLedgerIndex;
 
+                append (jvObj);
             }
         }
         else
@@ -124,7 +137,7 @@ Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadT
 
             for (std::vector< std::pair<Transaction::pointer, TransactionMetaSet::pointer> >::iterator it = txns.begin (), end = txns.end (); it != end; ++it)
             {
-                Json::Value&    jvObj = jvTxns.append (Json::objectValue);
+                Json::Value     jvObj (Json::objectValue);
 
                 if (it->first)
                     jvObj[jss::tx]          = it->first->getJson (1);
@@ -137,9 +150,15 @@ Json::Value RPCHandler::doAccountTx (Json::Value params, Resource::Charge& loadT
                     jvObj[jss::validated]   = bValidated && uValidatedMin <= uLedgerIndex && uValidatedMax >= uLedgerIndex;
                 }
 
+                append (jvObj);
             }
         }
 
+        if (mStream)
+            mStream->finish ();
+        else
+            ret["transactions"] = std::move (jvTxns);
+
         //Add information about the original query
         ret[jss::ledger_index_min] = uLedgerMin;
         ret[jss::ledger_index_max] = uLedgerMax;
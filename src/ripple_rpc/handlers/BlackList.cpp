@@ -22,7 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doBlackList (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock();
     if (params.isMember("threshold"))
         return getApp().getResourceManager().getJson(params["threshold"].asInt());
     else
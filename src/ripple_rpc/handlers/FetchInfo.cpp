@@ -22,8 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doFetchInfo (Json::Value jvParams, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     Json::Value ret (Json::objectValue);
 
     if (jvParams.isMember("clear") && jvParams["clear"].asBool())
@@ -70,6 +70,10 @@ Json::Value RPCHandler::doGetCounts (Json::Value params, Resource::Charge& loadT
     ret["fullbelow_size"] = int(getApp().getFullBelowCache().size());
     ret["treenode_size"] = SHAMap::getTreeNodeSize ();
 
+    ret["node_cache_KB"] = static_cast<Json::UInt> (getApp().getNodeStore ().getCacheBytes () >> 10);
+    ret["node_neg_cache_KB"] = static_cast<Json::UInt> (getApp().getNodeStore ().getNegativeCacheBytes () >> 10);
+    ret["treenode_KB"] = static_cast<Json::UInt> (SHAMap::getTreeNodeBytes () >> 10);
+
     std::string uptime;
     int s = UptimeTimer::getInstance ().getElapsedSeconds ();
     textTime (uptime, s, "year", 365 * 24 * 60 * 60);
@@ -26,8 +26,6 @@ namespace ripple {
 	// pull the inflate seq # from the ledger
 	Json::Value RPCHandler::doInflate(Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 	{
-		masterLockHolder.unlock();
-
 		loadType = Resource::feeMediumBurdenRPC;
 
 		uint32 inflationSeq = getApp().getLedgerMaster().getClosedLedger()->getInflationSeq();
@@ -27,7 +27,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doLedger (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     if (!params.isMember ("ledger") && !params.isMember ("ledger_hash") && !params.isMember ("ledger_index"))
     {
         Json::Value ret (Json::objectValue), current (Json::objectValue), closed (Json::objectValue);
@@ -76,7 +75,11 @@ Json::Value RPCHandler::doLedger (Json::Value params, Resource::Charge& loadType
 
 
     Json::Value ret (Json::objectValue);
-    lpLedger->addJson (ret, iOptions);
+
+    if (mStream)
+        lpLedger->addJson (*mStream, iOptions);
+    else
+        lpLedger->addJson (ret, iOptions);
 
     return ret;
 }
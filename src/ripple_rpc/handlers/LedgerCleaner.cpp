@@ -22,7 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doLedgerCleaner (Json::Value parameters, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock();
     getApp().getLedgerMaster().doLedgerCleaner (parameters);
     return "Cleaner configured";
 }
@@ -22,7 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doLedgerCurrent (Json::Value, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     Json::Value jvResult;
 
     jvResult["ledger_current_index"]    = mNetOps->getCurrentLedgerID ();
@@ -32,8 +32,6 @@ namespace ripple {
 //     marker:       resume point, if any
 Json::Value RPCHandler::doLedgerData (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     int const BINARY_PAGE_LENGTH = 256;
     int const JSON_PAGE_LENGTH = 2048;
 
@@ -85,6 +83,9 @@ Json::Value RPCHandler::doLedgerData (Json::Value params, Resource::Charge& load
     Json::Value& nodes = (jvReply["state"] = Json::arrayValue);
     SHAMap& map = *(lpLedger->peekAccountStateMap ());
 
+    // Paging through the state shouldn't evict the working set
+    NodeStore::Database::ScopedNoCache noCache;
+
     for (;;)
     {
        SHAMapItem::pointer item = map.peekNextItem (resumePoint);
@@ -22,7 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doLogRotate (Json::Value, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     return LogSink::get()->rotateLog ();
 }
 
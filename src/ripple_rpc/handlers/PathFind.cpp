@@ -23,7 +23,6 @@ namespace ripple {
 Json::Value RPCHandler::doPathFind (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
     Ledger::pointer lpLedger = mNetOps->getClosedLedger();
-    masterLockHolder.unlock();
 
     if (!params.isMember ("subcommand") || !params["subcommand"].isString ())
         return rpcError (rpcINVALID_PARAMS);
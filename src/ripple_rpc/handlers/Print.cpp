@@ -22,8 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doPrint (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     JsonPropertyStream stream;
     if (params.isObject() && params["params"].isArray() && params["params"][0u].isString ())
         getApp().write (stream, params["params"][0u].asString());
@@ -28,7 +28,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doProofCreate (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     // XXX: Add ability to create proof with arbitrary time
 
     Json::Value     jvResult (Json::objectValue);
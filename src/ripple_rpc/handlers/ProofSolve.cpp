@@ -25,8 +25,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doProofSolve (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     Json::Value         jvResult;
 
     if (!params.isMember ("token"))
@@ -29,7 +29,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doProofVerify (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     // XXX Add ability to check proof against arbitrary time
 
     Json::Value         jvResult;
@@ -26,7 +26,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doRandom (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     uint256         uRandom;
 
     try
@@ -24,8 +24,6 @@ namespace ripple {
 // This interface is deprecated.
 Json::Value RPCHandler::doRipplePathFind (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     RPC::LegacyPathFind lpf (mRole == Config::ADMIN);
     if (!lpf.isOk ())
         return rpcError (rpcTOO_BUSY);
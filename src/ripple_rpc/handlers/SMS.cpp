@@ -22,7 +22,6 @@ namespace ripple {
 
 Json::Value RPCHandler::doSMS (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     if (!params.isMember ("text"))
         return rpcError (rpcINVALID_PARAMS);
 
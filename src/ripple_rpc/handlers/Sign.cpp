@@ -26,8 +26,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doSign (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     loadType = Resource::feeHighBurdenRPC;
     bool bFailHard = params.isMember ("fail_hard") && params["fail_hard"].asBool ();
     return RPC::transactionSign (params, false, bFailHard, masterLockHolder, *mNetOps, mRole);
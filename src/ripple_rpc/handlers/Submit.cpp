@@ -26,8 +26,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doSubmit (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     loadType = Resource::feeMediumBurdenRPC;
 
     if (!params.isMember ("tx_blob"))
@@ -25,8 +25,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doTx (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     if (!params.isMember (jss::transaction))
         return rpcError (rpcINVALID_PARAMS);
 
@@ -25,7 +25,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doTxHistory (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
     loadType = Resource::feeMediumBurdenRPC;
 
     if (!params.isMember ("start"))
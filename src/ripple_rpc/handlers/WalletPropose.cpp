@@ -25,8 +25,6 @@ namespace ripple {
 // }
 Json::Value RPCHandler::doWalletPropose (Json::Value params, Resource::Charge& loadType, Application::ScopedLockType& masterLockHolder)
 {
-    masterLockHolder.unlock ();
-
     RippleAddress   naSeed;
 
     if (!params.isMember ("passphrase"))